@@ -9,6 +9,8 @@
 #include <functional>
 #include <vector>
 #include <string>
+#include <memory>
+#include "CapturedPacket.h"
 
 // For process-specific audio capture (Windows 10 Build 20348+)
 #include <audioclientactivationparams.h>
@@ -48,16 +50,24 @@ public:
     // Check if currently paused
     bool IsPaused() const { return m_isPaused; }
 
+    // Check if the stream delivers packets via event callback (vs 10ms polling)
+    bool IsEventDriven() const { return m_eventDriven; }
+
     // Get audio format information
     WAVEFORMATEX* GetFormat() const { return m_waveFormat; }
 
-    // Set callback for audio data (called when new audio data is available)
-    void SetDataCallback(std::function<void(const BYTE*, UINT32)> callback) {
+    // Packets dropped because the delivery thread fell behind the capture thread
+    UINT64 GetOverrunCount() const { return m_packetRing ? m_packetRing->Overruns() : 0; }
+
+    // Set callback for audio data (called on the delivery thread, never on the capture thread)
+    using DataCallback = std::function<void(const BYTE*, UINT32, const AudioPacketTiming&)>;
+    void SetDataCallback(DataCallback callback) {
         m_dataCallback = callback;
     }
 
-    // Set volume multiplier (0.0 to 1.0)
-    void SetVolume(float volume) { m_volumeMultiplier = volume; }
+    // Set volume multiplier (0.0 to 1.0). Safe to call while capturing; the
+    // change is ramped in over the next captured buffer.
+    void SetVolume(float volume) { m_volumeMultiplier.store(volume, std::memory_order_relaxed); }
 
     // Enable/disable audio passthrough to a render device
     bool EnablePassthrough(const std::wstring& deviceId);
@@ -66,8 +76,14 @@ public:
 
 private:
     void CaptureThread();
+    void DeliveryThread();
+    void ProcessPacket(const CapturePacket& packet);
+    void AllocatePacketRing();
+    void DeliverSilence(UINT32 size, const AudioPacketTiming& timing);
+    void WritePassthrough(const BYTE* data, UINT32 frames);
     bool InitializeProcessSpecificCapture(DWORD processId);
     bool InitializeSystemWideCapture();
+    HRESULT InitializeAudioClient(DWORD streamFlags);
     void ApplyVolumeToBuffer(BYTE* data, UINT32 size);
 
     IMMDeviceEnumerator* m_deviceEnumerator;
@@ -79,10 +95,21 @@ private:
     std::atomic<bool> m_isCapturing;
     std::atomic<bool> m_isPaused;
     std::thread m_captureThread;
-    std::function<void(const BYTE*, UINT32)> m_dataCallback;
+    std::unique_ptr<CaptureSource> m_source;
+    HANDLE m_captureEvent;  // Signaled by WASAPI each period when m_eventDriven
+    bool m_eventDriven;
+    DataCallback m_dataCallback;
+
+    // Capture thread publishes into m_packetRing, delivery thread drains it
+    // into m_dataCallback so a slow consumer can't stall the audio thread
+    std::unique_ptr<SpscRing<CapturedPacket>> m_packetRing;
+    std::thread m_deliveryThread;
+    std::atomic<bool> m_isDelivering;
+    HANDLE m_deliveryEvent;
 
     DWORD m_targetProcessId;
-    float m_volumeMultiplier;
+    std::atomic<float> m_volumeMultiplier;  // Requested volume (any thread)
+    float m_appliedVolume;                  // Volume at the end of the last buffer (capture thread)
     bool m_isProcessSpecific;
     bool m_isInputDevice;  // True if capturing from input device (mic), false if loopback
 
@@ -5,45 +5,243 @@
 #include <vector>
 #include <mutex>
 #include <map>
+#include <memory>
+#include <atomic>
+#include "AudioRingBuffer.h"
+#include "DriftController.h"
+#include "PeakLimiter.h"
+#include "Resampler.h"
+#include "SampleFormat.h"
 
-// Simple audio mixer that combines multiple audio streams by summing samples
+// How AudioMixer places its sources in the output
+enum class MixRouting {
+    Sum,          // Every source mapped onto the output layout and summed
+    SplitStereo   // Stereo output; each source down-mixed to mono on one channel
+};
+
+// Audio mixer that combines multiple audio streams by summing samples.
+//
+// Sources may use any PCM / float format: each packet is converted on
+// arrival (sample type, channel layout, then rate) to float at the mixer's
+// rate and channel count, and the sum goes through a look-ahead peak
+// limiter before it is converted to the output format once per
+// GetMixedAudio() call.
+//
+// Sources share one timeline of output frames. Packets that carry a capture
+// timestamp (QPC) are placed on it by time: a late or lost packet leaves
+// silence where it belongs instead of shifting the rest of that source.
+// Packets without one are placed by arrival order.
+//
+// With drift compensation on (the default), every source runs through its
+// resampler with a small ratio correction from a DriftController, so mic and
+// loopback captured on different hardware clocks stay aligned over long
+// calls instead of slipping apart and underrunning. Timestamped sources are
+// steered by the error between their stream position and their timestamps;
+// the others by their fill level relative to a reference source.
+//
+// In SplitStereo routing each source feeds a single output channel
+// (SetSourceChannel), so two parties recorded into one stereo file stay
+// separable. Sources are down-mixed to mono before resampling and each
+// channel gets its own limiter, so a loud party never ducks the other.
 class AudioMixer {
 public:
+    // Clock tracking state for one source (see GetClockStats)
+    struct SourceClockStats {
+        DWORD sourceId;
+        bool reference;      // The clock untimestamped sources are locked to
+        bool timestamped;    // Placed and steered by capture timestamps
+        double driftPpm;     // Correction applied = clock offset vs. the reference (+ = runs fast)
+        double latencyMs;    // Audio currently buffered for this source
+    };
+
     AudioMixer();
     ~AudioMixer();
 
-    // Initialize with the target audio format (mixer output format)
-    bool Initialize(const WAVEFORMATEX* format);
+    // Initialize with the target audio format (mixer output format). The
+    // full format is kept, including the WAVEFORMATEXTENSIBLE part.
+    // SplitStereo routing needs a 2-channel format.
+    bool Initialize(const WAVEFORMATEX* format, MixRouting routing = MixRouting::Sum);
+
+    MixRouting GetRouting() const { return m_routing; }
+
+    // SplitStereo: output channel (0 = left, 1 = right) a source goes to;
+    // sources without one go right. Set it before the source's first packet;
+    // a later change restarts that source's conversion.
+    void SetSourceChannel(DWORD sourceId, UINT32 channel);
+
+    // Output format as passed to Initialize
+    const WAVEFORMATEX* GetFormat() const {
+        return m_formatStorage.empty() ? nullptr : reinterpret_cast<const WAVEFORMATEX*>(m_formatStorage.data());
+    }
 
     // Add audio data from a specific source (identified by sourceId)
     // The sourceFormat parameter specifies the format of the incoming data
-    // Audio will be resampled to match the mixer's target format if needed
-    void AddAudioData(DWORD sourceId, const BYTE* data, UINT32 size, const WAVEFORMATEX* sourceFormat);
+    // Audio will be converted to match the mixer's target format if needed.
+    // timestamp is the QPC time of the first frame in 100 ns units (0 if
+    // unknown); discontinuity marks frames lost just before this packet.
+    void AddAudioData(DWORD sourceId, const BYTE* data, UINT32 size, const WAVEFORMATEX* sourceFormat,
+                      UINT64 timestamp = 0, bool discontinuity = false);
 
     // Get the mixed audio buffer (call this periodically to get mixed output)
     // Returns true if there's data available, false otherwise
     bool GetMixedAudio(std::vector<BYTE>& outBuffer);
 
+    // Mix exactly frameCount frames. Returns false, consuming nothing, until
+    // that many are ready.
+    bool GetMixedAudio(std::vector<BYTE>& outBuffer, size_t frameCount);
+
+    // Mix everything still buffered, including the kTargetLatencyMs held
+    // back for drift compensation and the limiter's look-ahead, for the last
+    // block of a recording. Returns false if nothing is buffered.
+    bool DrainMixedAudio(std::vector<BYTE>& outBuffer);
+
+    // Frames GetMixedAudio() would return now
+    size_t GetReadyFrames();
+
     // Remove a source (call when capture stops for a process/device)
     void RemoveSource(DWORD sourceId);
 
     // Clear all pending audio data
     void Clear();
 
+    // Frames discarded because a source ran more than kMaxBufferedSeconds ahead
+    // or was realigned, summed over every source since the last Clear()
+    // (removed ones included)
+    UINT64 GetDroppedFrameCount();
+
+    // Lock sources to a reference clock through their resamplers (default
+    // on). Also holds kTargetLatencyMs of audio back so late packets still
+    // make the block they belong to.
+    void SetDriftCompensation(bool enabled);
+
+    // Per-source drift and buffering, for diagnostics
+    std::vector<SourceClockStats> GetClockStats();
+
+    // Limiter for the summed output (enabled at -1 dBFS by default). Takes
+    // effect at once; changing it restarts the limiter's look-ahead.
+    void SetLimiter(const LimiterSettings& settings);
+
+    // Map a WAVEFORMATEX / WAVEFORMATEXTENSIBLE onto the conversion layer's
+    // description. Returns false for formats the mixer can't read.
+    static bool DescribeFormat(const WAVEFORMATEX* format, SampleFormat& out);
+
 private:
+    // A source that stalls the others is trimmed once it holds more than
+    // kMaxBufferedSeconds, back down to the newest kKeepBufferedSeconds
+    static constexpr UINT32 kMaxBufferedSeconds = 5;
+    static constexpr UINT32 kKeepBufferedSeconds = 2;
+
+    // Accumulator block for MixSamples (16 KB of float, stays in L1), used
+    // in whole frames so the limiter sees complete frames
+    static constexpr size_t kMixBlockSamples = 4096;
+
+    static constexpr ResamplerQuality kResamplerQuality = ResamplerQuality::Medium;
+
+    // Drift compensation: audio held back in the leading source, and the fill
+    // error past which a source is realigned at once instead of steered
+    static constexpr UINT32 kTargetLatencyMs = 50;
+    static constexpr UINT32 kResyncMs = 200;
+
+    // A timestamped packet further than this from where its stream puts it
+    // is moved (lost packets, device glitches); closer is drift and steered
+    static constexpr UINT32 kPlacementToleranceMs = 6;
+
     struct AudioBuffer {
-        std::vector<BYTE> data;
-        UINT32 readPosition;
+        AudioRingBuffer ring;           // Interleaved float frames at the mixer rate/channels
+        std::vector<float> mixScratch;  // Read-out block for MixSamples, reused across calls
+        DriftController drift;          // Rate correction relative to the reference source
+        size_t pendingSilence = 0;      // Frames of silence to mix before the ring's contents
+        bool aligned = false;           // false until placed on the timeline (and after an underrun)
+        bool timed = false;             // Last packet carried a capture timestamp
+
+        // Frames this source can supply, including the silence queued in front
+        size_t Fill() const { return ring.Available() + pendingSilence; }
     };
 
-    WAVEFORMATEX m_format;  // Target output format
+    std::vector<BYTE> m_formatStorage;  // Full output format (WAVEFORMATEX + extension)
+    SampleFormat m_output;              // Parsed output format
+    MixRouting m_routing;
+    std::map<DWORD, UINT32> m_sourceChannels;  // SplitStereo channel per source
+    LimiterSettings m_limiterSettings;
+    PeakLimiter m_limiter;              // Replaces hard clipping of the sum
+    PeakLimiter m_channelLimiters[2];   // SplitStereo: one per channel instead
     bool m_initialized;
+    std::atomic<bool> m_driftCompensation;
     std::mutex m_mutex;
     std::map<DWORD, AudioBuffer> m_buffers;  // Per-source audio buffers
+    std::vector<const float*> m_mixSources;  // MixFrames' per-block source list, reused
+    UINT64 m_removedDroppedFrames;           // Dropped frames of sources already removed
+
+    // Source whose clock untimestamped sources follow (valid when m_hasReference)
+    bool m_hasReference;
+    DWORD m_referenceSource;
+
+    // Timeline: m_outputFrames frames have been mixed so far, and timestamp
+    // m_timelineOriginTicks falls on frame m_timelineOriginFrame
+    UINT64 m_outputFrames;
+    bool m_hasTimeline;
+    UINT64 m_timelineOriginTicks;
+    double m_timelineOriginFrame;
+
+    // Streaming conversion state for one source. Only the source's own
+    // capture thread uses it once looked up, so it is shared_ptr-owned and
+    // converted outside m_mutex.
+    struct SourceConverter {
+        SampleFormat format;       // Format the stages below are configured for
+        int outputChannel = -1;    // SplitStereo: the one output channel fed (-1 = whole layout)
+        ChannelMatrix matrix;      // Source layout -> mixer layout
+        Resampler resampler;       // Carries phase and history across packets
+        bool resampling = false;   // Whether `resampler` is configured and in use
+        std::atomic<double> rateAdjust{1.0};  // Drift correction, set by the mixing thread
+        double leadFrames = 0.0;   // Last packet's first frame lands this far past the output it produced began
+        std::vector<std::vector<float>> input;      // Source planes
+        std::vector<std::vector<float>> remixed;    // After the channel matrix
+        std::vector<std::vector<float>> resampled;  // After rate conversion
+        std::vector<float> output;                  // Interleaved float for the ring
+        std::vector<float> silence;                 // SplitStereo: the channels this source doesn't feed
+        std::vector<float*> planes;                 // Stage pointers, kept to avoid per-packet allocation
+        std::vector<float*> remixedPlanes;
+    };
+    std::map<DWORD, std::shared_ptr<SourceConverter>> m_converters;
+
+    // (Re)configure the limiter(s) for the current routing. Called under m_mutex.
+    void InitializeLimiters();
+
+    // Frames buffered in the fullest source. Called under m_mutex.
+    size_t BufferedFrames() const;
+
+    // Frames that can be mixed now. Called under m_mutex.
+    size_t ReadyFrames() const;
+
+    // Mix frameCount frames (at most ReadyFrames()) into outBuffer. Called
+    // under m_mutex.
+    void MixFrames(std::vector<BYTE>& outBuffer, size_t frameCount);
+
+    // Choose the reference source, steer every other source's rate toward it
+    // and realign sources that start, resume or jump. Called under m_mutex
+    // before frameCount frames are read.
+    void TrackClocks(size_t frameCount);
+
+    // Check a timestamped packet against the source's stream position: steer
+    // the drift loop if it is close, otherwise move the stream to the
+    // timestamp. Returns how many leading output frames of the packet belong
+    // to time that is already mixed and must be skipped. Called under m_mutex.
+    size_t PlaceTimedPacket(DWORD sourceId, AudioBuffer& buffer, UINT64 timestamp, bool discontinuity,
+                            double leadFrames, double packetSeconds);
+
+    // Move a source's fill to `targetFill` by queueing silence or dropping
+    // its oldest frames
+    void Realign(DWORD sourceId, AudioBuffer& buffer, size_t targetFill);
+
+    // Hand a source's current correction to its converter
+    void PublishRateAdjust(DWORD sourceId, const AudioBuffer& buffer);
 
-    // Mix audio samples based on format
-    void MixSamples(const std::vector<const BYTE*>& sources, BYTE* dest, UINT32 frameCount);
+    // Sum float sources, limit, and write the result in the output format
+    void MixSamples(const std::vector<const float*>& sources, BYTE* dest, size_t frameCount);
 
-    // Resample audio from source format to target format using linear interpolation
-    std::vector<BYTE> ResampleAudio(const BYTE* data, UINT32 size, const WAVEFORMATEX* sourceFormat);
+    // Convert a packet to interleaved float at the mixer rate and channel
+    // count. Returns the frames (possibly `data` itself when no conversion is
+    // needed) and sets frameCount.
+    const float* ConvertSource(SourceConverter& converter, const BYTE* data, UINT32 size,
+                               const SampleFormat& format, size_t& frameCount);
 };
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Per-source frame FIFO for the mixer.
+//
+// Storage is a power-of-two number of frames, so wrapping is a mask and
+// neither writes nor reads ever move buffered audio. Read and write
+// positions are absolute 64-bit frame counters (they never wrap in
+// practice), which keeps Available() a subtraction and lets callers reason
+// about stream position.
+//
+// Overflow policy is explicit: writing into a full buffer drops the oldest
+// frames to make room, and every dropped frame is counted. Not thread-safe;
+// AudioMixer serializes access with its own mutex.
+class AudioRingBuffer {
+public:
+    AudioRingBuffer() = default;
+
+    // (Re)allocate for at least minFrames frames of frameBytes each. Clears
+    // buffered data and the drop counter.
+    void Reset(uint32_t frameBytes, size_t minFrames) {
+        size_t capacity = 1;
+        while (capacity < minFrames) {
+            capacity <<= 1;
+        }
+        m_frameBytes = frameBytes;
+        m_capacity = capacity;
+        m_mask = capacity - 1;
+        m_storage.assign(capacity * frameBytes, 0);
+        m_readIndex = 0;
+        m_writeIndex = 0;
+        m_droppedFrames = 0;
+    }
+
+    bool IsAllocated() const { return m_capacity != 0; }
+    uint32_t FrameBytes() const { return m_frameBytes; }
+    size_t Capacity() const { return m_capacity; }
+    size_t Available() const { return static_cast<size_t>(m_writeIndex - m_readIndex); }
+    uint64_t ReadIndex() const { return m_readIndex; }
+    uint64_t WriteIndex() const { return m_writeIndex; }
+
+    // Frames discarded by the overflow policy since Reset()
+    uint64_t DroppedFrames() const { return m_droppedFrames; }
+
+    // Append frames; when there is not enough room the oldest frames go first
+    void Write(const uint8_t* data, size_t frames) {
+        if (!m_capacity || !data || frames == 0) {
+            return;
+        }
+
+        // Input larger than the whole buffer: only its newest part can survive
+        if (frames > m_capacity) {
+            size_t skipped = frames - m_capacity;
+            DropOldest(Available());
+            m_droppedFrames += skipped;
+            m_writeIndex += skipped;
+            m_readIndex = m_writeIndex;
+            data += skipped * m_frameBytes;
+            frames = m_capacity;
+        }
+
+        size_t freeFrames = m_capacity - Available();
+        if (frames > freeFrames) {
+            DropOldest(frames - freeFrames);
+        }
+
+        size_t start = static_cast<size_t>(m_writeIndex & m_mask);
+        size_t first = (std::min)(frames, m_capacity - start);
+        memcpy(&m_storage[start * m_frameBytes], data, first * m_frameBytes);
+        if (first < frames) {
+            memcpy(&m_storage[0], data + first * m_frameBytes, (frames - first) * m_frameBytes);
+        }
+        m_writeIndex += frames;
+    }
+
+    // Append `frames` zeroed frames (silence for float and PCM), same overflow policy as Write
+    void WriteSilence(size_t frames) {
+        if (!m_capacity || frames == 0) {
+            return;
+        }
+
+        if (frames > m_capacity) {
+            size_t skipped = frames - m_capacity;
+            DropOldest(Available());
+            m_droppedFrames += skipped;
+            m_writeIndex += skipped;
+            m_readIndex = m_writeIndex;
+            frames = m_capacity;
+        }
+
+        size_t freeFrames = m_capacity - Available();
+        if (frames > freeFrames) {
+            DropOldest(frames - freeFrames);
+        }
+
+        size_t start = static_cast<size_t>(m_writeIndex & m_mask);
+        size_t first = (std::min)(frames, m_capacity - start);
+        memset(&m_storage[start * m_frameBytes], 0, first * m_frameBytes);
+        if (first < frames) {
+            memset(&m_storage[0], 0, (frames - first) * m_frameBytes);
+        }
+        m_writeIndex += frames;
+    }
+
+    // Copy up to `frames` frames into dest without consuming them
+    size_t Peek(uint8_t* dest, size_t frames) const {
+        frames = (std::min)(frames, Available());
+        if (frames == 0) {
+            return 0;
+        }
+
+        size_t start = static_cast<size_t>(m_readIndex & m_mask);
+        size_t first = (std::min)(frames, m_capacity - start);
+        memcpy(dest, &m_storage[start * m_frameBytes], first * m_frameBytes);
+        if (first < frames) {
+            memcpy(dest + first * m_frameBytes, &m_storage[0], (frames - first) * m_frameBytes);
+        }
+        return frames;
+    }
+
+    // Copy and consume up to `frames` frames; returns the number read
+    size_t Read(uint8_t* dest, size_t frames) {
+        size_t read = Peek(dest, frames);
+        m_readIndex += read;
+        return read;
+    }
+
+    // Consume up to `frames` frames without copying them
+    size_t Skip(size_t frames) {
+        frames = (std::min)(frames, Available());
+        m_readIndex += frames;
+        return frames;
+    }
+
+    // Discard the oldest frames under the overflow policy (counted)
+    size_t DropOldest(size_t frames) {
+        size_t dropped = Skip(frames);
+        m_droppedFrames += dropped;
+        return dropped;
+    }
+
+    void Clear() {
+        m_readIndex = m_writeIndex;
+    }
+
+private:
+    std::vector<uint8_t> m_storage;
+    uint32_t m_frameBytes = 0;
+    size_t m_capacity = 0;
+    size_t m_mask = 0;
+    uint64_t m_readIndex = 0;
+    uint64_t m_writeIndex = 0;
+    uint64_t m_droppedFrames = 0;
+};
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+// Fixed-period block clock for the mixer thread.
+//
+// The mixer emits audio in blocks of exactly one period (20 ms) instead of
+// whatever happened to be buffered. Producers call Notify() when a block's
+// worth of input is ready; the consuming thread sleeps in Wait() until then
+// (or until the next block is due, as a fallback), produces every block that
+// is ready and calls CompleteTick() for each.
+//
+// Block k is due one period after block k-1. Lateness is measured against
+// that schedule: a block more than a period late is a deadline miss and the
+// schedule restarts from it; one more than kResyncPeriods late (every
+// source stalled, long pause) restarts it without counting a miss. The
+// schedule slowly follows the actual tick times, because the blocks are
+// paced by the capture devices' clocks, which run a few hundred ppm off the
+// system clock.
+//
+// Only std:: primitives are used, and time comes from a TimeSource, so the
+// scheduling can be driven by a fake clock off Windows.
+class BlockClock {
+public:
+    using Duration = std::chrono::nanoseconds;
+
+    // Time base. Default is std::chrono::steady_clock.
+    class TimeSource {
+    public:
+        virtual ~TimeSource() = default;
+        virtual Duration Now() = 0;
+        // Wait on `cv` (lock held) until `deadline`, a notification or a
+        // spurious wakeup
+        virtual void WaitUntil(std::condition_variable& cv, std::unique_lock<std::mutex>& lock,
+                               Duration deadline) = 0;
+    };
+
+    struct Stats {
+        uint64_t ticks = 0;           // Blocks produced
+        uint64_t deadlineMisses = 0;  // Blocks produced more than a period late
+        uint64_t resyncs = 0;         // Blocks more than kResyncPeriods late (schedule restarted)
+        uint64_t wakeups = 0;         // Returns from Wait()
+        Duration maxLateness{0};      // Worst lateness of a block that didn't cause a resync
+    };
+
+    // A block later than this many periods restarts the schedule quietly
+    static constexpr int kResyncPeriods = 10;
+
+    explicit BlockClock(Duration period, TimeSource* timeSource = nullptr)
+        : m_period(period), m_time(timeSource ? timeSource : &SteadySource()) {
+    }
+
+    Duration GetPeriod() const { return m_period; }
+
+    // Producers: a block is (probably) ready. Cheap; safe from any thread.
+    void Notify() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_notified = true;
+        }
+        m_cv.notify_one();
+    }
+
+    // Make Wait() return false from now on
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_running = false;
+        }
+        m_cv.notify_one();
+    }
+
+    // Block until notified or the next block is overdue (then once a period
+    // until it arrives). Returns false after Stop().
+    bool Wait() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_running && !m_notified) {
+            // The timer is only the fallback for a notification that didn't
+            // come, so give the next block half a period of slack
+            const Duration now = m_time->Now();
+            Duration deadline = m_armed ? m_anchor + m_period * (m_blocks + 1) + m_period / 2 : now + m_period;
+            if (deadline <= now) {
+                if (m_wokeLate) {
+                    // Already woke for this overdue block; poll once a
+                    // period rather than spinning until its data arrives
+                    deadline = now + m_period;
+                } else {
+                    m_wokeLate = true;
+                    break;
+                }
+            }
+            m_time->WaitUntil(m_cv, lock, deadline);
+            if (m_time->Now() >= deadline) {
+                break;
+            }
+        }
+        m_notified = false;
+        m_stats.wakeups++;
+        return m_running;
+    }
+
+    // One block was produced just now
+    void CompleteTick() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const Duration now = m_time->Now();
+        m_stats.ticks++;
+        m_wokeLate = false;
+
+        if (!m_armed) {
+            Anchor(now);
+            return;
+        }
+
+        m_blocks++;
+        const Duration lateness = now - (m_anchor + m_period * m_blocks);
+        if (lateness > m_period * kResyncPeriods) {
+            m_stats.resyncs++;
+            Anchor(now);
+            return;
+        }
+        if (lateness > m_stats.maxLateness) {
+            m_stats.maxLateness = lateness;
+        }
+        if (lateness > m_period) {
+            // Count the miss once: the producers have shifted (a stall, a
+            // lost packet), so the blocks after this one are due from here
+            m_stats.deadlineMisses++;
+            Anchor(now);
+            return;
+        }
+
+        // Follow the producers' clock: move the schedule a small step toward
+        // where this block actually landed. A 200 ppm offset then settles at
+        // well under a millisecond of lateness.
+        m_anchor += lateness / kTrackingDivisor;
+    }
+
+    Stats GetStats() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+private:
+    static constexpr int kTrackingDivisor = 64;
+
+    class SteadyTimeSource : public TimeSource {
+    public:
+        Duration Now() override {
+            return std::chrono::duration_cast<Duration>(std::chrono::steady_clock::now().time_since_epoch());
+        }
+        void WaitUntil(std::condition_variable& cv, std::unique_lock<std::mutex>& lock,
+                       Duration deadline) override {
+            cv.wait_until(lock, std::chrono::steady_clock::time_point(
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(deadline)));
+        }
+    };
+
+    static TimeSource& SteadySource() {
+        static SteadyTimeSource source;
+        return source;
+    }
+
+    // Block 0 of a new schedule completed at `now`
+    void Anchor(Duration now) {
+        m_anchor = now;
+        m_blocks = 0;
+        m_armed = true;
+    }
+
+    const Duration m_period;
+    TimeSource* const m_time;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_running = true;
+    bool m_notified = false;
+
+    // Schedule: block m_blocks was due at m_anchor + m_blocks * m_period
+    bool m_armed = false;       // false until the first block
+    bool m_wokeLate = false;    // Wait() already returned for the overdue block
+    Duration m_anchor{0};
+    int64_t m_blocks = 0;
+
+    Stats m_stats;
+};
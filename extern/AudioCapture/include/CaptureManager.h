@@ -2,21 +2,27 @@
 
 #include "AudioCapture.h"
 #include "AudioMixer.h"
-#include "WavWriter.h"
-#include "Mp3Encoder.h"
-#include "OpusEncoder.h"
-#include "FlacEncoder.h"
+#include "BlockClock.h"
+#include "EncoderSink.h"
+#include "EncoderWorkerPool.h"
+#include "PreRollBuffer.h"
+#include "VoiceActivityDetector.h"
 #include <memory>
 #include <map>
 #include <mutex>
 #include <thread>
 #include <atomic>
-
-enum class AudioFormat {
-    WAV,
-    MP3,
-    OPUS,
-    FLAC
+#include <chrono>
+#include <functional>
+#include <string>
+
+// Encoder queue trouble already reported for one stream: the first
+// backpressure and the first refused packet are logged as they happen, the
+// counts when the stream closes
+struct EncoderQueueWarnings {
+    std::wstring label;                      // Names the stream in the log
+    std::atomic<bool> backpressure{false};
+    std::atomic<bool> rejected{false};
 };
 
 struct CaptureSession {
@@ -25,14 +31,14 @@ struct CaptureSession {
     std::wstring outputFile;
     AudioFormat format;
     std::unique_ptr<AudioCapture> capture;
-    std::unique_ptr<WavWriter> wavWriter;
-    std::unique_ptr<Mp3Encoder> mp3Encoder;
-    std::unique_ptr<OpusOggEncoder> opusEncoder;
-    std::unique_ptr<FlacEncoder> flacEncoder;
+    std::shared_ptr<EncoderWorkerPool::Stream> encoder;  // Queue to the session's sink (null when monitorOnly)
+    EncoderQueueWarnings encoderWarnings;
     bool isActive;
     UINT64 bytesWritten;
     bool skipSilence;
     bool monitorOnly;
+    bool inputDevice;   // Microphone / line-in (the local party) rather than playback
+    std::unique_ptr<PreRollBuffer> preRoll;   // Audio from before the session, kept for the next mixed recording
 };
 
 class CaptureManager {
@@ -47,6 +53,31 @@ public:
                      const std::wstring& passthroughDeviceId = L"",
                      bool monitorOnly = false);
 
+    // Keep the last `seconds` (at most maxBytes) of a process's audio in
+    // memory while it isn't being captured, so a recording can start before
+    // the call was detected. StartCapture() for the process takes over the
+    // running capture: the buffered audio goes into its file ahead of the
+    // live stream, and into the mixed recording enabled next. Returns true
+    // if the process is pre-rolling or being captured already. After a
+    // failure the process isn't tried again for a while (see
+    // m_preRollFailures); those calls return false at once.
+    bool StartPreRoll(DWORD processId, UINT32 seconds, size_t maxBytes);
+
+    // Stop a pre-roll capture and drop what it buffered
+    void StopPreRoll(DWORD processId);
+    void StopAllPreRolls();
+
+    bool IsPreRolling(DWORD processId) const;
+
+    // Run a VoiceActivityDetector on the audio of every process that is
+    // pre-rolling or being captured (not on input devices). Applies to
+    // captures started afterwards; disabling drops the running detectors.
+    void EnableVoiceActivity(bool enable, const VadSettings& settings = VadSettings());
+
+    // Frames analysed for a process since the last call. False when no
+    // detector runs for it.
+    bool TakeVoiceActivity(DWORD processId, VoiceActivityDetector::Counts& counts);
+
     // Start capturing from an audio device (microphone/line-in)
     bool StartCaptureFromDevice(DWORD sessionId, const std::wstring& deviceName,
                                 const std::wstring& deviceId, bool isInputDevice,
@@ -54,15 +85,32 @@ public:
                                 UINT32 bitrate = 0, bool skipSilence = false,
                                 bool monitorOnly = false);
 
+    // Limiter for the mixed recording; applies to the next EnableMixedRecording()
+    // and to the one in progress
+    void SetMixLimiter(const LimiterSettings& settings);
+
     // Enable mixed recording (all processes will be mixed into one file)
     bool EnableMixedRecording(const std::wstring& outputPath, AudioFormat format, UINT32 bitrate = 0);
 
-    // Disable mixed recording
+    // Like EnableMixedRecording, but into a stereo file with the parties
+    // apart: input devices (the local caller) down-mixed to mono on the left,
+    // everything else (the remote side) on the right. One file and one
+    // encoder, yet each voice can be analysed or transcribed on its own.
+    bool EnableSplitStereoRecording(const std::wstring& outputPath, AudioFormat format, UINT32 bitrate = 0);
+
+    // Disable mixed (or split stereo) recording
     void DisableMixedRecording();
 
     // Check if mixed recording is active
     bool IsMixedRecordingActive() const;
 
+    // Per-source clock drift and buffering of the mixed recording (empty when inactive)
+    std::vector<AudioMixer::SourceClockStats> GetMixerClockStats();
+
+    // Block scheduling of the mixed recording: blocks written, deadline
+    // misses, resyncs (zeros when inactive)
+    BlockClock::Stats GetMixerTimingStats();
+
     // Stop capturing from a specific process
     bool StopCapture(DWORD processId);
 
@@ -81,21 +129,123 @@ public:
     // Check if a process is being captured
     bool IsCapturing(DWORD processId) const;
 
+    // Sinks used for each AudioFormat (built-in encoders by default). Register
+    // before starting captures; sessions already running keep their sink.
+    EncoderSinkRegistry& GetSinkRegistry() { return m_sinkRegistry; }
+
+    // Encoder queue totals over every recording: packets written,
+    // backpressure, rejected packets, write failures, bytes queued now
+    EncoderWorkerPool::Stats GetEncoderStats();
+
+    // Diagnostics the manager reports on its own (lost packets, dropped
+    // audio, ...). Called on whichever thread notices; set it before
+    // starting captures.
+    using LogCallback = std::function<void(const std::wstring& message, bool warning)>;
+    void SetLogCallback(LogCallback callback) { m_logCallback = callback; }
+
 private:
-    void OnAudioData(DWORD processId, const BYTE* data, UINT32 size);
+    void LogMessage(const std::wstring& message, bool warning = false) const {
+        if (m_logCallback) m_logCallback(message, warning);
+    }
+
+    void OnAudioData(DWORD processId, const BYTE* data, UINT32 size, const AudioPacketTiming& timing);
     void MixerThread();
 
+    // Shared by EnableMixedRecording and EnableSplitStereoRecording
+    bool StartMixedRecording(const std::wstring& outputPath, AudioFormat format, UINT32 bitrate,
+                             MixRouting routing);
+
+    // Split stereo: put a source on its party's channel. Called with
+    // m_mixerMutex held, before the source's first packet.
+    void AssignMixerChannel(DWORD sourceId, bool inputDevice);
+
+    // A session that took over a pre-roll capture: queue the buffered audio
+    // for its sink, and keep it for the mixer unless a mix is already under
+    // way. Called with m_mutex and m_mixerMutex held.
+    void WritePreRoll(CaptureSession& session);
+
+    // Record a failed StartPreRoll() and schedule the next attempt
+    void PreRollFailed(DWORD processId, std::chrono::steady_clock::time_point now);
+
+    // Feed a session's pre-roll to a mixer that hasn't started, writing
+    // blocks out as they fill (the mixer holds only a few seconds per
+    // source). Called with m_mutex and m_mixerMutex held.
+    void PrimeMixer(CaptureSession& session);
+
+    // Start a detector for a process if voice activity is enabled and none
+    // runs yet. Called with m_mutex held.
+    void AttachVoiceActivity(DWORD processId, const WAVEFORMATEX* format);
+
+    // Create and open the sink for `format` and give it a queue on the
+    // encoder pool. Returns nullptr on failure.
+    std::shared_ptr<EncoderWorkerPool::Stream> OpenEncoder(AudioFormat format, const std::wstring& outputPath,
+                                                           const WAVEFORMATEX* waveFormat, UINT32 bitrate);
+
+    // A Submit() answered with Backpressure or Rejected: log it if it is the
+    // stream's first of that kind. Safe from any thread.
+    void ReportSubmit(EncoderWorkerPool::SubmitResult result, EncoderWorkerPool::Stream& stream,
+                      EncoderQueueWarnings& warnings);
+
+    // After CloseStream(): log the stream's backpressure, refused packets
+    // and write failures, if it had any
+    void ReportEncoderTotals(EncoderWorkerPool::Stream& stream, const EncoderQueueWarnings& warnings);
+
+    // Audio an encoder queue may hold: past the soft limit Submit reports
+    // backpressure, past the hard limit packets are refused
+    static constexpr UINT32 kEncoderQueueSoftSeconds = 2;
+    static constexpr UINT32 kEncoderQueueHardSeconds = 20;
+
+    // The mixer thread writes blocks of exactly this length
+    static constexpr UINT32 kMixBlockMs = 20;
+
+    // Split stereo channels
+    static constexpr UINT32 kCallerChannel = 0;   // Input devices
+    static constexpr UINT32 kCalleeChannel = 1;   // Process / playback audio
+
+    LogCallback m_logCallback;
+    EncoderSinkRegistry m_sinkRegistry;
+    std::unique_ptr<EncoderWorkerPool> m_encoderPool;   // Runs every sink's writes
     std::map<DWORD, std::unique_ptr<CaptureSession>> m_sessions;
     std::mutex m_mutex;
 
+    // Processes being captured only into memory (guarded by m_mutex)
+    struct PreRollCapture {
+        std::unique_ptr<AudioCapture> capture;
+        std::unique_ptr<PreRollBuffer> buffer;
+    };
+    std::map<DWORD, PreRollCapture> m_preRolls;
+
+    // Processes whose pre-roll capture couldn't be set up (guarded by
+    // m_mutex). StartPreRoll() skips them until retryAt, waiting twice as
+    // long after each failure, from kPreRollRetryMin up to kPreRollRetryMax.
+    struct PreRollFailure {
+        UINT32 failures = 0;
+        std::chrono::seconds delay{0};
+        std::chrono::steady_clock::time_point retryAt;
+    };
+    static constexpr std::chrono::seconds kPreRollRetryMin{10};
+    static constexpr std::chrono::seconds kPreRollRetryMax{300};
+    std::map<DWORD, PreRollFailure> m_preRollFailures;
+
+    // Voice activity per process (map guarded by m_mutex). Each detector has
+    // its own lock, so OnAudioData runs it outside m_mutex.
+    struct VoiceActivity {
+        std::mutex mutex;
+        VoiceActivityDetector detector;
+        UINT32 blockAlign = 0;
+    };
+    bool m_voiceActivityEnabled;
+    VadSettings m_vadSettings;
+    std::map<DWORD, std::shared_ptr<VoiceActivity>> m_voiceActivity;
+
     // Mixed recording members
     bool m_mixedRecordingEnabled;
     std::unique_ptr<AudioMixer> m_mixer;
-    std::unique_ptr<WavWriter> m_mixedWavWriter;
-    std::unique_ptr<Mp3Encoder> m_mixedMp3Encoder;
-    std::unique_ptr<OpusOggEncoder> m_mixedOpusEncoder;
-    std::unique_ptr<FlacEncoder> m_mixedFlacEncoder;
-    AudioFormat m_mixedFormat;
+    std::shared_ptr<EncoderWorkerPool::Stream> m_mixedEncoder;
+    EncoderQueueWarnings m_mixedEncoderWarnings;
+    LimiterSettings m_limiterSettings;
+    std::unique_ptr<BlockClock> m_mixClock;   // Paces MixerThread; producers notify it
+    size_t m_mixBlockFrames;
     std::unique_ptr<std::thread> m_mixerThread;
     std::atomic<bool> m_mixerThreadRunning;
     std::mutex m_mixerMutex;
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Platform-neutral view of a capture endpoint.
+//
+// AudioCapture drives WASAPI through this interface so the packet loop
+// itself has no COM dependency: the Windows build plugs in an
+// IAudioCaptureClient-backed source (event-driven or polling), and a fake
+// source can feed the same loop on any platform.
+
+struct CapturePacket {
+    const uint8_t* data = nullptr;  // Valid until ReleasePacket()
+    uint32_t frames = 0;
+    bool silent = false;            // Source flagged the packet as silence (data may be null)
+    bool discontinuity = false;     // Frames were lost between the previous packet and this one
+    uint64_t timestamp = 0;         // Capture time of the first frame (QPC, 100 ns units); 0 = unknown
+};
+
+enum class CaptureWaitResult {
+    Signaled,  // Source reported that a packet is ready
+    Timeout,   // Wait elapsed without a signal (drain anyway - loopback may not signal)
+    Failed     // Source is unusable, the loop must exit
+};
+
+class CaptureSource {
+public:
+    virtual ~CaptureSource() = default;
+
+    // Block until data may be available. Event-driven sources wait on
+    // their handle, polling sources simply sleep one period.
+    virtual CaptureWaitResult WaitForData() = 0;
+
+    // Unblock a pending WaitForData() (used by Stop)
+    virtual void Wake() = 0;
+
+    virtual bool GetNextPacketSize(uint32_t& frames) = 0;
+    virtual bool AcquirePacket(CapturePacket& packet) = 0;
+    virtual bool ReleasePacket(uint32_t frames) = 0;
+};
+
+// Capture loop shared by every source type.
+// Drains all queued packets after each wakeup, hands each one to onPacket,
+// and returns once running is cleared or the source fails.
+template <typename PacketHandler>
+void RunCaptureLoop(CaptureSource& source, const std::atomic<bool>& running, PacketHandler&& onPacket) {
+    while (running) {
+        if (source.WaitForData() == CaptureWaitResult::Failed) {
+            break;
+        }
+
+        // Check if we should stop
+        if (!running) {
+            break;
+        }
+
+        uint32_t packetLength = 0;
+        if (!source.GetNextPacketSize(packetLength)) {
+            break;
+        }
+
+        while (packetLength > 0 && running) {
+            CapturePacket packet;
+            if (!source.AcquirePacket(packet)) {
+                break;
+            }
+
+            onPacket(packet);
+
+            if (!source.ReleasePacket(packet.frames)) {
+                break;
+            }
+
+            // Check if we should stop before getting next packet
+            if (!running) {
+                break;
+            }
+
+            if (!source.GetNextPacketSize(packetLength)) {
+                break;
+            }
+        }
+    }
+}
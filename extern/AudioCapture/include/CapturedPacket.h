@@ -0,0 +1,88 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "CaptureSource.h"
+#include "SpscRing.h"
+
+// Capture timing handed to the data callback with each block
+struct AudioPacketTiming {
+    uint64_t timestamp = 0;      // QPC time of the block's first frame (100 ns units), 0 if unknown
+    bool discontinuity = false;  // The device lost frames just before this block
+};
+
+// One slot of the capture -> delivery ring. The buffer is allocated when the
+// ring is built (sized from the device period) and only overwritten afterwards.
+// Silent packets carry no payload: only size is set, and the delivery thread
+// hands out the shared zero page instead.
+struct CapturedPacket {
+    std::vector<uint8_t> data;
+    uint32_t size = 0;
+    bool silent = false;
+    AudioPacketTiming timing;
+};
+
+// Timestamp of the frame `bytes` into a block starting at `timestamp` (0 stays unknown)
+inline uint64_t TimestampAfter(uint64_t timestamp, uint32_t bytes, uint32_t blockAlign, uint32_t sampleRate) {
+    if (timestamp == 0 || blockAlign == 0 || sampleRate == 0) {
+        return 0;
+    }
+    const uint64_t frames = bytes / blockAlign;
+    return timestamp + frames * 10000000ull / sampleRate;
+}
+
+// Capture-thread half of AudioCapture::ProcessPacket, platform-neutral.
+// A silent packet is published as a flag and a length. Otherwise the data is
+// copied into as many slots as it needs, and onChunk(chunk, bytes) runs on
+// each copy before it is committed (volume, passthrough). When the ring is
+// full the rest is dropped; the ring counts the overrun. Returns false for an
+// empty packet or one without data, which publishes nothing.
+template <typename ChunkHandler>
+bool PublishCapturedPacket(SpscRing<CapturedPacket>& ring, const CapturePacket& packet, uint32_t blockAlign,
+                           uint32_t sampleRate, ChunkHandler&& onChunk) {
+    const uint32_t bufferSize = packet.frames * blockAlign;
+    if (bufferSize == 0 || (!packet.silent && !packet.data)) {
+        return false;
+    }
+
+    if (packet.silent) {
+        CapturedPacket* slot = ring.BeginPush();
+        if (slot) {
+            slot->size = bufferSize;
+            slot->silent = true;
+            slot->timing.timestamp = packet.timestamp;
+            slot->timing.discontinuity = packet.discontinuity;
+            ring.CommitPush();
+        }
+        return true;
+    }
+
+    uint32_t offset = 0;
+    while (offset < bufferSize) {
+        CapturedPacket* slot = ring.BeginPush();
+        if (!slot) {
+            break;
+        }
+
+        // Whole frames only, so a split never cuts a frame in two
+        const uint32_t slotBytes = static_cast<uint32_t>(slot->data.size()) / blockAlign * blockAlign;
+        if (slotBytes == 0) {
+            break;
+        }
+        const uint32_t chunkSize = (std::min)(bufferSize - offset, slotBytes);
+        uint8_t* chunk = slot->data.data();
+        memcpy(chunk, packet.data + offset, chunkSize);
+        onChunk(chunk, chunkSize);
+
+        slot->size = chunkSize;
+        slot->silent = false;
+        // Later slots of a split packet start later; only the first follows a gap
+        slot->timing.timestamp = TimestampAfter(packet.timestamp, offset, blockAlign, sampleRate);
+        slot->timing.discontinuity = packet.discontinuity && offset == 0;
+        ring.CommitPush();
+        offset += chunkSize;
+    }
+    return true;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+// Runtime SIMD detection shared by the audio kernels (gain, mixing, ...).
+// Kernels are compiled for every level the toolchain supports and picked
+// once at startup from DetectSimdLevel(), so a single binary runs on any
+// x86 CPU and still uses AVX2 where available.
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define AUDIO_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define AUDIO_SIMD_X86 0
+#endif
+
+// GCC/Clang only emit AVX2 instructions inside functions that opt in;
+// MSVC accepts the intrinsics anywhere.
+#if AUDIO_SIMD_X86 && (defined(__GNUC__) || defined(__clang__))
+#define AUDIO_TARGET_SSE2 __attribute__((target("sse2")))
+#define AUDIO_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define AUDIO_TARGET_SSE2
+#define AUDIO_TARGET_AVX2
+#endif
+
+enum class SimdLevel {
+    Scalar = 0,
+    SSE2 = 1,
+    AVX2 = 2
+};
+
+inline const char* SimdLevelName(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::AVX2: return "AVX2";
+    case SimdLevel::SSE2: return "SSE2";
+    default:              return "Scalar";
+    }
+}
+
+namespace detail {
+
+inline SimdLevel QuerySimdLevel() {
+#if AUDIO_SIMD_X86
+#if defined(_MSC_VER)
+    int info[4] = {};
+    __cpuid(info, 0);
+    const int maxLeaf = info[0];
+
+    __cpuid(info, 1);
+    const bool sse2 = (info[3] & (1 << 26)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!sse2) {
+        return SimdLevel::Scalar;
+    }
+
+    // AVX2 needs CPU support AND the OS saving YMM state on context switch
+    bool avx2 = false;
+    if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6) {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+    return avx2 ? SimdLevel::AVX2 : SimdLevel::SSE2;
+#else
+    // libgcc's probe also checks XCR0 for OS support of AVX state
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdLevel::AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return SimdLevel::SSE2;
+    }
+    return SimdLevel::Scalar;
+#endif
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+} // namespace detail
+
+// Highest SIMD level usable on this machine (probed once)
+inline SimdLevel DetectSimdLevel() {
+    static const SimdLevel level = detail::QuerySimdLevel();
+    return level;
+}
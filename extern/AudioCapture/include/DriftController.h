@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cmath>
+
+// PI loop that keeps one source's buffer fill locked to the mixer's
+// reference clock.
+//
+// The mic and the render-loopback endpoint run on separate crystals, so
+// one of them produces a few hundred ppm more frames than the other. The
+// mixer measures how far a source's fill level is ahead of (+) or behind
+// (-) the reference source, and this controller turns that error into a
+// rate correction for the source's resampler (Resampler::SetRateAdjust(1 +
+// correction)): a source that runs fast is consumed faster, a slow one is
+// stretched. Once settled, the correction is the source's clock offset
+// relative to the reference, which is what GetDriftPpm() reports.
+//
+// How fast the loop may react depends on how clean the error is:
+//   - Fill levels move in whole packets (~10 ms), so two sources whose
+//     packets interleave differently show a sawtooth of up to a packet even
+//     when perfectly in sync. kFillLevelTuning filters hard and is slow.
+//   - Capture timestamps give the error to within a frame or so, so
+//     kTimestampTuning locks an order of magnitude faster and keeps the
+//     error to a millisecond or two.
+// The error is low-pass filtered in both cases, and the integrator stops
+// while the correction is clamped. Time is measured in mixed output, not
+// wall clock, so the loop is deterministic for a given input.
+class DriftController {
+public:
+    // Largest correction applied; real clocks are well within +-200 ppm
+    static constexpr double kMaxCorrection = 1000e-6;
+
+    // Loop gains (error in seconds, correction as a fraction)
+    struct Tuning {
+        double proportionalGain;
+        double integralGain;
+        double errorTimeConstant;  // Seconds
+    };
+
+    // Natural frequency 0.008 rad/s, critically damped. A 400 ppm offset
+    // pulls the fill off by under 20 ms while the loop locks (a few
+    // minutes), and the packet sawtooth moves the rate by only tens of ppm.
+    static constexpr Tuning kFillLevelTuning = { 0.016, 0.000064, 10.0 };
+
+    // Natural frequency 0.05 rad/s, critically damped: a 400 ppm offset
+    // stays within ~3 ms while the loop locks (under a minute)
+    static constexpr Tuning kTimestampTuning = { 0.1, 0.0025, 2.0 };
+
+    DriftController() : m_tuning(kFillLevelTuning) { Reset(); }
+
+    // Switch gains; the learned drift is kept
+    void SetTuning(const Tuning& tuning) { m_tuning = tuning; }
+
+    // Forget everything, including the learned drift
+    void Reset() {
+        m_filteredError = 0.0;
+        m_integral = 0.0;
+        m_correction = 0.0;
+        m_primed = false;
+    }
+
+    // Forget the filtered error but keep the learned drift. Used after the
+    // mixer realigns the source (silence inserted / frames dropped), when
+    // the old error no longer means anything.
+    void ResetError() {
+        m_filteredError = 0.0;
+        m_primed = false;
+        m_correction = Clamp(m_integral);
+    }
+
+    // Feed the fill error (seconds, + = source ahead of the reference) after
+    // `elapsed` seconds of output. Returns the new correction.
+    double Update(double error, double elapsed) {
+        if (!(elapsed > 0.0)) {
+            return m_correction;
+        }
+
+        if (!m_primed) {
+            m_filteredError = error;
+            m_primed = true;
+        } else {
+            const double alpha = elapsed / (m_tuning.errorTimeConstant + elapsed);
+            m_filteredError += alpha * (error - m_filteredError);
+        }
+
+        // Conditional integration: hold the integrator while the output is
+        // clamped in the direction the error pushes
+        const double unclamped = m_tuning.proportionalGain * m_filteredError + m_integral;
+        const bool saturated = std::fabs(unclamped) >= kMaxCorrection &&
+                               (unclamped > 0.0) == (m_filteredError > 0.0);
+        if (!saturated) {
+            m_integral = Clamp(m_integral + m_tuning.integralGain * m_filteredError * elapsed);
+        }
+
+        m_correction = Clamp(m_tuning.proportionalGain * m_filteredError + m_integral);
+        return m_correction;
+    }
+
+    // Current correction as a fraction (+ = consume faster)
+    double GetCorrection() const { return m_correction; }
+
+    // Estimated clock offset of the source relative to the reference
+    double GetDriftPpm() const { return m_correction * 1e6; }
+
+    // Low-passed fill error in seconds
+    double GetFilteredError() const { return m_filteredError; }
+
+private:
+    static double Clamp(double value) {
+        return value > kMaxCorrection ? kMaxCorrection : (value < -kMaxCorrection ? -kMaxCorrection : value);
+    }
+
+    Tuning m_tuning;
+    double m_filteredError;
+    double m_integral;
+    double m_correction;
+    bool m_primed;
+};
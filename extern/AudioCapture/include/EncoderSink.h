@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+// Sinks only hand the format on to their encoders, so a declaration is
+// enough: this header and EncoderWorkerPool stay free of Windows headers.
+// The Windows SDK defines the struct under this tag.
+struct tWAVEFORMATEX;
+typedef struct tWAVEFORMATEX WAVEFORMATEX;
+
+enum class AudioFormat {
+    WAV,
+    MP3,
+    OPUS,
+    FLAC
+};
+
+// Destination for captured PCM packets. CaptureManager holds one per
+// session (and one for the mixed recording) and only ever talks to it
+// through this interface, so a new kind of output needs a sink class and a
+// registry entry, not another case in the capture path.
+//
+// Open() runs on the thread starting the recording. Write() runs on
+// EncoderWorkerPool worker threads, not always the same one, but never
+// concurrently for one sink. Close() comes from the thread stopping the
+// recording, after the last Write() has returned.
+class IEncoderSink {
+public:
+    virtual ~IEncoderSink() = default;
+
+    // Start writing PCM in `format` to `path`. `quality` is the format's own
+    // knob (bitrate in bps, FLAC compression level); 0 picks the default.
+    virtual bool Open(const std::wstring& path, const WAVEFORMATEX* format, uint32_t quality) = 0;
+
+    // Consume one packet of PCM in the format given to Open()
+    virtual bool Write(const uint8_t* data, uint32_t size) = 0;
+
+    // Push buffered output toward its destination without closing
+    virtual void Flush() {}
+
+    // Finish the output (headers, trailers) and release it. Safe to call twice.
+    virtual void Close() = 0;
+};
+
+// Accepts and discards everything. Used for monitor-only sessions, and as
+// the baseline when measuring dispatch cost.
+class NullSink : public IEncoderSink {
+public:
+    bool Open(const std::wstring&, const WAVEFORMATEX*, uint32_t) override { return true; }
+    bool Write(const uint8_t*, uint32_t size) override {
+        m_bytes += size;
+        return true;
+    }
+    void Close() override {}
+
+    uint64_t GetBytesWritten() const { return m_bytes; }
+
+private:
+    uint64_t m_bytes = 0;
+};
+
+// Creates sinks by AudioFormat. CaptureManager's registry starts with the
+// built-in encoders (RegisterBuiltinSinks); Register() replaces or adds one.
+class EncoderSinkRegistry {
+public:
+    using Factory = std::function<std::unique_ptr<IEncoderSink>()>;
+
+    void Register(AudioFormat format, Factory factory) {
+        m_factories[format] = std::move(factory);
+    }
+
+    // New, unopened sink for `format`, or nullptr if none is registered
+    std::unique_ptr<IEncoderSink> Create(AudioFormat format) const {
+        auto it = m_factories.find(format);
+        return it != m_factories.end() && it->second ? it->second() : nullptr;
+    }
+
+    bool IsRegistered(AudioFormat format) const { return m_factories.count(format) != 0; }
+
+private:
+    std::map<AudioFormat, Factory> m_factories;
+};
+
+// WAV, MP3, Opus and FLAC file encoders
+void RegisterBuiltinSinks(EncoderSinkRegistry& registry);
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "EncoderSink.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs IEncoderSink writes on a small pool of worker threads, so Media
+// Foundation encoding and disk I/O stay off the capture (MMCSS) and mixer
+// threads.
+//
+// Each recording is a Stream: an ordered packet queue in front of one sink.
+// A stream is handed to at most one worker at a time, so its packets are
+// written strictly in submission order, while different recordings encode
+// in parallel. Streams with work go onto the workers' own deques; an idle
+// worker takes from the front of its deque and steals from the back of the
+// others'. A worker writes a bounded batch from a stream before requeueing
+// it, so one busy recording can't starve the rest.
+//
+// Nothing is dropped quietly. Past its soft limit a stream still queues but
+// Submit() reports Backpressure; past its hard limit the packet is refused
+// (Rejected) and counted in the stats.
+class EncoderWorkerPool {
+public:
+    enum class SubmitResult {
+        Queued,
+        Backpressure,   // Queued, but the stream is above its soft limit
+        Rejected        // Not queued: above the hard limit, or the stream is closed
+    };
+
+    struct Stats {
+        uint64_t packetsWritten = 0;
+        uint64_t bytesWritten = 0;
+        uint64_t writeFailures = 0;       // Sink Write() returned false
+        uint64_t backpressureEvents = 0;  // Submits answered with Backpressure
+        uint64_t rejectedPackets = 0;
+        uint64_t rejectedBytes = 0;
+        uint64_t bytesQueued = 0;         // Waiting to be written right now
+    };
+
+    class Stream;
+
+    // workerCount 0 = one per hardware thread
+    explicit EncoderWorkerPool(unsigned workerCount = 0);
+
+    // Writes out every open stream's queue, then stops the workers. Sinks of
+    // streams that weren't closed are closed here.
+    ~EncoderWorkerPool();
+
+    EncoderWorkerPool(const EncoderWorkerPool&) = delete;
+    EncoderWorkerPool& operator=(const EncoderWorkerPool&) = delete;
+
+    unsigned GetWorkerCount() const { return static_cast<unsigned>(m_workers.size()); }
+
+    // Start a stream writing to an opened sink. Limits are in queued bytes
+    // (soft <= hard).
+    std::shared_ptr<Stream> OpenStream(std::unique_ptr<IEncoderSink> sink, size_t softLimitBytes,
+                                       size_t hardLimitBytes);
+
+    // Copy a packet into the stream's queue. Safe from any thread; one
+    // producer per stream keeps submission order well defined.
+    SubmitResult Submit(Stream& stream, const uint8_t* data, uint32_t size);
+
+    // Wait until everything submitted has been written, then close the sink
+    // on the calling thread. Later Submits are rejected.
+    void CloseStream(Stream& stream);
+
+    Stats GetStreamStats(Stream& stream);
+
+    // Totals over every stream opened on this pool
+    Stats GetStats();
+
+private:
+    // Packets a worker writes from one stream before moving on
+    static constexpr size_t kBatchPackets = 8;
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::shared_ptr<Stream>> ready;  // Streams with queued packets
+        std::thread thread;
+    };
+
+    void WorkerLoop(size_t index);
+
+    // Queue a stream that has packets and no worker; `hint` picks the deque
+    // (a worker requeues onto its own, producers round-robin)
+    void Schedule(std::shared_ptr<Stream> stream, size_t hint);
+
+    // Take a ready stream: own deque first, then steal from the others
+    std::shared_ptr<Stream> Take(size_t index);
+
+    // Write up to kBatchPackets of a stream's queue. Returns true if it
+    // still has packets (the caller requeues it).
+    bool RunBatch(Stream& stream);
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::atomic<size_t> m_nextWorker;
+
+    // Sleep/wake for idle workers: m_readyCount counts streams in all deques
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+    std::atomic<size_t> m_readyCount;
+    bool m_stopping;
+
+    // Every stream opened (for totals and shutdown)
+    std::mutex m_streamsMutex;
+    std::vector<std::weak_ptr<Stream>> m_streams;
+    Stats m_closedTotals;   // Stats of streams already dropped from m_streams
+};
+
+class EncoderWorkerPool::Stream : public std::enable_shared_from_this<Stream> {
+public:
+    explicit Stream(std::unique_ptr<IEncoderSink> sink, size_t softLimitBytes, size_t hardLimitBytes)
+        : m_sink(std::move(sink)), m_softLimit(softLimitBytes), m_hardLimit(hardLimitBytes) {
+    }
+
+private:
+    friend class EncoderWorkerPool;
+
+    std::unique_ptr<IEncoderSink> m_sink;
+    const size_t m_softLimit;
+    const size_t m_hardLimit;
+
+    std::mutex m_mutex;
+    std::condition_variable m_drained;  // Signalled when the queue empties and no worker holds the stream
+    std::deque<std::vector<uint8_t>> m_queue;
+    std::vector<std::vector<uint8_t>> m_spare;  // Written packet buffers, reused by Submit
+    size_t m_queuedBytes = 0;
+    bool m_scheduled = false;   // In a worker deque or being written
+    bool m_closed = false;
+    Stats m_stats;
+};
@@ -2,18 +2,36 @@
 
 #include <windows.h>
 #include <mmreg.h>
+#include "FlacStreamEncoder.h"
+#include "SampleFormat.h"
+#include <fstream>
 #include <string>
+#include <vector>
 
-// Stub header — FLAC support disabled (no libFLAC dependency)
-// Public API matches the full version so CaptureManager.h compiles.
-
+// FLAC file writer on top of the in-tree FlacStreamEncoder (no libFLAC).
+// Accepts the capture formats the rest of the pipeline produces: 16- and
+// 24-bit PCM are stored as is, 32-bit PCM and float as 24-bit.
 class FlacEncoder {
 public:
     FlacEncoder();
     ~FlacEncoder();
 
+    // Open FLAC file for writing; compressionLevel is 0 (fastest) to 8 (smallest)
     bool Open(const std::wstring& filename, const WAVEFORMATEX* format, UINT32 compressionLevel = 5);
+
+    // Write audio data (PCM in the format given to Open)
     bool WriteData(const BYTE* data, UINT32 size);
+
+    // Flush the last block and finalize STREAMINFO
     void Close();
-    bool IsOpen() const { return false; }
+
+    bool IsOpen() const { return m_encoder.IsOpen(); }
+
+private:
+    std::ofstream m_file;
+    FlacStreamEncoder m_encoder;
+    SampleType m_sampleType;
+    UINT32 m_bytesPerSample;
+    UINT32 m_channels;
+    std::vector<int32_t> m_samples;
 };
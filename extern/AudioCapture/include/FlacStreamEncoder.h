@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+// Self-contained FLAC encoder core (no libFLAC). Platform-neutral: takes
+// interleaved integer samples and writes a FLAC stream to a std::ostream.
+//
+// Frames are written as soon as a block fills, so the output is a valid
+// stream at every frame boundary. STREAMINFO goes out first with the
+// totals unknown; Close() seeks back and fills in the sample count, frame
+// sizes and MD5 when the stream is seekable.
+//
+// Each channel of a frame is coded as CONSTANT, FIXED (order 0-4) or LPC,
+// whichever is smallest, with VERBATIM as the fallback; residuals use
+// partitioned Rice coding. Stereo frames pick the cheapest of left/right,
+// left/side, side/right and mid/side. LPC coefficients come from a windowed
+// autocorrelation (SIMD) and Levinson-Durbin.
+//
+// Compression levels 0-8 follow the reference encoder's presets in spirit:
+// 0-2 use fixed predictors only with 1152-sample blocks, 3-8 add LPC (up to
+// order 6, 8 or 12) with 4096-sample blocks and finer Rice partitioning.
+class FlacStreamEncoder {
+public:
+    FlacStreamEncoder();
+    ~FlacStreamEncoder();
+
+    // Start a stream. bitsPerSample is 8..24; samples passed to Write() must
+    // fit in it. Writes the stream header.
+    bool Open(std::ostream* out, uint32_t sampleRate, uint32_t channels, uint32_t bitsPerSample,
+              uint32_t compressionLevel);
+
+    // Encode interleaved frames. Complete blocks are written immediately.
+    bool Write(const int32_t* samples, size_t frames);
+
+    // Write the last (short) block and patch STREAMINFO. Returns false if
+    // anything failed to write.
+    bool Close();
+
+    bool IsOpen() const { return m_out != nullptr; }
+
+    uint64_t GetSamplesWritten() const { return m_totalSamples; }
+
+private:
+    bool EncodeFrame(size_t blockSize);
+    void WriteStreamInfo(std::vector<uint8_t>& out) const;
+
+    std::ostream* m_out;
+    std::streampos m_streamInfoPos;
+    bool m_failed;
+
+    uint32_t m_sampleRate;
+    uint32_t m_channels;
+    uint32_t m_bitsPerSample;
+    uint32_t m_blockSize;
+    uint32_t m_maxLpcOrder;
+    uint32_t m_maxPartitionOrder;
+    bool m_midSide;           // Try stereo decorrelation
+    bool m_looseMidSide;      // Pick the stereo mode from an estimate instead of coding all four
+    bool m_exhaustiveOrder;   // Try every LPC order instead of the estimate's pick
+
+    // Current block, one plane per channel
+    std::vector<std::vector<int32_t>> m_planes;
+    size_t m_buffered;
+
+    uint64_t m_totalSamples;
+    uint32_t m_frameNumber;
+    uint32_t m_minFrameBytes;
+    uint32_t m_maxFrameBytes;
+
+    // Analysis buffers, window and MD5 state
+    struct Workspace;
+    std::unique_ptr<Workspace> m_work;
+};
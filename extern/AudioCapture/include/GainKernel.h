@@ -0,0 +1,306 @@
+#pragma once
+
+#include "CpuFeatures.h"
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Vectorized gain for interleaved float32 / int16 PCM.
+//
+// Every kernel exists as a scalar reference plus SSE2 and AVX2 variants that
+// produce bit-identical output:
+//   float32: out = in * gain
+//   int16:   out = saturate(round_half_even(in * gain))
+// The int16 path clamps in the float domain before converting, so an
+// oversized product saturates instead of wrapping.
+//
+// Ramped variants interpolate the gain linearly across the buffer, one step
+// per frame (all channels of a frame share a gain), which removes zipper
+// noise when the volume changes between buffers:
+//   gain(frame) = from + (to - from) / frames * frame
+// The next buffer should start at `to`.
+
+struct GainKernels {
+    void (*applyFloat)(float* samples, size_t count, float gain);
+    void (*applyInt16)(int16_t* samples, size_t count, float gain);
+    void (*rampFloat)(float* samples, size_t frames, unsigned channels, float from, float to);
+    void (*rampInt16)(int16_t* samples, size_t frames, unsigned channels, float from, float to);
+    SimdLevel level;
+};
+
+namespace gain_detail {
+
+inline int16_t ScaleInt16(int16_t sample, float gain) {
+    float scaled = static_cast<float>(sample) * gain;
+    scaled = scaled < -32768.0f ? -32768.0f : scaled;
+    scaled = scaled > 32767.0f ? 32767.0f : scaled;
+    return static_cast<int16_t>(std::lrint(scaled));
+}
+
+inline float RampStep(size_t frames, float from, float to) {
+    return frames > 0 ? (to - from) / static_cast<float>(frames) : 0.0f;
+}
+
+// log2(channels) when the SIMD ramps can handle the layout, -1 otherwise.
+// Vector lanes map to frames by shifting the sample index, so the channel
+// count must be a power of two that divides the vector width.
+inline int RampShift(unsigned channels) {
+    switch (channels) {
+    case 1: return 0;
+    case 2: return 1;
+    case 4: return 2;
+    default: return -1;
+    }
+}
+
+// ---- Scalar reference ----
+
+inline void ApplyFloatScalar(float* samples, size_t count, float gain) {
+    for (size_t i = 0; i < count; i++) {
+        samples[i] = samples[i] * gain;
+    }
+}
+
+inline void ApplyInt16Scalar(int16_t* samples, size_t count, float gain) {
+    for (size_t i = 0; i < count; i++) {
+        samples[i] = ScaleInt16(samples[i], gain);
+    }
+}
+
+// Shared tails so SIMD variants finish with exactly the reference math
+inline void RampFloatTail(float* samples, size_t begin, size_t count, unsigned channels, float from, float step) {
+    for (size_t i = begin; i < count; i++) {
+        samples[i] = samples[i] * (from + step * static_cast<float>(static_cast<uint32_t>(i / channels)));
+    }
+}
+
+inline void RampInt16Tail(int16_t* samples, size_t begin, size_t count, unsigned channels, float from, float step) {
+    for (size_t i = begin; i < count; i++) {
+        samples[i] = ScaleInt16(samples[i], from + step * static_cast<float>(static_cast<uint32_t>(i / channels)));
+    }
+}
+
+inline void RampFloatScalar(float* samples, size_t frames, unsigned channels, float from, float to) {
+    if (channels == 0) return;
+    RampFloatTail(samples, 0, frames * channels, channels, from, RampStep(frames, from, to));
+}
+
+inline void RampInt16Scalar(int16_t* samples, size_t frames, unsigned channels, float from, float to) {
+    if (channels == 0) return;
+    RampInt16Tail(samples, 0, frames * channels, channels, from, RampStep(frames, from, to));
+}
+
+#if AUDIO_SIMD_X86
+
+// ---- SSE2 ----
+
+AUDIO_TARGET_SSE2 inline __m128i ScaleInt16x4Sse2(__m128i values, __m128 gain) {
+    const __m128 lo = _mm_set1_ps(-32768.0f);
+    const __m128 hi = _mm_set1_ps(32767.0f);
+    __m128 scaled = _mm_mul_ps(_mm_cvtepi32_ps(values), gain);
+    scaled = _mm_min_ps(_mm_max_ps(scaled, lo), hi);
+    return _mm_cvtps_epi32(scaled);
+}
+
+AUDIO_TARGET_SSE2 inline void ApplyFloatSse2(float* samples, size_t count, float gain) {
+    const __m128 g = _mm_set1_ps(gain);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), g));
+    }
+    for (; i < count; i++) {
+        samples[i] = samples[i] * gain;
+    }
+}
+
+AUDIO_TARGET_SSE2 inline void ApplyInt16Sse2(int16_t* samples, size_t count, float gain) {
+    const __m128 g = _mm_set1_ps(gain);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        __m128i packed = _mm_packs_epi32(ScaleInt16x4Sse2(lo, g), ScaleInt16x4Sse2(hi, g));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(samples + i), packed);
+    }
+    for (; i < count; i++) {
+        samples[i] = ScaleInt16(samples[i], gain);
+    }
+}
+
+// Gain for 4 consecutive samples starting at sample index `base`
+AUDIO_TARGET_SSE2 inline __m128 RampGainSse2(size_t base, __m128i laneIndex, __m128i shift, __m128 from, __m128 step) {
+    __m128i sampleIndex = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(base)), laneIndex);
+    __m128 frame = _mm_cvtepi32_ps(_mm_srl_epi32(sampleIndex, shift));
+    return _mm_add_ps(from, _mm_mul_ps(step, frame));
+}
+
+AUDIO_TARGET_SSE2 inline void RampFloatSse2(float* samples, size_t frames, unsigned channels, float from, float to) {
+    const int shiftBits = RampShift(channels);
+    if (shiftBits < 0) {
+        RampFloatScalar(samples, frames, channels, from, to);
+        return;
+    }
+    const float stepValue = RampStep(frames, from, to);
+    const size_t count = frames * channels;
+    const __m128i laneIndex = _mm_setr_epi32(0, 1, 2, 3);
+    const __m128i shift = _mm_cvtsi32_si128(shiftBits);
+    const __m128 f = _mm_set1_ps(from);
+    const __m128 step = _mm_set1_ps(stepValue);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 g = RampGainSse2(i, laneIndex, shift, f, step);
+        _mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), g));
+    }
+    RampFloatTail(samples, i, count, channels, from, stepValue);
+}
+
+AUDIO_TARGET_SSE2 inline void RampInt16Sse2(int16_t* samples, size_t frames, unsigned channels, float from, float to) {
+    const int shiftBits = RampShift(channels);
+    if (shiftBits < 0) {
+        RampInt16Scalar(samples, frames, channels, from, to);
+        return;
+    }
+    const float stepValue = RampStep(frames, from, to);
+    const size_t count = frames * channels;
+    const __m128i laneIndex = _mm_setr_epi32(0, 1, 2, 3);
+    const __m128i shift = _mm_cvtsi32_si128(shiftBits);
+    const __m128 f = _mm_set1_ps(from);
+    const __m128 step = _mm_set1_ps(stepValue);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        __m128 gLo = RampGainSse2(i, laneIndex, shift, f, step);
+        __m128 gHi = RampGainSse2(i + 4, laneIndex, shift, f, step);
+        __m128i packed = _mm_packs_epi32(ScaleInt16x4Sse2(lo, gLo), ScaleInt16x4Sse2(hi, gHi));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(samples + i), packed);
+    }
+    RampInt16Tail(samples, i, count, channels, from, stepValue);
+}
+
+// ---- AVX2 ----
+
+AUDIO_TARGET_AVX2 inline __m256i ScaleInt16x8Avx2(__m256i values, __m256 gain) {
+    const __m256 lo = _mm256_set1_ps(-32768.0f);
+    const __m256 hi = _mm256_set1_ps(32767.0f);
+    __m256 scaled = _mm256_mul_ps(_mm256_cvtepi32_ps(values), gain);
+    scaled = _mm256_min_ps(_mm256_max_ps(scaled, lo), hi);
+    return _mm256_cvtps_epi32(scaled);
+}
+
+// Packs two vectors of 8 int32 into 16 int16 in sample order
+AUDIO_TARGET_AVX2 inline __m256i PackInt16Avx2(__m256i first, __m256i second) {
+    // packs works per 128-bit lane: [f0-3 s0-3 | f4-7 s4-7] -> reorder qwords
+    return _mm256_permute4x64_epi64(_mm256_packs_epi32(first, second), 0xD8);
+}
+
+AUDIO_TARGET_AVX2 inline void ApplyFloatAvx2(float* samples, size_t count, float gain) {
+    const __m256 g = _mm256_set1_ps(gain);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(samples + i, _mm256_mul_ps(_mm256_loadu_ps(samples + i), g));
+    }
+    for (; i < count; i++) {
+        samples[i] = samples[i] * gain;
+    }
+}
+
+AUDIO_TARGET_AVX2 inline void ApplyInt16Avx2(int16_t* samples, size_t count, float gain) {
+    const __m256 g = _mm256_set1_ps(gain);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(samples + i));
+        __m256i lo = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(v));
+        __m256i hi = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(v, 1));
+        __m256i packed = PackInt16Avx2(ScaleInt16x8Avx2(lo, g), ScaleInt16x8Avx2(hi, g));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(samples + i), packed);
+    }
+    for (; i < count; i++) {
+        samples[i] = ScaleInt16(samples[i], gain);
+    }
+}
+
+AUDIO_TARGET_AVX2 inline __m256 RampGainAvx2(size_t base, __m256i laneIndex, __m128i shift, __m256 from, __m256 step) {
+    __m256i sampleIndex = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(base)), laneIndex);
+    __m256 frame = _mm256_cvtepi32_ps(_mm256_srl_epi32(sampleIndex, shift));
+    return _mm256_add_ps(from, _mm256_mul_ps(step, frame));
+}
+
+AUDIO_TARGET_AVX2 inline void RampFloatAvx2(float* samples, size_t frames, unsigned channels, float from, float to) {
+    const int shiftBits = RampShift(channels);
+    if (shiftBits < 0) {
+        RampFloatScalar(samples, frames, channels, from, to);
+        return;
+    }
+    const float stepValue = RampStep(frames, from, to);
+    const size_t count = frames * channels;
+    const __m256i laneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m128i shift = _mm_cvtsi32_si128(shiftBits);
+    const __m256 f = _mm256_set1_ps(from);
+    const __m256 step = _mm256_set1_ps(stepValue);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 g = RampGainAvx2(i, laneIndex, shift, f, step);
+        _mm256_storeu_ps(samples + i, _mm256_mul_ps(_mm256_loadu_ps(samples + i), g));
+    }
+    RampFloatTail(samples, i, count, channels, from, stepValue);
+}
+
+AUDIO_TARGET_AVX2 inline void RampInt16Avx2(int16_t* samples, size_t frames, unsigned channels, float from, float to) {
+    const int shiftBits = RampShift(channels);
+    if (shiftBits < 0) {
+        RampInt16Scalar(samples, frames, channels, from, to);
+        return;
+    }
+    const float stepValue = RampStep(frames, from, to);
+    const size_t count = frames * channels;
+    const __m256i laneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m128i shift = _mm_cvtsi32_si128(shiftBits);
+    const __m256 f = _mm256_set1_ps(from);
+    const __m256 step = _mm256_set1_ps(stepValue);
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(samples + i));
+        __m256i lo = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(v));
+        __m256i hi = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(v, 1));
+        __m256 gLo = RampGainAvx2(i, laneIndex, shift, f, step);
+        __m256 gHi = RampGainAvx2(i + 8, laneIndex, shift, f, step);
+        __m256i packed = PackInt16Avx2(ScaleInt16x8Avx2(lo, gLo), ScaleInt16x8Avx2(hi, gHi));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(samples + i), packed);
+    }
+    RampInt16Tail(samples, i, count, channels, from, stepValue);
+}
+
+#endif // AUDIO_SIMD_X86
+
+} // namespace gain_detail
+
+// Kernel table for a specific level (falls back to the best level compiled in)
+inline GainKernels GetGainKernels(SimdLevel level) {
+#if AUDIO_SIMD_X86
+    if (level >= SimdLevel::AVX2) {
+        return { gain_detail::ApplyFloatAvx2, gain_detail::ApplyInt16Avx2,
+                 gain_detail::RampFloatAvx2, gain_detail::RampInt16Avx2, SimdLevel::AVX2 };
+    }
+    if (level >= SimdLevel::SSE2) {
+        return { gain_detail::ApplyFloatSse2, gain_detail::ApplyInt16Sse2,
+                 gain_detail::RampFloatSse2, gain_detail::RampInt16Sse2, SimdLevel::SSE2 };
+    }
+#else
+    (void)level;
+#endif
+    return { gain_detail::ApplyFloatScalar, gain_detail::ApplyInt16Scalar,
+             gain_detail::RampFloatScalar, gain_detail::RampInt16Scalar, SimdLevel::Scalar };
+}
+
+// Kernels for the running CPU, selected on first use
+inline const GainKernels& ActiveGainKernels() {
+    static const GainKernels kernels = GetGainKernels(DetectSimdLevel());
+    return kernels;
+}
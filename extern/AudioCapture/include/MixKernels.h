@@ -0,0 +1,139 @@
+#pragma once
+
+#include "CpuFeatures.h"
+#include <cstddef>
+#include <cstdint>
+
+// Building blocks for N-way mixing.
+//
+// Mixing is source-major: the first source is loaded into a float
+// accumulator block, every further source is added on top, and the block is
+// saturated into the output format once. Each pass is a straight streaming
+// loop over contiguous memory, so it vectorizes cleanly and the accumulator
+// stays in L1 for any number of sources.
+//
+// Sources arrive already converted to float (see SampleFormat.h), so the
+// kernels only handle float; the mixer converts the saturated block to the
+// output sample type afterwards. Saturation uses min/max rather than
+// branches. SIMD variants are bit-identical to the scalar reference.
+
+struct MixKernels {
+    // acc[i] = src[i]
+    void (*loadFloat)(float* acc, const float* src, size_t count);
+    // acc[i] += src[i]
+    void (*addFloat)(float* acc, const float* src, size_t count);
+    // dest[i] = clamp(acc[i], -1, 1); dest may equal acc
+    void (*storeFloat)(float* dest, const float* acc, size_t count);
+    SimdLevel level;
+};
+
+namespace mix_detail {
+
+// Written so NaN passes through unchanged, matching the SIMD min/max operand order
+inline float ClampUnit(float x) {
+    x = x < -1.0f ? -1.0f : x;
+    return x > 1.0f ? 1.0f : x;
+}
+
+// ---- Scalar reference ----
+
+inline void LoadFloatScalar(float* acc, const float* src, size_t count) {
+    for (size_t i = 0; i < count; i++) acc[i] = src[i];
+}
+
+inline void AddFloatScalar(float* acc, const float* src, size_t count) {
+    for (size_t i = 0; i < count; i++) acc[i] += src[i];
+}
+
+inline void StoreFloatScalar(float* dest, const float* acc, size_t count) {
+    for (size_t i = 0; i < count; i++) dest[i] = ClampUnit(acc[i]);
+}
+
+#if AUDIO_SIMD_X86
+
+// ---- SSE2 ----
+
+AUDIO_TARGET_SSE2 inline void LoadFloatSse2(float* acc, const float* src, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(acc + i, _mm_loadu_ps(src + i));
+    }
+    for (; i < count; i++) acc[i] = src[i];
+}
+
+AUDIO_TARGET_SSE2 inline void AddFloatSse2(float* acc, const float* src, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_loadu_ps(src + i)));
+    }
+    for (; i < count; i++) acc[i] += src[i];
+}
+
+AUDIO_TARGET_SSE2 inline void StoreFloatSse2(float* dest, const float* acc, size_t count) {
+    const __m128 lo = _mm_set1_ps(-1.0f);
+    const __m128 hi = _mm_set1_ps(1.0f);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        // Bound first so NaN is returned unchanged, as in ClampUnit
+        __m128 v = _mm_max_ps(lo, _mm_loadu_ps(acc + i));
+        _mm_storeu_ps(dest + i, _mm_min_ps(hi, v));
+    }
+    for (; i < count; i++) dest[i] = ClampUnit(acc[i]);
+}
+
+// ---- AVX2 ----
+
+AUDIO_TARGET_AVX2 inline void LoadFloatAvx2(float* acc, const float* src, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(acc + i, _mm256_loadu_ps(src + i));
+    }
+    for (; i < count; i++) acc[i] = src[i];
+}
+
+AUDIO_TARGET_AVX2 inline void AddFloatAvx2(float* acc, const float* src, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(acc + i, _mm256_add_ps(_mm256_loadu_ps(acc + i), _mm256_loadu_ps(src + i)));
+    }
+    for (; i < count; i++) acc[i] += src[i];
+}
+
+AUDIO_TARGET_AVX2 inline void StoreFloatAvx2(float* dest, const float* acc, size_t count) {
+    const __m256 lo = _mm256_set1_ps(-1.0f);
+    const __m256 hi = _mm256_set1_ps(1.0f);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 v = _mm256_max_ps(lo, _mm256_loadu_ps(acc + i));
+        _mm256_storeu_ps(dest + i, _mm256_min_ps(hi, v));
+    }
+    for (; i < count; i++) dest[i] = ClampUnit(acc[i]);
+}
+
+#endif // AUDIO_SIMD_X86
+
+} // namespace mix_detail
+
+// Kernel table for a specific level (falls back to the best level compiled in)
+inline MixKernels GetMixKernels(SimdLevel level) {
+#if AUDIO_SIMD_X86
+    if (level >= SimdLevel::AVX2) {
+        return { mix_detail::LoadFloatAvx2, mix_detail::AddFloatAvx2,
+                 mix_detail::StoreFloatAvx2, SimdLevel::AVX2 };
+    }
+    if (level >= SimdLevel::SSE2) {
+        return { mix_detail::LoadFloatSse2, mix_detail::AddFloatSse2,
+                 mix_detail::StoreFloatSse2, SimdLevel::SSE2 };
+    }
+#else
+    (void)level;
+#endif
+    return { mix_detail::LoadFloatScalar, mix_detail::AddFloatScalar,
+             mix_detail::StoreFloatScalar, SimdLevel::Scalar };
+}
+
+// Kernels for the running CPU, selected on first use
+inline const MixKernels& ActiveMixKernels() {
+    static const MixKernels kernels = GetMixKernels(DetectSimdLevel());
+    return kernels;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Settings for the mixed-output limiter (see PeakLimiter)
+struct LimiterSettings {
+    bool enabled = true;
+    float ceilingDb = -1.0f;    // Output peak ceiling, dBFS (<= 0)
+    float attackMs = 5.0f;      // Look-ahead: gain is fully down by the time a peak plays
+    float releaseMs = 150.0f;   // Time constant for the gain to recover after a peak
+};
+
+// Look-ahead peak limiter for interleaved float audio.
+//
+// Output is the input delayed by a constant GetLatencyFrames() (the attack
+// time) and scaled by a gain that is never higher than what keeps each
+// sample under the ceiling: the required gain per frame goes through a
+// sliding minimum over the look-ahead window and a box filter of the same
+// length (so the gain ramps down smoothly and has fully reached a peak's
+// level when that peak comes out), then an exponential release. All
+// channels share one gain, so the stereo image doesn't move. A final
+// clamp to the ceiling only catches rounding.
+//
+// Per-frame required gain and the gain application run as SIMD block
+// kernels; the envelope in between is a short scalar recurrence.
+class PeakLimiter {
+public:
+    PeakLimiter();
+
+    // Configure for a stream. Clears the delay line and envelope.
+    bool Initialize(const LimiterSettings& settings, uint32_t sampleRate, uint32_t channels);
+
+    // Clear the delay line and envelope but keep the configuration
+    void Reset();
+
+    bool IsEnabled() const { return m_enabled; }
+
+    // Limit `frames` interleaved frames in place. The output lags the input
+    // by GetLatencyFrames(); the first call starts with that much silence.
+    void Process(float* samples, size_t frames);
+
+    // Constant delay added by the look-ahead (0 when disabled)
+    uint32_t GetLatencyFrames() const { return m_enabled ? m_lookahead - 1 : 0; }
+
+    // Linear ceiling
+    float GetCeiling() const { return m_ceiling; }
+
+private:
+    static constexpr size_t kBlockFrames = 1024;
+
+    void ProcessBlock(float* samples, size_t frames);
+
+    bool m_enabled;
+    uint32_t m_channels;
+    uint32_t m_lookahead;      // Window length in frames (attack), >= 1
+    float m_ceiling;
+    double m_releaseCoefficient;
+
+    // Delay line: the last m_lookahead - 1 input frames
+    std::vector<float> m_delay;
+
+    // Sliding minimum of the required gain: monotonic queue over a ring of
+    // m_lookahead entries (frame index, gain)
+    std::vector<uint64_t> m_minIndex;
+    std::vector<float> m_minValue;
+    size_t m_minHead;
+    size_t m_minCount;
+    uint64_t m_frameIndex;
+
+    // Box filter over the sliding minimum
+    std::vector<float> m_boxHistory;
+    size_t m_boxPosition;
+    double m_boxSum;
+
+    double m_gain;
+
+    // Per-block scratch
+    std::vector<float> m_required;
+    std::vector<float> m_gains;
+    std::vector<float> m_scratch;
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+// The last few seconds of a capture that isn't being recorded yet, kept as
+// the packets the capture delivered (bytes in its own format plus timing).
+//
+// Bytes live in one circular buffer allocated up front, so Push() only
+// copies. The budget is in bytes; when a packet doesn't fit, whole packets
+// are dropped from the oldest end. Not thread-safe; CaptureManager
+// serializes access with its session mutex.
+class PreRollBuffer {
+public:
+    // `timestamp` and `discontinuity` are the capture's AudioPacketTiming
+    struct Packet {
+        size_t offset;      // Into the circular buffer
+        size_t size;
+        uint64_t timestamp;
+        bool discontinuity;
+    };
+
+    explicit PreRollBuffer(size_t capacityBytes)
+        : m_storage(capacityBytes), m_writeOffset(0), m_bufferedBytes(0), m_droppedBytes(0) {
+    }
+
+    size_t Capacity() const { return m_storage.size(); }
+    size_t BufferedBytes() const { return m_bufferedBytes; }
+    size_t PacketCount() const { return m_packets.size(); }
+    bool Empty() const { return m_packets.empty(); }
+
+    // Bytes evicted (or refused) to stay within the budget
+    uint64_t DroppedBytes() const { return m_droppedBytes; }
+
+    // Append a packet, dropping the oldest ones to make room. A packet larger
+    // than the whole buffer can't be kept with anything before it: the buffer
+    // is emptied and the packet refused.
+    void Push(const uint8_t* data, size_t size, uint64_t timestamp, bool discontinuity) {
+        if (!data || size == 0) {
+            return;
+        }
+        if (size > m_storage.size()) {
+            m_droppedBytes += m_bufferedBytes + size;
+            Clear();
+            return;
+        }
+
+        while (m_storage.size() - m_bufferedBytes < size) {
+            m_droppedBytes += m_packets.front().size;
+            m_bufferedBytes -= m_packets.front().size;
+            m_packets.pop_front();
+        }
+
+        const size_t first = (std::min)(size, m_storage.size() - m_writeOffset);
+        memcpy(&m_storage[m_writeOffset], data, first);
+        if (first < size) {
+            memcpy(&m_storage[0], data + first, size - first);
+        }
+
+        m_packets.push_back({ m_writeOffset, size, timestamp, discontinuity });
+        m_writeOffset = (m_writeOffset + size) % m_storage.size();
+        m_bufferedBytes += size;
+    }
+
+    // Hand every packet to `sink(data, size, timestamp, discontinuity)`,
+    // oldest first. Packets that wrap around the end of the storage are
+    // passed from a contiguous copy.
+    template <typename Sink>
+    void ForEach(Sink&& sink) {
+        for (const Packet& packet : m_packets) {
+            const size_t first = (std::min)(packet.size, m_storage.size() - packet.offset);
+            if (first == packet.size) {
+                sink(&m_storage[packet.offset], packet.size, packet.timestamp, packet.discontinuity);
+                continue;
+            }
+            m_scratch.resize(packet.size);
+            memcpy(m_scratch.data(), &m_storage[packet.offset], first);
+            memcpy(m_scratch.data() + first, &m_storage[0], packet.size - first);
+            sink(m_scratch.data(), packet.size, packet.timestamp, packet.discontinuity);
+        }
+    }
+
+    // ForEach(), then empty the buffer
+    template <typename Sink>
+    void Drain(Sink&& sink) {
+        ForEach(sink);
+        Clear();
+    }
+
+    void Clear() {
+        m_packets.clear();
+        m_writeOffset = 0;
+        m_bufferedBytes = 0;
+    }
+
+private:
+    std::vector<uint8_t> m_storage;
+    std::deque<Packet> m_packets;   // Oldest first
+    size_t m_writeOffset;
+    size_t m_bufferedBytes;
+    uint64_t m_droppedBytes;
+    std::vector<uint8_t> m_scratch;
+};
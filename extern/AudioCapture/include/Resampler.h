@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Quality presets for Resampler (taps per phase at unity ratio / stopband)
+enum class ResamplerQuality {
+    Low,     // 16 taps, ~60 dB stopband - cheapest, fine for voice monitoring
+    Medium,  // 48 taps, ~90 dB stopband - default for recordings
+    High     // 96 taps, ~110 dB stopband
+};
+
+// Precomputed Kaiser-windowed sinc filter bank, shared between resamplers
+// with the same parameters (see Resampler::GetFilterBank)
+struct ResamplerFilterBank {
+    uint32_t phases;    // Number of fractional positions (rows)
+    uint32_t taps;      // Coefficients per row, padded to a multiple of 8
+    uint32_t center;    // Coefficient that lines up with the integer read position
+    bool interpolated;  // true: rows are blended linearly (arbitrary ratios)
+    std::vector<float> coefficients;  // (phases + 1) rows of `taps` floats
+};
+
+// Streaming polyphase windowed-sinc sample rate converter for interleaved
+// float audio.
+//
+// Phase and per-channel history carry over between Process() calls, so a
+// stream split into packets of any size produces exactly the same output as
+// one large call, and no fractional frames are lost at packet boundaries.
+// The read position advances in exact integer arithmetic:
+//   - Rational ratios with a small denominator (44.1k <-> 48k, 16k <-> 48k,
+//     ...) use one filter row per output phase, no interpolation.
+//   - Any other ratio (including the fine adjustments from SetRateAdjust)
+//     uses a 32.32 fixed-point position and blends two adjacent rows of a
+//     256-phase bank.
+//
+// Output lags input by a constant taps/2 input frames (the filter needs
+// that much look-ahead); nothing is dropped, it is just held back until the
+// next call.
+class Resampler {
+public:
+    Resampler();
+    ~Resampler();
+
+    // Configure for a rate pair and channel count. Clears history and phase.
+    bool Initialize(uint32_t inputRate, uint32_t outputRate, uint32_t channels,
+                    ResamplerQuality quality = ResamplerQuality::Medium);
+
+    // Reset history and phase but keep the configuration
+    void Reset();
+
+    // Fine-tune the effective ratio: consume input `factor` times faster
+    // than nominal (1.0 = nominal). Used for clock-drift compensation.
+    // Phase and history are kept, so changes are glitch-free.
+    void SetRateAdjust(double factor);
+    double GetRateAdjust() const { return m_rateAdjust; }
+
+    // Resample `inputFrames` interleaved frames; output frames are appended
+    // to `output` (interleaved). Returns the number of frames appended.
+    size_t Process(const float* input, size_t inputFrames, std::vector<float>& output);
+
+    // Planar variant: input[ch] points at `inputFrames` samples of channel ch,
+    // and output[ch] (an array of GetChannels() vectors) receives channel ch.
+    size_t ProcessPlanar(const float* const* input, size_t inputFrames, std::vector<float>* output);
+
+    uint32_t GetInputRate() const { return m_inputRate; }
+    uint32_t GetOutputRate() const { return m_outputRate; }
+    uint32_t GetChannels() const { return m_channels; }
+    bool IsInitialized() const { return m_bank != nullptr; }
+
+    // Input frames held back for look-ahead (constant after Initialize)
+    uint32_t GetLatencyFrames() const;
+
+    // Input frames received but not yet reached by the output position
+    // (fractional). The next input frame lands this many input frames after
+    // the next output frame.
+    double GetBufferedInputFrames() const;
+
+    // Shared, cached filter bank for a rate pair (thread-safe). Called with
+    // the common rate pairs at mixer start so the first packets don't pay for
+    // filter design.
+    static std::shared_ptr<const ResamplerFilterBank> GetFilterBank(
+        uint32_t inputRate, uint32_t outputRate, ResamplerQuality quality, bool interpolated);
+
+    // Build banks for the usual device rates converting into outputRate
+    static void PrewarmFilterBanks(uint32_t outputRate, ResamplerQuality quality);
+
+private:
+    void ConfigureStep();
+
+    // Produce every output the buffered history allows, into exactly one of
+    // `interleaved` or `planes`, then trim consumed history
+    size_t RunFilter(std::vector<float>* interleaved, std::vector<float>* planes);
+
+    uint32_t m_inputRate;
+    uint32_t m_outputRate;
+    uint32_t m_channels;
+    ResamplerQuality m_quality;
+    double m_rateAdjust;
+
+    std::shared_ptr<const ResamplerFilterBank> m_bank;           // Active bank
+    std::shared_ptr<const ResamplerFilterBank> m_rationalBank;   // Exact-phase bank, if the ratio allows one
+
+    // Position of the next output, relative to the start of m_history:
+    // m_position + m_phase / m_phaseDenominator input frames
+    size_t m_position;
+    uint64_t m_phase;
+    uint64_t m_phaseDenominator;
+
+    // Step per output frame, in the same representation
+    uint64_t m_stepWhole;
+    uint64_t m_stepPhase;
+
+    // Planar input history per channel; each output reads bank->taps frames
+    // starting at m_position - bank->center
+    std::vector<std::vector<float>> m_history;
+};
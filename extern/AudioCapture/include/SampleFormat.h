@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Platform-neutral sample format description and conversion to / from the
+// mixer's float representation. Nothing here depends on Windows headers;
+// AudioMixer::DescribeFormat() maps a WAVEFORMATEX(TENSIBLE) onto it.
+
+enum class SampleType {
+    Unknown,
+    Int16,
+    Int24,    // Packed 3-byte little-endian
+    Int32,    // Also 24-in-32 containers (valid bits are left-aligned)
+    Float32
+};
+
+// Speaker position bits, same values as the KSAUDIO_SPEAKER / SPEAKER_* masks
+enum SpeakerPosition : uint32_t {
+    kSpeakerFrontLeft          = 0x1,
+    kSpeakerFrontRight         = 0x2,
+    kSpeakerFrontCenter        = 0x4,
+    kSpeakerLowFrequency       = 0x8,
+    kSpeakerBackLeft           = 0x10,
+    kSpeakerBackRight          = 0x20,
+    kSpeakerFrontLeftOfCenter  = 0x40,
+    kSpeakerFrontRightOfCenter = 0x80,
+    kSpeakerBackCenter         = 0x100,
+    kSpeakerSideLeft           = 0x200,
+    kSpeakerSideRight          = 0x400
+};
+
+struct SampleFormat {
+    SampleType type = SampleType::Unknown;
+    uint32_t sampleRate = 0;
+    uint32_t channels = 0;
+    uint32_t channelMask = 0;  // 0 = positions unknown
+    uint32_t blockAlign = 0;   // Bytes per frame (may include container padding)
+
+    bool IsValid() const { return type != SampleType::Unknown && sampleRate && channels && blockAlign; }
+};
+
+inline bool operator==(const SampleFormat& a, const SampleFormat& b) {
+    return a.type == b.type && a.sampleRate == b.sampleRate && a.channels == b.channels &&
+           a.channelMask == b.channelMask && a.blockAlign == b.blockAlign;
+}
+inline bool operator!=(const SampleFormat& a, const SampleFormat& b) { return !(a == b); }
+
+// Bytes per sample of the given type (0 for Unknown)
+uint32_t SampleTypeBytes(SampleType type);
+
+// Conventional Windows layout for a channel count (0 if there is none)
+uint32_t DefaultChannelMask(uint32_t channels);
+
+// Packed samples -> float in [-1, 1). `count` is samples, not frames.
+void ConvertToFloat(const void* src, SampleType type, size_t count, float* dest);
+
+// Float -> packed samples, rounded and saturated for integer types
+void ConvertFromFloat(const float* src, size_t count, SampleType type, void* dest);
+
+// Interleaved frames of any sample type (with `stride` bytes per frame) ->
+// one float plane per channel
+void DeinterleaveToFloat(const void* src, SampleType type, uint32_t channels, uint32_t stride,
+                         size_t frames, float* const* planes);
+
+// Float planes -> interleaved frames of the given type (tightly packed)
+void InterleaveFromFloat(const float* const* planes, uint32_t channels, size_t frames,
+                         SampleType type, void* dest);
+
+// Up/down-mix between channel layouts: out[d] = sum_s gain[d][s] * in[s].
+//
+// Channels are matched by speaker position where the masks allow it; what
+// has no counterpart is folded onto the nearest side (centre -> both fronts
+// at -3 dB, surrounds -> same-side front at -3 dB, LFE dropped). A mono
+// source feeds every front channel at unity, and rows are normalized so a
+// full-scale input cannot overload an output channel.
+class ChannelMatrix {
+public:
+    ChannelMatrix();
+
+    void Build(uint32_t sourceChannels, uint32_t sourceMask, uint32_t destChannels, uint32_t destMask);
+
+    uint32_t SourceChannels() const { return m_sourceChannels; }
+    uint32_t DestChannels() const { return m_destChannels; }
+    bool IsIdentity() const { return m_identity; }
+    float Gain(uint32_t dest, uint32_t source) const { return m_gains[dest * m_sourceChannels + source]; }
+
+    // Planar in -> planar out (buffers must not alias)
+    void Apply(const float* const* in, float* const* out, size_t frames) const;
+
+private:
+    uint32_t m_sourceChannels;
+    uint32_t m_destChannels;
+    bool m_identity;
+    std::vector<float> m_gains;  // [dest][source]
+};
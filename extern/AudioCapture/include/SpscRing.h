@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Fixed-capacity, lock-free single-producer/single-consumer ring.
+//
+// Used to hand packets from the MMCSS capture thread to a consumer thread
+// without taking a lock or touching the heap. All slots are constructed up
+// front (copied from a prototype, so per-slot buffers can be preallocated)
+// and then written in place: BeginPush()/CommitPush() on the producer side,
+// Front()/Pop() on the consumer side. A push into a full ring is counted as
+// an overrun and rejected; the producer never waits.
+//
+// Head and tail live on separate cache lines, and each side keeps a private
+// copy of the other side's index so the shared line is only re-read when
+// the ring looks full (producer) or empty (consumer).
+template <typename T>
+class SpscRing {
+public:
+    static constexpr size_t kCacheLineSize = 64;
+
+    // capacity is rounded up to a power of two
+    explicit SpscRing(size_t capacity, const T& prototype = T())
+        : m_capacity(RoundUpToPowerOfTwo(capacity < 2 ? 2 : capacity))
+        , m_mask(m_capacity - 1)
+        , m_slots(new T[m_capacity])
+    {
+        for (size_t i = 0; i < m_capacity; i++) {
+            m_slots[i] = prototype;
+        }
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // ---- Producer side ----
+
+    // Returns the next free slot, or nullptr (and counts an overrun) when full
+    T* BeginPush() {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_cachedHead >= m_capacity) {
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+            if (tail - m_cachedHead >= m_capacity) {
+                m_overruns.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+        }
+        return &m_slots[tail & m_mask];
+    }
+
+    // Publishes the slot returned by the last BeginPush()
+    void CommitPush() {
+        m_tail.store(m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    bool TryPush(const T& value) {
+        T* slot = BeginPush();
+        if (!slot) {
+            return false;
+        }
+        *slot = value;
+        CommitPush();
+        return true;
+    }
+
+    // ---- Consumer side ----
+
+    // Returns the oldest published slot, or nullptr when empty
+    T* Front() {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_cachedTail) {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            if (head == m_cachedTail) {
+                return nullptr;
+            }
+        }
+        return &m_slots[head & m_mask];
+    }
+
+    // Releases the slot returned by the last Front() back to the producer
+    void Pop() {
+        m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    bool TryPop(T& value) {
+        T* slot = Front();
+        if (!slot) {
+            return false;
+        }
+        value = *slot;
+        Pop();
+        return true;
+    }
+
+    // ---- Either side ----
+
+    size_t Capacity() const { return m_capacity; }
+
+    // Snapshot only - exact when called from the producer or consumer thread
+    // while the other side is idle
+    size_t SizeApprox() const {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+
+    // Number of pushes rejected because the ring was full
+    uint64_t Overruns() const { return m_overruns.load(std::memory_order_relaxed); }
+
+private:
+    static size_t RoundUpToPowerOfTwo(size_t value) {
+        size_t result = 1;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    const size_t m_capacity;
+    const size_t m_mask;
+    std::unique_ptr<T[]> m_slots;
+
+    // Consumer-owned line
+    alignas(kCacheLineSize) std::atomic<size_t> m_head{0};
+    size_t m_cachedTail = 0;
+
+    // Producer-owned line
+    alignas(kCacheLineSize) std::atomic<size_t> m_tail{0};
+    size_t m_cachedHead = 0;
+
+    alignas(kCacheLineSize) std::atomic<uint64_t> m_overruns{0};
+};
@@ -0,0 +1,291 @@
+#pragma once
+
+#include "CpuFeatures.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Vectorized per-frame work of VoiceActivityDetector.
+//
+//   boxDecimate:    out[j] = mean(in[j*width .. j*width+width)), the
+//                   downmix and low-pass in one pass over interleaved audio
+//   sumSquares:     sum of x[i]^2
+//   zeroCrossings:  count of i in [1, n) with (x[i] < 0) != (x[i-1] < 0)
+//   spectrumStats:  P = re^2 + im^2 + floor per bin; adds sum(P) and
+//                   sum(log2 P) (FastLog2, |error| < 2e-4)
+//
+// Scalar reference plus SSE2 and AVX2 variants. zeroCrossings is exact; the
+// sums are reassociated across lanes, so they agree with the scalar
+// reference to float rounding rather than bit for bit.
+
+struct VadKernels {
+    void (*boxDecimate)(const float* in, size_t outCount, size_t width, float* out);
+    float (*sumSquares)(const float* x, size_t n);
+    uint32_t (*zeroCrossings)(const float* x, size_t n);
+    void (*spectrumStats)(const float* re, const float* im, size_t n, float floor, float* sumPower, float* sumLog2);
+    SimdLevel level;
+};
+
+namespace vad_detail {
+
+// log2(1 + t) on [0, 1), least-squares fit
+constexpr float kLog2C1 = 1.4385479f;
+constexpr float kLog2C2 = -0.67808946f;
+constexpr float kLog2C3 = 0.32364631f;
+constexpr float kLog2C4 = -0.084294656f;
+
+// log2 of a positive normal float: exponent plus a polynomial in the mantissa
+inline float FastLog2(float x) {
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    const float exponent = static_cast<float>(static_cast<int32_t>(bits >> 23) - 127);
+    bits = (bits & 0x007FFFFFu) | 0x3F800000u;
+    float mantissa;
+    memcpy(&mantissa, &bits, sizeof(mantissa));
+    const float t = mantissa - 1.0f;
+    return exponent + t * (kLog2C1 + t * (kLog2C2 + t * (kLog2C3 + t * kLog2C4)));
+}
+
+// ---- Scalar reference ----
+
+inline void BoxDecimateScalar(const float* in, size_t outCount, size_t width, float* out) {
+    const float scale = 1.0f / static_cast<float>(width);
+    for (size_t j = 0; j < outCount; j++) {
+        float sum = 0.0f;
+        for (size_t k = 0; k < width; k++) {
+            sum += in[j * width + k];
+        }
+        out[j] = sum * scale;
+    }
+}
+
+inline float SumSquaresScalar(const float* x, size_t n) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; i++) {
+        sum += x[i] * x[i];
+    }
+    return sum;
+}
+
+inline uint32_t ZeroCrossingsTail(const float* x, size_t begin, size_t n) {
+    uint32_t count = 0;
+    for (size_t i = (begin > 0 ? begin : 1); i < n; i++) {
+        count += ((x[i] < 0.0f) != (x[i - 1] < 0.0f)) ? 1 : 0;
+    }
+    return count;
+}
+
+inline uint32_t ZeroCrossingsScalar(const float* x, size_t n) {
+    return ZeroCrossingsTail(x, 1, n);
+}
+
+inline void SpectrumStatsTail(const float* re, const float* im, size_t begin, size_t n, float floor,
+                              float* sumPower, float* sumLog2) {
+    for (size_t i = begin; i < n; i++) {
+        const float power = re[i] * re[i] + im[i] * im[i] + floor;
+        *sumPower += power;
+        *sumLog2 += FastLog2(power);
+    }
+}
+
+inline void SpectrumStatsScalar(const float* re, const float* im, size_t n, float floor,
+                                float* sumPower, float* sumLog2) {
+    SpectrumStatsTail(re, im, 0, n, floor, sumPower, sumLog2);
+}
+
+#if AUDIO_SIMD_X86
+
+// ---- SSE2 ----
+
+AUDIO_TARGET_SSE2 inline float HorizontalSumSse2(__m128 v) {
+    __m128 shuffled = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(v, shuffled);
+    shuffled = _mm_movehl_ps(shuffled, sums);
+    return _mm_cvtss_f32(_mm_add_ss(sums, shuffled));
+}
+
+AUDIO_TARGET_SSE2 inline __m128 FastLog2Sse2(__m128 x) {
+    const __m128i bits = _mm_castps_si128(x);
+    const __m128 exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+    const __m128 mantissa = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)),
+                                                          _mm_set1_epi32(0x3F800000)));
+    const __m128 t = _mm_sub_ps(mantissa, _mm_set1_ps(1.0f));
+    __m128 p = _mm_add_ps(_mm_set1_ps(kLog2C3), _mm_mul_ps(t, _mm_set1_ps(kLog2C4)));
+    p = _mm_add_ps(_mm_set1_ps(kLog2C2), _mm_mul_ps(t, p));
+    p = _mm_add_ps(_mm_set1_ps(kLog2C1), _mm_mul_ps(t, p));
+    return _mm_add_ps(exponent, _mm_mul_ps(t, p));
+}
+
+AUDIO_TARGET_SSE2 inline void BoxDecimateSse2(const float* in, size_t outCount, size_t width, float* out) {
+    if (width % 4 != 0) {
+        BoxDecimateScalar(in, outCount, width, out);
+        return;
+    }
+    const float scale = 1.0f / static_cast<float>(width);
+    for (size_t j = 0; j < outCount; j++) {
+        const float* block = in + j * width;
+        __m128 sum = _mm_setzero_ps();
+        for (size_t k = 0; k < width; k += 4) {
+            sum = _mm_add_ps(sum, _mm_loadu_ps(block + k));
+        }
+        out[j] = HorizontalSumSse2(sum) * scale;
+    }
+}
+
+AUDIO_TARGET_SSE2 inline float SumSquaresSse2(const float* x, size_t n) {
+    __m128 sum = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m128 v = _mm_loadu_ps(x + i);
+        sum = _mm_add_ps(sum, _mm_mul_ps(v, v));
+    }
+    float total = HorizontalSumSse2(sum);
+    for (; i < n; i++) {
+        total += x[i] * x[i];
+    }
+    return total;
+}
+
+AUDIO_TARGET_SSE2 inline uint32_t ZeroCrossingsSse2(const float* x, size_t n) {
+    const __m128 zero = _mm_setzero_ps();
+    uint32_t count = 0;
+    size_t i = 1;
+    for (; i + 4 <= n; i += 4) {
+        const __m128 current = _mm_cmplt_ps(_mm_loadu_ps(x + i), zero);
+        const __m128 previous = _mm_cmplt_ps(_mm_loadu_ps(x + i - 1), zero);
+        const int mask = _mm_movemask_ps(_mm_xor_ps(current, previous));
+        count += static_cast<uint32_t>((mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1));
+    }
+    return count + ZeroCrossingsTail(x, i, n);
+}
+
+AUDIO_TARGET_SSE2 inline void SpectrumStatsSse2(const float* re, const float* im, size_t n, float floor,
+                                                float* sumPower, float* sumLog2) {
+    const __m128 f = _mm_set1_ps(floor);
+    __m128 power = _mm_setzero_ps();
+    __m128 logs = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m128 r = _mm_loadu_ps(re + i);
+        const __m128 m = _mm_loadu_ps(im + i);
+        const __m128 p = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, r), _mm_mul_ps(m, m)), f);
+        power = _mm_add_ps(power, p);
+        logs = _mm_add_ps(logs, FastLog2Sse2(p));
+    }
+    *sumPower += HorizontalSumSse2(power);
+    *sumLog2 += HorizontalSumSse2(logs);
+    SpectrumStatsTail(re, im, i, n, floor, sumPower, sumLog2);
+}
+
+// ---- AVX2 ----
+
+AUDIO_TARGET_AVX2 inline float HorizontalSumAvx2(__m256 v) {
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    __m128 shuffled = _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(2, 3, 0, 1));
+    sum = _mm_add_ps(sum, shuffled);
+    shuffled = _mm_movehl_ps(shuffled, sum);
+    return _mm_cvtss_f32(_mm_add_ss(sum, shuffled));
+}
+
+AUDIO_TARGET_AVX2 inline __m256 FastLog2Avx2(__m256 x) {
+    const __m256i bits = _mm256_castps_si256(x);
+    const __m256 exponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+    const __m256 mantissa = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)),
+                                                                _mm256_set1_epi32(0x3F800000)));
+    const __m256 t = _mm256_sub_ps(mantissa, _mm256_set1_ps(1.0f));
+    __m256 p = _mm256_add_ps(_mm256_set1_ps(kLog2C3), _mm256_mul_ps(t, _mm256_set1_ps(kLog2C4)));
+    p = _mm256_add_ps(_mm256_set1_ps(kLog2C2), _mm256_mul_ps(t, p));
+    p = _mm256_add_ps(_mm256_set1_ps(kLog2C1), _mm256_mul_ps(t, p));
+    return _mm256_add_ps(exponent, _mm256_mul_ps(t, p));
+}
+
+AUDIO_TARGET_AVX2 inline void BoxDecimateAvx2(const float* in, size_t outCount, size_t width, float* out) {
+    if (width % 8 != 0) {
+        BoxDecimateSse2(in, outCount, width, out);
+        return;
+    }
+    const float scale = 1.0f / static_cast<float>(width);
+    for (size_t j = 0; j < outCount; j++) {
+        const float* block = in + j * width;
+        __m256 sum = _mm256_setzero_ps();
+        for (size_t k = 0; k < width; k += 8) {
+            sum = _mm256_add_ps(sum, _mm256_loadu_ps(block + k));
+        }
+        out[j] = HorizontalSumAvx2(sum) * scale;
+    }
+}
+
+AUDIO_TARGET_AVX2 inline float SumSquaresAvx2(const float* x, size_t n) {
+    __m256 sum = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256 v = _mm256_loadu_ps(x + i);
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(v, v));
+    }
+    float total = HorizontalSumAvx2(sum);
+    for (; i < n; i++) {
+        total += x[i] * x[i];
+    }
+    return total;
+}
+
+AUDIO_TARGET_AVX2 inline uint32_t ZeroCrossingsAvx2(const float* x, size_t n) {
+    const __m256 zero = _mm256_setzero_ps();
+    uint32_t count = 0;
+    size_t i = 1;
+    for (; i + 8 <= n; i += 8) {
+        const __m256 current = _mm256_cmp_ps(_mm256_loadu_ps(x + i), zero, _CMP_LT_OQ);
+        const __m256 previous = _mm256_cmp_ps(_mm256_loadu_ps(x + i - 1), zero, _CMP_LT_OQ);
+        const unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_xor_ps(current, previous)));
+        for (unsigned bits = mask; bits != 0; bits &= bits - 1) {
+            count++;
+        }
+    }
+    return count + ZeroCrossingsTail(x, i, n);
+}
+
+AUDIO_TARGET_AVX2 inline void SpectrumStatsAvx2(const float* re, const float* im, size_t n, float floor,
+                                                float* sumPower, float* sumLog2) {
+    const __m256 f = _mm256_set1_ps(floor);
+    __m256 power = _mm256_setzero_ps();
+    __m256 logs = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256 r = _mm256_loadu_ps(re + i);
+        const __m256 m = _mm256_loadu_ps(im + i);
+        const __m256 p = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r, r), _mm256_mul_ps(m, m)), f);
+        power = _mm256_add_ps(power, p);
+        logs = _mm256_add_ps(logs, FastLog2Avx2(p));
+    }
+    *sumPower += HorizontalSumAvx2(power);
+    *sumLog2 += HorizontalSumAvx2(logs);
+    SpectrumStatsTail(re, im, i, n, floor, sumPower, sumLog2);
+}
+
+#endif // AUDIO_SIMD_X86
+
+} // namespace vad_detail
+
+// Kernel table for a specific level (falls back to the best level compiled in)
+inline VadKernels GetVadKernels(SimdLevel level) {
+#if AUDIO_SIMD_X86
+    if (level >= SimdLevel::AVX2) {
+        return { vad_detail::BoxDecimateAvx2, vad_detail::SumSquaresAvx2,
+                 vad_detail::ZeroCrossingsAvx2, vad_detail::SpectrumStatsAvx2, SimdLevel::AVX2 };
+    }
+    if (level >= SimdLevel::SSE2) {
+        return { vad_detail::BoxDecimateSse2, vad_detail::SumSquaresSse2,
+                 vad_detail::ZeroCrossingsSse2, vad_detail::SpectrumStatsSse2, SimdLevel::SSE2 };
+    }
+#else
+    (void)level;
+#endif
+    return { vad_detail::BoxDecimateScalar, vad_detail::SumSquaresScalar,
+             vad_detail::ZeroCrossingsScalar, vad_detail::SpectrumStatsScalar, SimdLevel::Scalar };
+}
+
+// Kernels for the running CPU, selected on first use
+inline const VadKernels& ActiveVadKernels() {
+    static const VadKernels kernels = GetVadKernels(DetectSimdLevel());
+    return kernels;
+}
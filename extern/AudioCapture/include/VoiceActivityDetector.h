@@ -0,0 +1,118 @@
+#pragma once
+
+#include "SampleFormat.h"
+#include "VadKernels.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Settings for VoiceActivityDetector
+struct VadSettings {
+    float marginDb = 9.0f;          // Frame energy above the tracked noise floor
+    float minEnergyDb = -60.0f;     // Absolute floor for speech, dBFS
+    float minFlatness = 0.001f;     // Below: a tone (notification, ringback)
+    float maxFlatness = 0.4f;       // Above: noise
+    float maxZeroCrossings = 0.45f; // Zero crossings per sample; above: hiss
+    float floorRiseDbPerSec = 3.0f; // How fast the noise floor follows a louder background
+    int minRunFrames = 3;           // Consecutive speech frames before any count
+    int hangoverFrames = 12;        // Frames still counted after a run ends
+};
+
+// Streaming voice-activity detector for captured PCM.
+//
+// Input of any SampleFormat is downmixed and decimated to about 8 kHz with
+// a box filter (D = round(rate / 8000) frames averaged, carried across
+// packets), then cut into frames of kFrameSize samples (16 ms at 8 kHz).
+// Per frame:
+//   energy     mean square in dBFS, against a noise floor that follows a
+//              quieter frame at once and a louder one at floorRiseDbPerSec
+//   flatness   geometric / arithmetic mean of the Hann-windowed power
+//              spectrum over 250-3500 Hz: low for voiced speech, near 0 for
+//              a pure tone, high for noise
+//   zcr        zero crossings per sample
+// A frame counts as speech once all three have been in range for
+// minRunFrames frames in a row, and for hangoverFrames after such a run.
+//
+// The box filter aliases some energy above 4 kHz into the band, which only
+// nudges the flatness of hiss further up. Not thread-safe; the owner
+// serializes Process and TakeCounts.
+class VoiceActivityDetector {
+public:
+    static constexpr size_t kFrameSize = 128;
+    static constexpr uint32_t kTargetRate = 8000;
+
+    struct Features {
+        float energyDb;
+        float noiseFloorDb;
+        float flatness;
+        float zcr;
+        bool speech;
+    };
+
+    struct Counts {
+        uint32_t frames = 0;
+        uint32_t speechFrames = 0;
+
+        // Share of speech frames, or -1 when no frame was analysed
+        float GetRatio() const { return frames ? (float)speechFrames / (float)frames : -1.0f; }
+    };
+
+    VoiceActivityDetector();
+
+    // Configure for a stream. Clears all state.
+    bool Initialize(const VadSettings& settings, const SampleFormat& format);
+
+    bool IsInitialized() const { return m_format.IsValid(); }
+
+    // Kernel level; the CPU's best by default
+    void SetSimdLevel(SimdLevel level) { m_kernels = GetVadKernels(level); }
+    SimdLevel GetSimdLevel() const { return m_kernels.level; }
+
+    // Feed `frames` frames of the configured format. Completed analysis
+    // frames are appended to `features` when given.
+    void Process(const void* data, size_t frames, std::vector<Features>* features = nullptr);
+
+    // Frames analysed since the last call
+    Counts TakeCounts();
+
+    // Clear the stream state (carry, noise floor, runs) but keep the configuration
+    void Reset();
+
+    // Rate of the analysed signal (sampleRate / D)
+    float GetAnalysisRate() const { return m_analysisRate; }
+
+private:
+    void AnalyzeFrame(const float* frame, std::vector<Features>* features);
+    void Fft();
+
+    VadSettings m_settings;
+    SampleFormat m_format;
+    VadKernels m_kernels;
+
+    uint32_t m_decimation;      // Input frames per analysed sample
+    float m_analysisRate;
+    size_t m_bandBegin;         // FFT bins of the speech band
+    size_t m_bandEnd;
+    float m_floorRisePerFrame;  // dB
+
+    // Interleaved input not yet forming a full decimation block, then the
+    // decimated samples not yet forming a full frame
+    std::vector<float> m_input;
+    size_t m_inputCount;
+    std::vector<float> m_samples;
+    size_t m_sampleCount;
+
+    float m_noiseFloorDb;
+    bool m_haveFloor;
+    int m_run;
+    int m_hangover;
+    Counts m_counts;
+
+    // FFT tables and buffers
+    std::vector<float> m_window;
+    std::vector<float> m_cos;
+    std::vector<float> m_sin;
+    std::vector<uint16_t> m_bitReverse;
+    std::vector<float> m_re;
+    std::vector<float> m_im;
+};
@@ -1,4 +1,5 @@
 #include "AudioCapture.h"
+#include "GainKernel.h"
 #include <avrt.h>
 #include <functiondiscoverykeys_devpkey.h>
 #include <audioclientactivationparams.h>
@@ -10,6 +11,102 @@
 #include <ksmedia.h>
 #include <algorithm>
 
+//=============================================================================
+// WasapiCaptureSource - CaptureSource backed by IAudioCaptureClient
+//=============================================================================
+
+namespace {
+
+// Polling fallback period (original behavior)
+constexpr DWORD kPollIntervalMs = 10;
+
+// Upper bound on an event wait. Loopback streams on older Windows builds
+// never signal the event, and a render endpoint playing nothing produces no
+// packets at all, so the loop still drains on timeout.
+constexpr DWORD kEventWaitTimeoutMs = 100;
+
+// Capture -> delivery ring. Each slot holds two device periods (packets
+// can run slightly long when the thread wakes late); the ring as a whole
+// covers at least kPacketRingDepthMs of audio.
+constexpr UINT32 kPacketSlotPeriods = 2;
+constexpr UINT32 kPacketRingDepthMs = 500;
+constexpr REFERENCE_TIME kFallbackDevicePeriod = 100000; // 10ms, when GetDevicePeriod is unsupported
+
+// Read-only zeros handed to the data callback for silent packets
+constexpr UINT32 kZeroPageSize = 16384;
+alignas(64) const BYTE g_zeroPage[kZeroPageSize] = {};
+
+// Delivery thread re-checks for shutdown at least this often
+constexpr DWORD kDeliveryWaitTimeoutMs = 100;
+
+class WasapiCaptureSource : public CaptureSource {
+public:
+    // captureEvent == nullptr selects the polling fallback
+    WasapiCaptureSource(IAudioCaptureClient* captureClient, HANDLE captureEvent)
+        : m_captureClient(captureClient), m_captureEvent(captureEvent) {}
+
+    CaptureWaitResult WaitForData() override {
+        if (!m_captureEvent) {
+            Sleep(kPollIntervalMs);
+            return CaptureWaitResult::Timeout;
+        }
+
+        DWORD waitResult = WaitForSingleObject(m_captureEvent, kEventWaitTimeoutMs);
+        if (waitResult == WAIT_OBJECT_0) {
+            return CaptureWaitResult::Signaled;
+        }
+        if (waitResult == WAIT_TIMEOUT) {
+            return CaptureWaitResult::Timeout;
+        }
+        return CaptureWaitResult::Failed;
+    }
+
+    void Wake() override {
+        if (m_captureEvent) {
+            SetEvent(m_captureEvent);
+        }
+    }
+
+    bool GetNextPacketSize(uint32_t& frames) override {
+        UINT32 packetLength = 0;
+        HRESULT hr = m_captureClient->GetNextPacketSize(&packetLength);
+        frames = packetLength;
+        return SUCCEEDED(hr);
+    }
+
+    bool AcquirePacket(CapturePacket& packet) override {
+        BYTE* data = nullptr;
+        UINT32 numFramesAvailable = 0;
+        DWORD flags = 0;
+        UINT64 devicePosition = 0;
+        UINT64 qpcPosition = 0;
+
+        HRESULT hr = m_captureClient->GetBuffer(&data, &numFramesAvailable, &flags,
+                                                &devicePosition, &qpcPosition);
+        if (FAILED(hr)) {
+            return false;
+        }
+
+        packet.data = data;
+        packet.frames = numFramesAvailable;
+        packet.silent = (flags & AUDCLNT_BUFFERFLAGS_SILENT) != 0;
+        packet.discontinuity = (flags & AUDCLNT_BUFFERFLAGS_DATA_DISCONTINUITY) != 0;
+        // The engine couldn't correlate the device position with QPC for this packet
+        packet.timestamp = (flags & AUDCLNT_BUFFERFLAGS_TIMESTAMP_ERROR) ? 0 : qpcPosition;
+        return true;
+    }
+
+    bool ReleasePacket(uint32_t frames) override {
+        return SUCCEEDED(m_captureClient->ReleaseBuffer(frames));
+    }
+
+private:
+    IAudioCaptureClient* m_captureClient;
+    HANDLE m_captureEvent;
+};
+
+} // namespace
+
 //=============================================================================
 // AudioClientActivationHandler Implementation
 //=============================================================================
@@ -134,8 +231,13 @@ AudioCapture::AudioCapture()
     , m_waveFormat(nullptr)
     , m_isCapturing(false)
     , m_isPaused(false)
+    , m_captureEvent(nullptr)
+    , m_eventDriven(false)
+    , m_isDelivering(false)
+    , m_deliveryEvent(nullptr)
     , m_targetProcessId(0)
     , m_volumeMultiplier(1.0f)  // Default to 100% volume
+    , m_appliedVolume(1.0f)
     , m_isProcessSpecific(false)
     , m_isInputDevice(false)
     , m_passthroughEnabled(false)
@@ -166,6 +268,12 @@ AudioCapture::~AudioCapture() {
     if (m_deviceEnumerator) {
         m_deviceEnumerator->Release();
     }
+    if (m_captureEvent) {
+        CloseHandle(m_captureEvent);
+    }
+    if (m_deliveryEvent) {
+        CloseHandle(m_deliveryEvent);
+    }
 
     // Don't call CoUninitialize - main thread will handle it
 }
@@ -388,14 +496,8 @@ bool AudioCapture::InitializeProcessSpecificCapture(DWORD processId) {
     }
 
     // Initialize audio client for loopback capture
-    const REFERENCE_TIME hnsRequestedDuration = 10000000; // 1 second
-    hr = m_audioClient->Initialize(
-        AUDCLNT_SHAREMODE_SHARED,
-        AUDCLNT_STREAMFLAGS_LOOPBACK | AUDCLNT_STREAMFLAGS_AUTOCONVERTPCM | AUDCLNT_STREAMFLAGS_SRC_DEFAULT_QUALITY,
-        hnsRequestedDuration,
-        0,
-        m_waveFormat,
-        nullptr);
+    hr = InitializeAudioClient(
+        AUDCLNT_STREAMFLAGS_LOOPBACK | AUDCLNT_STREAMFLAGS_AUTOCONVERTPCM | AUDCLNT_STREAMFLAGS_SRC_DEFAULT_QUALITY);
 
     if (FAILED(hr)) {
         CoTaskMemFree(m_waveFormat);
@@ -435,14 +537,7 @@ bool AudioCapture::InitializeSystemWideCapture() {
     }
 
     // Initialize audio client for loopback capture
-    const REFERENCE_TIME hnsRequestedDuration = 10000000; // 1 second
-    hr = m_audioClient->Initialize(
-        AUDCLNT_SHAREMODE_SHARED,
-        AUDCLNT_STREAMFLAGS_LOOPBACK,
-        hnsRequestedDuration,
-        0,
-        m_waveFormat,
-        nullptr);
+    hr = InitializeAudioClient(AUDCLNT_STREAMFLAGS_LOOPBACK);
     if (FAILED(hr)) {
         return false;
     }
@@ -457,6 +552,44 @@ bool AudioCapture::InitializeSystemWideCapture() {
     return true;
 }
 
+HRESULT AudioCapture::InitializeAudioClient(DWORD streamFlags) {
+    const REFERENCE_TIME hnsRequestedDuration = 10000000; // 1 second
+    m_eventDriven = false;
+
+    // Prefer event-driven delivery: the capture thread sleeps until WASAPI
+    // signals a full period instead of waking every 10ms.
+    if (!m_captureEvent) {
+        m_captureEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    }
+
+    if (m_captureEvent) {
+        HRESULT hr = m_audioClient->Initialize(
+            AUDCLNT_SHAREMODE_SHARED,
+            streamFlags | AUDCLNT_STREAMFLAGS_EVENTCALLBACK,
+            hnsRequestedDuration,
+            0,
+            m_waveFormat,
+            nullptr);
+
+        if (SUCCEEDED(hr)) {
+            // The client is now initialized in event mode - without a handle
+            // Start() would fail, so there is nothing to fall back to here.
+            hr = m_audioClient->SetEventHandle(m_captureEvent);
+            m_eventDriven = SUCCEEDED(hr);
+            return hr;
+        }
+    }
+
+    // Endpoint rejected EVENTCALLBACK - fall back to polling
+    return m_audioClient->Initialize(
+        AUDCLNT_SHAREMODE_SHARED,
+        streamFlags,
+        hnsRequestedDuration,
+        0,
+        m_waveFormat,
+        nullptr);
+}
+
 bool AudioCapture::InitializeFromDevice(const std::wstring& deviceId, bool isInputDevice) {
     m_isInputDevice = isInputDevice;
     m_isProcessSpecific = false;
@@ -512,7 +645,6 @@ bool AudioCapture::InitializeFromDevice(const std::wstring& deviceId, bool isInp
     }
 
     // Initialize audio client
-    const REFERENCE_TIME hnsRequestedDuration = 10000000; // 1 second
     DWORD streamFlags = 0;
 
     // For input devices (microphones), don't use loopback mode
@@ -521,13 +653,7 @@ bool AudioCapture::InitializeFromDevice(const std::wstring& deviceId, bool isInp
         streamFlags = AUDCLNT_STREAMFLAGS_LOOPBACK;
     }
 
-    hr = m_audioClient->Initialize(
-        AUDCLNT_SHAREMODE_SHARED,
-        streamFlags,
-        hnsRequestedDuration,
-        0,
-        m_waveFormat,
-        nullptr);
+    hr = InitializeAudioClient(streamFlags);
     if (FAILED(hr)) {
         return false;
     }
@@ -547,16 +673,32 @@ bool AudioCapture::Start() {
         return false;
     }
 
-    if (!m_audioClient || !m_captureClient) {
+    if (!m_audioClient || !m_captureClient || !m_waveFormat) {
         return false;
     }
 
+    // Preallocate the delivery ring so the capture thread never allocates
+    AllocatePacketRing();
+
+    // Start at the requested volume rather than ramping in from the last session
+    m_appliedVolume = (std::max)(0.0f, (std::min)(m_volumeMultiplier.load(), 1.0f));
+
+    if (!m_deliveryEvent) {
+        m_deliveryEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    }
+
     // Start audio client
     HRESULT hr = m_audioClient->Start();
     if (FAILED(hr)) {
         return false;
     }
 
+    m_source = std::make_unique<WasapiCaptureSource>(m_captureClient,
+                                                     m_eventDriven ? m_captureEvent : nullptr);
+
+    m_isDelivering = true;
+    m_deliveryThread = std::thread(&AudioCapture::DeliveryThread, this);
+
     m_isCapturing = true;
     m_captureThread = std::thread(&AudioCapture::CaptureThread, this);
 
@@ -577,10 +719,26 @@ void AudioCapture::Stop() {
     m_isCapturing = false;
     m_isPaused = false;
 
+    // Wake the thread if it is blocked waiting for the next period
+    if (m_source) {
+        m_source->Wake();
+    }
+
     // Wait for thread to finish
     if (m_captureThread.joinable()) {
         m_captureThread.join();
     }
+
+    m_source.reset();
+
+    // Capture thread is gone - let the delivery thread flush what's queued and exit
+    m_isDelivering = false;
+    if (m_deliveryEvent) {
+        SetEvent(m_deliveryEvent);
+    }
+    if (m_deliveryThread.joinable()) {
+        m_deliveryThread.join();
+    }
 }
 
 void AudioCapture::Pause() {
@@ -624,7 +782,12 @@ void AudioCapture::ApplyVolumeToBuffer(BYTE* data, UINT32 size) {
         return;
     }
 
-    if (m_volumeMultiplier >= 1.0f) {
+    // Clamp to the documented 0.0 - 1.0 range; gain above unity is never applied
+    float target = m_volumeMultiplier.load(std::memory_order_relaxed);
+    target = (std::max)(0.0f, (std::min)(target, 1.0f));
+    const float from = m_appliedVolume;
+
+    if (from >= 1.0f && target >= 1.0f) {
         return; // No adjustment needed
     }
 
@@ -641,27 +804,38 @@ void AudioCapture::ApplyVolumeToBuffer(BYTE* data, UINT32 size) {
         isFloat = (m_waveFormat->wFormatTag == WAVE_FORMAT_IEEE_FLOAT);
     }
 
+    const GainKernels& kernels = ActiveGainKernels();
+    const unsigned channels = m_waveFormat->nChannels ? m_waveFormat->nChannels : 1;
+
+    // A volume change is ramped across this buffer instead of stepping
+    // at the buffer boundary, which would be audible as a click
     if (isFloat && m_waveFormat->wBitsPerSample == 32) {
         // 32-bit float PCM
         float* samples = reinterpret_cast<float*>(data);
-        UINT32 numSamples = size / sizeof(float);
-        for (UINT32 i = 0; i < numSamples; i++) {
-            samples[i] = samples[i] * m_volumeMultiplier;
+        size_t frames = size / (sizeof(float) * channels);
+        if (from == target) {
+            kernels.applyFloat(samples, frames * channels, target);
+        } else {
+            kernels.rampFloat(samples, frames, channels, from, target);
         }
     }
     else if (m_waveFormat->wBitsPerSample == 16) {
         // 16-bit PCM
         int16_t* samples = reinterpret_cast<int16_t*>(data);
-        UINT32 numSamples = size / sizeof(int16_t);
-        for (UINT32 i = 0; i < numSamples; i++) {
-            samples[i] = static_cast<int16_t>(samples[i] * m_volumeMultiplier);
+        size_t frames = size / (sizeof(int16_t) * channels);
+        if (from == target) {
+            kernels.applyInt16(samples, frames * channels, target);
+        } else {
+            kernels.rampInt16(samples, frames, channels, from, target);
         }
     }
+
+    m_appliedVolume = target;
 }
 
 void AudioCapture::CaptureThread() {
     // Validate required members
-    if (!m_captureClient || !m_waveFormat) {
+    if (!m_source || !m_waveFormat) {
         return;
     }
 
@@ -669,97 +843,132 @@ void AudioCapture::CaptureThread() {
     DWORD taskIndex = 0;
     HANDLE hTask = AvSetMmThreadCharacteristics(L"Audio", &taskIndex);
 
-    // Poll every 10ms
-    const DWORD sleepMs = 10;
+    RunCaptureLoop(*m_source, m_isCapturing, [this](const CapturePacket& packet) {
+        ProcessPacket(packet);
+    });
 
-    while (m_isCapturing) {
-        Sleep(sleepMs);
+    if (hTask) {
+        AvRevertMmThreadCharacteristics(hTask);
+    }
+}
 
-        // Check if we should stop
-        if (!m_isCapturing) {
-            break;
+void AudioCapture::AllocatePacketRing() {
+    // Packet size follows the shared-mode engine period (10ms on most devices).
+    // Process loopback clients may not report one - assume the default.
+    REFERENCE_TIME defaultPeriod = 0;
+    if (FAILED(m_audioClient->GetDevicePeriod(&defaultPeriod, nullptr)) || defaultPeriod <= 0) {
+        defaultPeriod = kFallbackDevicePeriod;
+    }
+
+    const UINT32 blockAlign = m_waveFormat->nBlockAlign;
+    UINT32 periodFrames = static_cast<UINT32>(
+        (static_cast<UINT64>(m_waveFormat->nSamplesPerSec) * defaultPeriod + 9999999) / 10000000);
+    periodFrames = (std::max)(periodFrames, 1u);
+
+    UINT32 periodMs = static_cast<UINT32>((defaultPeriod + 9999) / 10000);
+    size_t slotCount = kPacketRingDepthMs / (std::max)(periodMs, 1u);
+
+    CapturedPacket prototype;
+    prototype.data.resize(static_cast<size_t>(periodFrames) * kPacketSlotPeriods * blockAlign);
+    m_packetRing = std::make_unique<SpscRing<CapturedPacket>>(slotCount, prototype);
+}
+
+void AudioCapture::DeliverSilence(UINT32 size, const AudioPacketTiming& timing) {
+    // Hand out the shared zero page in frame-aligned pieces
+    const UINT32 maxChunk = (kZeroPageSize / m_waveFormat->nBlockAlign) * m_waveFormat->nBlockAlign;
+    if (maxChunk == 0) {
+        return;
+    }
+    AudioPacketTiming chunkTiming = timing;
+    while (size > 0) {
+        UINT32 chunkSize = (std::min)(size, maxChunk);
+        m_dataCallback(g_zeroPage, chunkSize, chunkTiming);
+        chunkTiming.timestamp = TimestampAfter(chunkTiming.timestamp, chunkSize, m_waveFormat->nBlockAlign,
+                                               m_waveFormat->nSamplesPerSec);
+        chunkTiming.discontinuity = false;
+        size -= chunkSize;
+    }
+}
+
+void AudioCapture::DeliveryThread() {
+    while (true) {
+        // Read the flag BEFORE draining: Stop() clears it only after the
+        // capture thread has exited, so the last pass sees every packet
+        bool delivering = m_isDelivering;
+
+        while (CapturedPacket* packet = m_packetRing->Front()) {
+            if (m_dataCallback && packet->size > 0) {
+                if (packet->silent) {
+                    DeliverSilence(packet->size, packet->timing);
+                } else {
+                    m_dataCallback(packet->data.data(), packet->size, packet->timing);
+                }
+            }
+            m_packetRing->Pop();
         }
 
-        UINT32 packetLength = 0;
-        HRESULT hr = m_captureClient->GetNextPacketSize(&packetLength);
-        if (FAILED(hr)) {
+        if (!delivering) {
             break;
         }
 
-        while (packetLength > 0 && m_isCapturing) {
-            BYTE* data = nullptr;
-            UINT32 numFramesAvailable = 0;
-            DWORD flags = 0;
+        if (m_deliveryEvent) {
+            WaitForSingleObject(m_deliveryEvent, kDeliveryWaitTimeoutMs);
+        } else {
+            Sleep(kPollIntervalMs);
+        }
+    }
+}
 
-            hr = m_captureClient->GetBuffer(&data, &numFramesAvailable, &flags, nullptr, nullptr);
-            if (FAILED(hr)) {
-                break;
-            }
+void AudioCapture::ProcessPacket(const CapturePacket& packet) {
+    if (!m_dataCallback) {
+        return;
+    }
 
-            // Calculate buffer size
-            UINT32 bufferSize = numFramesAvailable * m_waveFormat->nBlockAlign;
+    // Even if silent, send zeros to keep stream continuous. A silent packet is
+    // just a flag and a length - the delivery thread supplies the zeros.
+    // Packets larger than a slot span several slots; if the delivery thread
+    // is behind, the rest is dropped and the ring counts the overrun.
+    const UINT32 blockAlign = m_waveFormat->nBlockAlign;
+    const bool published = PublishCapturedPacket(*m_packetRing, packet, blockAlign, m_waveFormat->nSamplesPerSec,
+        [this, blockAlign](BYTE* chunk, UINT32 chunkSize) {
+            // Apply volume adjustment
+            ApplyVolumeToBuffer(chunk, chunkSize);
 
-            // Send data to callback - even if silent, send zeros to keep stream continuous
-            if (m_dataCallback && bufferSize > 0) {
-                if (flags & AUDCLNT_BUFFERFLAGS_SILENT) {
-                    // For silent buffers, send zeros
-                    std::vector<BYTE> silence(bufferSize, 0);
-                    m_dataCallback(silence.data(), bufferSize);
-                }
-                else if (data) {
-                    // Apply volume adjustment
-                    std::vector<BYTE> buffer(data, data + bufferSize);
-                    ApplyVolumeToBuffer(buffer.data(), bufferSize);
-                    m_dataCallback(buffer.data(), bufferSize);
-
-                    // If passthrough is enabled, also send to render device
-                    if (m_passthroughEnabled && m_audioRenderClient && m_renderClient) {
-                        // Get padding (how much is already in the buffer)
-                        UINT32 numFramesPadding = 0;
-                        if (SUCCEEDED(m_renderClient->GetCurrentPadding(&numFramesPadding))) {
-                            // Calculate how many frames we can write
-                            UINT32 renderFramesAvailable = m_renderBufferFrameCount - numFramesPadding;
-
-                            // Calculate how many frames we have from capture
-                            UINT32 captureFrames = numFramesAvailable;
-
-                            // Only write as many frames as we have available, and don't exceed buffer space
-                            UINT32 framesToWrite = std::min(renderFramesAvailable, captureFrames);
-
-                            if (framesToWrite > 0) {
-                                BYTE* renderBuffer = nullptr;
-                                if (SUCCEEDED(m_audioRenderClient->GetBuffer(framesToWrite, &renderBuffer))) {
-                                    // Copy audio data to render buffer
-                                    UINT32 bytesToCopy = framesToWrite * m_waveFormat->nBlockAlign;
-                                    memcpy(renderBuffer, buffer.data(), bytesToCopy);
-
-                                    m_audioRenderClient->ReleaseBuffer(framesToWrite, 0);
-                                }
-                            }
-                        }
-                    }
-                }
-            }
+            // If passthrough is enabled, also send to render device
+            WritePassthrough(chunk, chunkSize / blockAlign);
+        });
 
-            hr = m_captureClient->ReleaseBuffer(numFramesAvailable);
-            if (FAILED(hr)) {
-                break;
-            }
+    if (published && m_deliveryEvent) {
+        SetEvent(m_deliveryEvent);
+    }
+}
 
-            // Check if we should stop before getting next packet
-            if (!m_isCapturing) {
-                break;
-            }
+void AudioCapture::WritePassthrough(const BYTE* data, UINT32 frames) {
+    if (!m_passthroughEnabled || !m_audioRenderClient || !m_renderClient) {
+        return;
+    }
 
-            hr = m_captureClient->GetNextPacketSize(&packetLength);
-            if (FAILED(hr)) {
-                break;
-            }
-        }
+    // Get padding (how much is already in the buffer)
+    UINT32 numFramesPadding = 0;
+    if (FAILED(m_renderClient->GetCurrentPadding(&numFramesPadding))) {
+        return;
     }
 
-    if (hTask) {
-        AvRevertMmThreadCharacteristics(hTask);
+    // Calculate how many frames we can write
+    UINT32 renderFramesAvailable = m_renderBufferFrameCount - numFramesPadding;
+
+    // Only write as many frames as we have available, and don't exceed buffer space
+    UINT32 framesToWrite = std::min(renderFramesAvailable, frames);
+
+    if (framesToWrite > 0) {
+        BYTE* renderBuffer = nullptr;
+        if (SUCCEEDED(m_audioRenderClient->GetBuffer(framesToWrite, &renderBuffer))) {
+            // Copy audio data to render buffer
+            UINT32 bytesToCopy = framesToWrite * m_waveFormat->nBlockAlign;
+            memcpy(renderBuffer, data, bytesToCopy);
+
+            m_audioRenderClient->ReleaseBuffer(framesToWrite, 0);
+        }
     }
 }
 
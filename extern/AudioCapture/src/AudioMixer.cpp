@@ -1,62 +1,239 @@
 #include "AudioMixer.h"
+#include "MixKernels.h"
 #include <algorithm>
+#include <cmath>
 #include <cstring>
-
-AudioMixer::AudioMixer() : m_initialized(false) {
-    memset(&m_format, 0, sizeof(m_format));
+#include <ks.h>
+#include <ksmedia.h>
+
+AudioMixer::AudioMixer()
+    : m_routing(MixRouting::Sum)
+    , m_initialized(false)
+    , m_driftCompensation(true)
+    , m_removedDroppedFrames(0)
+    , m_hasReference(false)
+    , m_referenceSource(0)
+    , m_outputFrames(0)
+    , m_hasTimeline(false)
+    , m_timelineOriginTicks(0)
+    , m_timelineOriginFrame(0.0) {
 }
 
 AudioMixer::~AudioMixer() {
     Clear();
 }
 
-bool AudioMixer::Initialize(const WAVEFORMATEX* format) {
+bool AudioMixer::DescribeFormat(const WAVEFORMATEX* format, SampleFormat& out) {
+    out = SampleFormat();
     if (!format) {
         return false;
     }
 
+    WORD formatTag = format->wFormatTag;
+    UINT32 channelMask = 0;
+
+    // Check if this is WAVEFORMATEXTENSIBLE
+    if (formatTag == WAVE_FORMAT_EXTENSIBLE && format->cbSize >= 22) {
+        const WAVEFORMATEXTENSIBLE* wfex = reinterpret_cast<const WAVEFORMATEXTENSIBLE*>(format);
+        channelMask = wfex->dwChannelMask;
+        if (wfex->SubFormat == KSDATAFORMAT_SUBTYPE_IEEE_FLOAT) {
+            formatTag = WAVE_FORMAT_IEEE_FLOAT;
+        } else if (wfex->SubFormat == KSDATAFORMAT_SUBTYPE_PCM) {
+            formatTag = WAVE_FORMAT_PCM;
+        } else {
+            return false;
+        }
+    }
+
+    if (formatTag == WAVE_FORMAT_IEEE_FLOAT && format->wBitsPerSample == 32) {
+        out.type = SampleType::Float32;
+    } else if (formatTag == WAVE_FORMAT_PCM) {
+        // 24-in-32 containers are left-aligned, so they read correctly as Int32
+        switch (format->wBitsPerSample) {
+        case 16: out.type = SampleType::Int16; break;
+        case 24: out.type = SampleType::Int24; break;
+        case 32: out.type = SampleType::Int32; break;
+        default: return false;
+        }
+    } else {
+        return false;
+    }
+
+    out.sampleRate = format->nSamplesPerSec;
+    out.channels = format->nChannels;
+    out.channelMask = channelMask;
+    out.blockAlign = format->nBlockAlign;
+
+    return out.IsValid() && out.blockAlign >= out.channels * SampleTypeBytes(out.type);
+}
+
+bool AudioMixer::Initialize(const WAVEFORMATEX* format, MixRouting routing) {
+    SampleFormat output;
+    if (!DescribeFormat(format, output) ||
+        output.blockAlign != output.channels * SampleTypeBytes(output.type) ||
+        (routing == MixRouting::SplitStereo && output.channels != 2)) {
+        return false;
+    }
+
     std::lock_guard<std::mutex> lock(m_mutex);
-    memcpy(&m_format, format, sizeof(WAVEFORMATEX));
+
+    // Keep the whole structure - the SubFormat and channel mask matter to encoders
+    size_t formatSize = sizeof(WAVEFORMATEX);
+    if (format->wFormatTag == WAVE_FORMAT_EXTENSIBLE) {
+        formatSize += format->cbSize;
+    }
+    const BYTE* formatBytes = reinterpret_cast<const BYTE*>(format);
+    m_formatStorage.assign(formatBytes, formatBytes + formatSize);
+    m_output = output;
+    m_routing = routing;
+    InitializeLimiters();
     m_initialized = true;
+
+    // Design the resampling filters now rather than on the first packet
+    Resampler::PrewarmFilterBanks(m_output.sampleRate, kResamplerQuality);
     return true;
 }
 
-void AudioMixer::AddAudioData(DWORD sourceId, const BYTE* data, UINT32 size, const WAVEFORMATEX* sourceFormat) {
+void AudioMixer::AddAudioData(DWORD sourceId, const BYTE* data, UINT32 size, const WAVEFORMATEX* sourceFormat,
+                              UINT64 timestamp, bool discontinuity) {
     if (!m_initialized || !data || size == 0 || !sourceFormat) {
         return;
     }
 
+    // Unreadable formats are dropped rather than mixed in as noise
+    SampleFormat format;
+    if (!DescribeFormat(sourceFormat, format)) {
+        return;
+    }
+
+    std::shared_ptr<SourceConverter> converter;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::shared_ptr<SourceConverter>& slot = m_converters[sourceId];
+        if (!slot) {
+            slot = std::make_shared<SourceConverter>();
+            if (m_routing == MixRouting::SplitStereo) {
+                auto channel = m_sourceChannels.find(sourceId);
+                slot->outputChannel = channel != m_sourceChannels.end() ? static_cast<int>(channel->second) : 1;
+            }
+        }
+        converter = slot;
+    }
+
+    // Convert outside the lock, on this source's own state
+    size_t frames = 0;
+    const float* samples = ConvertSource(*converter, data, size, format, frames);
+    if (!samples || frames == 0) {
+        return;
+    }
+
     std::lock_guard<std::mutex> lock(m_mutex);
 
     // Get or create buffer for this source
     AudioBuffer& buffer = m_buffers[sourceId];
+    if (!buffer.ring.IsAllocated()) {
+        // Room for the full backlog plus a second of headroom for the incoming packet
+        buffer.ring.Reset(m_output.channels * sizeof(float),
+                          static_cast<size_t>(m_output.sampleRate) * (kMaxBufferedSeconds + 1));
+        m_mixSources.reserve(m_buffers.size());
+    }
+
+    // Limit buffered audio to prevent unbounded latency when another source stalls:
+    // past kMaxBufferedSeconds, drop the oldest frames down to kKeepBufferedSeconds
+    const size_t maxFrames = static_cast<size_t>(m_output.sampleRate) * kMaxBufferedSeconds;
+    const size_t keepFrames = static_cast<size_t>(m_output.sampleRate) * kKeepBufferedSeconds;
+    if (buffer.ring.Available() > maxFrames) {
+        buffer.ring.DropOldest(buffer.ring.Available() - keepFrames);
+    }
 
-    // Limit buffer size to prevent memory leak when one source stalls
-    // Max 5 seconds of buffered audio per source
-    const UINT32 maxBufferBytes = m_format.nAvgBytesPerSec * 5;
-    UINT32 currentAvailable = static_cast<UINT32>(buffer.data.size()) - buffer.readPosition;
-    if (currentAvailable > maxBufferBytes) {
-        if (buffer.readPosition > 0) {
-            buffer.data.erase(buffer.data.begin(), buffer.data.begin() + buffer.readPosition);
-            buffer.readPosition = 0;
+    if (timestamp != 0) {
+        const double packetSeconds = static_cast<double>(size / format.blockAlign) / format.sampleRate;
+        const size_t skip = (std::min)(frames, PlaceTimedPacket(sourceId, buffer, timestamp, discontinuity,
+                                                                converter->leadFrames, packetSeconds));
+        samples += skip * m_output.channels;
+        frames -= skip;
+    } else {
+        if (buffer.timed) {
+            buffer.timed = false;
+            buffer.drift.SetTuning(DriftController::kFillLevelTuning);
         }
-        UINT32 keepBytes = m_format.nAvgBytesPerSec * 2;
-        if (buffer.data.size() > keepBytes) {
-            buffer.data.erase(buffer.data.begin(), buffer.data.end() - keepBytes);
+        if (discontinuity) {
+            // Lost frames: line it up with the reference again at the next mix
+            buffer.aligned = false;
         }
     }
 
-    // Check if resampling is needed
-    if (sourceFormat->nSamplesPerSec != m_format.nSamplesPerSec ||
-        sourceFormat->nChannels != m_format.nChannels ||
-        sourceFormat->wBitsPerSample != m_format.wBitsPerSample) {
-        // Resample the audio to match target format
-        std::vector<BYTE> resampledData = ResampleAudio(data, size, sourceFormat);
-        buffer.data.insert(buffer.data.end(), resampledData.begin(), resampledData.end());
-    } else {
-        // No resampling needed, append directly
-        buffer.data.insert(buffer.data.end(), data, data + size);
+    buffer.ring.Write(reinterpret_cast<const uint8_t*>(samples), frames);
+}
+
+size_t AudioMixer::PlaceTimedPacket(DWORD sourceId, AudioBuffer& buffer, UINT64 timestamp, bool discontinuity,
+                                    double leadFrames, double packetSeconds) {
+    const double rate = static_cast<double>(m_output.sampleRate);
+    if (!buffer.timed) {
+        buffer.timed = true;
+        buffer.drift.SetTuning(DriftController::kTimestampTuning);
+    }
+
+    // Where the source's own stream puts the packet's first frame
+    const double streamPosition = static_cast<double>(m_outputFrames + buffer.Fill()) + leadFrames;
+
+    // The first timestamped packet anchors the timeline
+    if (!m_hasTimeline) {
+        m_timelineOriginTicks = timestamp;
+        m_timelineOriginFrame = streamPosition;
+        m_hasTimeline = true;
+    }
+
+    // Where its timestamp puts it (packets may predate the origin)
+    const INT64 ticks = static_cast<INT64>(timestamp - m_timelineOriginTicks);
+    const double timelinePosition = m_timelineOriginFrame + static_cast<double>(ticks) * rate / 10000000.0;
+
+    // Close enough: this is clock drift, let the loop steer it
+    const double error = streamPosition - timelinePosition;
+    if (buffer.aligned && !discontinuity && std::fabs(error) <= rate * kPlacementToleranceMs / 1000.0) {
+        if (m_driftCompensation.load(std::memory_order_relaxed)) {
+            buffer.drift.Update(error / rate, packetSeconds);
+            PublishRateAdjust(sourceId, buffer);
+        }
+        return 0;
+    }
+
+    // Nothing is buffered anywhere (every source was idle): there is no time
+    // to keep, so move the timeline instead of recording the gap as silence
+    bool idle = true;
+    for (const auto& pair : m_buffers) {
+        if (pair.second.Fill() > 0) {
+            idle = false;
+            break;
+        }
+    }
+    if (idle) {
+        m_timelineOriginFrame += error;
+    }
+
+    // First packet, resume after an underrun, lost packets or a jump: move
+    // the stream to the timestamp
+    const INT64 shift = idle ? 0 : std::llround(-error);
+    size_t skip = 0;
+    if (shift > 0) {
+        // Gap: silence up to where the packet belongs (bounded like any backlog)
+        const size_t silence = (std::min)(static_cast<size_t>(shift),
+                                          static_cast<size_t>(m_output.sampleRate) * kMaxBufferedSeconds);
+        if (buffer.ring.Available() == 0) {
+            buffer.pendingSilence += silence;
+        } else {
+            buffer.ring.WriteSilence(silence);
+        }
+    } else if (shift < 0) {
+        // The start of the packet belongs to time that is already mixed (or
+        // overlaps what was written); drop that part
+        skip = static_cast<size_t>(-shift);
     }
+
+    buffer.aligned = true;
+    buffer.drift.ResetError();
+    PublishRateAdjust(sourceId, buffer);
+    return skip;
 }
 
 bool AudioMixer::GetMixedAudio(std::vector<BYTE>& outBuffer) {
@@ -66,233 +243,456 @@ bool AudioMixer::GetMixedAudio(std::vector<BYTE>& outBuffer) {
 
     std::lock_guard<std::mutex> lock(m_mutex);
 
-    if (m_buffers.empty()) {
+    const size_t frameCount = ReadyFrames();
+    if (frameCount == 0) {
         return false;
     }
 
-    // FIX: Use MAXIMUM available data, not minimum.
-    // Sources that don't have enough data get padded with silence.
-    // Old code used min — if the RDP mic stalled for a moment, NOTHING
-    // got written to disk, causing "recording chunks" / gaps.
-    UINT32 maxDataAvailable = 0;
-    for (const auto& pair : m_buffers) {
-        UINT32 available = static_cast<UINT32>(pair.second.data.size()) - pair.second.readPosition;
-        if (available > maxDataAvailable) {
-            maxDataAvailable = available;
-        }
+    MixFrames(outBuffer, frameCount);
+    return true;
+}
+
+bool AudioMixer::GetMixedAudio(std::vector<BYTE>& outBuffer, size_t frameCount) {
+    if (!m_initialized || frameCount == 0) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (ReadyFrames() < frameCount) {
+        return false;
     }
 
-    if (maxDataAvailable == 0) {
+    MixFrames(outBuffer, frameCount);
+    return true;
+}
+
+bool AudioMixer::DrainMixedAudio(std::vector<BYTE>& outBuffer) {
+    if (!m_initialized) {
         return false;
     }
 
-    // Calculate frame count
-    UINT32 bytesPerFrame = m_format.nBlockAlign;
-    UINT32 frameCount = maxDataAvailable / bytesPerFrame;
+    std::lock_guard<std::mutex> lock(m_mutex);
 
+    const size_t frameCount = BufferedFrames();
     if (frameCount == 0) {
         return false;
     }
 
-    UINT32 bytesToMix = frameCount * bytesPerFrame;
+    // Sources run out with silence, which also pushes the last frames out
+    // of the limiter's delay line
+    const PeakLimiter& limiter = m_routing == MixRouting::SplitStereo ? m_channelLimiters[0] : m_limiter;
+    MixFrames(outBuffer, frameCount + limiter.GetLatencyFrames());
+    return true;
+}
 
-    // Prepare output buffer
-    outBuffer.resize(bytesToMix);
-
-    // If only one source, copy what's available and pad rest with silence
-    if (m_buffers.size() == 1) {
-        AudioBuffer& buffer = m_buffers.begin()->second;
-        UINT32 available = static_cast<UINT32>(buffer.data.size()) - buffer.readPosition;
-        UINT32 toCopy = (std::min)(available, bytesToMix);
-        memcpy(outBuffer.data(), buffer.data.data() + buffer.readPosition, toCopy);
-        if (toCopy < bytesToMix) {
-            memset(outBuffer.data() + toCopy, 0, bytesToMix - toCopy);
-        }
-        buffer.readPosition += toCopy;
-    }
-    else {
-        // Multiple sources — mix, padding silence for sources that are behind
-        std::vector<std::vector<BYTE>> paddedStorage;
-        paddedStorage.reserve(m_buffers.size());
-        std::vector<const BYTE*> sources;
-        sources.reserve(m_buffers.size());
-
-        for (auto& pair : m_buffers) {
-            UINT32 available = static_cast<UINT32>(pair.second.data.size()) - pair.second.readPosition;
-            if (available >= bytesToMix) {
-                // Enough data — use directly
-                sources.push_back(pair.second.data.data() + pair.second.readPosition);
-                paddedStorage.emplace_back(); // placeholder
-            } else {
-                // Not enough — copy what we have, rest is silence
-                std::vector<BYTE> padded(bytesToMix, 0);
-                if (available > 0) {
-                    memcpy(padded.data(), pair.second.data.data() + pair.second.readPosition, available);
-                }
-                paddedStorage.push_back(std::move(padded));
-                sources.push_back(paddedStorage.back().data());
-            }
-        }
+size_t AudioMixer::GetReadyFrames() {
+    if (!m_initialized) {
+        return 0;
+    }
 
-        MixSamples(sources, outBuffer.data(), frameCount);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return ReadyFrames();
+}
 
-        // Update read positions — each source advances by what it actually had
-        for (auto& pair : m_buffers) {
-            UINT32 available = static_cast<UINT32>(pair.second.data.size()) - pair.second.readPosition;
-            pair.second.readPosition += (std::min)(available, bytesToMix);
-        }
+size_t AudioMixer::BufferedFrames() const {
+    // FIX: Use MAXIMUM available data, not minimum.
+    // Sources that don't have enough data get padded with silence.
+    // Old code used min — if the RDP mic stalled for a moment, NOTHING
+    // got written to disk, causing "recording chunks" / gaps.
+    size_t frameCount = 0;
+    for (const auto& pair : m_buffers) {
+        frameCount = (std::max)(frameCount, pair.second.Fill());
     }
+    return frameCount;
+}
+
+size_t AudioMixer::ReadyFrames() const {
+    size_t frameCount = BufferedFrames();
 
-    // Clean up consumed data
-    for (auto it = m_buffers.begin(); it != m_buffers.end(); ++it) {
-        AudioBuffer& buffer = it->second;
+    // With drift compensation, keep kTargetLatencyMs back in the leading
+    // source so the others, which arrive a packet or two later, are not
+    // padded with silence every time
+    if (m_driftCompensation.load(std::memory_order_relaxed)) {
+        const size_t latency = static_cast<size_t>(m_output.sampleRate) * kTargetLatencyMs / 1000;
+        frameCount = frameCount > latency ? frameCount - latency : 0;
+    }
+    return frameCount;
+}
 
-        if (buffer.readPosition >= buffer.data.size()) {
-            buffer.data.clear();
-            buffer.readPosition = 0;
+void AudioMixer::MixFrames(std::vector<BYTE>& outBuffer, size_t frameCount) {
+    if (m_driftCompensation.load(std::memory_order_relaxed)) {
+        TrackClocks(frameCount);
+    }
+    m_outputFrames += frameCount;
+
+    // Each source reads into its own float scratch block (which only grows):
+    // queued alignment silence first, then the ring, padded with silence if
+    // it is behind
+    const size_t sampleCount = frameCount * m_output.channels;
+    m_mixSources.clear();
+
+    for (auto& pair : m_buffers) {
+        AudioBuffer& buffer = pair.second;
+        if (buffer.mixScratch.size() < sampleCount) {
+            buffer.mixScratch.resize(sampleCount);
         }
-        else if (buffer.readPosition > static_cast<UINT32>(48000 * m_format.nBlockAlign)) {
-            buffer.data.erase(buffer.data.begin(), buffer.data.begin() + buffer.readPosition);
-            buffer.readPosition = 0;
+
+        const size_t silence = (std::min)(buffer.pendingSilence, frameCount);
+        std::fill(buffer.mixScratch.begin(), buffer.mixScratch.begin() + silence * m_output.channels, 0.0f);
+        buffer.pendingSilence -= silence;
+
+        size_t read = silence + buffer.ring.Read(
+            reinterpret_cast<uint8_t*>(buffer.mixScratch.data() + silence * m_output.channels),
+            frameCount - silence);
+        if (read < frameCount) {
+            std::fill(buffer.mixScratch.begin() + read * m_output.channels,
+                      buffer.mixScratch.begin() + sampleCount, 0.0f);
+            // Underrun: the source's position is lost, place it again when it resumes
+            buffer.aligned = false;
         }
+        m_mixSources.push_back(buffer.mixScratch.data());
     }
 
-    return true;
+    // Prepare output buffer
+    outBuffer.resize(frameCount * m_output.blockAlign);
+    MixSamples(m_mixSources, outBuffer.data(), frameCount);
 }
 
-void AudioMixer::MixSamples(const std::vector<const BYTE*>& sources, BYTE* dest, UINT32 frameCount) {
+void AudioMixer::MixSamples(const std::vector<const float*>& sources, BYTE* dest, size_t frameCount) {
     if (sources.empty() || !dest) {
         return;
     }
 
-    UINT32 channels = m_format.nChannels;
-    UINT32 bitsPerSample = m_format.wBitsPerSample;
+    const MixKernels& kernels = ActiveMixKernels();
+    const size_t sampleCount = frameCount * m_output.channels;
+    const size_t blockSamples = (kMixBlockSamples / m_output.channels) * m_output.channels;
+    const UINT32 sampleBytes = SampleTypeBytes(m_output.type);
+
+    // Source-major over L1-sized blocks: load the first source into the float
+    // accumulator, add the rest, run the limiter over the sum, then clamp to
+    // [-1.0, 1.0] once per block (a no-op after the limiter; it stays as the
+    // guard when the limiter is disabled)
+    alignas(32) float acc[kMixBlockSamples];
 
-    if (bitsPerSample == 16) {
-        // 16-bit PCM mixing
-        int16_t* destSamples = reinterpret_cast<int16_t*>(dest);
-        UINT32 sampleCount = frameCount * channels;
+    for (size_t offset = 0; offset < sampleCount; offset += blockSamples) {
+        const size_t count = (std::min)(sampleCount - offset, blockSamples);
 
-        for (UINT32 i = 0; i < sampleCount; i++) {
-            int32_t sum = 0;
+        kernels.loadFloat(acc, sources[0] + offset, count);
+        for (size_t s = 1; s < sources.size(); s++) {
+            kernels.addFloat(acc, sources[s] + offset, count);
+        }
 
-            for (const BYTE* source : sources) {
-                const int16_t* sourceSamples = reinterpret_cast<const int16_t*>(source);
-                sum += sourceSamples[i];
+        if (m_routing == MixRouting::SplitStereo) {
+            // Limit each party on its own: split, limit, re-interleave
+            alignas(32) float planes[2][kMixBlockSamples / 2];
+            const size_t frames = count / 2;
+            for (size_t i = 0; i < frames; i++) {
+                planes[0][i] = acc[2 * i];
+                planes[1][i] = acc[2 * i + 1];
             }
+            m_channelLimiters[0].Process(planes[0], frames);
+            m_channelLimiters[1].Process(planes[1], frames);
+            for (size_t i = 0; i < frames; i++) {
+                acc[2 * i] = planes[0][i];
+                acc[2 * i + 1] = planes[1][i];
+            }
+        } else {
+            m_limiter.Process(acc, count / m_output.channels);
+        }
 
-            // Clamp to 16-bit range
-            if (sum > 32767) sum = 32767;
-            if (sum < -32768) sum = -32768;
+        if (m_output.type == SampleType::Float32) {
+            kernels.storeFloat(reinterpret_cast<float*>(dest) + offset, acc, count);
+        } else {
+            kernels.storeFloat(acc, acc, count);
+            ConvertFromFloat(acc, count, m_output.type, dest + offset * sampleBytes);
+        }
+    }
+}
 
-            destSamples[i] = static_cast<int16_t>(sum);
+void AudioMixer::TrackClocks(size_t frameCount) {
+    const double rate = static_cast<double>(m_output.sampleRate);
+
+    // Keep the reference while it keeps up; otherwise hand over to the
+    // aligned source holding the most audio, preferring timestamped sources
+    // (they already follow QPC), or if none is aligned to the leading
+    // source. The new reference keeps running at the correction it had, so
+    // the handover doesn't move its pitch.
+    auto better = [](const AudioBuffer& a, const AudioBuffer& b) {
+        if (a.aligned != b.aligned) {
+            return a.aligned;
+        }
+        if (a.timed != b.timed) {
+            return a.timed;
+        }
+        return a.Fill() > b.Fill();
+    };
+    auto reference = m_hasReference ? m_buffers.find(m_referenceSource) : m_buffers.end();
+    if (reference == m_buffers.end() || !reference->second.aligned) {
+        auto best = m_buffers.begin();
+        for (auto it = m_buffers.begin(); it != m_buffers.end(); ++it) {
+            if (better(it->second, best->second)) {
+                best = it;
+            }
         }
+        reference = best;
+        m_referenceSource = reference->first;
+        m_hasReference = true;
+        reference->second.aligned = true;
     }
-    else if (bitsPerSample == 32) {
-        // 32-bit float mixing
-        float* destSamples = reinterpret_cast<float*>(dest);
-        UINT32 sampleCount = frameCount * channels;
 
-        for (UINT32 i = 0; i < sampleCount; i++) {
-            float sum = 0.0f;
+    const size_t referenceFill = reference->second.Fill();
+    const double resyncFrames = rate * kResyncMs / 1000.0;
 
-            for (const BYTE* source : sources) {
-                const float* sourceSamples = reinterpret_cast<const float*>(source);
-                sum += sourceSamples[i];
+    for (auto& pair : m_buffers) {
+        // Timestamped sources are placed and steered as their packets arrive
+        if (pair.first == m_referenceSource || pair.second.timed) {
+            continue;
+        }
+        AudioBuffer& buffer = pair.second;
+        const size_t fill = buffer.Fill();
+
+        // New or resuming source: line it up with the reference in one step.
+        // Nothing to place while it is still starved.
+        if (!buffer.aligned) {
+            if (fill > 0) {
+                Realign(pair.first, buffer, referenceFill);
             }
+            continue;
+        }
+
+        const double error = static_cast<double>(fill) - static_cast<double>(referenceFill);
+        if (std::fabs(error) > resyncFrames) {
+            // A jump (lost or burst packets), not drift
+            Realign(pair.first, buffer, referenceFill);
+            continue;
+        }
 
-            // Clamp to float range [-1.0, 1.0]
-            if (sum > 1.0f) sum = 1.0f;
-            if (sum < -1.0f) sum = -1.0f;
+        buffer.drift.Update(error / rate, frameCount / rate);
+        PublishRateAdjust(pair.first, buffer);
+    }
+}
+
+void AudioMixer::Realign(DWORD sourceId, AudioBuffer& buffer, size_t targetFill) {
+    const size_t fill = buffer.Fill();
+    if (fill < targetFill) {
+        buffer.pendingSilence += targetFill - fill;
+    } else if (fill > targetFill) {
+        size_t excess = fill - targetFill;
+        const size_t fromSilence = (std::min)(excess, buffer.pendingSilence);
+        buffer.pendingSilence -= fromSilence;
+        buffer.ring.DropOldest(excess - fromSilence);
+    }
+    buffer.aligned = true;
+    buffer.drift.ResetError();
+    PublishRateAdjust(sourceId, buffer);
+}
+
+void AudioMixer::PublishRateAdjust(DWORD sourceId, const AudioBuffer& buffer) {
+    auto it = m_converters.find(sourceId);
+    if (it != m_converters.end()) {
+        it->second->rateAdjust.store(1.0 + buffer.drift.GetCorrection(), std::memory_order_relaxed);
+    }
+}
+
+void AudioMixer::SetLimiter(const LimiterSettings& settings) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_limiterSettings = settings;
+    if (m_initialized) {
+        InitializeLimiters();
+    }
+}
 
-            destSamples[i] = sum;
+void AudioMixer::InitializeLimiters() {
+    if (m_routing == MixRouting::SplitStereo) {
+        for (PeakLimiter& limiter : m_channelLimiters) {
+            limiter.Initialize(m_limiterSettings, m_output.sampleRate, 1);
         }
+    } else {
+        m_limiter.Initialize(m_limiterSettings, m_output.sampleRate, m_output.channels);
+    }
+}
+
+void AudioMixer::SetSourceChannel(DWORD sourceId, UINT32 channel) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    channel = (std::min)(channel, 1u);
+    m_sourceChannels[sourceId] = channel;
+
+    // A converter built for the other channel is replaced; one still
+    // converting a packet finishes with the old routing
+    auto it = m_converters.find(sourceId);
+    if (it != m_converters.end() && it->second && it->second->outputChannel != static_cast<int>(channel)) {
+        m_converters.erase(it);
+    }
+}
+
+void AudioMixer::SetDriftCompensation(bool enabled) {
+    m_driftCompensation.store(enabled, std::memory_order_relaxed);
+}
+
+std::vector<AudioMixer::SourceClockStats> AudioMixer::GetClockStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<SourceClockStats> stats;
+    stats.reserve(m_buffers.size());
+    for (const auto& pair : m_buffers) {
+        SourceClockStats entry;
+        entry.sourceId = pair.first;
+        entry.reference = m_hasReference && pair.first == m_referenceSource;
+        entry.timestamped = pair.second.timed;
+        entry.driftPpm = pair.second.drift.GetDriftPpm();
+        entry.latencyMs = m_output.sampleRate ? pair.second.Fill() * 1000.0 / m_output.sampleRate : 0.0;
+        stats.push_back(entry);
     }
+    return stats;
 }
 
 void AudioMixer::RemoveSource(DWORD sourceId) {
     std::lock_guard<std::mutex> lock(m_mutex);
-    m_buffers.erase(sourceId);
+    auto it = m_buffers.find(sourceId);
+    if (it != m_buffers.end()) {
+        m_removedDroppedFrames += it->second.ring.DroppedFrames();
+        m_buffers.erase(it);
+    }
+    m_converters.erase(sourceId);
+    if (m_hasReference && m_referenceSource == sourceId) {
+        m_hasReference = false;
+    }
 }
 
 void AudioMixer::Clear() {
     std::lock_guard<std::mutex> lock(m_mutex);
     m_buffers.clear();
+    m_converters.clear();
+    m_removedDroppedFrames = 0;
+    m_hasReference = false;
+    m_hasTimeline = false;
+    m_outputFrames = 0;
+    m_limiter.Reset();
+    for (PeakLimiter& limiter : m_channelLimiters) {
+        limiter.Reset();
+    }
 }
 
-std::vector<BYTE> AudioMixer::ResampleAudio(const BYTE* data, UINT32 size, const WAVEFORMATEX* sourceFormat) {
-    // Calculate number of frames in source data
-    UINT32 sourceBytesPerFrame = sourceFormat->nBlockAlign;
-    UINT32 sourceFrameCount = size / sourceBytesPerFrame;
-
-    // Calculate target frame count based on sample rate ratio
-    double ratio = (double)m_format.nSamplesPerSec / (double)sourceFormat->nSamplesPerSec;
-    UINT32 targetFrameCount = (UINT32)(sourceFrameCount * ratio);
+UINT64 AudioMixer::GetDroppedFrameCount() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    UINT64 dropped = m_removedDroppedFrames;
+    for (const auto& pair : m_buffers) {
+        dropped += pair.second.ring.DroppedFrames();
+    }
+    return dropped;
+}
 
-    // Calculate target buffer size
-    UINT32 targetBytesPerFrame = m_format.nBlockAlign;
-    UINT32 targetSize = targetFrameCount * targetBytesPerFrame;
+const float* AudioMixer::ConvertSource(SourceConverter& converter, const BYTE* data, UINT32 size,
+                                       const SampleFormat& format, size_t& frameCount) {
+    frameCount = 0;
+
+    const UINT32 sourceChannels = format.channels;
+    // A source routed to one channel is converted as mono and only placed on
+    // its channel at the end
+    const bool routed = converter.outputChannel >= 0;
+    const UINT32 targetChannels = routed ? 1 : m_output.channels;
+    // Drift compensation steers every source through its resampler, even at
+    // the mixer's own rate
+    const bool needsResample = format.sampleRate != m_output.sampleRate ||
+                               m_driftCompensation.load(std::memory_order_relaxed);
+
+    // Downmix before resampling and upmix after, so the resampler always
+    // runs on the smaller channel count
+    const bool remixFirst = targetChannels < sourceChannels;
+    const UINT32 resampleChannels = (std::min)(sourceChannels, targetChannels);
+
+    // (Re)configure when the source format changes (device switch, first packet)
+    if (converter.format != format || converter.resampling != needsResample) {
+        converter.format = SampleFormat();
+        converter.matrix.Build(sourceChannels, format.channelMask, targetChannels,
+                               routed ? 0 : m_output.channelMask);
+        if (needsResample &&
+            !converter.resampler.Initialize(format.sampleRate, m_output.sampleRate,
+                                            resampleChannels, kResamplerQuality)) {
+            return nullptr;
+        }
+        converter.resampling = needsResample;
+        converter.input.resize(sourceChannels);
+        converter.remixed.resize(targetChannels);
+        converter.resampled.resize(resampleChannels);
+        converter.format = format;
+    }
 
-    std::vector<BYTE> resampledData(targetSize);
+    const size_t sourceFrames = size / format.blockAlign;
+    if (sourceFrames == 0) {
+        return nullptr;
+    }
 
-    // Only support 32-bit float for now (most common for WASAPI)
-    if (sourceFormat->wBitsPerSample == 32 && m_format.wBitsPerSample == 32) {
-        const float* sourceSamples = reinterpret_cast<const float*>(data);
-        float* targetSamples = reinterpret_cast<float*>(resampledData.data());
+    converter.leadFrames = 0.0;
 
-        UINT32 sourceChannels = sourceFormat->nChannels;
-        UINT32 targetChannels = m_format.nChannels;
+    // Already in the mixer's float layout - nothing to do
+    if (!routed && format.type == SampleType::Float32 && !needsResample && converter.matrix.IsIdentity() &&
+        format.blockAlign == sourceChannels * sizeof(float)) {
+        frameCount = sourceFrames;
+        return reinterpret_cast<const float*>(data);
+    }
 
-        // Linear interpolation resampling
-        for (UINT32 targetFrame = 0; targetFrame < targetFrameCount; targetFrame++) {
-            // Calculate source position (floating point)
-            double sourcePos = (double)targetFrame / ratio;
-            UINT32 sourceFrameLow = (UINT32)sourcePos;
-            UINT32 sourceFrameHigh = std::min(sourceFrameLow + 1, sourceFrameCount - 1);
-            float frac = (float)(sourcePos - sourceFrameLow);
+    // Sample type -> float planes. `planes` always points at the current stage.
+    std::vector<float*>& planes = converter.planes;
+    planes.resize(sourceChannels);
+    for (UINT32 ch = 0; ch < sourceChannels; ch++) {
+        converter.input[ch].resize(sourceFrames);
+        planes[ch] = converter.input[ch].data();
+    }
+    DeinterleaveToFloat(data, format.type, sourceChannels, format.blockAlign, sourceFrames, planes.data());
 
-            // Interpolate each channel
-            for (UINT32 ch = 0; ch < targetChannels; ch++) {
-                // Handle channel count mismatch
-                UINT32 sourceCh = (ch < sourceChannels) ? ch : (sourceChannels - 1);
+    size_t frames = sourceFrames;
+    auto remix = [&]() {
+        if (converter.matrix.IsIdentity()) {
+            return;
+        }
+        std::vector<float*>& remixed = converter.remixedPlanes;
+        remixed.resize(targetChannels);
+        for (UINT32 ch = 0; ch < targetChannels; ch++) {
+            converter.remixed[ch].resize(frames);
+            remixed[ch] = converter.remixed[ch].data();
+        }
+        converter.matrix.Apply(planes.data(), remixed.data(), frames);
+        planes = remixed;
+    };
 
-                float sampleLow = sourceSamples[sourceFrameLow * sourceChannels + sourceCh];
-                float sampleHigh = sourceSamples[sourceFrameHigh * sourceChannels + sourceCh];
-                float interpolated = sampleLow + (sampleHigh - sampleLow) * frac;
+    if (remixFirst) {
+        remix();
+    }
 
-                targetSamples[targetFrame * targetChannels + ch] = interpolated;
-            }
+    // Sample rate conversion (streaming - phase carries into the next packet)
+    if (needsResample) {
+        const double rateAdjust = converter.rateAdjust.load(std::memory_order_relaxed);
+        converter.resampler.SetRateAdjust(rateAdjust);
+        // Frames still inside the filter from the previous packet come out first
+        converter.leadFrames = converter.resampler.GetBufferedInputFrames() * m_output.sampleRate /
+                               (format.sampleRate * rateAdjust);
+        for (auto& plane : converter.resampled) {
+            plane.clear();
+        }
+        frames = converter.resampler.ProcessPlanar(planes.data(), frames, converter.resampled.data());
+        planes.resize(resampleChannels);
+        for (UINT32 ch = 0; ch < resampleChannels; ch++) {
+            planes[ch] = converter.resampled[ch].data();
         }
     }
-    else if (sourceFormat->wBitsPerSample == 16 && m_format.wBitsPerSample == 16) {
-        // 16-bit PCM resampling
-        const int16_t* sourceSamples = reinterpret_cast<const int16_t*>(data);
-        int16_t* targetSamples = reinterpret_cast<int16_t*>(resampledData.data());
-
-        UINT32 sourceChannels = sourceFormat->nChannels;
-        UINT32 targetChannels = m_format.nChannels;
-
-        for (UINT32 targetFrame = 0; targetFrame < targetFrameCount; targetFrame++) {
-            double sourcePos = (double)targetFrame / ratio;
-            UINT32 sourceFrameLow = (UINT32)sourcePos;
-            UINT32 sourceFrameHigh = std::min(sourceFrameLow + 1, sourceFrameCount - 1);
-            float frac = (float)(sourcePos - sourceFrameLow);
-
-            for (UINT32 ch = 0; ch < targetChannels; ch++) {
-                UINT32 sourceCh = (ch < sourceChannels) ? ch : (sourceChannels - 1);
 
-                int16_t sampleLow = sourceSamples[sourceFrameLow * sourceChannels + sourceCh];
-                int16_t sampleHigh = sourceSamples[sourceFrameHigh * sourceChannels + sourceCh];
-                float interpolated = sampleLow + (sampleHigh - sampleLow) * frac;
-
-                targetSamples[targetFrame * targetChannels + ch] = (int16_t)interpolated;
-            }
-        }
+    if (!remixFirst) {
+        remix();
     }
-    else {
-        // Unsupported format combination - just copy without resampling (fallback)
-        resampledData.assign(data, data + size);
+
+    if (routed) {
+        // The mono plane on its channel, silence on the rest
+        converter.silence.assign(frames, 0.0f);
+        float* mono = planes[0];
+        planes.assign(m_output.channels, converter.silence.data());
+        planes[(std::min)(static_cast<UINT32>(converter.outputChannel), m_output.channels - 1)] = mono;
     }
 
-    return resampledData;
+    // Planes -> interleaved float for the ring
+    converter.output.resize(frames * m_output.channels);
+    InterleaveFromFloat(planes.data(), m_output.channels, frames, SampleType::Float32, converter.output.data());
+
+    frameCount = frames;
+    return converter.output.data();
 }
@@ -5,13 +5,273 @@
 #include <ks.h>
 #include <ksmedia.h>
 
+namespace {
+
+// `format` with two front channels and otherwise the same sample layout
+std::vector<BYTE> MakeStereoFormat(const WAVEFORMATEX* format) {
+    size_t formatSize = sizeof(WAVEFORMATEX);
+    if (format->wFormatTag == WAVE_FORMAT_EXTENSIBLE) {
+        formatSize += format->cbSize;
+    }
+    const BYTE* bytes = reinterpret_cast<const BYTE*>(format);
+    std::vector<BYTE> storage(bytes, bytes + formatSize);
+
+    WAVEFORMATEX* stereo = reinterpret_cast<WAVEFORMATEX*>(storage.data());
+    const WORD bytesPerSample = format->nBlockAlign / format->nChannels;
+    stereo->nChannels = 2;
+    stereo->nBlockAlign = bytesPerSample * 2;
+    stereo->nAvgBytesPerSec = stereo->nSamplesPerSec * stereo->nBlockAlign;
+    if (format->wFormatTag == WAVE_FORMAT_EXTENSIBLE && format->cbSize >= 22) {
+        reinterpret_cast<WAVEFORMATEXTENSIBLE*>(stereo)->dwChannelMask = SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT;
+    }
+    return storage;
+}
+
+// True when every sample of the packet is below the skip-silence threshold
+bool IsSilentPacket(const WAVEFORMATEX* captureFormat, const BYTE* data, UINT32 size) {
+    if (!captureFormat || size == 0) {
+        return false;
+    }
+
+    bool isSilent = true;
+    UINT32 bytesPerSample = captureFormat->wBitsPerSample / 8;
+    UINT32 numSamples = size / bytesPerSample;
+
+    // Define silence threshold
+    const int16_t SILENCE_THRESHOLD_16 = 50;  // ~0.15% of max amplitude
+
+    if (bytesPerSample == 2) {
+        // 16-bit samples
+        const int16_t* samples = reinterpret_cast<const int16_t*>(data);
+        for (UINT32 i = 0; i < numSamples; i++) {
+            if (abs(samples[i]) > SILENCE_THRESHOLD_16) {
+                isSilent = false;
+                break;
+            }
+        }
+    } else if (bytesPerSample == 4) {
+        // FIX: Determine if 32-bit data is float or int.
+        // WASAPI default is IEEE_FLOAT — old code treated float bits as int32,
+        // so silence detection never worked for float audio.
+        bool isFloat = false;
+        if (captureFormat->wFormatTag == WAVE_FORMAT_IEEE_FLOAT) {
+            isFloat = true;
+        } else if (captureFormat->wFormatTag == WAVE_FORMAT_EXTENSIBLE && captureFormat->cbSize >= 22) {
+            const WAVEFORMATEXTENSIBLE* wfex = reinterpret_cast<const WAVEFORMATEXTENSIBLE*>(captureFormat);
+            if (wfex->SubFormat == KSDATAFORMAT_SUBTYPE_IEEE_FLOAT) {
+                isFloat = true;
+            }
+        }
+
+        if (isFloat) {
+            const float* samples = reinterpret_cast<const float*>(data);
+            const float SILENCE_THRESHOLD_FLOAT = 0.001f;
+            for (UINT32 i = 0; i < numSamples; i++) {
+                if (fabsf(samples[i]) > SILENCE_THRESHOLD_FLOAT) {
+                    isSilent = false;
+                    break;
+                }
+            }
+        } else {
+            const int32_t* samples = reinterpret_cast<const int32_t*>(data);
+            const int32_t SILENCE_THRESHOLD_32 = 3276;
+            for (UINT32 i = 0; i < numSamples; i++) {
+                if (abs(samples[i]) > SILENCE_THRESHOLD_32) {
+                    isSilent = false;
+                    break;
+                }
+            }
+        }
+    }
+    return isSilent;
+}
+
+} // namespace
+
 CaptureManager::CaptureManager()
-    : m_mixedRecordingEnabled(false), m_mixerThreadRunning(false) {
+    : m_voiceActivityEnabled(false), m_mixedRecordingEnabled(false), m_mixBlockFrames(0),
+      m_mixerThreadRunning(false) {
+    RegisterBuiltinSinks(m_sinkRegistry);
+    m_encoderPool = std::make_unique<EncoderWorkerPool>();
 }
 
 CaptureManager::~CaptureManager() {
     DisableMixedRecording();
     StopAllCaptures();
+    StopAllPreRolls();
+}
+
+bool CaptureManager::StartPreRoll(DWORD processId, UINT32 seconds, size_t maxBytes) {
+    if (processId == 0 || seconds == 0 || maxBytes == 0) {
+        return false;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_sessions.find(processId) != m_sessions.end() ||
+            m_preRolls.find(processId) != m_preRolls.end()) {
+            return true;
+        }
+
+        // Forget failures long past their retry time (the pid may be reused)
+        for (auto it = m_preRollFailures.begin(); it != m_preRollFailures.end();) {
+            it = now - it->second.retryAt > kPreRollRetryMax ? m_preRollFailures.erase(it) : std::next(it);
+        }
+        auto failure = m_preRollFailures.find(processId);
+        if (failure != m_preRollFailures.end() && now < failure->second.retryAt) {
+            return false;
+        }
+    }
+
+    // Initialize() can take seconds, so the capture is set up without the
+    // lock; the delivery thread and StopCapture() need it meanwhile.
+    // Same checks as StartCapture(): only this process's own audio.
+    auto capture = std::make_unique<AudioCapture>();
+    const WAVEFORMATEX* format = nullptr;
+    if (capture->Initialize(processId) && capture->IsProcessSpecific()) {
+        format = capture->GetFormat();
+    }
+    if (!format || format->nAvgBytesPerSec == 0) {
+        PreRollFailed(processId, now);
+        return false;
+    }
+    const size_t capacity = (std::min)(static_cast<size_t>(format->nAvgBytesPerSec) * seconds, maxBytes);
+
+    // The same callback a recording uses, so StartCapture() can take the
+    // capture over without touching it while it runs. Until the capture is
+    // registered below its packets are dropped: they could otherwise land
+    // in a recording of the same process started meanwhile.
+    auto registered = std::make_shared<std::atomic<bool>>(false);
+    capture->SetDataCallback([this, processId, registered](const BYTE* data, UINT32 size,
+                                                           const AudioPacketTiming& timing) {
+        if (registered->load(std::memory_order_acquire)) {
+            OnAudioData(processId, data, size, timing);
+        }
+    });
+    if (!capture->Start()) {
+        PreRollFailed(processId, now);
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_preRollFailures.erase(processId);
+
+        // A recording or another pre-roll got there first: keep theirs
+        if (m_sessions.find(processId) == m_sessions.end() &&
+            m_preRolls.find(processId) == m_preRolls.end()) {
+            AttachVoiceActivity(processId, format);
+            m_preRolls[processId] = { std::move(capture), std::make_unique<PreRollBuffer>(capacity) };
+            registered->store(true, std::memory_order_release);
+            return true;
+        }
+    }
+
+    capture->Stop();
+    return true;
+}
+
+void CaptureManager::PreRollFailed(DWORD processId, std::chrono::steady_clock::time_point now) {
+    std::chrono::seconds delay;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        PreRollFailure& failure = m_preRollFailures[processId];
+        delay = failure.failures == 0 ? kPreRollRetryMin : (std::min)(failure.delay * 2, kPreRollRetryMax);
+        failure.failures++;
+        failure.delay = delay;
+        failure.retryAt = now + delay;
+    }
+    LogMessage(L"Pre-roll for PID " + std::to_wstring(processId) + L" could not start, retrying in " +
+               std::to_wstring(delay.count()) + L" s");
+}
+
+void CaptureManager::StopPreRoll(DWORD processId) {
+    PreRollCapture preRoll;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_preRolls.find(processId);
+        if (it == m_preRolls.end()) {
+            return;
+        }
+        preRoll = std::move(it->second);
+        m_preRolls.erase(it);
+        m_voiceActivity.erase(processId);
+    }
+
+    // Stop WITHOUT holding the mutex (the delivery thread may be waiting on it)
+    preRoll.capture->Stop();
+}
+
+void CaptureManager::StopAllPreRolls() {
+    std::map<DWORD, PreRollCapture> preRolls;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        preRolls.swap(m_preRolls);
+        for (const auto& pair : preRolls) {
+            m_voiceActivity.erase(pair.first);
+        }
+    }
+
+    for (auto& pair : preRolls) {
+        pair.second.capture->Stop();
+    }
+}
+
+bool CaptureManager::IsPreRolling(DWORD processId) const {
+    std::lock_guard<std::mutex> lock(const_cast<std::mutex&>(m_mutex));
+    return m_preRolls.find(processId) != m_preRolls.end();
+}
+
+void CaptureManager::EnableVoiceActivity(bool enable, const VadSettings& settings) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_voiceActivityEnabled = enable;
+    m_vadSettings = settings;
+    if (!enable) {
+        m_voiceActivity.clear();
+        return;
+    }
+
+    // Captures already running get a detector from their next packet on
+    for (auto& pair : m_preRolls) {
+        AttachVoiceActivity(pair.first, pair.second.capture->GetFormat());
+    }
+    for (auto& pair : m_sessions) {
+        if (!pair.second->inputDevice && pair.second->capture) {
+            AttachVoiceActivity(pair.first, pair.second->capture->GetFormat());
+        }
+    }
+}
+
+bool CaptureManager::TakeVoiceActivity(DWORD processId, VoiceActivityDetector::Counts& counts) {
+    std::shared_ptr<VoiceActivity> voiceActivity;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_voiceActivity.find(processId);
+        if (it == m_voiceActivity.end()) {
+            return false;
+        }
+        voiceActivity = it->second;
+    }
+
+    std::lock_guard<std::mutex> lock(voiceActivity->mutex);
+    counts = voiceActivity->detector.TakeCounts();
+    return true;
+}
+
+void CaptureManager::AttachVoiceActivity(DWORD processId, const WAVEFORMATEX* format) {
+    if (!m_voiceActivityEnabled || !format || m_voiceActivity.find(processId) != m_voiceActivity.end()) {
+        return;
+    }
+
+    SampleFormat described;
+    auto voiceActivity = std::make_shared<VoiceActivity>();
+    if (!AudioMixer::DescribeFormat(format, described) ||
+        !voiceActivity->detector.Initialize(m_vadSettings, described)) {
+        return;
+    }
+    voiceActivity->blockAlign = described.blockAlign;
+    m_voiceActivity[processId] = std::move(voiceActivity);
 }
 
 bool CaptureManager::StartCapture(DWORD processId, const std::wstring& processName,
@@ -19,6 +279,12 @@ bool CaptureManager::StartCapture(DWORD processId, const std::wstring& processNa
                                   UINT32 bitrate, bool skipSilence,
                                   const std::wstring& passthroughDeviceId,
                                   bool monitorOnly) {
+    // Passthrough is set up before a capture starts, so it can't take over a
+    // running pre-roll capture
+    if (!passthroughDeviceId.empty()) {
+        StopPreRoll(processId);
+    }
+
     std::lock_guard<std::mutex> lock(m_mutex);
 
     // Check if already capturing this process
@@ -36,77 +302,77 @@ bool CaptureManager::StartCapture(DWORD processId, const std::wstring& processNa
     session->bytesWritten = 0;
     session->skipSilence = skipSilence;
     session->monitorOnly = monitorOnly;
+    session->inputDevice = false;
+    session->encoderWarnings.label = L"capture " + std::to_wstring(processId) + L" (" + processName + L")";
+
+    // A pre-roll capture of this process is already running and delivering
+    // to OnAudioData: the session takes it over along with what it buffered
+    auto preRoll = m_preRolls.find(processId);
+    const bool adopted = preRoll != m_preRolls.end();
+    if (adopted) {
+        session->capture = std::move(preRoll->second.capture);
+        session->preRoll = std::move(preRoll->second.buffer);
+        m_preRolls.erase(preRoll);
+    } else {
+        // Create audio capture
+        session->capture = std::make_unique<AudioCapture>();
+        if (!session->capture->Initialize(processId)) {
+            return false;
+        }
 
-    // Create audio capture
-    session->capture = std::make_unique<AudioCapture>();
-    if (!session->capture->Initialize(processId)) {
-        return false;
-    }
+        // FIX: Reject system-wide fallback for process-specific captures.
+        // If process loopback failed, Initialize() silently falls back to capturing
+        // ALL system audio — which records notifications, music, everything.
+        // This causes "records when it shouldn't" behavior.
+        if (processId != 0 && !session->capture->IsProcessSpecific()) {
+            return false;
+        }
 
-    // FIX: Reject system-wide fallback for process-specific captures.
-    // If process loopback failed, Initialize() silently falls back to capturing
-    // ALL system audio — which records notifications, music, everything.
-    // This causes "records when it shouldn't" behavior.
-    if (processId != 0 && !session->capture->IsProcessSpecific()) {
-        return false;
+        // Enable passthrough if device ID is provided
+        if (!passthroughDeviceId.empty()) {
+            if (!session->capture->EnablePassthrough(passthroughDeviceId)) {
+                // Passthrough failed, but we can still continue with recording only
+                // Could add a warning here if needed
+            }
+        }
     }
 
-    // Enable passthrough if device ID is provided
-    if (!passthroughDeviceId.empty()) {
-        if (!session->capture->EnablePassthrough(passthroughDeviceId)) {
-            // Passthrough failed, but we can still continue with recording only
-            // Could add a warning here if needed
+    // Create the output sink; monitor-only sessions write nothing and get none
+    if (!monitorOnly) {
+        session->encoder = OpenEncoder(format, outputPath, session->capture->GetFormat(), bitrate);
+    }
+    if (!monitorOnly && !session->encoder) {
+        if (adopted) {
+            // Keep pre-rolling; the capture is running and can't be stopped under m_mutex
+            m_preRolls[processId] = { std::move(session->capture), std::move(session->preRoll) };
         }
+        return false;
     }
 
-    // Create appropriate encoder (skip if monitor-only mode)
-    const WAVEFORMATEX* waveFormat = session->capture->GetFormat();
-    bool encoderReady = monitorOnly; // If monitor-only, skip encoder setup
+    if (!adopted) {
+        // Set audio data callback
+        session->capture->SetDataCallback([this, processId](const BYTE* data, UINT32 size,
+                                                      const AudioPacketTiming& timing) {
+            OnAudioData(processId, data, size, timing);
+        });
 
-    if (!monitorOnly) {
-        switch (format) {
-        case AudioFormat::WAV:
-            session->wavWriter = std::make_unique<WavWriter>();
-            encoderReady = session->wavWriter->Open(outputPath, waveFormat);
-            break;
-
-        case AudioFormat::MP3:
-            session->mp3Encoder = std::make_unique<Mp3Encoder>();
-            // Use provided bitrate or default to 192000 (192 kbps)
-            encoderReady = session->mp3Encoder->Open(outputPath, waveFormat,
-                                                      bitrate > 0 ? bitrate : 192000);
-            break;
-
-        case AudioFormat::OPUS:
-            session->opusEncoder = std::make_unique<OpusOggEncoder>();
-            // Use provided bitrate or default to 128000 (128 kbps)
-            encoderReady = session->opusEncoder->Open(outputPath, waveFormat,
-                                                       bitrate > 0 ? bitrate : 128000);
-            break;
-
-        case AudioFormat::FLAC:
-            session->flacEncoder = std::make_unique<FlacEncoder>();
-            // Use bitrate as compression level (0-8), default to 5
-            encoderReady = session->flacEncoder->Open(outputPath, waveFormat,
-                                                       bitrate > 0 ? std::min(bitrate, 8u) : 5);
-            break;
-        }
-
-        if (!encoderReady) {
+        // Start capture
+        if (!session->capture->Start()) {
             return false;
         }
     }
 
-    // Set audio data callback
-    session->capture->SetDataCallback([this, processId](const BYTE* data, UINT32 size) {
-        OnAudioData(processId, data, size);
-    });
-
-    // Start capture
-    if (!session->capture->Start()) {
-        return false;
+    {
+        std::lock_guard<std::mutex> mixLock(m_mixerMutex);
+        AssignMixerChannel(processId, false);
+        if (session->preRoll) {
+            WritePreRoll(*session);
+        }
     }
 
+    // Adopted pre-rolls keep the detector they had
+    AttachVoiceActivity(processId, session->capture->GetFormat());
+
     session->isActive = true;
     m_sessions[processId] = std::move(session);
 
@@ -134,6 +400,8 @@ bool CaptureManager::StartCaptureFromDevice(DWORD sessionId, const std::wstring&
     session->bytesWritten = 0;
     session->skipSilence = skipSilence;
     session->monitorOnly = monitorOnly;
+    session->inputDevice = isInputDevice;
+    session->encoderWarnings.label = L"capture " + std::to_wstring(sessionId) + L" (" + deviceName + L")";
 
     // Create audio capture for device
     session->capture = std::make_unique<AudioCapture>();
@@ -141,44 +409,18 @@ bool CaptureManager::StartCaptureFromDevice(DWORD sessionId, const std::wstring&
         return false;
     }
 
-    // Create appropriate encoder (skip if monitor-only mode)
-    const WAVEFORMATEX* waveFormat = session->capture->GetFormat();
-    bool encoderReady = monitorOnly; // If monitor-only, skip encoder setup
-
+    // Create the output sink; monitor-only sessions write nothing and get none
     if (!monitorOnly) {
-        switch (format) {
-        case AudioFormat::WAV:
-            session->wavWriter = std::make_unique<WavWriter>();
-            encoderReady = session->wavWriter->Open(outputPath, waveFormat);
-            break;
-
-        case AudioFormat::MP3:
-            session->mp3Encoder = std::make_unique<Mp3Encoder>();
-            encoderReady = session->mp3Encoder->Open(outputPath, waveFormat,
-                                                      bitrate > 0 ? bitrate : 192000);
-            break;
-
-        case AudioFormat::OPUS:
-            session->opusEncoder = std::make_unique<OpusOggEncoder>();
-            encoderReady = session->opusEncoder->Open(outputPath, waveFormat,
-                                                       bitrate > 0 ? bitrate : 128000);
-            break;
-
-        case AudioFormat::FLAC:
-            session->flacEncoder = std::make_unique<FlacEncoder>();
-            encoderReady = session->flacEncoder->Open(outputPath, waveFormat,
-                                                       bitrate > 0 ? std::min(bitrate, 8u) : 5);
-            break;
-        }
-
-        if (!encoderReady) {
-            return false;
-        }
+        session->encoder = OpenEncoder(format, outputPath, session->capture->GetFormat(), bitrate);
+    }
+    if (!monitorOnly && !session->encoder) {
+        return false;
     }
 
     // Set audio data callback
-    session->capture->SetDataCallback([this, sessionId](const BYTE* data, UINT32 size) {
-        OnAudioData(sessionId, data, size);
+    session->capture->SetDataCallback([this, sessionId](const BYTE* data, UINT32 size,
+                                                  const AudioPacketTiming& timing) {
+        OnAudioData(sessionId, data, size, timing);
     });
 
     // Start capture
@@ -186,6 +428,11 @@ bool CaptureManager::StartCaptureFromDevice(DWORD sessionId, const std::wstring&
         return false;
     }
 
+    {
+        std::lock_guard<std::mutex> mixLock(m_mixerMutex);
+        AssignMixerChannel(sessionId, isInputDevice);
+    }
+
     session->isActive = true;
     m_sessions[sessionId] = std::move(session);
 
@@ -204,11 +451,17 @@ bool CaptureManager::StopCapture(DWORD processId) {
         // Move the session out of the map
         session = std::move(it->second);
         m_sessions.erase(it);
+        m_voiceActivity.erase(processId);
     }
 
     // Stop capture WITHOUT holding the mutex (avoids deadlock with OnAudioData)
     if (session->capture) {
         session->capture->Stop();
+        const UINT64 overruns = session->capture->GetOverrunCount();
+        if (overruns > 0) {
+            LogMessage(L"Capture " + std::to_wstring(processId) + L" (" + session->processName + L"): " +
+                       std::to_wstring(overruns) + L" packets lost, delivery fell behind capture", true);
+        }
     }
 
     // FIX: Remove this source from the mixer so its empty buffer
@@ -220,18 +473,10 @@ bool CaptureManager::StopCapture(DWORD processId) {
         }
     }
 
-    // Close encoders
-    if (session->wavWriter) {
-        session->wavWriter->Close();
-    }
-    if (session->mp3Encoder) {
-        session->mp3Encoder->Close();
-    }
-    if (session->opusEncoder) {
-        session->opusEncoder->Close();
-    }
-    if (session->flacEncoder) {
-        session->flacEncoder->Close();
+    // Write out what is still queued and finish the output file
+    if (session->encoder) {
+        m_encoderPool->CloseStream(*session->encoder);
+        ReportEncoderTotals(*session->encoder, session->encoderWarnings);
     }
 
     // Session will be automatically destroyed when it goes out of scope
@@ -290,7 +535,8 @@ bool CaptureManager::IsCapturing(DWORD processId) const {
     return m_sessions.find(processId) != m_sessions.end();
 }
 
-void CaptureManager::OnAudioData(DWORD processId, const BYTE* data, UINT32 size) {
+void CaptureManager::OnAudioData(DWORD processId, const BYTE* data, UINT32 size,
+                                 const AudioPacketTiming& timing) {
     // FIX: Minimize lock hold time. Old code held m_mutex for the entire
     // duration of encoding + mixer add. Two capture threads (process + mic)
     // competing for this lock every 10ms caused one to stall and lose packets.
@@ -298,128 +544,71 @@ void CaptureManager::OnAudioData(DWORD processId, const BYTE* data, UINT32 size)
 
     bool monitorOnly = false;
     bool skipSilenceFlag = false;
-    AudioFormat sessionFormat = AudioFormat::WAV;
-    WavWriter* wavWriter = nullptr;
-    Mp3Encoder* mp3Encoder = nullptr;
-    OpusOggEncoder* opusEncoder = nullptr;
-    FlacEncoder* flacEncoder = nullptr;
+    EncoderWorkerPool::Stream* encoder = nullptr;
+    EncoderQueueWarnings* encoderWarnings = nullptr;
     const WAVEFORMATEX* captureFormat = nullptr;
     bool mixedEnabled = false;
     UINT64* bytesWrittenPtr = nullptr;
+    bool captured = false;
+    std::shared_ptr<VoiceActivity> voiceActivity;
 
     {
         std::lock_guard<std::mutex> lock(m_mutex);
 
-        auto it = m_sessions.find(processId);
-        if (it == m_sessions.end()) {
-            return;
+        auto vad = m_voiceActivity.find(processId);
+        if (vad != m_voiceActivity.end()) {
+            voiceActivity = vad->second;
         }
 
-        CaptureSession* session = it->second.get();
-        monitorOnly = session->monitorOnly;
-        skipSilenceFlag = session->skipSilence;
-        sessionFormat = session->format;
-        wavWriter = session->wavWriter.get();
-        mp3Encoder = session->mp3Encoder.get();
-        opusEncoder = session->opusEncoder.get();
-        flacEncoder = session->flacEncoder.get();
-        captureFormat = session->capture->GetFormat();
-        bytesWrittenPtr = &session->bytesWritten;
-        mixedEnabled = m_mixedRecordingEnabled;
-    }
-    // --- mutex released ---
-
-    // Check for silence if skip silence is enabled
-    if (skipSilenceFlag && size > 0) {
-        if (captureFormat) {
-            bool isSilent = true;
-            UINT32 bytesPerSample = captureFormat->wBitsPerSample / 8;
-            UINT32 numSamples = size / bytesPerSample;
-
-            // Define silence threshold
-            const int16_t SILENCE_THRESHOLD_16 = 50;  // ~0.15% of max amplitude
-
-            if (bytesPerSample == 2) {
-                // 16-bit samples
-                const int16_t* samples = reinterpret_cast<const int16_t*>(data);
-                for (UINT32 i = 0; i < numSamples; i++) {
-                    if (abs(samples[i]) > SILENCE_THRESHOLD_16) {
-                        isSilent = false;
-                        break;
-                    }
-                }
-            } else if (bytesPerSample == 4) {
-                // FIX: Determine if 32-bit data is float or int.
-                // WASAPI default is IEEE_FLOAT — old code treated float bits as int32,
-                // so silence detection never worked for float audio.
-                bool isFloat = false;
-                if (captureFormat->wFormatTag == WAVE_FORMAT_IEEE_FLOAT) {
-                    isFloat = true;
-                } else if (captureFormat->wFormatTag == WAVE_FORMAT_EXTENSIBLE && captureFormat->cbSize >= 22) {
-                    const WAVEFORMATEXTENSIBLE* wfex = reinterpret_cast<const WAVEFORMATEXTENSIBLE*>(captureFormat);
-                    if (wfex->SubFormat == KSDATAFORMAT_SUBTYPE_IEEE_FLOAT) {
-                        isFloat = true;
-                    }
-                }
-
-                if (isFloat) {
-                    const float* samples = reinterpret_cast<const float*>(data);
-                    const float SILENCE_THRESHOLD_FLOAT = 0.001f;
-                    for (UINT32 i = 0; i < numSamples; i++) {
-                        if (fabsf(samples[i]) > SILENCE_THRESHOLD_FLOAT) {
-                            isSilent = false;
-                            break;
-                        }
-                    }
-                } else {
-                    const int32_t* samples = reinterpret_cast<const int32_t*>(data);
-                    const int32_t SILENCE_THRESHOLD_32 = 3276;
-                    for (UINT32 i = 0; i < numSamples; i++) {
-                        if (abs(samples[i]) > SILENCE_THRESHOLD_32) {
-                            isSilent = false;
-                            break;
-                        }
-                    }
-                }
+        auto it = m_sessions.find(processId);
+        if (it == m_sessions.end()) {
+            // Not recorded yet: keep it in case a recording starts
+            auto preRoll = m_preRolls.find(processId);
+            if (preRoll != m_preRolls.end()) {
+                preRoll->second.buffer->Push(data, size, timing.timestamp, timing.discontinuity);
             }
-
-            // Skip writing if silent
-            if (isSilent) {
-                return;
+        } else {
+            CaptureSession* session = it->second.get();
+            if (session->preRoll) {
+                // The mixed recording that takes the pre-roll hasn't started:
+                // keep it running up to that point
+                session->preRoll->Push(data, size, timing.timestamp, timing.discontinuity);
             }
+            monitorOnly = session->monitorOnly;
+            skipSilenceFlag = session->skipSilence;
+            encoder = session->encoder.get();
+            encoderWarnings = &session->encoderWarnings;
+            captureFormat = session->capture->GetFormat();
+            bytesWrittenPtr = &session->bytesWritten;
+            mixedEnabled = m_mixedRecordingEnabled;
+            captured = true;
         }
     }
+    // --- mutex released ---
 
-    // Write data to appropriate encoder (skip if monitor-only mode)
-    if (!monitorOnly) {
-        bool success = false;
-        switch (sessionFormat) {
-        case AudioFormat::WAV:
-            if (wavWriter) {
-                success = wavWriter->WriteData(data, size);
-            }
-            break;
+    // Speech detection sees every packet, silent or not
+    if (voiceActivity && voiceActivity->blockAlign) {
+        std::lock_guard<std::mutex> vadLock(voiceActivity->mutex);
+        voiceActivity->detector.Process(data, size / voiceActivity->blockAlign);
+    }
 
-        case AudioFormat::MP3:
-            if (mp3Encoder) {
-                success = mp3Encoder->WriteData(data, size);
-            }
-            break;
+    if (!captured) {
+        return;   // Pre-rolling only
+    }
 
-        case AudioFormat::OPUS:
-            if (opusEncoder) {
-                success = opusEncoder->WriteData(data, size);
-            }
-            break;
+    // Check for silence if skip silence is enabled
+    if (skipSilenceFlag && IsSilentPacket(captureFormat, data, size)) {
+        return;
+    }
 
-        case AudioFormat::FLAC:
-            if (flacEncoder) {
-                success = flacEncoder->WriteData(data, size);
-            }
-            break;
+    // Queue for the session's sink; a worker thread does the encoding.
+    // Monitor-only sessions have no sink.
+    if (encoder && !monitorOnly) {
+        const EncoderWorkerPool::SubmitResult result = m_encoderPool->Submit(*encoder, data, size);
+        if (result != EncoderWorkerPool::SubmitResult::Queued) {
+            ReportSubmit(result, *encoder, *encoderWarnings);
         }
-
-        if (success && bytesWrittenPtr) {
+        if (result != EncoderWorkerPool::SubmitResult::Rejected && bytesWrittenPtr) {
             *bytesWrittenPtr += size;
         }
     }
@@ -431,12 +620,131 @@ void CaptureManager::OnAudioData(DWORD processId, const BYTE* data, UINT32 size)
     if (mixedEnabled) {
         std::lock_guard<std::mutex> mixLock(m_mixerMutex);
         if (m_mixedRecordingEnabled && m_mixer) {
-            m_mixer->AddAudioData(processId, data, size, captureFormat);
+            m_mixer->AddAudioData(processId, data, size, captureFormat,
+                                  timing.timestamp, timing.discontinuity);
+            // Wake the mixer thread only when it has a whole block to write
+            if (m_mixClock && m_mixer->GetReadyFrames() >= m_mixBlockFrames) {
+                m_mixClock->Notify();
+            }
+        }
+    }
+}
+
+std::shared_ptr<EncoderWorkerPool::Stream> CaptureManager::OpenEncoder(AudioFormat format,
+                                                                        const std::wstring& outputPath,
+                                                                        const WAVEFORMATEX* waveFormat,
+                                                                        UINT32 bitrate) {
+    std::unique_ptr<IEncoderSink> sink = m_sinkRegistry.Create(format);
+    if (!waveFormat || !sink || !sink->Open(outputPath, waveFormat, bitrate)) {
+        return nullptr;
+    }
+
+    const size_t bytesPerSecond = waveFormat->nAvgBytesPerSec;
+    return m_encoderPool->OpenStream(std::move(sink), bytesPerSecond * kEncoderQueueSoftSeconds,
+                                     bytesPerSecond * kEncoderQueueHardSeconds);
+}
+
+void CaptureManager::WritePreRoll(CaptureSession& session) {
+    const WAVEFORMATEX* format = session.capture->GetFormat();
+    if (!session.monitorOnly) {
+        session.preRoll->ForEach([&](const BYTE* data, size_t size, UINT64, bool) {
+            if (session.skipSilence && IsSilentPacket(format, data, static_cast<UINT32>(size))) {
+                return;
+            }
+            const EncoderWorkerPool::SubmitResult result =
+                m_encoderPool->Submit(*session.encoder, data, static_cast<UINT32>(size));
+            if (result != EncoderWorkerPool::SubmitResult::Queued) {
+                ReportSubmit(result, *session.encoder, session.encoderWarnings);
+            }
+            if (result != EncoderWorkerPool::SubmitResult::Rejected) {
+                session.bytesWritten += size;
+            }
+        });
+    }
+
+    // A mix in progress has already written the time the pre-roll covers
+    if (m_mixedRecordingEnabled) {
+        session.preRoll.reset();
+    }
+}
+
+void CaptureManager::PrimeMixer(CaptureSession& session) {
+    const WAVEFORMATEX* format = session.capture->GetFormat();
+    std::vector<BYTE> mixedBuffer;
+    session.preRoll->Drain([&](const BYTE* data, size_t size, UINT64 timestamp, bool discontinuity) {
+        if (session.skipSilence && IsSilentPacket(format, data, static_cast<UINT32>(size))) {
+            return;
+        }
+        m_mixer->AddAudioData(session.processId, data, static_cast<UINT32>(size), format,
+                              timestamp, discontinuity);
+        while (m_mixer->GetMixedAudio(mixedBuffer, m_mixBlockFrames)) {
+            const EncoderWorkerPool::SubmitResult result =
+                m_encoderPool->Submit(*m_mixedEncoder, mixedBuffer.data(), static_cast<UINT32>(mixedBuffer.size()));
+            if (result != EncoderWorkerPool::SubmitResult::Queued) {
+                ReportSubmit(result, *m_mixedEncoder, m_mixedEncoderWarnings);
+            }
         }
+    });
+    session.preRoll.reset();
+}
+
+EncoderWorkerPool::Stats CaptureManager::GetEncoderStats() {
+    return m_encoderPool->GetStats();
+}
+
+void CaptureManager::ReportSubmit(EncoderWorkerPool::SubmitResult result, EncoderWorkerPool::Stream& stream,
+                                  EncoderQueueWarnings& warnings) {
+    if (result == EncoderWorkerPool::SubmitResult::Backpressure) {
+        if (!warnings.backpressure.exchange(true)) {
+            const EncoderWorkerPool::Stats stats = m_encoderPool->GetStreamStats(stream);
+            LogMessage(L"Encoder for " + warnings.label + L" is falling behind: " +
+                       std::to_wstring(stats.bytesQueued) + L" bytes queued", true);
+        }
+    } else if (result == EncoderWorkerPool::SubmitResult::Rejected) {
+        if (!warnings.rejected.exchange(true)) {
+            const EncoderWorkerPool::Stats stats = m_encoderPool->GetStreamStats(stream);
+            LogMessage(L"Encoder for " + warnings.label + L" refused a packet, its queue is full (" +
+                       std::to_wstring(stats.bytesQueued) + L" bytes queued); audio is being lost", true);
+        }
+    }
+}
+
+void CaptureManager::ReportEncoderTotals(EncoderWorkerPool::Stream& stream, const EncoderQueueWarnings& warnings) {
+    const EncoderWorkerPool::Stats stats = m_encoderPool->GetStreamStats(stream);
+    if (stats.backpressureEvents == 0 && stats.rejectedPackets == 0 && stats.writeFailures == 0) {
+        return;
+    }
+    LogMessage(L"Encoder for " + warnings.label + L": " + std::to_wstring(stats.packetsWritten) +
+               L" packets written, " + std::to_wstring(stats.backpressureEvents) + L" over the soft limit, " +
+               std::to_wstring(stats.rejectedPackets) + L" refused (" + std::to_wstring(stats.rejectedBytes) +
+               L" bytes), " + std::to_wstring(stats.writeFailures) + L" write failures", true);
+}
+
+void CaptureManager::SetMixLimiter(const LimiterSettings& settings) {
+    std::lock_guard<std::mutex> lock(m_mixerMutex);
+    m_limiterSettings = settings;
+    if (m_mixer) {
+        m_mixer->SetLimiter(settings);
     }
 }
 
 bool CaptureManager::EnableMixedRecording(const std::wstring& outputPath, AudioFormat format, UINT32 bitrate) {
+    return StartMixedRecording(outputPath, format, bitrate, MixRouting::Sum);
+}
+
+bool CaptureManager::EnableSplitStereoRecording(const std::wstring& outputPath, AudioFormat format,
+                                                UINT32 bitrate) {
+    return StartMixedRecording(outputPath, format, bitrate, MixRouting::SplitStereo);
+}
+
+void CaptureManager::AssignMixerChannel(DWORD sourceId, bool inputDevice) {
+    if (m_mixer && m_mixer->GetRouting() == MixRouting::SplitStereo) {
+        m_mixer->SetSourceChannel(sourceId, inputDevice ? kCallerChannel : kCalleeChannel);
+    }
+}
+
+bool CaptureManager::StartMixedRecording(const std::wstring& outputPath, AudioFormat format, UINT32 bitrate,
+                                         MixRouting routing) {
     // FIX: Lock m_mutex first to safely read m_sessions, then m_mixerMutex.
     // Previous code only held m_mixerMutex — data race with OnAudioData/StopCapture.
     std::lock_guard<std::mutex> sessLock(m_mutex);
@@ -451,58 +759,71 @@ bool CaptureManager::EnableMixedRecording(const std::wstring& outputPath, AudioF
         return false;
     }
 
-    // Get format from first session (all sessions should have the same format)
-    const WAVEFORMATEX* waveFormat = m_sessions.begin()->second->capture->GetFormat();
-    if (!waveFormat) {
+    // Sessions may differ in rate, channels and sample type (a 16 kHz mono
+    // RDP mic next to 48 kHz stereo loopback). The mixer converts every source
+    // on arrival, so mix at the highest rate any session offers (more channels
+    // breaks a tie) and let the others be converted up to it.
+    const WAVEFORMATEX* mixFormat = nullptr;
+    for (const auto& pair : m_sessions) {
+        const WAVEFORMATEX* candidate = pair.second->capture->GetFormat();
+        SampleFormat described;
+        if (!AudioMixer::DescribeFormat(candidate, described) ||
+            described.blockAlign != described.channels * SampleTypeBytes(described.type)) {
+            continue;
+        }
+        if (!mixFormat ||
+            candidate->nSamplesPerSec > mixFormat->nSamplesPerSec ||
+            (candidate->nSamplesPerSec == mixFormat->nSamplesPerSec &&
+             candidate->nChannels > mixFormat->nChannels)) {
+            mixFormat = candidate;
+        }
+    }
+    if (!mixFormat) {
         return false;
     }
 
+    // Split stereo always writes two channels, whatever the sessions have
+    std::vector<BYTE> stereoFormat;
+    if (routing == MixRouting::SplitStereo) {
+        stereoFormat = MakeStereoFormat(mixFormat);
+        mixFormat = reinterpret_cast<const WAVEFORMATEX*>(stereoFormat.data());
+    }
+
     // Create mixer
     m_mixer = std::make_unique<AudioMixer>();
-    if (!m_mixer->Initialize(waveFormat)) {
+    m_mixer->SetLimiter(m_limiterSettings);
+    if (!m_mixer->Initialize(mixFormat, routing)) {
         m_mixer.reset();
         return false;
     }
-
-    // Create appropriate encoder
-    m_mixedFormat = format;
-    bool encoderReady = false;
-
-    switch (format) {
-    case AudioFormat::WAV:
-        m_mixedWavWriter = std::make_unique<WavWriter>();
-        encoderReady = m_mixedWavWriter->Open(outputPath, waveFormat);
-        break;
-
-    case AudioFormat::MP3:
-        m_mixedMp3Encoder = std::make_unique<Mp3Encoder>();
-        encoderReady = m_mixedMp3Encoder->Open(outputPath, waveFormat,
-                                                bitrate > 0 ? bitrate : 192000);
-        break;
-
-    case AudioFormat::OPUS:
-        m_mixedOpusEncoder = std::make_unique<OpusOggEncoder>();
-        encoderReady = m_mixedOpusEncoder->Open(outputPath, waveFormat,
-                                                 bitrate > 0 ? bitrate : 128000);
-        break;
-
-    case AudioFormat::FLAC:
-        m_mixedFlacEncoder = std::make_unique<FlacEncoder>();
-        encoderReady = m_mixedFlacEncoder->Open(outputPath, waveFormat,
-                                                 bitrate > 0 ? std::min(bitrate, 8u) : 5);
-        break;
+    for (const auto& pair : m_sessions) {
+        AssignMixerChannel(pair.first, pair.second->inputDevice);
     }
 
-    if (!encoderReady) {
+    // The sink sees exactly what the mixer produces
+    m_mixedEncoder = OpenEncoder(format, outputPath, m_mixer->GetFormat(), bitrate);
+    if (!m_mixedEncoder) {
         m_mixer.reset();
-        m_mixedWavWriter.reset();
-        m_mixedMp3Encoder.reset();
-        m_mixedOpusEncoder.reset();
-        m_mixedFlacEncoder.reset();
         return false;
     }
+    m_mixedEncoderWarnings.label = routing == MixRouting::SplitStereo ? L"split stereo recording"
+                                                                      : L"mixed recording";
+    m_mixedEncoderWarnings.backpressure = false;
+    m_mixedEncoderWarnings.rejected = false;
+
+    m_mixBlockFrames = static_cast<size_t>(m_mixer->GetFormat()->nSamplesPerSec) * kMixBlockMs / 1000;
+
+    // Audio from before the sessions started goes in first. Sessions are
+    // primed one after another, so a later one keeps only what falls after
+    // the audio already written; in practice only the call's process has one.
+    for (const auto& pair : m_sessions) {
+        if (pair.second->preRoll) {
+            PrimeMixer(*pair.second);
+        }
+    }
 
     // Start mixer thread
+    m_mixClock = std::make_unique<BlockClock>(std::chrono::milliseconds(kMixBlockMs));
     m_mixerThreadRunning = true;
     m_mixerThread = std::make_unique<std::thread>(&CaptureManager::MixerThread, this);
 
@@ -521,37 +842,58 @@ void CaptureManager::DisableMixedRecording() {
         m_mixedRecordingEnabled = false;
     }
 
-    // Signal thread to stop (atomic, no lock needed)
+    // Signal thread to stop and wake it (m_mixClock lives until the join)
     m_mixerThreadRunning = false;
+    m_mixClock->Stop();
 
     // Wait for mixer thread to finish
     if (m_mixerThread && m_mixerThread->joinable()) {
         m_mixerThread->join();
     }
 
+    // How well the mixer thread kept to its block schedule
+    const BlockClock::Stats timing = GetMixerTimingStats();
+    wchar_t timingLine[160];
+    swprintf_s(timingLine, L"Mixed recording: %llu blocks, %llu deadline misses, %llu resyncs, "
+               L"worst lateness %.1f ms, %llu wakeups",
+               static_cast<unsigned long long>(timing.ticks), static_cast<unsigned long long>(timing.deadlineMisses),
+               static_cast<unsigned long long>(timing.resyncs),
+               std::chrono::duration<double, std::milli>(timing.maxLateness).count(),
+               static_cast<unsigned long long>(timing.wakeups));
+    LogMessage(timingLine, timing.deadlineMisses > 0);
+
     // Now clean up
     std::lock_guard<std::mutex> lock(m_mixerMutex);
 
-    // Close encoders
-    if (m_mixedWavWriter) {
-        m_mixedWavWriter->Close();
-        m_mixedWavWriter.reset();
-    }
-    if (m_mixedMp3Encoder) {
-        m_mixedMp3Encoder->Close();
-        m_mixedMp3Encoder.reset();
-    }
-    if (m_mixedOpusEncoder) {
-        m_mixedOpusEncoder->Close();
-        m_mixedOpusEncoder.reset();
+    if (m_mixer) {
+        const UINT64 dropped = m_mixer->GetDroppedFrameCount();
+        if (dropped > 0) {
+            const WAVEFORMATEX* format = m_mixer->GetFormat();
+            LogMessage(L"Mixed recording: " + std::to_wstring(dropped) + L" frames (" +
+                       std::to_wstring(format ? dropped * 1000 / format->nSamplesPerSec : 0) +
+                       L" ms) of source audio dropped to keep the sources aligned", true);
+        }
+
+        // Where each source's clock ended up relative to the reference
+        for (const AudioMixer::SourceClockStats& source : m_mixer->GetClockStats()) {
+            wchar_t line[128];
+            swprintf_s(line, L"Mixed recording: source %lu%s drift %+.1f ppm, %.1f ms buffered%s",
+                       source.sourceId, source.reference ? L" (reference)" : L"", source.driftPpm,
+                       source.latencyMs, source.timestamped ? L", timestamped" : L"");
+            LogMessage(line);
+        }
     }
-    if (m_mixedFlacEncoder) {
-        m_mixedFlacEncoder->Close();
-        m_mixedFlacEncoder.reset();
+
+    // Write out what is still queued and finish the output file
+    if (m_mixedEncoder) {
+        m_encoderPool->CloseStream(*m_mixedEncoder);
+        ReportEncoderTotals(*m_mixedEncoder, m_mixedEncoderWarnings);
+        m_mixedEncoder.reset();
     }
 
     m_mixer.reset();
     m_mixerThread.reset();
+    m_mixClock.reset();
 }
 
 bool CaptureManager::IsMixedRecordingActive() const {
@@ -559,67 +901,68 @@ bool CaptureManager::IsMixedRecordingActive() const {
     return m_mixedRecordingEnabled;
 }
 
+BlockClock::Stats CaptureManager::GetMixerTimingStats() {
+    std::lock_guard<std::mutex> lock(m_mixerMutex);
+    if (!m_mixClock) {
+        return {};
+    }
+    return m_mixClock->GetStats();
+}
+
+std::vector<AudioMixer::SourceClockStats> CaptureManager::GetMixerClockStats() {
+    std::lock_guard<std::mutex> lock(m_mixerMutex);
+    if (!m_mixer) {
+        return {};
+    }
+    return m_mixer->GetClockStats();
+}
+
 void CaptureManager::MixerThread() {
     std::vector<BYTE> mixedBuffer;
 
-    while (m_mixerThreadRunning) {
-        bool hasData = false;
-        AudioFormat currentFormat = AudioFormat::WAV;
-        WavWriter* wavWriter = nullptr;
-        Mp3Encoder* mp3Encoder = nullptr;
-        OpusOggEncoder* opusEncoder = nullptr;
-        FlacEncoder* flacEncoder = nullptr;
-
-        // Get mixed audio data and encoder pointers (with lock held)
-        {
-            std::lock_guard<std::mutex> lock(m_mixerMutex);
-
-            if (m_mixer) {
-                hasData = m_mixer->GetMixedAudio(mixedBuffer);
-                currentFormat = m_mixedFormat;
-
-                // Get raw pointers to encoders (they're managed by unique_ptrs in CaptureManager)
-                if (hasData && !mixedBuffer.empty()) {
-                    wavWriter = m_mixedWavWriter.get();
-                    mp3Encoder = m_mixedMp3Encoder.get();
-                    opusEncoder = m_mixedOpusEncoder.get();
-                    flacEncoder = m_mixedFlacEncoder.get();
+    // Sleep until a producer reports a whole block (or the next block is
+    // due), then write every block the mixer has ready. Once stopped, one
+    // last pass drains everything still buffered, the latency held back for
+    // drift compensation included.
+    bool running = true;
+    while (running) {
+        running = m_mixClock->Wait() && m_mixerThreadRunning;
+        const bool flush = !running;
+
+        for (;;) {
+            bool hasData = false;
+            EncoderWorkerPool::Stream* encoder = nullptr;
+
+            // Get mixed audio data and the encoder queue (with lock held)
+            {
+                std::lock_guard<std::mutex> lock(m_mixerMutex);
+
+                if (m_mixer) {
+                    hasData = flush ? m_mixer->DrainMixedAudio(mixedBuffer)
+                                    : m_mixer->GetMixedAudio(mixedBuffer, m_mixBlockFrames);
+                    encoder = m_mixedEncoder.get();
                 }
             }
-        }
 
-        // Write data to encoder WITHOUT lock held - encoding can be slow!
-        if (hasData && !mixedBuffer.empty() && m_mixerThreadRunning) {
-            switch (currentFormat) {
-            case AudioFormat::WAV:
-                if (wavWriter) {
-                    wavWriter->WriteData(mixedBuffer.data(), static_cast<UINT32>(mixedBuffer.size()));
-                }
-                break;
-
-            case AudioFormat::MP3:
-                if (mp3Encoder) {
-                    mp3Encoder->WriteData(mixedBuffer.data(), static_cast<UINT32>(mixedBuffer.size()));
-                }
+            if (!hasData || mixedBuffer.empty()) {
                 break;
+            }
+            if (!flush) {
+                m_mixClock->CompleteTick();
+            }
 
-            case AudioFormat::OPUS:
-                if (opusEncoder) {
-                    opusEncoder->WriteData(mixedBuffer.data(), static_cast<UINT32>(mixedBuffer.size()));
+            // Queue for the encoder pool WITHOUT lock held
+            if (encoder) {
+                const EncoderWorkerPool::SubmitResult result =
+                    m_encoderPool->Submit(*encoder, mixedBuffer.data(), static_cast<UINT32>(mixedBuffer.size()));
+                if (result != EncoderWorkerPool::SubmitResult::Queued) {
+                    ReportSubmit(result, *encoder, m_mixedEncoderWarnings);
                 }
-                break;
+            }
 
-            case AudioFormat::FLAC:
-                if (flacEncoder) {
-                    flacEncoder->WriteData(mixedBuffer.data(), static_cast<UINT32>(mixedBuffer.size()));
-                }
+            if (flush) {
                 break;
             }
         }
-
-        if (!hasData) {
-            // Sleep for a short time if no data available
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        }
     }
 }
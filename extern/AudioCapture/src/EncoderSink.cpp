@@ -0,0 +1,71 @@
+#include "EncoderSink.h"
+#include "WavWriter.h"
+#include "Mp3Encoder.h"
+#include "OpusEncoder.h"
+#include "FlacEncoder.h"
+#include <algorithm>
+
+namespace {
+
+// Defaults for quality == 0
+constexpr uint32_t kDefaultMp3Bitrate = 192000;
+constexpr uint32_t kDefaultOpusBitrate = 128000;
+constexpr uint32_t kDefaultFlacLevel = 5;
+constexpr uint32_t kMaxFlacLevel = 8;
+
+class WavSink : public IEncoderSink {
+public:
+    bool Open(const std::wstring& path, const WAVEFORMATEX* format, uint32_t) override {
+        return m_writer.Open(path, format);
+    }
+    bool Write(const uint8_t* data, uint32_t size) override { return m_writer.WriteData(data, size); }
+    void Close() override { m_writer.Close(); }
+
+private:
+    WavWriter m_writer;
+};
+
+class Mp3Sink : public IEncoderSink {
+public:
+    bool Open(const std::wstring& path, const WAVEFORMATEX* format, uint32_t quality) override {
+        return m_encoder.Open(path, format, quality > 0 ? quality : kDefaultMp3Bitrate);
+    }
+    bool Write(const uint8_t* data, uint32_t size) override { return m_encoder.WriteData(data, size); }
+    void Close() override { m_encoder.Close(); }
+
+private:
+    Mp3Encoder m_encoder;
+};
+
+class OpusSink : public IEncoderSink {
+public:
+    bool Open(const std::wstring& path, const WAVEFORMATEX* format, uint32_t quality) override {
+        return m_encoder.Open(path, format, quality > 0 ? quality : kDefaultOpusBitrate);
+    }
+    bool Write(const uint8_t* data, uint32_t size) override { return m_encoder.WriteData(data, size); }
+    void Close() override { m_encoder.Close(); }
+
+private:
+    OpusOggEncoder m_encoder;
+};
+
+class FlacSink : public IEncoderSink {
+public:
+    bool Open(const std::wstring& path, const WAVEFORMATEX* format, uint32_t quality) override {
+        return m_encoder.Open(path, format, quality > 0 ? (std::min)(quality, kMaxFlacLevel) : kDefaultFlacLevel);
+    }
+    bool Write(const uint8_t* data, uint32_t size) override { return m_encoder.WriteData(data, size); }
+    void Close() override { m_encoder.Close(); }
+
+private:
+    FlacEncoder m_encoder;
+};
+
+} // namespace
+
+void RegisterBuiltinSinks(EncoderSinkRegistry& registry) {
+    registry.Register(AudioFormat::WAV, [] { return std::make_unique<WavSink>(); });
+    registry.Register(AudioFormat::MP3, [] { return std::make_unique<Mp3Sink>(); });
+    registry.Register(AudioFormat::OPUS, [] { return std::make_unique<OpusSink>(); });
+    registry.Register(AudioFormat::FLAC, [] { return std::make_unique<FlacSink>(); });
+}
@@ -0,0 +1,285 @@
+#include "EncoderWorkerPool.h"
+#include <algorithm>
+#ifdef _WIN32
+#include <objbase.h>
+#endif
+
+namespace {
+
+void AddStats(EncoderWorkerPool::Stats& total, const EncoderWorkerPool::Stats& stats) {
+    total.packetsWritten += stats.packetsWritten;
+    total.bytesWritten += stats.bytesWritten;
+    total.writeFailures += stats.writeFailures;
+    total.backpressureEvents += stats.backpressureEvents;
+    total.rejectedPackets += stats.rejectedPackets;
+    total.rejectedBytes += stats.rejectedBytes;
+    total.bytesQueued += stats.bytesQueued;
+}
+
+} // namespace
+
+EncoderWorkerPool::EncoderWorkerPool(unsigned workerCount)
+    : m_nextWorker(0)
+    , m_readyCount(0)
+    , m_stopping(false) {
+    if (workerCount == 0) {
+        workerCount = (std::max)(1u, std::thread::hardware_concurrency());
+    }
+
+    m_workers.reserve(workerCount);
+    for (unsigned i = 0; i < workerCount; i++) {
+        m_workers.push_back(std::make_unique<Worker>());
+    }
+    for (unsigned i = 0; i < workerCount; i++) {
+        m_workers[i]->thread = std::thread(&EncoderWorkerPool::WorkerLoop, this, i);
+    }
+}
+
+EncoderWorkerPool::~EncoderWorkerPool() {
+    // Drain and close whatever the owner left open
+    std::vector<std::shared_ptr<Stream>> open;
+    {
+        std::lock_guard<std::mutex> lock(m_streamsMutex);
+        for (const auto& weak : m_streams) {
+            if (auto stream = weak.lock()) {
+                open.push_back(std::move(stream));
+            }
+        }
+    }
+    for (const auto& stream : open) {
+        CloseStream(*stream);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (auto& worker : m_workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+}
+
+std::shared_ptr<EncoderWorkerPool::Stream> EncoderWorkerPool::OpenStream(std::unique_ptr<IEncoderSink> sink,
+                                                                        size_t softLimitBytes,
+                                                                        size_t hardLimitBytes) {
+    if (!sink) {
+        return nullptr;
+    }
+
+    auto stream = std::make_shared<Stream>(std::move(sink), softLimitBytes,
+                                           (std::max)(softLimitBytes, hardLimitBytes));
+
+    std::lock_guard<std::mutex> lock(m_streamsMutex);
+    m_streams.push_back(stream);
+    return stream;
+}
+
+EncoderWorkerPool::SubmitResult EncoderWorkerPool::Submit(Stream& stream, const uint8_t* data, uint32_t size) {
+    if (!data || size == 0) {
+        return SubmitResult::Queued;
+    }
+
+    bool schedule = false;
+    SubmitResult result = SubmitResult::Queued;
+    {
+        std::lock_guard<std::mutex> lock(stream.m_mutex);
+
+        if (stream.m_closed || stream.m_queuedBytes + size > stream.m_hardLimit) {
+            stream.m_stats.rejectedPackets++;
+            stream.m_stats.rejectedBytes += size;
+            return SubmitResult::Rejected;
+        }
+
+        // Reuse a written packet's buffer when there is one
+        std::vector<uint8_t> packet;
+        if (!stream.m_spare.empty()) {
+            packet = std::move(stream.m_spare.back());
+            stream.m_spare.pop_back();
+        }
+        packet.assign(data, data + size);
+        stream.m_queue.push_back(std::move(packet));
+        stream.m_queuedBytes += size;
+
+        if (stream.m_queuedBytes > stream.m_softLimit) {
+            stream.m_stats.backpressureEvents++;
+            result = SubmitResult::Backpressure;
+        }
+
+        if (!stream.m_scheduled) {
+            stream.m_scheduled = true;
+            schedule = true;
+        }
+    }
+
+    if (schedule) {
+        Schedule(stream.shared_from_this(), m_nextWorker.fetch_add(1, std::memory_order_relaxed));
+    }
+    return result;
+}
+
+void EncoderWorkerPool::CloseStream(Stream& stream) {
+    std::unique_lock<std::mutex> lock(stream.m_mutex);
+    if (stream.m_closed && !stream.m_sink) {
+        return;
+    }
+    stream.m_closed = true;
+    stream.m_drained.wait(lock, [&stream] { return !stream.m_scheduled; });
+
+    std::unique_ptr<IEncoderSink> sink = std::move(stream.m_sink);
+    const Stats stats = stream.m_stats;
+    lock.unlock();
+
+    if (sink) {
+        sink->Close();
+    }
+
+    // Fold the stream into the totals and forget it
+    std::lock_guard<std::mutex> streamsLock(m_streamsMutex);
+    AddStats(m_closedTotals, stats);
+    m_streams.erase(std::remove_if(m_streams.begin(), m_streams.end(),
+                                   [&stream](const std::weak_ptr<Stream>& weak) {
+                                       auto locked = weak.lock();
+                                       return !locked || locked.get() == &stream;
+                                   }),
+                    m_streams.end());
+}
+
+EncoderWorkerPool::Stats EncoderWorkerPool::GetStreamStats(Stream& stream) {
+    std::lock_guard<std::mutex> lock(stream.m_mutex);
+    Stats stats = stream.m_stats;
+    stats.bytesQueued = stream.m_queuedBytes;
+    return stats;
+}
+
+EncoderWorkerPool::Stats EncoderWorkerPool::GetStats() {
+    std::vector<std::shared_ptr<Stream>> open;
+    Stats total;
+    {
+        std::lock_guard<std::mutex> lock(m_streamsMutex);
+        total = m_closedTotals;
+        for (const auto& weak : m_streams) {
+            if (auto stream = weak.lock()) {
+                open.push_back(std::move(stream));
+            }
+        }
+    }
+    for (const auto& stream : open) {
+        AddStats(total, GetStreamStats(*stream));
+    }
+    return total;
+}
+
+void EncoderWorkerPool::Schedule(std::shared_ptr<Stream> stream, size_t hint) {
+    Worker& worker = *m_workers[hint % m_workers.size()];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.ready.push_back(std::move(stream));
+    }
+    {
+        // Under m_wakeMutex so a worker that just found nothing can't miss it
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_readyCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_wake.notify_one();
+}
+
+std::shared_ptr<EncoderWorkerPool::Stream> EncoderWorkerPool::Take(size_t index) {
+    const size_t count = m_workers.size();
+    for (size_t i = 0; i < count; i++) {
+        Worker& worker = *m_workers[(index + i) % count];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.ready.empty()) {
+            continue;
+        }
+        std::shared_ptr<Stream> stream;
+        if (i == 0) {
+            stream = std::move(worker.ready.front());
+            worker.ready.pop_front();
+        } else {
+            stream = std::move(worker.ready.back());
+            worker.ready.pop_back();
+        }
+        m_readyCount.fetch_sub(1, std::memory_order_relaxed);
+        return stream;
+    }
+    return nullptr;
+}
+
+void EncoderWorkerPool::WorkerLoop(size_t index) {
+#ifdef _WIN32
+    // Media Foundation sink writers are driven from here: join the MTA
+    const HRESULT comResult = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+#endif
+
+    for (;;) {
+        std::shared_ptr<Stream> stream = Take(index);
+        if (!stream) {
+            std::unique_lock<std::mutex> lock(m_wakeMutex);
+            m_wake.wait(lock, [this] {
+                return m_stopping || m_readyCount.load(std::memory_order_relaxed) > 0;
+            });
+            if (m_stopping && m_readyCount.load(std::memory_order_relaxed) == 0) {
+                break;
+            }
+            continue;
+        }
+
+        if (RunBatch(*stream)) {
+            Schedule(std::move(stream), index);
+        }
+    }
+
+#ifdef _WIN32
+    if (SUCCEEDED(comResult)) {
+        CoUninitialize();
+    }
+#endif
+}
+
+bool EncoderWorkerPool::RunBatch(Stream& stream) {
+    // Only this worker holds the stream (m_scheduled), so the sink and the
+    // front of the queue are ours; the lock is only for the queue itself
+    std::vector<uint8_t> packets[kBatchPackets];
+    size_t count = 0;
+    {
+        std::lock_guard<std::mutex> lock(stream.m_mutex);
+        while (count < kBatchPackets && !stream.m_queue.empty()) {
+            packets[count++] = std::move(stream.m_queue.front());
+            stream.m_queue.pop_front();
+        }
+    }
+
+    size_t taken = 0;
+    uint64_t written = 0;
+    uint64_t failures = 0;
+    for (size_t i = 0; i < count; i++) {
+        const uint32_t size = static_cast<uint32_t>(packets[i].size());
+        taken += size;
+        if (stream.m_sink && stream.m_sink->Write(packets[i].data(), size)) {
+            written += size;
+        } else {
+            failures++;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(stream.m_mutex);
+    stream.m_queuedBytes -= taken;
+    stream.m_stats.packetsWritten += count - failures;
+    stream.m_stats.bytesWritten += written;
+    stream.m_stats.writeFailures += failures;
+    for (size_t i = 0; i < count; i++) {
+        if (stream.m_spare.size() < kBatchPackets) {
+            stream.m_spare.push_back(std::move(packets[i]));
+        }
+    }
+
+    if (!stream.m_queue.empty()) {
+        return true;
+    }
+    stream.m_scheduled = false;
+    stream.m_drained.notify_all();
+    return false;
+}
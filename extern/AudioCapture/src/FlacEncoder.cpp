@@ -0,0 +1,103 @@
+#include "FlacEncoder.h"
+#include "AudioMixer.h"
+#include <cmath>
+
+FlacEncoder::FlacEncoder()
+    : m_sampleType(SampleType::Unknown)
+    , m_bytesPerSample(0)
+    , m_channels(0)
+{
+}
+
+FlacEncoder::~FlacEncoder() {
+    Close();
+}
+
+bool FlacEncoder::Open(const std::wstring& filename, const WAVEFORMATEX* format, UINT32 compressionLevel) {
+    if (m_encoder.IsOpen()) {
+        return false;
+    }
+
+    SampleFormat input;
+    if (!AudioMixer::DescribeFormat(format, input) ||
+        input.blockAlign != input.channels * SampleTypeBytes(input.type)) {
+        return false;
+    }
+
+    // FLAC tops out at 24 bits here; wider input is reduced to that
+    const uint32_t bitsPerSample = input.type == SampleType::Int16 ? 16 : 24;
+
+    m_file.open(filename, std::ios::binary | std::ios::out | std::ios::trunc);
+    if (!m_file.is_open()) {
+        return false;
+    }
+    if (!m_encoder.Open(&m_file, input.sampleRate, input.channels, bitsPerSample, compressionLevel)) {
+        m_file.close();
+        return false;
+    }
+
+    m_sampleType = input.type;
+    m_bytesPerSample = SampleTypeBytes(input.type);
+    m_channels = input.channels;
+    return true;
+}
+
+bool FlacEncoder::WriteData(const BYTE* data, UINT32 size) {
+    if (!m_encoder.IsOpen()) {
+        return false;
+    }
+
+    const size_t count = size / m_bytesPerSample;
+    const size_t frames = count / m_channels;
+    m_samples.resize(frames * m_channels);
+    int32_t* dest = m_samples.data();
+
+    switch (m_sampleType) {
+    case SampleType::Int16: {
+        const int16_t* src = reinterpret_cast<const int16_t*>(data);
+        for (size_t i = 0; i < m_samples.size(); i++) {
+            dest[i] = src[i];
+        }
+        break;
+    }
+    case SampleType::Int24:
+        for (size_t i = 0; i < m_samples.size(); i++) {
+            const BYTE* p = data + i * 3;
+            // Assemble in the top bytes, then shift down to sign-extend
+            dest[i] = static_cast<int32_t>((static_cast<uint32_t>(p[0]) << 8) |
+                                           (static_cast<uint32_t>(p[1]) << 16) |
+                                           (static_cast<uint32_t>(p[2]) << 24)) >> 8;
+        }
+        break;
+    case SampleType::Int32: {
+        const int32_t* src = reinterpret_cast<const int32_t*>(data);
+        for (size_t i = 0; i < m_samples.size(); i++) {
+            dest[i] = src[i] >> 8;
+        }
+        break;
+    }
+    case SampleType::Float32: {
+        const float* src = reinterpret_cast<const float*>(data);
+        for (size_t i = 0; i < m_samples.size(); i++) {
+            float x = src[i] * 8388608.0f;
+            x = x < -8388608.0f ? -8388608.0f : x;
+            x = x > 8388607.0f ? 8388607.0f : x;
+            dest[i] = static_cast<int32_t>(std::lrint(x));
+        }
+        break;
+    }
+    default:
+        return false;
+    }
+
+    return m_encoder.Write(m_samples.data(), frames);
+}
+
+void FlacEncoder::Close() {
+    if (!m_encoder.IsOpen()) {
+        return;
+    }
+
+    m_encoder.Close();
+    m_file.close();
+}
@@ -0,0 +1,1216 @@
+#include "FlacStreamEncoder.h"
+#include "CpuFeatures.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <limits>
+
+namespace {
+
+constexpr uint32_t kMaxChannels = 8;
+constexpr uint32_t kMaxFixedOrder = 4;
+constexpr uint32_t kMaxLpcOrder = 32;
+constexpr uint32_t kMaxRiceParameter = 30;        // 5-bit parameters (method 1)
+constexpr uint32_t kMaxRice4BitParameter = 14;    // 15 is the escape code
+constexpr uint32_t kMaxQlpShift = 15;             // 5-bit signed field
+
+constexpr uint32_t kStreamInfoBytes = 34;
+
+// Channel assignments in the frame header
+constexpr uint32_t kLeftSide = 8;
+constexpr uint32_t kSideRight = 9;
+constexpr uint32_t kMidSide = 10;
+
+// ---------------------------------------------------------------------------
+// CRCs and MD5
+// ---------------------------------------------------------------------------
+
+struct CrcTables {
+    uint8_t crc8[256];
+    uint16_t crc16[256];
+
+    CrcTables() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c8 = i;
+            uint32_t c16 = i << 8;
+            for (int bit = 0; bit < 8; bit++) {
+                c8 = (c8 & 0x80) ? ((c8 << 1) ^ 0x07) : (c8 << 1);
+                c16 = (c16 & 0x8000) ? ((c16 << 1) ^ 0x8005) : (c16 << 1);
+            }
+            crc8[i] = static_cast<uint8_t>(c8);
+            crc16[i] = static_cast<uint16_t>(c16);
+        }
+    }
+};
+
+const CrcTables& Crc() {
+    static const CrcTables tables;
+    return tables;
+}
+
+uint8_t Crc8(const uint8_t* data, size_t size) {
+    const CrcTables& tables = Crc();
+    uint8_t crc = 0;
+    for (size_t i = 0; i < size; i++) {
+        crc = tables.crc8[crc ^ data[i]];
+    }
+    return crc;
+}
+
+uint16_t Crc16(const uint8_t* data, size_t size) {
+    const CrcTables& tables = Crc();
+    uint16_t crc = 0;
+    for (size_t i = 0; i < size; i++) {
+        crc = static_cast<uint16_t>((crc << 8) ^ tables.crc16[(crc >> 8) ^ data[i]]);
+    }
+    return crc;
+}
+
+// RFC 1321
+class Md5 {
+public:
+    Md5() { Reset(); }
+
+    void Reset() {
+        m_state[0] = 0x67452301;
+        m_state[1] = 0xefcdab89;
+        m_state[2] = 0x98badcfe;
+        m_state[3] = 0x10325476;
+        m_length = 0;
+    }
+
+    void Update(const uint8_t* data, size_t size) {
+        size_t used = static_cast<size_t>(m_length & 63);
+        m_length += size;
+
+        if (used) {
+            const size_t take = (std::min)(size, 64 - used);
+            memcpy(m_buffer + used, data, take);
+            data += take;
+            size -= take;
+            if (used + take < 64) {
+                return;
+            }
+            Transform(m_buffer);
+        }
+        for (; size >= 64; data += 64, size -= 64) {
+            Transform(data);
+        }
+        memcpy(m_buffer, data, size);
+    }
+
+    void Final(uint8_t digest[16]) {
+        const uint64_t bits = m_length * 8;
+        const uint8_t pad = 0x80;
+        const uint8_t zero = 0;
+        Update(&pad, 1);
+        while ((m_length & 63) != 56) {
+            Update(&zero, 1);
+        }
+        uint8_t length[8];
+        for (int i = 0; i < 8; i++) {
+            length[i] = static_cast<uint8_t>(bits >> (8 * i));
+        }
+        Update(length, 8);
+        for (int i = 0; i < 16; i++) {
+            digest[i] = static_cast<uint8_t>(m_state[i / 4] >> (8 * (i % 4)));
+        }
+    }
+
+private:
+    static uint32_t Rotate(uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+
+    void Transform(const uint8_t block[64]) {
+        static const uint32_t k[64] = {
+            0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+            0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+            0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+            0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+            0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+            0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+            0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+            0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+        };
+        static const int shifts[16] = { 7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21 };
+
+        uint32_t m[16];
+        for (int i = 0; i < 16; i++) {
+            m[i] = static_cast<uint32_t>(block[i * 4]) | (static_cast<uint32_t>(block[i * 4 + 1]) << 8) |
+                   (static_cast<uint32_t>(block[i * 4 + 2]) << 16) | (static_cast<uint32_t>(block[i * 4 + 3]) << 24);
+        }
+
+        uint32_t a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3];
+        for (int i = 0; i < 64; i++) {
+            uint32_t f;
+            int g;
+            if (i < 16) {
+                f = (b & c) | (~b & d);
+                g = i;
+            } else if (i < 32) {
+                f = (d & b) | (~d & c);
+                g = (5 * i + 1) & 15;
+            } else if (i < 48) {
+                f = b ^ c ^ d;
+                g = (3 * i + 5) & 15;
+            } else {
+                f = c ^ (b | ~d);
+                g = (7 * i) & 15;
+            }
+            const uint32_t next = d;
+            d = c;
+            c = b;
+            b = b + Rotate(a + f + k[i] + m[g], shifts[(i / 16) * 4 + (i & 3)]);
+            a = next;
+        }
+        m_state[0] += a;
+        m_state[1] += b;
+        m_state[2] += c;
+        m_state[3] += d;
+    }
+
+    uint32_t m_state[4];
+    uint64_t m_length;
+    uint8_t m_buffer[64];
+};
+
+// ---------------------------------------------------------------------------
+// Bit writer (MSB first, as FLAC is)
+// ---------------------------------------------------------------------------
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : m_out(out), m_acc(0), m_bits(0) {}
+
+    // bits <= 32
+    void Write(uint32_t value, uint32_t bits) {
+        if (bits == 0) {
+            return;
+        }
+        m_acc = (m_acc << bits) | (bits < 32 ? (value & ((1u << bits) - 1)) : value);
+        m_bits += bits;
+        while (m_bits >= 8) {
+            m_bits -= 8;
+            m_out.push_back(static_cast<uint8_t>(m_acc >> m_bits));
+        }
+        m_acc &= (1u << m_bits) - 1;
+    }
+
+    void WriteSigned(int32_t value, uint32_t bits) { Write(static_cast<uint32_t>(value), bits); }
+
+    // `zeros` zero bits followed by a one
+    void WriteUnary(uint32_t zeros) {
+        for (; zeros >= 32; zeros -= 32) {
+            Write(0, 32);
+        }
+        Write(1, zeros + 1);
+    }
+
+    void WriteRice(int32_t value, uint32_t parameter) {
+        const uint32_t folded = (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+        const uint32_t quotient = folded >> parameter;
+        if (quotient + 1 + parameter <= 32) {
+            // Leading zeros, stop bit and remainder in one go
+            Write((1u << parameter) | (folded & ((1u << parameter) - 1)), quotient + 1 + parameter);
+        } else {
+            WriteUnary(quotient);
+            Write(folded, parameter);
+        }
+    }
+
+    void AlignToByte() {
+        if (m_bits) {
+            Write(0, 8 - m_bits);
+        }
+    }
+
+private:
+    std::vector<uint8_t>& m_out;
+    uint64_t m_acc;
+    uint32_t m_bits;   // Pending bits in m_acc (< 8 between calls)
+};
+
+// ---------------------------------------------------------------------------
+// Autocorrelation kernels
+// ---------------------------------------------------------------------------
+
+using AutocorrelationFn = void (*)(const double* data, size_t count, uint32_t lags, double* autoc);
+
+void AutocorrelationScalar(const double* data, size_t count, uint32_t lags, double* autoc) {
+    for (uint32_t lag = 0; lag < lags; lag++) {
+        double sum = 0.0;
+        for (size_t i = lag; i < count; i++) {
+            sum += data[i] * data[i - lag];
+        }
+        autoc[lag] = sum;
+    }
+}
+
+#if AUDIO_SIMD_X86
+
+AUDIO_TARGET_SSE2
+void AutocorrelationSSE2(const double* data, size_t count, uint32_t lags, double* autoc) {
+    for (uint32_t lag = 0; lag < lags; lag++) {
+        __m128d sum0 = _mm_setzero_pd();
+        __m128d sum1 = _mm_setzero_pd();
+        size_t i = lag;
+        for (; i + 4 <= count; i += 4) {
+            sum0 = _mm_add_pd(sum0, _mm_mul_pd(_mm_loadu_pd(data + i), _mm_loadu_pd(data + i - lag)));
+            sum1 = _mm_add_pd(sum1, _mm_mul_pd(_mm_loadu_pd(data + i + 2), _mm_loadu_pd(data + i + 2 - lag)));
+        }
+        double lanes[2];
+        _mm_storeu_pd(lanes, _mm_add_pd(sum0, sum1));
+        double sum = lanes[0] + lanes[1];
+        for (; i < count; i++) {
+            sum += data[i] * data[i - lag];
+        }
+        autoc[lag] = sum;
+    }
+}
+
+AUDIO_TARGET_AVX2
+void AutocorrelationAVX2(const double* data, size_t count, uint32_t lags, double* autoc) {
+    for (uint32_t lag = 0; lag < lags; lag++) {
+        __m256d sum0 = _mm256_setzero_pd();
+        __m256d sum1 = _mm256_setzero_pd();
+        size_t i = lag;
+        for (; i + 8 <= count; i += 8) {
+            sum0 = _mm256_add_pd(sum0, _mm256_mul_pd(_mm256_loadu_pd(data + i), _mm256_loadu_pd(data + i - lag)));
+            sum1 = _mm256_add_pd(sum1, _mm256_mul_pd(_mm256_loadu_pd(data + i + 4),
+                                                     _mm256_loadu_pd(data + i + 4 - lag)));
+        }
+        double lanes[4];
+        _mm256_storeu_pd(lanes, _mm256_add_pd(sum0, sum1));
+        double sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+        for (; i < count; i++) {
+            sum += data[i] * data[i - lag];
+        }
+        autoc[lag] = sum;
+    }
+}
+
+#endif
+
+AutocorrelationFn SelectAutocorrelation() {
+#if AUDIO_SIMD_X86
+    switch (DetectSimdLevel()) {
+    case SimdLevel::AVX2: return AutocorrelationAVX2;
+    case SimdLevel::SSE2: return AutocorrelationSSE2;
+    default:              break;
+    }
+#endif
+    return AutocorrelationScalar;
+}
+
+AutocorrelationFn Autocorrelation() {
+    static const AutocorrelationFn fn = SelectAutocorrelation();
+    return fn;
+}
+
+// ---------------------------------------------------------------------------
+// Prediction
+// ---------------------------------------------------------------------------
+
+// Residual of the order-N fixed polynomial predictor for samples [order, n).
+// Inputs are at most 25 bits (side channel), so int32 holds every order.
+void FixedResidual(const int32_t* x, size_t n, uint32_t order, int32_t* residual) {
+    switch (order) {
+    case 0:
+        for (size_t i = 0; i < n; i++) residual[i] = x[i];
+        break;
+    case 1:
+        for (size_t i = 1; i < n; i++) residual[i - 1] = x[i] - x[i - 1];
+        break;
+    case 2:
+        for (size_t i = 2; i < n; i++) residual[i - 2] = x[i] - 2 * x[i - 1] + x[i - 2];
+        break;
+    case 3:
+        for (size_t i = 3; i < n; i++) residual[i - 3] = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3];
+        break;
+    default:
+        for (size_t i = 4; i < n; i++) {
+            residual[i - 4] = x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4];
+        }
+        break;
+    }
+}
+
+// Sum of |residual| for fixed orders 0..4 in one pass; returns the cheapest
+// order. Only orders below n are considered.
+uint32_t BestFixedOrder(const int32_t* x, size_t n, uint64_t sums[kMaxFixedOrder + 1]) {
+    for (uint32_t order = 0; order <= kMaxFixedOrder; order++) {
+        sums[order] = 0;
+    }
+    if (n <= kMaxFixedOrder) {
+        for (size_t i = 0; i < n; i++) {
+            sums[0] += static_cast<uint64_t>(std::llabs(x[i]));
+        }
+        return 0;
+    }
+
+    int64_t e0 = x[3];
+    int64_t e1 = e0 - x[2];
+    int64_t e2 = e1 - (x[2] - x[1]);
+    int64_t e3 = e2 - (x[2] - 2 * static_cast<int64_t>(x[1]) + x[0]);
+    for (size_t i = kMaxFixedOrder; i < n; i++) {
+        const int64_t s0 = x[i];
+        const int64_t s1 = s0 - e0;
+        const int64_t s2 = s1 - e1;
+        const int64_t s3 = s2 - e2;
+        const int64_t s4 = s3 - e3;
+        sums[0] += static_cast<uint64_t>(s0 < 0 ? -s0 : s0);
+        sums[1] += static_cast<uint64_t>(s1 < 0 ? -s1 : s1);
+        sums[2] += static_cast<uint64_t>(s2 < 0 ? -s2 : s2);
+        sums[3] += static_cast<uint64_t>(s3 < 0 ? -s3 : s3);
+        sums[4] += static_cast<uint64_t>(s4 < 0 ? -s4 : s4);
+        e0 = s0;
+        e1 = s1;
+        e2 = s2;
+        e3 = s3;
+    }
+
+    uint32_t best = 0;
+    for (uint32_t order = 1; order <= kMaxFixedOrder; order++) {
+        if (sums[order] < sums[best]) {
+            best = order;
+        }
+    }
+    return best;
+}
+
+// Levinson-Durbin. Fills lp[order-1][0..order) with predictor coefficients
+// for every order up to maxOrder and error[order-1] with the residual
+// energy; returns the highest order it got to (stops at a perfect fit).
+uint32_t ComputeLpCoefficients(const double* autoc, uint32_t maxOrder, double lp[][kMaxLpcOrder], double* error) {
+    double lpc[kMaxLpcOrder];
+    double err = autoc[0];
+
+    for (uint32_t i = 0; i < maxOrder; i++) {
+        double r = -autoc[i + 1];
+        for (uint32_t j = 0; j < i; j++) {
+            r -= lpc[j] * autoc[i - j];
+        }
+        r /= err;
+
+        lpc[i] = r;
+        uint32_t j = 0;
+        for (; j < (i >> 1); j++) {
+            const double tmp = lpc[j];
+            lpc[j] += r * lpc[i - 1 - j];
+            lpc[i - 1 - j] += r * tmp;
+        }
+        if (i & 1) {
+            lpc[j] += lpc[j] * r;
+        }
+
+        err *= (1.0 - r * r);
+        for (j = 0; j <= i; j++) {
+            lp[i][j] = -lpc[j];
+        }
+        error[i] = err;
+
+        if (err <= 0.0) {
+            return i + 1;
+        }
+    }
+    return maxOrder;
+}
+
+// Coefficient precision the reference encoder uses for a block size
+// (bits including sign)
+uint32_t QlpPrecision(size_t blockSize, uint32_t bitsPerSample) {
+    if (bitsPerSample > 16) {
+        return 15;
+    }
+    if (blockSize <= 192) return 7;
+    if (blockSize <= 384) return 8;
+    if (blockSize <= 576) return 9;
+    if (blockSize <= 1152) return 10;
+    if (blockSize <= 2304) return 11;
+    if (blockSize <= 4608) return 12;
+    return 13;
+}
+
+// Round lp to `precision`-bit integers with a common right shift, carrying
+// the rounding error forward. False if the coefficients can't be scaled.
+bool QuantizeCoefficients(const double* lp, uint32_t order, uint32_t precision, int32_t* qlp, int* shift) {
+    double cmax = 0.0;
+    for (uint32_t i = 0; i < order; i++) {
+        cmax = (std::max)(cmax, std::fabs(lp[i]));
+    }
+    if (cmax <= 0.0) {
+        return false;
+    }
+
+    const int bits = static_cast<int>(precision) - 1;   // Less the sign bit
+    const int32_t qmax = (1 << bits) - 1;
+    const int32_t qmin = -(1 << bits);
+
+    int log2cmax;
+    std::frexp(cmax, &log2cmax);
+    *shift = (std::min)(bits - log2cmax, static_cast<int>(kMaxQlpShift));
+    if (*shift < 0) {
+        return false;
+    }
+
+    double carry = 0.0;
+    for (uint32_t i = 0; i < order; i++) {
+        carry += lp[i] * static_cast<double>(1 << *shift);
+        int32_t q = static_cast<int32_t>(std::lround(carry));
+        q = (std::max)(qmin, (std::min)(qmax, q));
+        carry -= q;
+        qlp[i] = q;
+    }
+    return true;
+}
+
+// Residual of a quantized LPC predictor for samples [order, n). False if
+// any residual doesn't fit in 32 bits (the decoder works in int32).
+bool LpcResidual(const int32_t* x, size_t n, const int32_t* qlp, uint32_t order, int shift, int32_t* residual) {
+    for (size_t i = order; i < n; i++) {
+        int64_t sum = 0;
+        const int32_t* history = x + i;
+        for (uint32_t j = 0; j < order; j++) {
+            sum += static_cast<int64_t>(qlp[j]) * history[-1 - static_cast<ptrdiff_t>(j)];
+        }
+        const int64_t value = static_cast<int64_t>(x[i]) - (sum >> shift);
+        if (value < (std::numeric_limits<int32_t>::min)() || value > (std::numeric_limits<int32_t>::max)()) {
+            return false;
+        }
+        residual[i - order] = static_cast<int32_t>(value);
+    }
+    return true;
+}
+
+double ExpectedBitsPerResidual(double error, size_t samples) {
+    if (error <= 0.0) {
+        return error < 0.0 ? 1e32 : 0.0;
+    }
+    const double bits = 0.5 * std::log2(error * 0.5 / static_cast<double>(samples));
+    return bits > 0.0 ? bits : 0.0;
+}
+
+
+// ---------------------------------------------------------------------------
+// Rice partitioning
+// ---------------------------------------------------------------------------
+
+// Finest partitioning any preset asks for
+constexpr uint32_t kMaxPartitionOrder = 8;
+
+struct RicePlan {
+    uint32_t partitionOrder = 0;
+    bool wideParameters = false;   // Method 1: 5-bit parameters
+    uint32_t parameters[1 << kMaxPartitionOrder] = {};
+};
+
+uint32_t FoldedValue(int32_t value) {
+    return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+// Bits for `count` folded values summing to `sum`, at the parameter it
+// returns through `parameter`
+uint64_t RicePartitionBits(uint64_t sum, uint64_t count, uint32_t& parameter) {
+    uint32_t guess = 0;
+    if (count && sum > count) {
+        const uint64_t mean = sum / count;
+        while (guess < kMaxRiceParameter && (mean >> (guess + 1)) != 0) {
+            guess++;
+        }
+    }
+
+    uint64_t best = (std::numeric_limits<uint64_t>::max)();
+    const uint32_t first = guess > 0 ? guess - 1 : 0;
+    const uint32_t last = (std::min)(guess + 1, kMaxRiceParameter);
+    for (uint32_t k = first; k <= last; k++) {
+        const uint64_t bits = count * (k + 1) + (sum >> k);
+        if (bits < best) {
+            best = bits;
+            parameter = k;
+        }
+    }
+    return best;
+}
+
+// Pick the partition order and parameters for the `blockSize -
+// predictorOrder` residual values. Returns the coded size in bits.
+uint64_t PlanResidual(const int32_t* residual, size_t blockSize, uint32_t predictorOrder,
+                      uint32_t maxPartitionOrder, std::vector<uint64_t>& sums, RicePlan& plan) {
+    // Partitions must divide the block and the first must hold more than
+    // the warm-up samples
+    uint32_t maxOrder = (std::min)(maxPartitionOrder, kMaxPartitionOrder);
+    while (maxOrder > 0 && ((blockSize & ((size_t(1) << maxOrder) - 1)) != 0 ||
+                            (blockSize >> maxOrder) <= predictorOrder)) {
+        maxOrder--;
+    }
+
+    // Sums at the finest order, merged pairwise for each coarser one
+    const size_t partitions = size_t(1) << maxOrder;
+    const size_t partitionSize = blockSize >> maxOrder;
+    sums.resize(partitions);
+    size_t index = 0;
+    for (size_t p = 0; p < partitions; p++) {
+        const size_t end = (p + 1) * partitionSize - predictorOrder;
+        uint64_t sum = 0;
+        for (; index < end; index++) {
+            sum += FoldedValue(residual[index]);
+        }
+        sums[p] = sum;
+    }
+
+    uint64_t bestBits = (std::numeric_limits<uint64_t>::max)();
+    uint32_t parameters[1 << kMaxPartitionOrder];
+    for (uint32_t order = maxOrder;; order--) {
+        const size_t count = size_t(1) << order;
+        const size_t size = blockSize >> order;
+        uint64_t bits = 2 + 4;
+        uint32_t maxParameter = 0;
+        for (size_t p = 0; p < count; p++) {
+            const uint64_t samples = size - (p == 0 ? predictorOrder : 0);
+            bits += RicePartitionBits(sums[p], samples, parameters[p]);
+            maxParameter = (std::max)(maxParameter, parameters[p]);
+        }
+        const bool wide = maxParameter > kMaxRice4BitParameter;
+        bits += count * (wide ? 5 : 4);
+
+        if (bits < bestBits) {
+            bestBits = bits;
+            plan.partitionOrder = order;
+            plan.wideParameters = wide;
+            memcpy(plan.parameters, parameters, count * sizeof(uint32_t));
+        }
+
+        if (order == 0) {
+            break;
+        }
+        for (size_t p = 0; p < count / 2; p++) {
+            sums[p] = sums[2 * p] + sums[2 * p + 1];
+        }
+    }
+    return bestBits;
+}
+
+void WriteResidual(BitWriter& writer, const int32_t* residual, size_t blockSize, uint32_t predictorOrder,
+                   const RicePlan& plan) {
+    writer.Write(plan.wideParameters ? 1 : 0, 2);
+    writer.Write(plan.partitionOrder, 4);
+
+    const size_t count = size_t(1) << plan.partitionOrder;
+    const size_t size = blockSize >> plan.partitionOrder;
+    const uint32_t parameterBits = plan.wideParameters ? 5 : 4;
+    size_t index = 0;
+    for (size_t p = 0; p < count; p++) {
+        const uint32_t parameter = plan.parameters[p];
+        writer.Write(parameter, parameterBits);
+        const size_t end = (p + 1) * size - predictorOrder;
+        for (; index < end; index++) {
+            writer.WriteRice(residual[index], parameter);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Subframes and frame header fields
+// ---------------------------------------------------------------------------
+
+enum class SubframeType {
+    Constant,
+    Verbatim,
+    Fixed,
+    Lpc
+};
+
+struct Subframe {
+    SubframeType type = SubframeType::Verbatim;
+    uint32_t wastedBits = 0;
+    uint32_t order = 0;
+    uint32_t precision = 0;
+    int shift = 0;
+    int32_t qlp[kMaxLpcOrder] = {};
+    RicePlan plan;
+    std::vector<int32_t> residual;
+    uint64_t bits = 0;   // Coded size, header included
+};
+
+uint32_t BlockSizeCode(size_t blockSize) {
+    switch (blockSize) {
+    case 192:   return 1;
+    case 576:   return 2;
+    case 1152:  return 3;
+    case 2304:  return 4;
+    case 4608:  return 5;
+    case 256:   return 8;
+    case 512:   return 9;
+    case 1024:  return 10;
+    case 2048:  return 11;
+    case 4096:  return 12;
+    case 8192:  return 13;
+    case 16384: return 14;
+    case 32768: return 15;
+    default:    return blockSize <= 256 ? 6 : 7;   // Size - 1 follows in 8 / 16 bits
+    }
+}
+
+uint32_t SampleRateCode(uint32_t sampleRate) {
+    switch (sampleRate) {
+    case 88200:  return 1;
+    case 176400: return 2;
+    case 192000: return 3;
+    case 8000:   return 4;
+    case 16000:  return 5;
+    case 22050:  return 6;
+    case 24000:  return 7;
+    case 32000:  return 8;
+    case 44100:  return 9;
+    case 48000:  return 10;
+    case 96000:  return 11;
+    default:
+        if (sampleRate % 1000 == 0 && sampleRate / 1000 <= 255) return 12;   // kHz in 8 bits
+        if (sampleRate <= 65535) return 13;                                   // Hz in 16 bits
+        if (sampleRate % 10 == 0 && sampleRate / 10 <= 65535) return 14;     // 10 Hz in 16 bits
+        return 0;                                                             // From STREAMINFO
+    }
+}
+
+uint32_t SampleSizeCode(uint32_t bitsPerSample) {
+    switch (bitsPerSample) {
+    case 8:  return 1;
+    case 12: return 2;
+    case 16: return 4;
+    case 20: return 5;
+    case 24: return 6;
+    default: return 0;
+    }
+}
+
+// Frame number in FLAC's extended UTF-8 coding
+void WriteUtf8(BitWriter& writer, uint32_t value) {
+    if (value < 0x80) {
+        writer.Write(value, 8);
+        return;
+    }
+    uint32_t bytes = 2;
+    while (bytes < 6 && value >= (1u << (5 * bytes + 1))) {
+        bytes++;
+    }
+    const uint32_t lead = (0xFF00u >> bytes) & 0xFF;
+    writer.Write(lead | (value >> (6 * (bytes - 1))), 8);
+    for (uint32_t i = bytes - 1; i > 0; i--) {
+        writer.Write(0x80 | ((value >> (6 * (i - 1))) & 0x3F), 8);
+    }
+}
+
+struct Preset {
+    uint32_t blockSize;
+    uint32_t maxLpcOrder;
+    uint32_t maxPartitionOrder;
+    bool midSide;
+    bool looseMidSide;
+    bool exhaustive;
+};
+
+const Preset kPresets[] = {
+    { 1152, 0, 3, false, false, false },   // 0
+    { 1152, 0, 3, true, true, false },     // 1
+    { 1152, 0, 3, true, false, false },    // 2
+    { 4096, 6, 4, true, false, false },    // 3
+    { 4096, 8, 4, true, true, false },     // 4
+    { 4096, 8, 5, true, false, false },    // 5
+    { 4096, 8, 6, true, false, false },    // 6
+    { 4096, 12, 6, true, false, false },   // 7
+    { 4096, 12, 6, true, false, true },    // 8
+};
+
+} // namespace
+
+// Per-frame analysis state. Lives behind a pointer so the header doesn't
+// carry the coder's internals.
+struct FlacStreamEncoder::Workspace {
+    Md5 md5;
+    std::vector<uint8_t> md5Bytes;
+
+    std::vector<int32_t> mid;
+    std::vector<int32_t> side;
+    std::vector<int32_t> shifted;     // Channel with wasted bits removed
+
+    std::vector<double> window;       // Tukey(0.5) for windowSize samples
+    size_t windowSize = 0;
+    std::vector<double> windowed;
+    std::vector<uint64_t> partitionSums;
+
+    Subframe subframes[kMaxChannels];
+    Subframe candidate;
+
+    std::vector<uint8_t> frame;
+
+    // Cheapest coding of one channel into `out`
+    void AnalyzeSubframe(const int32_t* x, size_t n, uint32_t bps, const FlacStreamEncoder& encoder, Subframe& out);
+
+    void WriteSubframe(BitWriter& writer, const int32_t* x, size_t n, uint32_t bps, const Subframe& subframe);
+
+private:
+    // Try `candidate` against `out` and keep the smaller
+    void Keep(Subframe& out) {
+        if (candidate.bits < out.bits) {
+            std::swap(out, candidate);
+        }
+    }
+
+    void UpdateWindow(size_t n);
+};
+
+void FlacStreamEncoder::Workspace::UpdateWindow(size_t n) {
+    if (windowSize == n) {
+        return;
+    }
+    windowSize = n;
+
+    // Tukey, p = 0.5: flat middle, raised-cosine quarter at each end
+    window.assign(n, 1.0);
+    const size_t taper = n / 4;
+    const double pi = 3.14159265358979323846;
+    for (size_t i = 0; i < taper; i++) {
+        const double w = 0.5 - 0.5 * std::cos(pi * static_cast<double>(i) / static_cast<double>(taper));
+        window[i] = w;
+        window[n - 1 - i] = w;
+    }
+}
+
+void FlacStreamEncoder::Workspace::AnalyzeSubframe(const int32_t* x, size_t n, uint32_t bps,
+                                                   const FlacStreamEncoder& encoder, Subframe& out) {
+    out.wastedBits = 0;
+
+    uint32_t bitsUsed = 0;
+    bool constant = true;
+    for (size_t i = 0; i < n; i++) {
+        bitsUsed |= static_cast<uint32_t>(x[i]);
+        constant = constant && x[i] == x[0];
+    }
+    if (constant) {
+        out.type = SubframeType::Constant;
+        out.bits = 8 + bps;
+        return;
+    }
+
+    // Low bits that are zero in every sample are sent once, not per sample
+    uint32_t wasted = 0;
+    while (!(bitsUsed & (1u << wasted))) {
+        wasted++;
+    }
+    if (wasted) {
+        shifted.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            shifted[i] = x[i] >> wasted;
+        }
+        x = shifted.data();
+        bps -= wasted;
+    }
+    const uint64_t headerBits = 8 + wasted;
+
+    out.type = SubframeType::Verbatim;
+    out.wastedBits = wasted;
+    out.bits = headerBits + static_cast<uint64_t>(n) * bps;
+
+    candidate.wastedBits = wasted;
+    candidate.residual.resize(n);
+
+    // Fixed polynomial: the order with the smallest residual magnitude
+    uint64_t sums[kMaxFixedOrder + 1];
+    const uint32_t fixedOrder = BestFixedOrder(x, n, sums);
+    FixedResidual(x, n, fixedOrder, candidate.residual.data());
+    candidate.type = SubframeType::Fixed;
+    candidate.order = fixedOrder;
+    candidate.bits = headerBits + static_cast<uint64_t>(fixedOrder) * bps +
+                     PlanResidual(candidate.residual.data(), n, fixedOrder, encoder.m_maxPartitionOrder,
+                                  partitionSums, candidate.plan);
+    Keep(out);
+
+    const uint32_t maxLpcOrder = (std::min)(encoder.m_maxLpcOrder, static_cast<uint32_t>(n - 1));
+    if (maxLpcOrder == 0) {
+        return;
+    }
+
+    UpdateWindow(n);
+    windowed.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        windowed[i] = static_cast<double>(x[i]) * window[i];
+    }
+    double autoc[kMaxLpcOrder + 1];
+    Autocorrelation()(windowed.data(), n, maxLpcOrder + 1, autoc);
+    if (autoc[0] <= 0.0) {
+        return;
+    }
+
+    double lp[kMaxLpcOrder][kMaxLpcOrder];
+    double error[kMaxLpcOrder];
+    const uint32_t orders = ComputeLpCoefficients(autoc, maxLpcOrder, lp, error);
+    const uint32_t precision = QlpPrecision(n, bps);
+
+    uint32_t firstOrder = 1;
+    uint32_t lastOrder = orders;
+    if (!encoder.m_exhaustiveOrder) {
+        // Order with the smallest expected size from the prediction error
+        double bestEstimate = std::numeric_limits<double>::max();
+        for (uint32_t order = 1; order <= orders; order++) {
+            const double estimate = ExpectedBitsPerResidual(error[order - 1], n) * static_cast<double>(n - order) +
+                                    static_cast<double>(order) * (precision + bps);
+            if (estimate < bestEstimate) {
+                bestEstimate = estimate;
+                firstOrder = order;
+            }
+        }
+        lastOrder = firstOrder;
+    }
+
+    for (uint32_t order = firstOrder; order <= lastOrder; order++) {
+        candidate.type = SubframeType::Lpc;
+        candidate.wastedBits = wasted;
+        candidate.residual.resize(n);
+        candidate.order = order;
+        candidate.precision = precision;
+        if (!QuantizeCoefficients(lp[order - 1], order, precision, candidate.qlp, &candidate.shift) ||
+            !LpcResidual(x, n, candidate.qlp, order, candidate.shift, candidate.residual.data())) {
+            continue;
+        }
+        candidate.bits = headerBits + static_cast<uint64_t>(order) * (bps + precision) + 4 + 5 +
+                         PlanResidual(candidate.residual.data(), n, order, encoder.m_maxPartitionOrder,
+                                      partitionSums, candidate.plan);
+        Keep(out);
+    }
+}
+
+void FlacStreamEncoder::Workspace::WriteSubframe(BitWriter& writer, const int32_t* x, size_t n, uint32_t bps,
+                                                 const Subframe& subframe) {
+    writer.Write(0, 1);
+    switch (subframe.type) {
+    case SubframeType::Constant: writer.Write(0, 6); break;
+    case SubframeType::Verbatim: writer.Write(1, 6); break;
+    case SubframeType::Fixed:    writer.Write(8 | subframe.order, 6); break;
+    case SubframeType::Lpc:      writer.Write(32 | (subframe.order - 1), 6); break;
+    }
+
+    const uint32_t wasted = subframe.wastedBits;
+    if (wasted) {
+        writer.Write(1, 1);
+        writer.WriteUnary(wasted - 1);
+        bps -= wasted;
+    } else {
+        writer.Write(0, 1);
+    }
+
+    switch (subframe.type) {
+    case SubframeType::Constant:
+        writer.WriteSigned(x[0], bps);
+        break;
+    case SubframeType::Verbatim:
+        for (size_t i = 0; i < n; i++) {
+            writer.WriteSigned(x[i] >> wasted, bps);
+        }
+        break;
+    case SubframeType::Fixed:
+    case SubframeType::Lpc:
+        for (uint32_t i = 0; i < subframe.order; i++) {
+            writer.WriteSigned(x[i] >> wasted, bps);
+        }
+        if (subframe.type == SubframeType::Lpc) {
+            writer.Write(subframe.precision - 1, 4);
+            writer.WriteSigned(subframe.shift, 5);
+            for (uint32_t i = 0; i < subframe.order; i++) {
+                writer.WriteSigned(subframe.qlp[i], subframe.precision);
+            }
+        }
+        WriteResidual(writer, subframe.residual.data(), n, subframe.order, subframe.plan);
+        break;
+    }
+}
+
+FlacStreamEncoder::FlacStreamEncoder()
+    : m_out(nullptr)
+    , m_streamInfoPos(-1)
+    , m_failed(false)
+    , m_sampleRate(0)
+    , m_channels(0)
+    , m_bitsPerSample(0)
+    , m_blockSize(0)
+    , m_maxLpcOrder(0)
+    , m_maxPartitionOrder(0)
+    , m_midSide(false)
+    , m_looseMidSide(false)
+    , m_exhaustiveOrder(false)
+    , m_buffered(0)
+    , m_totalSamples(0)
+    , m_frameNumber(0)
+    , m_minFrameBytes(0)
+    , m_maxFrameBytes(0)
+{
+}
+
+FlacStreamEncoder::~FlacStreamEncoder() {
+    Close();
+}
+
+bool FlacStreamEncoder::Open(std::ostream* out, uint32_t sampleRate, uint32_t channels, uint32_t bitsPerSample,
+                             uint32_t compressionLevel) {
+    if (m_out || !out || channels == 0 || channels > kMaxChannels || bitsPerSample < 8 || bitsPerSample > 24 ||
+        sampleRate == 0 || sampleRate >= (1u << 20)) {
+        return false;
+    }
+
+    const Preset& preset = kPresets[(std::min)(compressionLevel, static_cast<uint32_t>(std::size(kPresets) - 1))];
+    m_sampleRate = sampleRate;
+    m_channels = channels;
+    m_bitsPerSample = bitsPerSample;
+    m_blockSize = preset.blockSize;
+    m_maxLpcOrder = preset.maxLpcOrder;
+    m_maxPartitionOrder = preset.maxPartitionOrder;
+    m_midSide = preset.midSide && channels == 2;
+    m_looseMidSide = preset.looseMidSide;
+    m_exhaustiveOrder = preset.exhaustive;
+
+    m_planes.assign(channels, std::vector<int32_t>(m_blockSize));
+    m_buffered = 0;
+    m_totalSamples = 0;
+    m_frameNumber = 0;
+    m_minFrameBytes = 0;
+    m_maxFrameBytes = 0;
+    m_failed = false;
+
+    m_work = std::make_unique<Workspace>();
+    if (m_midSide) {
+        m_work->mid.resize(m_blockSize);
+        m_work->side.resize(m_blockSize);
+    }
+
+    // Stream marker, then STREAMINFO with the totals still unknown
+    out->write("fLaC", 4);
+    m_streamInfoPos = out->tellp();
+    std::vector<uint8_t> header;
+    WriteStreamInfo(header);
+    out->write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
+    if (!out->good()) {
+        m_work.reset();
+        return false;
+    }
+
+    m_out = out;
+    return true;
+}
+
+bool FlacStreamEncoder::Write(const int32_t* samples, size_t frames) {
+    if (!m_out) {
+        return false;
+    }
+
+    // MD5 of the input as little-endian samples of the stream's byte width
+    const uint32_t bytesPerSample = (m_bitsPerSample + 7) / 8;
+    std::vector<uint8_t>& bytes = m_work->md5Bytes;
+    bytes.resize(frames * m_channels * bytesPerSample);
+    uint8_t* dest = bytes.data();
+    for (size_t i = 0; i < frames * m_channels; i++) {
+        const uint32_t value = static_cast<uint32_t>(samples[i]);
+        for (uint32_t b = 0; b < bytesPerSample; b++) {
+            *dest++ = static_cast<uint8_t>(value >> (8 * b));
+        }
+    }
+    m_work->md5.Update(bytes.data(), bytes.size());
+
+    while (frames > 0) {
+        const size_t take = (std::min)(frames, m_blockSize - m_buffered);
+        for (uint32_t ch = 0; ch < m_channels; ch++) {
+            int32_t* plane = m_planes[ch].data() + m_buffered;
+            for (size_t i = 0; i < take; i++) {
+                plane[i] = samples[i * m_channels + ch];
+            }
+        }
+        samples += take * m_channels;
+        frames -= take;
+        m_buffered += take;
+
+        if (m_buffered == m_blockSize) {
+            EncodeFrame(m_blockSize);
+            m_buffered = 0;
+        }
+    }
+    return !m_failed;
+}
+
+bool FlacStreamEncoder::Close() {
+    if (!m_out) {
+        return false;
+    }
+
+    if (m_buffered > 0) {
+        EncodeFrame(m_buffered);
+        m_buffered = 0;
+    }
+
+    // Patch STREAMINFO now that the totals are known. A pipe or other
+    // unseekable stream keeps the placeholder, which decoders accept.
+    if (m_streamInfoPos != std::streampos(-1)) {
+        const std::streampos end = m_out->tellp();
+        std::vector<uint8_t> header;
+        WriteStreamInfo(header);
+        m_out->seekp(m_streamInfoPos);
+        m_out->write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
+        m_out->seekp(end);
+    }
+    m_out->flush();
+    if (!m_out->good()) {
+        m_failed = true;
+    }
+
+    m_out = nullptr;
+    m_planes.clear();
+    m_work.reset();
+    return !m_failed;
+}
+
+bool FlacStreamEncoder::EncodeFrame(size_t blockSize) {
+    Workspace& ws = *m_work;
+    const size_t n = blockSize;
+
+    // What gets coded: the input channels, or for stereo the cheapest pair
+    // of left, right, mid and side
+    const int32_t* channels[kMaxChannels];
+    uint32_t channelBits[kMaxChannels];
+    const Subframe* coded[kMaxChannels];
+    uint32_t assignment = m_channels - 1;
+
+    if (m_midSide && n > kMaxFixedOrder) {
+        const int32_t* left = m_planes[0].data();
+        const int32_t* right = m_planes[1].data();
+        int32_t* mid = ws.mid.data();
+        int32_t* side = ws.side.data();
+        for (size_t i = 0; i < n; i++) {
+            mid[i] = (left[i] + right[i]) >> 1;
+            side[i] = left[i] - right[i];
+        }
+
+        const int32_t* sources[4] = { left, right, mid, side };
+        const uint32_t sourceBits[4] = { m_bitsPerSample, m_bitsPerSample, m_bitsPerSample, m_bitsPerSample + 1 };
+        uint64_t cost[4];
+        for (int c = 0; c < 4; c++) {
+            if (m_looseMidSide) {
+                // Estimate from the best fixed predictor, no worse than verbatim
+                uint64_t sums[kMaxFixedOrder + 1];
+                const uint32_t order = BestFixedOrder(sources[c], n, sums);
+                uint32_t parameter;
+                cost[c] = (std::min)(RicePartitionBits(2 * sums[order], n - order, parameter) +
+                                         static_cast<uint64_t>(order) * sourceBits[c],
+                                     static_cast<uint64_t>(n) * sourceBits[c]);
+            } else {
+                ws.AnalyzeSubframe(sources[c], n, sourceBits[c], *this, ws.subframes[c]);
+                cost[c] = ws.subframes[c].bits;
+            }
+        }
+
+        // Assignment code and the (first, second) sources it sends
+        static const uint32_t pairs[4][3] = {
+            { 1, 0, 1 }, { kLeftSide, 0, 3 }, { kSideRight, 3, 1 }, { kMidSide, 2, 3 }
+        };
+        int best = 0;
+        for (int p = 1; p < 4; p++) {
+            if (cost[pairs[p][1]] + cost[pairs[p][2]] < cost[pairs[best][1]] + cost[pairs[best][2]]) {
+                best = p;
+            }
+        }
+        assignment = pairs[best][0];
+        for (int ch = 0; ch < 2; ch++) {
+            const uint32_t source = pairs[best][ch + 1];
+            channels[ch] = sources[source];
+            channelBits[ch] = sourceBits[source];
+            if (m_looseMidSide) {
+                ws.AnalyzeSubframe(channels[ch], n, channelBits[ch], *this, ws.subframes[ch]);
+                coded[ch] = &ws.subframes[ch];
+            } else {
+                coded[ch] = &ws.subframes[source];
+            }
+        }
+    } else {
+        for (uint32_t ch = 0; ch < m_channels; ch++) {
+            channels[ch] = m_planes[ch].data();
+            channelBits[ch] = m_bitsPerSample;
+            ws.AnalyzeSubframe(channels[ch], n, channelBits[ch], *this, ws.subframes[ch]);
+            coded[ch] = &ws.subframes[ch];
+        }
+    }
+
+    std::vector<uint8_t>& frame = ws.frame;
+    frame.clear();
+    BitWriter writer(frame);
+
+    // Header: fixed-blocksize sync, block size, rate, channels, sample size
+    const uint32_t blockCode = BlockSizeCode(n);
+    const uint32_t rateCode = SampleRateCode(m_sampleRate);
+    writer.Write(0xFFF8, 16);
+    writer.Write(blockCode, 4);
+    writer.Write(rateCode, 4);
+    writer.Write(assignment, 4);
+    writer.Write(SampleSizeCode(m_bitsPerSample), 3);
+    writer.Write(0, 1);
+    WriteUtf8(writer, m_frameNumber);
+    if (blockCode == 6) {
+        writer.Write(static_cast<uint32_t>(n - 1), 8);
+    } else if (blockCode == 7) {
+        writer.Write(static_cast<uint32_t>(n - 1), 16);
+    }
+    if (rateCode == 12) {
+        writer.Write(m_sampleRate / 1000, 8);
+    } else if (rateCode == 13) {
+        writer.Write(m_sampleRate, 16);
+    } else if (rateCode == 14) {
+        writer.Write(m_sampleRate / 10, 16);
+    }
+    writer.Write(Crc8(frame.data(), frame.size()), 8);
+
+    for (uint32_t ch = 0; ch < m_channels; ch++) {
+        ws.WriteSubframe(writer, channels[ch], n, channelBits[ch], *coded[ch]);
+    }
+    writer.AlignToByte();
+    const uint16_t crc = Crc16(frame.data(), frame.size());
+    frame.push_back(static_cast<uint8_t>(crc >> 8));
+    frame.push_back(static_cast<uint8_t>(crc));
+
+    m_out->write(reinterpret_cast<const char*>(frame.data()), static_cast<std::streamsize>(frame.size()));
+    if (!m_out->good()) {
+        m_failed = true;
+        return false;
+    }
+
+    const uint32_t frameBytes = static_cast<uint32_t>(frame.size());
+    m_minFrameBytes = m_frameNumber == 0 ? frameBytes : (std::min)(m_minFrameBytes, frameBytes);
+    m_maxFrameBytes = (std::max)(m_maxFrameBytes, frameBytes);
+    m_totalSamples += n;
+    m_frameNumber++;
+    return true;
+}
+
+void FlacStreamEncoder::WriteStreamInfo(std::vector<uint8_t>& out) const {
+    BitWriter writer(out);
+
+    // Metadata block header: last block, type 0, 34 bytes
+    writer.Write(1, 1);
+    writer.Write(0, 7);
+    writer.Write(kStreamInfoBytes, 24);
+
+    writer.Write(m_blockSize, 16);
+    writer.Write(m_blockSize, 16);
+    writer.Write(m_minFrameBytes, 24);
+    writer.Write(m_maxFrameBytes, 24);
+    writer.Write(m_sampleRate, 20);
+    writer.Write(m_channels - 1, 3);
+    writer.Write(m_bitsPerSample - 1, 5);
+    writer.Write(static_cast<uint32_t>(m_totalSamples >> 32), 4);
+    writer.Write(static_cast<uint32_t>(m_totalSamples), 32);
+
+    // The MD5 is only final once the last block is in
+    uint8_t digest[16] = {};
+    if (m_totalSamples > 0 && m_buffered == 0) {
+        Md5 md5 = m_work->md5;
+        md5.Final(digest);
+    }
+    for (uint8_t byte : digest) {
+        writer.Write(byte, 8);
+    }
+}
@@ -0,0 +1,294 @@
+#include "PeakLimiter.h"
+#include "CpuFeatures.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Accepted setting ranges
+constexpr float kMinCeilingDb = -24.0f;
+constexpr float kMaxAttackMs = 50.0f;
+constexpr float kMinReleaseMs = 1.0f;
+constexpr float kMaxReleaseMs = 5000.0f;
+
+// ---- Scalar reference kernels ----
+
+// gains[n] = gain that brings frame n's peak down to the ceiling (1 if it is below)
+void RequiredGainScalar(const float* in, size_t frames, uint32_t channels, float ceiling, float* gains) {
+    for (size_t n = 0; n < frames; n++) {
+        float peak = 0.0f;
+        for (uint32_t ch = 0; ch < channels; ch++) {
+            const float a = std::fabs(in[n * channels + ch]);
+            peak = a > peak ? a : peak;
+        }
+        gains[n] = ceiling / (peak > ceiling ? peak : ceiling);
+    }
+}
+
+// Written so NaN passes through unchanged, matching the SIMD min/max operand order
+inline float ClampCeiling(float x, float ceiling) {
+    x = x < -ceiling ? -ceiling : x;
+    return x > ceiling ? ceiling : x;
+}
+
+// out[n][ch] = clamp(in[n][ch] * gains[n])
+void ApplyGainScalar(const float* in, const float* gains, size_t frames, uint32_t channels,
+                     float ceiling, float* out) {
+    for (size_t n = 0; n < frames; n++) {
+        const float g = gains[n];
+        for (uint32_t ch = 0; ch < channels; ch++) {
+            out[n * channels + ch] = ClampCeiling(in[n * channels + ch] * g, ceiling);
+        }
+    }
+}
+
+#if AUDIO_SIMD_X86
+
+// Mono and stereo get vector paths; other layouts are rare enough for the
+// scalar loop. Results match the scalar kernels for finite input.
+
+// ---- SSE2 ----
+
+AUDIO_TARGET_SSE2 void RequiredGainSse2(const float* in, size_t frames, uint32_t channels, float ceiling,
+                                        float* gains) {
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const __m128 ceil = _mm_set1_ps(ceiling);
+    size_t n = 0;
+    if (channels == 1) {
+        for (; n + 4 <= frames; n += 4) {
+            __m128 peak = _mm_and_ps(_mm_loadu_ps(in + n), absMask);
+            _mm_storeu_ps(gains + n, _mm_div_ps(ceil, _mm_max_ps(peak, ceil)));
+        }
+    } else if (channels == 2) {
+        for (; n + 2 <= frames; n += 2) {
+            __m128 v = _mm_and_ps(_mm_loadu_ps(in + n * 2), absMask);
+            // Max of each L/R pair, in both lanes of the pair
+            __m128 peak = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+            __m128 g = _mm_div_ps(ceil, _mm_max_ps(peak, ceil));
+            _mm_storel_pi(reinterpret_cast<__m64*>(gains + n), _mm_shuffle_ps(g, g, _MM_SHUFFLE(2, 0, 2, 0)));
+        }
+    }
+    RequiredGainScalar(in + n * channels, frames - n, channels, ceiling, gains + n);
+}
+
+AUDIO_TARGET_SSE2 void ApplyGainSse2(const float* in, const float* gains, size_t frames, uint32_t channels,
+                                     float ceiling, float* out) {
+    const __m128 lo = _mm_set1_ps(-ceiling);
+    const __m128 hi = _mm_set1_ps(ceiling);
+    size_t n = 0;
+    if (channels == 1) {
+        for (; n + 4 <= frames; n += 4) {
+            __m128 v = _mm_mul_ps(_mm_loadu_ps(in + n), _mm_loadu_ps(gains + n));
+            _mm_storeu_ps(out + n, _mm_min_ps(hi, _mm_max_ps(lo, v)));
+        }
+    } else if (channels == 2) {
+        for (; n + 2 <= frames; n += 2) {
+            __m128 g = _mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(gains + n)));
+            g = _mm_unpacklo_ps(g, g);  // g0 g0 g1 g1
+            __m128 v = _mm_mul_ps(_mm_loadu_ps(in + n * 2), g);
+            _mm_storeu_ps(out + n * 2, _mm_min_ps(hi, _mm_max_ps(lo, v)));
+        }
+    }
+    ApplyGainScalar(in + n * channels, gains + n, frames - n, channels, ceiling, out + n * channels);
+}
+
+// ---- AVX2 ----
+
+AUDIO_TARGET_AVX2 void RequiredGainAvx2(const float* in, size_t frames, uint32_t channels, float ceiling,
+                                        float* gains) {
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    const __m256 ceil = _mm256_set1_ps(ceiling);
+    size_t n = 0;
+    if (channels == 1) {
+        for (; n + 8 <= frames; n += 8) {
+            __m256 peak = _mm256_and_ps(_mm256_loadu_ps(in + n), absMask);
+            _mm256_storeu_ps(gains + n, _mm256_div_ps(ceil, _mm256_max_ps(peak, ceil)));
+        }
+    } else if (channels == 2) {
+        const __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+        for (; n + 4 <= frames; n += 4) {
+            __m256 v = _mm256_and_ps(_mm256_loadu_ps(in + n * 2), absMask);
+            __m256 peak = _mm256_max_ps(v, _mm256_permute_ps(v, _MM_SHUFFLE(2, 3, 0, 1)));
+            __m256 g = _mm256_div_ps(ceil, _mm256_max_ps(peak, ceil));
+            _mm_storeu_ps(gains + n, _mm256_castps256_ps128(_mm256_permutevar8x32_ps(g, even)));
+        }
+    }
+    RequiredGainScalar(in + n * channels, frames - n, channels, ceiling, gains + n);
+}
+
+AUDIO_TARGET_AVX2 void ApplyGainAvx2(const float* in, const float* gains, size_t frames, uint32_t channels,
+                                     float ceiling, float* out) {
+    const __m256 lo = _mm256_set1_ps(-ceiling);
+    const __m256 hi = _mm256_set1_ps(ceiling);
+    size_t n = 0;
+    if (channels == 1) {
+        for (; n + 8 <= frames; n += 8) {
+            __m256 v = _mm256_mul_ps(_mm256_loadu_ps(in + n), _mm256_loadu_ps(gains + n));
+            _mm256_storeu_ps(out + n, _mm256_min_ps(hi, _mm256_max_ps(lo, v)));
+        }
+    } else if (channels == 2) {
+        const __m256i pairs = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+        for (; n + 4 <= frames; n += 4) {
+            __m256 g = _mm256_permutevar8x32_ps(_mm256_castps128_ps256(_mm_loadu_ps(gains + n)), pairs);
+            __m256 v = _mm256_mul_ps(_mm256_loadu_ps(in + n * 2), g);
+            _mm256_storeu_ps(out + n * 2, _mm256_min_ps(hi, _mm256_max_ps(lo, v)));
+        }
+    }
+    ApplyGainScalar(in + n * channels, gains + n, frames - n, channels, ceiling, out + n * channels);
+}
+
+#endif // AUDIO_SIMD_X86
+
+struct LimiterKernels {
+    void (*requiredGain)(const float*, size_t, uint32_t, float, float*);
+    void (*applyGain)(const float*, const float*, size_t, uint32_t, float, float*);
+};
+
+LimiterKernels SelectLimiterKernels() {
+#if AUDIO_SIMD_X86
+    switch (DetectSimdLevel()) {
+    case SimdLevel::AVX2:
+        return { RequiredGainAvx2, ApplyGainAvx2 };
+    case SimdLevel::SSE2:
+        return { RequiredGainSse2, ApplyGainSse2 };
+    default:
+        break;
+    }
+#endif
+    return { RequiredGainScalar, ApplyGainScalar };
+}
+
+const LimiterKernels& Kernels() {
+    static const LimiterKernels kernels = SelectLimiterKernels();
+    return kernels;
+}
+
+} // namespace
+
+PeakLimiter::PeakLimiter()
+    : m_enabled(false)
+    , m_channels(0)
+    , m_lookahead(1)
+    , m_ceiling(1.0f)
+    , m_releaseCoefficient(1.0)
+    , m_minHead(0)
+    , m_minCount(0)
+    , m_frameIndex(0)
+    , m_boxPosition(0)
+    , m_boxSum(0.0)
+    , m_gain(1.0) {
+}
+
+bool PeakLimiter::Initialize(const LimiterSettings& settings, uint32_t sampleRate, uint32_t channels) {
+    m_enabled = false;
+    if (sampleRate == 0 || channels == 0) {
+        return false;
+    }
+    if (!settings.enabled) {
+        return true;
+    }
+
+    const float ceilingDb = (std::min)((std::max)(settings.ceilingDb, kMinCeilingDb), 0.0f);
+    const float attackMs = (std::min)((std::max)(settings.attackMs, 0.0f), kMaxAttackMs);
+    const float releaseMs = (std::min)((std::max)(settings.releaseMs, kMinReleaseMs), kMaxReleaseMs);
+
+    m_channels = channels;
+    m_ceiling = std::pow(10.0f, ceilingDb / 20.0f);
+    m_lookahead = (std::max)(1u, static_cast<uint32_t>(std::lround(attackMs * sampleRate / 1000.0f)));
+    m_releaseCoefficient = 1.0 - std::exp(-1000.0 / (static_cast<double>(releaseMs) * sampleRate));
+
+    m_minIndex.assign(m_lookahead, 0);
+    m_minValue.assign(m_lookahead, 1.0f);
+    m_boxHistory.assign(m_lookahead, 1.0f);
+    m_required.resize(kBlockFrames);
+    m_gains.resize(kBlockFrames);
+    m_scratch.resize((static_cast<size_t>(m_lookahead) - 1 + kBlockFrames) * channels);
+
+    m_enabled = true;
+    Reset();
+    return true;
+}
+
+void PeakLimiter::Reset() {
+    if (!m_enabled) {
+        return;
+    }
+    m_delay.assign(static_cast<size_t>(m_lookahead - 1) * m_channels, 0.0f);
+    m_minHead = 0;
+    m_minCount = 0;
+    m_frameIndex = 0;
+    std::fill(m_boxHistory.begin(), m_boxHistory.end(), 1.0f);
+    m_boxPosition = 0;
+    m_boxSum = m_lookahead;
+    m_gain = 1.0;
+}
+
+void PeakLimiter::Process(float* samples, size_t frames) {
+    if (!m_enabled || !samples) {
+        return;
+    }
+    for (size_t offset = 0; offset < frames; offset += kBlockFrames) {
+        ProcessBlock(samples + offset * m_channels, (std::min)(frames - offset, kBlockFrames));
+    }
+}
+
+void PeakLimiter::ProcessBlock(float* samples, size_t frames) {
+    const LimiterKernels& kernels = Kernels();
+    const size_t window = m_lookahead;
+    const size_t delaySamples = m_delay.size();
+
+    // 1. Gain each incoming frame needs on its own
+    kernels.requiredGain(samples, frames, m_channels, m_ceiling, m_required.data());
+
+    // 2. Envelope: sliding minimum over the look-ahead window, box-averaged
+    //    over the same window, then released exponentially. The box average
+    //    of window minima never exceeds the required gain of the frame that
+    //    leaves the delay line now, so the output stays under the ceiling.
+    for (size_t n = 0; n < frames; n++) {
+        const uint64_t index = m_frameIndex++;
+
+        while (m_minCount > 0 && m_minIndex[m_minHead] + window <= index) {
+            m_minHead = (m_minHead + 1 == window) ? 0 : m_minHead + 1;
+            m_minCount--;
+        }
+        const float required = m_required[n];
+        while (m_minCount > 0 && m_minValue[(m_minHead + m_minCount - 1) % window] >= required) {
+            m_minCount--;
+        }
+        const size_t slot = (m_minHead + m_minCount) % window;
+        m_minIndex[slot] = index;
+        m_minValue[slot] = required;
+        m_minCount++;
+
+        const float windowMin = m_minValue[m_minHead];
+        m_boxSum += static_cast<double>(windowMin) - m_boxHistory[m_boxPosition];
+        m_boxHistory[m_boxPosition] = windowMin;
+        if (++m_boxPosition == window) {
+            // Re-sum once per window so rounding can't accumulate
+            m_boxPosition = 0;
+            m_boxSum = 0.0;
+            for (float value : m_boxHistory) {
+                m_boxSum += value;
+            }
+        }
+
+        const double target = m_boxSum / static_cast<double>(window);
+        if (target < m_gain) {
+            m_gain = target;
+        } else {
+            m_gain += (target - m_gain) * m_releaseCoefficient;
+        }
+        m_gains[n] = static_cast<float>(m_gain);
+    }
+
+    // 3. Delay the audio by window - 1 frames and apply the gain
+    if (delaySamples > 0) {
+        std::memcpy(m_scratch.data(), m_delay.data(), delaySamples * sizeof(float));
+    }
+    std::memcpy(m_scratch.data() + delaySamples, samples, frames * m_channels * sizeof(float));
+    kernels.applyGain(m_scratch.data(), m_gains.data(), frames, m_channels, m_ceiling, samples);
+    if (delaySamples > 0) {
+        std::memcpy(m_delay.data(), m_scratch.data() + frames * m_channels, delaySamples * sizeof(float));
+    }
+}
@@ -0,0 +1,423 @@
+#include "Resampler.h"
+#include "CpuFeatures.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Rational ratios up to this many output phases get an exact bank
+constexpr uint32_t kMaxRationalPhases = 1024;
+
+// Phase resolution of the blended bank used for arbitrary ratios
+constexpr uint32_t kInterpolatedPhaseBits = 8;
+constexpr uint32_t kInterpolatedPhases = 1u << kInterpolatedPhaseBits;
+constexpr uint32_t kFractionBits = 32;
+constexpr uint64_t kFractionOne = 1ull << kFractionBits;
+
+struct QualityParams {
+    uint32_t taps;         // Taps at unity ratio (scaled up when downsampling)
+    double attenuationDb;  // Stopband target, sets the Kaiser beta
+};
+
+QualityParams GetQualityParams(ResamplerQuality quality) {
+    switch (quality) {
+    case ResamplerQuality::Low:  return { 16, 60.0 };
+    case ResamplerQuality::High: return { 96, 110.0 };
+    default:                     return { 48, 90.0 };
+    }
+}
+
+uint32_t Gcd(uint32_t a, uint32_t b) {
+    while (b != 0) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Zeroth-order modified Bessel function of the first kind (series expansion)
+double BesselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    const double q = x * x / 4.0;
+    for (int k = 1; k < 64; k++) {
+        term *= q / (static_cast<double>(k) * k);
+        sum += term;
+        if (term < sum * 1e-17) {
+            break;
+        }
+    }
+    return sum;
+}
+
+double KaiserBeta(double attenuationDb) {
+    if (attenuationDb > 50.0) {
+        return 0.1102 * (attenuationDb - 8.7);
+    }
+    if (attenuationDb >= 21.0) {
+        return 0.5842 * std::pow(attenuationDb - 21.0, 0.4) + 0.07886 * (attenuationDb - 21.0);
+    }
+    return 0.0;
+}
+
+std::shared_ptr<ResamplerFilterBank> DesignFilterBank(uint32_t up, uint32_t down,
+                                                      ResamplerQuality quality, bool interpolated) {
+    const QualityParams params = GetQualityParams(quality);
+
+    // Downsampling: the filter must cut below the output Nyquist, which takes
+    // proportionally more input taps for the same transition band
+    const double ratio = static_cast<double>(up) / static_cast<double>(down);
+    const double bandwidth = (std::min)(1.0, ratio);
+    uint32_t taps = static_cast<uint32_t>(std::ceil(params.taps / bandwidth));
+    taps = (taps + 1) & ~1u;
+
+    // Transition width for this length and attenuation (Kaiser estimate), in
+    // cycles per input sample; place it just below the Nyquist of the slower side
+    const double transition = (params.attenuationDb - 7.95) / (14.36 * taps);
+    const double cutoff = (std::max)(0.05 * bandwidth, 0.5 * bandwidth - transition / 2.0);
+    const double beta = KaiserBeta(params.attenuationDb);
+    const double betaNorm = BesselI0(beta);
+
+    auto bank = std::make_shared<ResamplerFilterBank>();
+    bank->phases = interpolated ? kInterpolatedPhases : up;
+    bank->taps = (taps + 7) & ~7u;
+    bank->center = taps / 2 - 1;
+    bank->interpolated = interpolated;
+    bank->coefficients.assign(static_cast<size_t>(bank->phases + 1) * bank->taps, 0.0f);
+
+    const double halfLength = taps / 2.0;
+    for (uint32_t phase = 0; phase <= bank->phases; phase++) {
+        const double fraction = static_cast<double>(phase) / bank->phases;
+        float* row = &bank->coefficients[static_cast<size_t>(phase) * bank->taps];
+
+        double sum = 0.0;
+        std::vector<double> values(taps);
+        for (uint32_t k = 0; k < taps; k++) {
+            // Distance (in input frames) between tap k and the output position
+            const double d = static_cast<double>(k) - bank->center - fraction;
+            const double x = 2.0 * cutoff * d;
+            const double sinc = (std::fabs(x) < 1e-12) ? 1.0 : std::sin(kPi * x) / (kPi * x);
+            const double r = d / halfLength;
+            const double window = (std::fabs(r) >= 1.0) ? 0.0 : BesselI0(beta * std::sqrt(1.0 - r * r)) / betaNorm;
+            values[k] = sinc * window;
+            sum += values[k];
+        }
+
+        // Unity DC gain per row, so blending rows never modulates the level
+        for (uint32_t k = 0; k < taps; k++) {
+            row[k] = static_cast<float>(values[k] / sum);
+        }
+    }
+
+    return bank;
+}
+
+// ---- Dot product kernels (the inner loop) ----
+
+float DotScalar(const float* x, const float* h, uint32_t taps) {
+    float sum = 0.0f;
+    for (uint32_t k = 0; k < taps; k++) {
+        sum += x[k] * h[k];
+    }
+    return sum;
+}
+
+#if AUDIO_SIMD_X86
+
+AUDIO_TARGET_SSE2 float DotSse2(const float* x, const float* h, uint32_t taps) {
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for (uint32_t k = 0; k < taps; k += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(x + k), _mm_loadu_ps(h + k)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(x + k + 4), _mm_loadu_ps(h + k + 4)));
+    }
+    __m128 acc = _mm_add_ps(acc0, acc1);
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 0x55));
+    return _mm_cvtss_f32(acc);
+}
+
+AUDIO_TARGET_AVX2 float DotAvx2(const float* x, const float* h, uint32_t taps) {
+    __m256 acc = _mm256_setzero_ps();
+    for (uint32_t k = 0; k < taps; k += 8) {
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(x + k), _mm256_loadu_ps(h + k)));
+    }
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+    return _mm_cvtss_f32(sum);
+}
+
+#endif
+
+using DotFunction = float (*)(const float*, const float*, uint32_t);
+
+// Taps are always a multiple of 8, so the SIMD loops need no tail
+DotFunction SelectDot() {
+#if AUDIO_SIMD_X86
+    switch (DetectSimdLevel()) {
+    case SimdLevel::AVX2: return DotAvx2;
+    case SimdLevel::SSE2: return DotSse2;
+    default: break;
+    }
+#endif
+    return DotScalar;
+}
+
+const DotFunction g_dot = SelectDot();
+
+} // namespace
+
+//=============================================================================
+// Filter bank cache
+//=============================================================================
+
+std::shared_ptr<const ResamplerFilterBank> Resampler::GetFilterBank(
+    uint32_t inputRate, uint32_t outputRate, ResamplerQuality quality, bool interpolated) {
+    if (inputRate == 0 || outputRate == 0) {
+        return nullptr;
+    }
+
+    const uint32_t g = Gcd(inputRate, outputRate);
+    const uint32_t up = outputRate / g;
+    const uint32_t down = inputRate / g;
+    if (!interpolated && up > kMaxRationalPhases) {
+        return nullptr;
+    }
+
+    using Key = std::tuple<uint32_t, uint32_t, int, bool>;
+    static std::mutex cacheMutex;
+    static std::map<Key, std::shared_ptr<const ResamplerFilterBank>> cache;
+
+    const Key key(up, down, static_cast<int>(quality), interpolated);
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto it = cache.find(key);
+    if (it != cache.end()) {
+        return it->second;
+    }
+
+    std::shared_ptr<const ResamplerFilterBank> bank = DesignFilterBank(up, down, quality, interpolated);
+    cache.emplace(key, bank);
+    return bank;
+}
+
+void Resampler::PrewarmFilterBanks(uint32_t outputRate, ResamplerQuality quality) {
+    static const uint32_t commonRates[] = { 8000, 16000, 22050, 24000, 32000, 44100, 48000, 96000 };
+    for (uint32_t rate : commonRates) {
+        if (rate != outputRate) {
+            GetFilterBank(rate, outputRate, quality, false);
+        }
+        // Drift compensation runs every source through the blended bank
+        GetFilterBank(rate, outputRate, quality, true);
+    }
+}
+
+//=============================================================================
+// Resampler
+//=============================================================================
+
+Resampler::Resampler()
+    : m_inputRate(0)
+    , m_outputRate(0)
+    , m_channels(0)
+    , m_quality(ResamplerQuality::Medium)
+    , m_rateAdjust(1.0)
+    , m_position(0)
+    , m_phase(0)
+    , m_phaseDenominator(1)
+    , m_stepWhole(1)
+    , m_stepPhase(0)
+{
+}
+
+Resampler::~Resampler() {
+}
+
+bool Resampler::Initialize(uint32_t inputRate, uint32_t outputRate, uint32_t channels,
+                           ResamplerQuality quality) {
+    if (inputRate == 0 || outputRate == 0 || channels == 0) {
+        return false;
+    }
+
+    m_inputRate = inputRate;
+    m_outputRate = outputRate;
+    m_channels = channels;
+    m_quality = quality;
+    m_rateAdjust = 1.0;
+
+    m_rationalBank = GetFilterBank(inputRate, outputRate, quality, false);
+    m_bank = m_rationalBank ? m_rationalBank : GetFilterBank(inputRate, outputRate, quality, true);
+    if (!m_bank) {
+        return false;
+    }
+
+    Reset();
+    return true;
+}
+
+void Resampler::Reset() {
+    if (!m_bank) {
+        return;
+    }
+
+    // Pre-fill the look-behind half of the filter with silence so the first
+    // output lines up with the first input frame
+    m_history.assign(m_channels, std::vector<float>(m_bank->center, 0.0f));
+    m_position = m_bank->center;
+    m_phase = 0;
+    ConfigureStep();
+}
+
+void Resampler::SetRateAdjust(double factor) {
+    if (!m_bank || !(factor > 0.0) || factor == m_rateAdjust) {
+        return;
+    }
+    m_rateAdjust = factor;
+    ConfigureStep();
+}
+
+void Resampler::ConfigureStep() {
+    const bool exact = (m_rateAdjust == 1.0) && m_rationalBank;
+    std::shared_ptr<const ResamplerFilterBank> target =
+        exact ? m_rationalBank : GetFilterBank(m_inputRate, m_outputRate, m_quality, true);
+    if (!target) {
+        return;
+    }
+
+    // Carry the current fractional position over into the new representation
+    const uint64_t newDenominator = exact ? target->phases : kFractionOne;
+    if (newDenominator != m_phaseDenominator) {
+        const double fraction = static_cast<double>(m_phase) / static_cast<double>(m_phaseDenominator);
+        m_phase = (std::min)(static_cast<uint64_t>(fraction * newDenominator + 0.5), newDenominator - 1);
+        m_phaseDenominator = newDenominator;
+    }
+    m_bank = target;
+
+    if (exact) {
+        // Exact rational step: down / up input frames per output frame
+        const uint32_t g = Gcd(m_inputRate, m_outputRate);
+        const uint64_t up = m_outputRate / g;
+        const uint64_t down = m_inputRate / g;
+        m_stepWhole = down / up;
+        m_stepPhase = down % up;
+    } else {
+        const double step = static_cast<double>(m_inputRate) / m_outputRate * m_rateAdjust;
+        const uint64_t fixedStep = static_cast<uint64_t>(std::llround(step * static_cast<double>(kFractionOne)));
+        m_stepWhole = fixedStep >> kFractionBits;
+        m_stepPhase = fixedStep & (kFractionOne - 1);
+    }
+}
+
+uint32_t Resampler::GetLatencyFrames() const {
+    return m_bank ? m_bank->taps - m_bank->center : 0;
+}
+
+double Resampler::GetBufferedInputFrames() const {
+    if (!m_bank) {
+        return 0.0;
+    }
+    const double position = static_cast<double>(m_position) +
+                             static_cast<double>(m_phase) / static_cast<double>(m_phaseDenominator);
+    return static_cast<double>(m_history[0].size()) - position;
+}
+
+size_t Resampler::Process(const float* input, size_t inputFrames, std::vector<float>& output) {
+    if (!m_bank || !input) {
+        return 0;
+    }
+
+    // Append the new frames to the per-channel history (deinterleave)
+    const size_t oldFrames = m_history[0].size();
+    for (uint32_t ch = 0; ch < m_channels; ch++) {
+        std::vector<float>& history = m_history[ch];
+        history.resize(oldFrames + inputFrames);
+        float* dest = history.data() + oldFrames;
+        for (size_t i = 0; i < inputFrames; i++) {
+            dest[i] = input[i * m_channels + ch];
+        }
+    }
+
+    return RunFilter(&output, nullptr);
+}
+
+size_t Resampler::ProcessPlanar(const float* const* input, size_t inputFrames, std::vector<float>* output) {
+    if (!m_bank || !input || !output) {
+        return 0;
+    }
+
+    for (uint32_t ch = 0; ch < m_channels; ch++) {
+        m_history[ch].insert(m_history[ch].end(), input[ch], input[ch] + inputFrames);
+    }
+
+    return RunFilter(nullptr, output);
+}
+
+size_t Resampler::RunFilter(std::vector<float>* interleaved, std::vector<float>* planes) {
+    const size_t available = m_history[0].size();
+    const ResamplerFilterBank& bank = *m_bank;
+    const uint32_t taps = bank.taps;
+    size_t produced = 0;
+
+    // Upper bound on the outputs this call can produce, so the loop never reallocates
+    const double step = static_cast<double>(m_inputRate) / m_outputRate * m_rateAdjust;
+    const size_t maxOutput = static_cast<size_t>(available / step) + 2;
+    if (interleaved) {
+        interleaved->reserve(interleaved->size() + maxOutput * m_channels);
+    } else {
+        for (uint32_t ch = 0; ch < m_channels; ch++) {
+            planes[ch].reserve(planes[ch].size() + maxOutput);
+        }
+    }
+
+    while (m_position - bank.center + taps <= available) {
+        const size_t base = m_position - bank.center;
+
+        for (uint32_t ch = 0; ch < m_channels; ch++) {
+            const float* x = m_history[ch].data() + base;
+            float sample;
+            if (bank.interpolated) {
+                const uint64_t row = m_phase >> (kFractionBits - kInterpolatedPhaseBits);
+                const float mu = static_cast<float>(m_phase & ((1ull << (kFractionBits - kInterpolatedPhaseBits)) - 1)) *
+                                 (1.0f / static_cast<float>(1ull << (kFractionBits - kInterpolatedPhaseBits)));
+                const float* rowA = &bank.coefficients[row * taps];
+                const float a = g_dot(x, rowA, taps);
+                const float b = g_dot(x, rowA + taps, taps);
+                sample = a + (b - a) * mu;
+            } else {
+                sample = g_dot(x, &bank.coefficients[m_phase * taps], taps);
+            }
+
+            if (interleaved) {
+                interleaved->push_back(sample);
+            } else {
+                planes[ch].push_back(sample);
+            }
+        }
+        produced++;
+
+        // Advance by one output step (exact: whole frames + phase carry)
+        m_position += static_cast<size_t>(m_stepWhole);
+        m_phase += m_stepPhase;
+        if (m_phase >= m_phaseDenominator) {
+            m_phase -= m_phaseDenominator;
+            m_position++;
+        }
+    }
+
+    // Drop history the filter no longer needs, keeping the look-behind window
+    const size_t consumed = (std::min)(m_position - bank.center, available);
+    if (consumed > 0) {
+        for (uint32_t ch = 0; ch < m_channels; ch++) {
+            m_history[ch].erase(m_history[ch].begin(), m_history[ch].begin() + consumed);
+        }
+        m_position -= consumed;
+    }
+
+    return produced;
+}
@@ -0,0 +1,507 @@
+#include "SampleFormat.h"
+#include "CpuFeatures.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+constexpr float kInt16Scale = 32768.0f;
+constexpr float kInt24Scale = 8388608.0f;
+constexpr float kInt32Scale = 2147483648.0f;
+// Largest float below 2^31 - anything above would overflow the conversion
+constexpr float kInt32Max = 2147483520.0f;
+
+// Scratch block for the (de)interleave passes
+constexpr size_t kBlockSamples = 1024;
+
+constexpr float kMinus3dB = 0.70710678f;
+
+constexpr uint32_t kLeftPositions = kSpeakerFrontLeft | kSpeakerFrontLeftOfCenter | kSpeakerBackLeft | kSpeakerSideLeft;
+constexpr uint32_t kRightPositions = kSpeakerFrontRight | kSpeakerFrontRightOfCenter | kSpeakerBackRight | kSpeakerSideRight;
+constexpr uint32_t kCenterPositions = kSpeakerFrontCenter | kSpeakerBackCenter;
+constexpr uint32_t kFrontPositions = kSpeakerFrontLeft | kSpeakerFrontRight | kSpeakerFrontCenter |
+                                     kSpeakerFrontLeftOfCenter | kSpeakerFrontRightOfCenter;
+
+// ---- Scalar reference converters ----
+
+void Int16ToFloatScalar(const int16_t* src, size_t count, float* dest) {
+    for (size_t i = 0; i < count; i++) {
+        dest[i] = static_cast<float>(src[i]) * (1.0f / kInt16Scale);
+    }
+}
+
+void Int32ToFloatScalar(const int32_t* src, size_t count, float* dest) {
+    for (size_t i = 0; i < count; i++) {
+        dest[i] = static_cast<float>(src[i]) * (1.0f / kInt32Scale);
+    }
+}
+
+void FloatToInt16Scalar(const float* src, size_t count, int16_t* dest) {
+    for (size_t i = 0; i < count; i++) {
+        float x = src[i] * kInt16Scale;
+        x = x < -32768.0f ? -32768.0f : x;
+        x = x > 32767.0f ? 32767.0f : x;
+        dest[i] = static_cast<int16_t>(std::lrint(x));
+    }
+}
+
+void FloatToInt32Scalar(const float* src, size_t count, int32_t* dest) {
+    for (size_t i = 0; i < count; i++) {
+        float x = src[i] * kInt32Scale;
+        x = x < -kInt32Scale ? -kInt32Scale : x;
+        x = x > kInt32Max ? kInt32Max : x;
+        dest[i] = static_cast<int32_t>(std::lrint(x));
+    }
+}
+
+// 24-bit packed has no useful vector form; it is rare enough to stay scalar
+void Int24ToFloat(const uint8_t* src, size_t count, float* dest) {
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* p = src + i * 3;
+        int32_t value = static_cast<int32_t>((static_cast<uint32_t>(p[0]) << 8) |
+                                             (static_cast<uint32_t>(p[1]) << 16) |
+                                             (static_cast<uint32_t>(p[2]) << 24)) >> 8;
+        dest[i] = static_cast<float>(value) * (1.0f / kInt24Scale);
+    }
+}
+
+void FloatToInt24(const float* src, size_t count, uint8_t* dest) {
+    for (size_t i = 0; i < count; i++) {
+        float x = src[i] * kInt24Scale;
+        x = x < -8388608.0f ? -8388608.0f : x;
+        x = x > 8388607.0f ? 8388607.0f : x;
+        int32_t value = static_cast<int32_t>(std::lrint(x));
+        uint8_t* p = dest + i * 3;
+        p[0] = static_cast<uint8_t>(value);
+        p[1] = static_cast<uint8_t>(value >> 8);
+        p[2] = static_cast<uint8_t>(value >> 16);
+    }
+}
+
+#if AUDIO_SIMD_X86
+
+// ---- SSE2 ----
+
+AUDIO_TARGET_SSE2 void Int16ToFloatSse2(const int16_t* src, size_t count, float* dest) {
+    const __m128 scale = _mm_set1_ps(1.0f / kInt16Scale);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(dest + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(dest + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    Int16ToFloatScalar(src + i, count - i, dest + i);
+}
+
+AUDIO_TARGET_SSE2 void Int32ToFloatSse2(const int32_t* src, size_t count, float* dest) {
+    const __m128 scale = _mm_set1_ps(1.0f / kInt32Scale);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_ps(dest + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+    }
+    Int32ToFloatScalar(src + i, count - i, dest + i);
+}
+
+AUDIO_TARGET_SSE2 void FloatToInt16Sse2(const float* src, size_t count, int16_t* dest) {
+    const __m128 scale = _mm_set1_ps(kInt16Scale);
+    const __m128 lo = _mm_set1_ps(-32768.0f);
+    const __m128 hi = _mm_set1_ps(32767.0f);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128 a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), lo), hi);
+        __m128 b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale), lo), hi);
+        __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), packed);
+    }
+    FloatToInt16Scalar(src + i, count - i, dest + i);
+}
+
+AUDIO_TARGET_SSE2 void FloatToInt32Sse2(const float* src, size_t count, int32_t* dest) {
+    const __m128 scale = _mm_set1_ps(kInt32Scale);
+    const __m128 lo = _mm_set1_ps(-kInt32Scale);
+    const __m128 hi = _mm_set1_ps(kInt32Max);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 v = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), lo), hi);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_cvtps_epi32(v));
+    }
+    FloatToInt32Scalar(src + i, count - i, dest + i);
+}
+
+// ---- AVX2 ----
+
+AUDIO_TARGET_AVX2 void Int16ToFloatAvx2(const int16_t* src, size_t count, float* dest) {
+    const __m256 scale = _mm256_set1_ps(1.0f / kInt16Scale);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm256_storeu_ps(dest + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(v)), scale));
+    }
+    Int16ToFloatScalar(src + i, count - i, dest + i);
+}
+
+AUDIO_TARGET_AVX2 void Int32ToFloatAvx2(const int32_t* src, size_t count, float* dest) {
+    const __m256 scale = _mm256_set1_ps(1.0f / kInt32Scale);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_ps(dest + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+    Int32ToFloatScalar(src + i, count - i, dest + i);
+}
+
+AUDIO_TARGET_AVX2 void FloatToInt16Avx2(const float* src, size_t count, int16_t* dest) {
+    const __m256 scale = _mm256_set1_ps(kInt16Scale);
+    const __m256 lo = _mm256_set1_ps(-32768.0f);
+    const __m256 hi = _mm256_set1_ps(32767.0f);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256 a = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale), lo), hi);
+        __m256 b = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scale), lo), hi);
+        __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+        packed = _mm256_permute4x64_epi64(packed, 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), packed);
+    }
+    FloatToInt16Scalar(src + i, count - i, dest + i);
+}
+
+AUDIO_TARGET_AVX2 void FloatToInt32Avx2(const float* src, size_t count, int32_t* dest) {
+    const __m256 scale = _mm256_set1_ps(kInt32Scale);
+    const __m256 lo = _mm256_set1_ps(-kInt32Scale);
+    const __m256 hi = _mm256_set1_ps(kInt32Max);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale), lo), hi);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), _mm256_cvtps_epi32(v));
+    }
+    FloatToInt32Scalar(src + i, count - i, dest + i);
+}
+
+#endif // AUDIO_SIMD_X86
+
+struct ConvertKernels {
+    void (*int16ToFloat)(const int16_t*, size_t, float*);
+    void (*int32ToFloat)(const int32_t*, size_t, float*);
+    void (*floatToInt16)(const float*, size_t, int16_t*);
+    void (*floatToInt32)(const float*, size_t, int32_t*);
+};
+
+ConvertKernels SelectConvertKernels() {
+#if AUDIO_SIMD_X86
+    switch (DetectSimdLevel()) {
+    case SimdLevel::AVX2:
+        return { Int16ToFloatAvx2, Int32ToFloatAvx2, FloatToInt16Avx2, FloatToInt32Avx2 };
+    case SimdLevel::SSE2:
+        return { Int16ToFloatSse2, Int32ToFloatSse2, FloatToInt16Sse2, FloatToInt32Sse2 };
+    default:
+        break;
+    }
+#endif
+    return { Int16ToFloatScalar, Int32ToFloatScalar, FloatToInt16Scalar, FloatToInt32Scalar };
+}
+
+const ConvertKernels& Kernels() {
+    static const ConvertKernels kernels = SelectConvertKernels();
+    return kernels;
+}
+
+// Speaker position of each channel: mask bits are assigned to channels in
+// ascending order; channels beyond the mask get 0 (unknown)
+std::vector<uint32_t> ChannelPositions(uint32_t channels, uint32_t mask) {
+    if (mask == 0) {
+        mask = DefaultChannelMask(channels);
+    }
+    std::vector<uint32_t> positions(channels, 0);
+    uint32_t channel = 0;
+    for (uint32_t bit = 0; bit < 32 && channel < channels; bit++) {
+        if (mask & (1u << bit)) {
+            positions[channel++] = 1u << bit;
+        }
+    }
+    return positions;
+}
+
+int FindPosition(const std::vector<uint32_t>& positions, uint32_t position) {
+    for (size_t i = 0; i < positions.size(); i++) {
+        if (positions[i] == position) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+} // namespace
+
+uint32_t SampleTypeBytes(SampleType type) {
+    switch (type) {
+    case SampleType::Int16:   return 2;
+    case SampleType::Int24:   return 3;
+    case SampleType::Int32:   return 4;
+    case SampleType::Float32: return 4;
+    default:                  return 0;
+    }
+}
+
+uint32_t DefaultChannelMask(uint32_t channels) {
+    switch (channels) {
+    case 1: return kSpeakerFrontCenter;
+    case 2: return kSpeakerFrontLeft | kSpeakerFrontRight;
+    case 3: return kSpeakerFrontLeft | kSpeakerFrontRight | kSpeakerFrontCenter;
+    case 4: return kSpeakerFrontLeft | kSpeakerFrontRight | kSpeakerBackLeft | kSpeakerBackRight;
+    case 5: return kSpeakerFrontLeft | kSpeakerFrontRight | kSpeakerFrontCenter |
+                   kSpeakerBackLeft | kSpeakerBackRight;
+    case 6: return kSpeakerFrontLeft | kSpeakerFrontRight | kSpeakerFrontCenter | kSpeakerLowFrequency |
+                   kSpeakerBackLeft | kSpeakerBackRight;
+    case 7: return kSpeakerFrontLeft | kSpeakerFrontRight | kSpeakerFrontCenter | kSpeakerLowFrequency |
+                   kSpeakerBackCenter | kSpeakerSideLeft | kSpeakerSideRight;
+    case 8: return kSpeakerFrontLeft | kSpeakerFrontRight | kSpeakerFrontCenter | kSpeakerLowFrequency |
+                   kSpeakerBackLeft | kSpeakerBackRight | kSpeakerSideLeft | kSpeakerSideRight;
+    default: return 0;
+    }
+}
+
+void ConvertToFloat(const void* src, SampleType type, size_t count, float* dest) {
+    switch (type) {
+    case SampleType::Int16:
+        Kernels().int16ToFloat(static_cast<const int16_t*>(src), count, dest);
+        break;
+    case SampleType::Int24:
+        Int24ToFloat(static_cast<const uint8_t*>(src), count, dest);
+        break;
+    case SampleType::Int32:
+        Kernels().int32ToFloat(static_cast<const int32_t*>(src), count, dest);
+        break;
+    case SampleType::Float32:
+        memcpy(dest, src, count * sizeof(float));
+        break;
+    default:
+        memset(dest, 0, count * sizeof(float));
+        break;
+    }
+}
+
+void ConvertFromFloat(const float* src, size_t count, SampleType type, void* dest) {
+    switch (type) {
+    case SampleType::Int16:
+        Kernels().floatToInt16(src, count, static_cast<int16_t*>(dest));
+        break;
+    case SampleType::Int24:
+        FloatToInt24(src, count, static_cast<uint8_t*>(dest));
+        break;
+    case SampleType::Int32:
+        Kernels().floatToInt32(src, count, static_cast<int32_t*>(dest));
+        break;
+    case SampleType::Float32:
+        memcpy(dest, src, count * sizeof(float));
+        break;
+    default:
+        break;
+    }
+}
+
+void DeinterleaveToFloat(const void* src, SampleType type, uint32_t channels, uint32_t stride,
+                         size_t frames, float* const* planes) {
+    const uint32_t sampleBytes = SampleTypeBytes(type);
+    if (channels == 0 || channels > kBlockSamples || sampleBytes == 0) {
+        return;
+    }
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(src);
+    const bool packed = (stride == channels * sampleBytes);
+    const size_t blockFrames = kBlockSamples / channels;
+    float scratch[kBlockSamples];
+
+    for (size_t frame = 0; frame < frames; frame += blockFrames) {
+        const size_t count = (std::min)(blockFrames, frames - frame);
+
+        // Vectorized conversion into an interleaved float block...
+        if (packed) {
+            ConvertToFloat(bytes + frame * stride, type, count * channels, scratch);
+        } else {
+            for (size_t f = 0; f < count; f++) {
+                ConvertToFloat(bytes + (frame + f) * stride, type, channels, scratch + f * channels);
+            }
+        }
+
+        // ...then scatter to the planes
+        for (uint32_t ch = 0; ch < channels; ch++) {
+            float* plane = planes[ch] + frame;
+            for (size_t f = 0; f < count; f++) {
+                plane[f] = scratch[f * channels + ch];
+            }
+        }
+    }
+}
+
+void InterleaveFromFloat(const float* const* planes, uint32_t channels, size_t frames,
+                         SampleType type, void* dest) {
+    const uint32_t sampleBytes = SampleTypeBytes(type);
+    if (channels == 0 || channels > kBlockSamples || sampleBytes == 0) {
+        return;
+    }
+
+    uint8_t* bytes = static_cast<uint8_t*>(dest);
+    const size_t blockFrames = kBlockSamples / channels;
+    float scratch[kBlockSamples];
+
+    for (size_t frame = 0; frame < frames; frame += blockFrames) {
+        const size_t count = (std::min)(blockFrames, frames - frame);
+        for (uint32_t ch = 0; ch < channels; ch++) {
+            const float* plane = planes[ch] + frame;
+            for (size_t f = 0; f < count; f++) {
+                scratch[f * channels + ch] = plane[f];
+            }
+        }
+        ConvertFromFloat(scratch, count * channels, type, bytes + frame * channels * sampleBytes);
+    }
+}
+
+//=============================================================================
+// ChannelMatrix
+//=============================================================================
+
+ChannelMatrix::ChannelMatrix()
+    : m_sourceChannels(0)
+    , m_destChannels(0)
+    , m_identity(true)
+{
+}
+
+void ChannelMatrix::Build(uint32_t sourceChannels, uint32_t sourceMask, uint32_t destChannels, uint32_t destMask) {
+    m_sourceChannels = sourceChannels;
+    m_destChannels = destChannels;
+    m_gains.assign(static_cast<size_t>(sourceChannels) * destChannels, 0.0f);
+
+    const std::vector<uint32_t> sourcePos = ChannelPositions(sourceChannels, sourceMask);
+    const std::vector<uint32_t> destPos = ChannelPositions(destChannels, destMask);
+    auto gain = [this](uint32_t dest, uint32_t source) -> float& {
+        return m_gains[dest * m_sourceChannels + source];
+    };
+
+    if (sourceChannels == 1) {
+        // Mono (typically a mic) goes to every front channel at full level
+        bool routed = false;
+        for (uint32_t d = 0; d < destChannels; d++) {
+            if ((destPos[d] & kFrontPositions) || (destPos[d] == 0 && d < 2)) {
+                gain(d, 0) = 1.0f;
+                routed = true;
+            }
+        }
+        if (!routed) {
+            for (uint32_t d = 0; d < destChannels; d++) {
+                gain(d, 0) = 1.0f;
+            }
+        }
+    } else {
+        const int destLeft = FindPosition(destPos, kSpeakerFrontLeft);
+        const int destRight = FindPosition(destPos, kSpeakerFrontRight);
+        const int destCenter = FindPosition(destPos, kSpeakerFrontCenter);
+
+        for (uint32_t s = 0; s < sourceChannels; s++) {
+            const uint32_t position = sourcePos[s];
+
+            // Same speaker on both sides
+            const int direct = position ? FindPosition(destPos, position) : -1;
+            if (direct >= 0) {
+                gain(direct, s) += 1.0f;
+                continue;
+            }
+
+            // Unknown position: keep channel order
+            if (position == 0) {
+                if (s < destChannels) {
+                    gain(s, s) += 1.0f;
+                }
+                continue;
+            }
+
+            if (position == kSpeakerLowFrequency) {
+                continue;  // Not reproduced by a full-range layout
+            }
+
+            const float weight = (position & kFrontPositions) ? 1.0f : kMinus3dB;
+
+            if (position & kCenterPositions) {
+                if (destLeft >= 0 && destRight >= 0) {
+                    gain(destLeft, s) += kMinus3dB;
+                    gain(destRight, s) += kMinus3dB;
+                } else if (destCenter >= 0) {
+                    gain(destCenter, s) += 1.0f;
+                }
+                continue;
+            }
+
+            // Surrounds prefer the other surround pair before folding forward
+            int target = -1;
+            if (position == kSpeakerSideLeft) target = FindPosition(destPos, kSpeakerBackLeft);
+            if (position == kSpeakerBackLeft) target = FindPosition(destPos, kSpeakerSideLeft);
+            if (position == kSpeakerSideRight) target = FindPosition(destPos, kSpeakerBackRight);
+            if (position == kSpeakerBackRight) target = FindPosition(destPos, kSpeakerSideRight);
+            if (target >= 0) {
+                gain(target, s) += 1.0f;
+                continue;
+            }
+
+            const int side = (position & kLeftPositions) ? destLeft : (position & kRightPositions) ? destRight : -1;
+            if (side >= 0) {
+                gain(side, s) += weight;
+            } else if (destCenter >= 0) {
+                gain(destCenter, s) += weight;
+            }
+        }
+
+        // Keep every output row's worst-case sum at or below unity
+        for (uint32_t d = 0; d < destChannels; d++) {
+            float sum = 0.0f;
+            for (uint32_t s = 0; s < sourceChannels; s++) {
+                sum += gain(d, s);
+            }
+            if (sum > 1.0f) {
+                for (uint32_t s = 0; s < sourceChannels; s++) {
+                    gain(d, s) /= sum;
+                }
+            }
+        }
+    }
+
+    m_identity = (sourceChannels == destChannels);
+    for (uint32_t d = 0; d < destChannels && m_identity; d++) {
+        for (uint32_t s = 0; s < sourceChannels; s++) {
+            if (gain(d, s) != (d == s ? 1.0f : 0.0f)) {
+                m_identity = false;
+                break;
+            }
+        }
+    }
+}
+
+void ChannelMatrix::Apply(const float* const* in, float* const* out, size_t frames) const {
+    for (uint32_t d = 0; d < m_destChannels; d++) {
+        float* dest = out[d];
+        bool written = false;
+        for (uint32_t s = 0; s < m_sourceChannels; s++) {
+            const float g = Gain(d, s);
+            if (g == 0.0f) {
+                continue;
+            }
+            const float* src = in[s];
+            if (!written) {
+                if (g == 1.0f) {
+                    memcpy(dest, src, frames * sizeof(float));
+                } else {
+                    for (size_t i = 0; i < frames; i++) dest[i] = src[i] * g;
+                }
+                written = true;
+            } else {
+                for (size_t i = 0; i < frames; i++) dest[i] += src[i] * g;
+            }
+        }
+        if (!written) {
+            memset(dest, 0, frames * sizeof(float));
+        }
+    }
+}
@@ -0,0 +1,221 @@
+#include "VoiceActivityDetector.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Speech band for the flatness measure, Hz
+constexpr float kBandLowHz = 250.0f;
+constexpr float kBandHighHz = 3500.0f;
+
+// Decimation blocks converted per pass, bounds the scratch buffer
+constexpr size_t kChunkBlocks = 256;
+
+// Added to every power so silence and log2 stay finite
+constexpr float kPowerFloor = 1e-10f;
+
+constexpr float kPi = 3.14159265358979f;
+
+} // namespace
+
+VoiceActivityDetector::VoiceActivityDetector()
+    : m_kernels(ActiveVadKernels())
+    , m_decimation(1)
+    , m_analysisRate(0.0f)
+    , m_bandBegin(0)
+    , m_bandEnd(0)
+    , m_floorRisePerFrame(0.0f)
+    , m_inputCount(0)
+    , m_sampleCount(0)
+    , m_noiseFloorDb(0.0f)
+    , m_haveFloor(false)
+    , m_run(0)
+    , m_hangover(0)
+{
+}
+
+bool VoiceActivityDetector::Initialize(const VadSettings& settings, const SampleFormat& format) {
+    m_format = SampleFormat();
+    if (!format.IsValid() || format.blockAlign < format.channels * SampleTypeBytes(format.type)) {
+        return false;
+    }
+
+    m_settings = settings;
+    m_settings.minRunFrames = (std::max)(1, settings.minRunFrames);
+    m_settings.hangoverFrames = (std::max)(0, settings.hangoverFrames);
+    m_format = format;
+
+    m_decimation = (std::max)(1u, (format.sampleRate + kTargetRate / 2) / kTargetRate);
+    m_analysisRate = (float)format.sampleRate / (float)m_decimation;
+    m_bandBegin = (size_t)std::ceil(kBandLowHz * kFrameSize / m_analysisRate);
+    m_bandEnd = (std::min)(kFrameSize / 2, (size_t)(kBandHighHz * kFrameSize / m_analysisRate) + 1);
+    if (m_bandBegin >= m_bandEnd) {
+        m_bandBegin = 1;
+        m_bandEnd = kFrameSize / 2;
+    }
+    m_floorRisePerFrame = m_settings.floorRiseDbPerSec * (float)kFrameSize / m_analysisRate;
+
+    m_input.assign((size_t)m_decimation * format.channels * kChunkBlocks, 0.0f);
+    m_samples.assign(kFrameSize, 0.0f);
+
+    m_window.resize(kFrameSize);
+    for (size_t i = 0; i < kFrameSize; i++) {
+        m_window[i] = 0.5f - 0.5f * std::cos(2.0f * kPi * (float)i / (float)kFrameSize);
+    }
+    m_cos.resize(kFrameSize / 2);
+    m_sin.resize(kFrameSize / 2);
+    for (size_t k = 0; k < kFrameSize / 2; k++) {
+        m_cos[k] = std::cos(2.0f * kPi * (float)k / (float)kFrameSize);
+        m_sin[k] = std::sin(2.0f * kPi * (float)k / (float)kFrameSize);
+    }
+    m_bitReverse.resize(kFrameSize);
+    for (size_t i = 0; i < kFrameSize; i++) {
+        size_t reversed = 0;
+        for (size_t bit = 1, mirror = kFrameSize / 2; bit < kFrameSize; bit <<= 1, mirror >>= 1) {
+            if (i & bit) reversed |= mirror;
+        }
+        m_bitReverse[i] = (uint16_t)reversed;
+    }
+    m_re.assign(kFrameSize, 0.0f);
+    m_im.assign(kFrameSize, 0.0f);
+
+    Reset();
+    return true;
+}
+
+void VoiceActivityDetector::Reset() {
+    m_inputCount = 0;
+    m_sampleCount = 0;
+    m_noiseFloorDb = 0.0f;
+    m_haveFloor = false;
+    m_run = 0;
+    m_hangover = 0;
+    m_counts = Counts();
+}
+
+VoiceActivityDetector::Counts VoiceActivityDetector::TakeCounts() {
+    const Counts counts = m_counts;
+    m_counts = Counts();
+    return counts;
+}
+
+void VoiceActivityDetector::Process(const void* data, size_t frames, std::vector<Features>* features) {
+    if (!IsInitialized() || !data) return;
+
+    const uint32_t channels = m_format.channels;
+    const uint32_t packedBytes = channels * SampleTypeBytes(m_format.type);
+    const size_t width = (size_t)m_decimation * channels;
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+
+    while (frames > 0) {
+        // Append what fits after the carried-over samples
+        const size_t take = (std::min)(frames, (m_input.size() - m_inputCount) / channels);
+        float* dest = m_input.data() + m_inputCount;
+        if (m_format.blockAlign == packedBytes) {
+            ConvertToFloat(src, m_format.type, take * channels, dest);
+        } else {
+            for (size_t f = 0; f < take; f++) {
+                ConvertToFloat(src + f * m_format.blockAlign, m_format.type, channels, dest + f * channels);
+            }
+        }
+        m_inputCount += take * channels;
+        src += take * m_format.blockAlign;
+        frames -= take;
+
+        // Downmix + decimate whole blocks, analysing each full frame
+        const size_t blocks = m_inputCount / width;
+        size_t done = 0;
+        while (done < blocks) {
+            const size_t n = (std::min)(blocks - done, kFrameSize - m_sampleCount);
+            m_kernels.boxDecimate(m_input.data() + done * width, n, width, m_samples.data() + m_sampleCount);
+            m_sampleCount += n;
+            done += n;
+            if (m_sampleCount == kFrameSize) {
+                AnalyzeFrame(m_samples.data(), features);
+                m_sampleCount = 0;
+            }
+        }
+
+        const size_t used = blocks * width;
+        if (used > 0 && used < m_inputCount) {
+            memmove(m_input.data(), m_input.data() + used, (m_inputCount - used) * sizeof(float));
+        }
+        m_inputCount -= used;
+    }
+}
+
+void VoiceActivityDetector::AnalyzeFrame(const float* frame, std::vector<Features>* features) {
+    Features f;
+
+    const float meanSquare = m_kernels.sumSquares(frame, kFrameSize) / (float)kFrameSize;
+    f.energyDb = 10.0f * std::log10(meanSquare + kPowerFloor);
+    f.zcr = (float)m_kernels.zeroCrossings(frame, kFrameSize) / (float)(kFrameSize - 1);
+
+    for (size_t i = 0; i < kFrameSize; i++) {
+        m_re[m_bitReverse[i]] = frame[i] * m_window[i];
+        m_im[i] = 0.0f;
+    }
+    Fft();
+
+    const size_t bins = m_bandEnd - m_bandBegin;
+    float sumPower = 0.0f;
+    float sumLog2 = 0.0f;
+    m_kernels.spectrumStats(m_re.data() + m_bandBegin, m_im.data() + m_bandBegin, bins, kPowerFloor,
+                            &sumPower, &sumLog2);
+    f.flatness = std::exp2(sumLog2 / (float)bins) / (sumPower / (float)bins);
+
+    // Compare against the floor before this frame moves it
+    if (!m_haveFloor) {
+        m_noiseFloorDb = f.energyDb;
+        m_haveFloor = true;
+    }
+    f.noiseFloorDb = m_noiseFloorDb;
+
+    const bool candidate = f.energyDb >= m_settings.minEnergyDb &&
+                           f.energyDb >= m_noiseFloorDb + m_settings.marginDb &&
+                           f.flatness >= m_settings.minFlatness &&
+                           f.flatness <= m_settings.maxFlatness &&
+                           f.zcr <= m_settings.maxZeroCrossings;
+
+    m_noiseFloorDb = (std::min)(f.energyDb, m_noiseFloorDb + m_floorRisePerFrame);
+
+    m_run = candidate ? m_run + 1 : 0;
+    if (m_run >= m_settings.minRunFrames) {
+        f.speech = true;
+        m_hangover = m_settings.hangoverFrames;
+    } else if (m_hangover > 0) {
+        f.speech = true;
+        m_hangover--;
+    } else {
+        f.speech = false;
+    }
+
+    m_counts.frames++;
+    if (f.speech) m_counts.speechFrames++;
+    if (features) features->push_back(f);
+}
+
+// In-place radix-2 FFT of m_re / m_im, input already in bit-reversed order
+void VoiceActivityDetector::Fft() {
+    float* re = m_re.data();
+    float* im = m_im.data();
+    for (size_t length = 2; length <= kFrameSize; length <<= 1) {
+        const size_t half = length / 2;
+        const size_t step = kFrameSize / length;
+        for (size_t start = 0; start < kFrameSize; start += length) {
+            for (size_t k = 0; k < half; k++) {
+                const float wr = m_cos[k * step];
+                const float wi = -m_sin[k * step];
+                const size_t a = start + k;
+                const size_t b = a + half;
+                const float tr = re[b] * wr - im[b] * wi;
+                const float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
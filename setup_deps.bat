@@ -14,12 +14,11 @@ if not exist "%AC_DIR%\include\AudioCapture.h" (
     exit /b 1
 )
 
-echo Patching AudioCapture with stub headers...
+echo Patching AudioCapture with stub header...
 
 copy /Y "%SCRIPT_DIR%include\OpusEncoder.h" "%AC_DIR%\include\OpusEncoder.h"
-copy /Y "%SCRIPT_DIR%include\FlacEncoder.h" "%AC_DIR%\include\FlacEncoder.h"
 
-echo Done. AudioCapture patched for build without Opus/FLAC dependencies.
+echo Done. AudioCapture patched for build without Opus dependency.
 echo.
 echo Now you can build:
 echo   mkdir build ^& cd build
@@ -21,6 +21,21 @@ AudioFormat GetAudioFormatFromConfig() {
     return AudioFormat::MP3;
 }
 
+LimiterSettings GetLimiterSettingsFromConfig(const AgentConfig& config) {
+    LimiterSettings settings;
+    settings.enabled = config.limiterEnabled;
+    settings.ceilingDb = config.limiterCeilingDb;
+    settings.attackMs = static_cast<float>(config.limiterAttackMs);
+    settings.releaseMs = static_cast<float>(config.limiterReleaseMs);
+    return settings;
+}
+
+// The sinks' quality knob: bitrate for the lossy formats, level for FLAC
+UINT32 GetEncoderQualityFromConfig(const AgentConfig& config, AudioFormat format) {
+    if (format == AudioFormat::FLAC) return static_cast<UINT32>(config.flacCompressionLevel);
+    return config.mp3Bitrate;
+}
+
 std::wstring GetFileExtension(AudioFormat format) {
     switch (format) {
         case AudioFormat::WAV:  return L".wav";
@@ -82,7 +97,6 @@ MicInfo GetDefaultMicrophone() {
 
 // ============================================================
 // Bug 3 fix: CheckProcessRealAudio delegates to GetProcessPeakLevel
-// (no more cached device dependency)
 // ============================================================
 bool AudioSessionMonitor::CheckProcessRealAudio(DWORD processId, float threshold) {
     return GetProcessPeakLevel(processId) > threshold;
@@ -93,26 +107,12 @@ bool AudioSessionMonitor::CheckProcessRealAudio(DWORD processId, float threshold
 // Legacy version (creates its own snapshot for IsChildOfProcess)
 // ============================================================
 float AudioSessionMonitor::GetProcessPeakLevel(DWORD processId) {
-    if (!EnsureEnumeratorInitialized()) return 0.0f;
-
-    ComPtr<IMMDeviceCollection> deviceCollection;
-    if (FAILED(m_deviceEnumerator->EnumAudioEndpoints(eRender, DEVICE_STATE_ACTIVE, &deviceCollection)) || !deviceCollection)
-        return 0.0f;
-
-    UINT deviceCount = 0;
-    deviceCollection->GetCount(&deviceCount);
+    const auto& devices = m_deviceCache.GetDevices();
     float maxPeak = 0.0f;
 
-    for (UINT d = 0; d < deviceCount; d++) {
-        ComPtr<IMMDevice> device;
-        if (FAILED(deviceCollection->Item(d, &device)) || !device) continue;
-
-        ComPtr<IAudioSessionManager2> sessionManager;
-        if (FAILED(device->Activate(__uuidof(IAudioSessionManager2), CLSCTX_ALL,
-            nullptr, reinterpret_cast<void**>(sessionManager.GetAddressOf()))) || !sessionManager) continue;
-
+    for (size_t d = 0; d < devices.size(); d++) {
         ComPtr<IAudioSessionEnumerator> sessionEnumerator;
-        if (FAILED(sessionManager->GetSessionEnumerator(&sessionEnumerator)) || !sessionEnumerator) continue;
+        if (!OpenSessionEnumerator(devices[d], sessionEnumerator)) continue;
 
         int sessionCount = 0;
         sessionEnumerator->GetCount(&sessionCount);
@@ -145,83 +145,30 @@ float AudioSessionMonitor::GetProcessPeakLevel(DWORD processId) {
 }
 
 // ============================================================
-// Bug 4: Snapshot-based GetProcessPeakLevel (hot path)
+// Single-pass scan: one device/session walk per poll cycle
+// instead of one per pid and per question
 // ============================================================
-float AudioSessionMonitor::GetProcessPeakLevel(DWORD processId, const ProcessSnapshot& snap) {
-    if (!EnsureEnumeratorInitialized()) return 0.0f;
-
-    ComPtr<IMMDeviceCollection> deviceCollection;
-    if (FAILED(m_deviceEnumerator->EnumAudioEndpoints(eRender, DEVICE_STATE_ACTIVE, &deviceCollection)) || !deviceCollection)
-        return 0.0f;
-
-    UINT deviceCount = 0;
-    deviceCollection->GetCount(&deviceCount);
-    float maxPeak = 0.0f;
-
-    for (UINT d = 0; d < deviceCount; d++) {
-        ComPtr<IMMDevice> device;
-        if (FAILED(deviceCollection->Item(d, &device)) || !device) continue;
-
-        ComPtr<IAudioSessionManager2> sessionManager;
-        if (FAILED(device->Activate(__uuidof(IAudioSessionManager2), CLSCTX_ALL,
-            nullptr, reinterpret_cast<void**>(sessionManager.GetAddressOf()))) || !sessionManager) continue;
-
-        ComPtr<IAudioSessionEnumerator> sessionEnumerator;
-        if (FAILED(sessionManager->GetSessionEnumerator(&sessionEnumerator)) || !sessionEnumerator) continue;
-
-        int sessionCount = 0;
-        sessionEnumerator->GetCount(&sessionCount);
-
-        for (int i = 0; i < sessionCount; i++) {
-            ComPtr<IAudioSessionControl> sessionControl;
-            if (FAILED(sessionEnumerator->GetSession(i, &sessionControl)) || !sessionControl) continue;
-
-            ComPtr<IAudioSessionControl2> sessionControl2;
-            if (SUCCEEDED(sessionControl.As(&sessionControl2))) {
-                DWORD sessionProcessId = 0;
-                if (SUCCEEDED(sessionControl2->GetProcessId(&sessionProcessId))) {
-                    bool isMatch = (sessionProcessId == processId);
-                    if (!isMatch && sessionProcessId != 0)
-                        isMatch = IsChildOfProcess(sessionProcessId, processId, snap);
-
-                    if (isMatch) {
-                        ComPtr<IAudioMeterInformation> meter;
-                        if (SUCCEEDED(sessionControl.As(&meter))) {
-                            float peakLevel = 0.0f;
-                            if (SUCCEEDED(meter->GetPeakValue(&peakLevel)) && peakLevel > maxPeak)
-                                maxPeak = peakLevel;
-                        }
-                    }
-                }
-            }
-        }
+const SessionActivityTable& AudioSessionMonitor::ScanAllSessions(const ProcessSnapshot& snap) {
+    m_samples.clear();
+    if (!CollectSessions(m_samples)) {
+        m_sessionTable.Clear();
+        return m_sessionTable;
     }
-    return maxPeak;
-}
-
-// ============================================================
-// IsSessionActive — legacy (no snapshot)
-// ============================================================
-bool AudioSessionMonitor::IsSessionActive(DWORD processId) {
-    if (!EnsureEnumeratorInitialized()) return false;
 
-    ComPtr<IMMDeviceCollection> deviceCollection;
-    if (FAILED(m_deviceEnumerator->EnumAudioEndpoints(eRender, DEVICE_STATE_ACTIVE, &deviceCollection)) || !deviceCollection)
-        return false;
-
-    UINT deviceCount = 0;
-    deviceCollection->GetCount(&deviceCount);
+    m_sessionTable.Build(m_samples, [&snap](uint32_t pid) {
+        return static_cast<uint32_t>(GetParentProcessId(pid, snap));
+    });
+    return m_sessionTable;
+}
 
-    for (UINT d = 0; d < deviceCount; d++) {
-        ComPtr<IMMDevice> device;
-        if (FAILED(deviceCollection->Item(d, &device)) || !device) continue;
+bool AudioSessionMonitor::CollectSessions(std::vector<SessionSample>& sessions) {
+    if (!m_deviceCache.Initialize()) return false;
 
-        ComPtr<IAudioSessionManager2> sessionManager;
-        if (FAILED(device->Activate(__uuidof(IAudioSessionManager2), CLSCTX_ALL,
-            nullptr, reinterpret_cast<void**>(sessionManager.GetAddressOf()))) || !sessionManager) continue;
+    const auto& devices = m_deviceCache.GetDevices();
 
+    for (size_t d = 0; d < devices.size(); d++) {
         ComPtr<IAudioSessionEnumerator> sessionEnumerator;
-        if (FAILED(sessionManager->GetSessionEnumerator(&sessionEnumerator)) || !sessionEnumerator) continue;
+        if (!OpenSessionEnumerator(devices[d], sessionEnumerator)) continue;
 
         int sessionCount = 0;
         sessionEnumerator->GetCount(&sessionCount);
@@ -236,45 +183,37 @@ bool AudioSessionMonitor::IsSessionActive(DWORD processId) {
             DWORD sessionPid = 0;
             if (!SUCCEEDED(sessionControl2->GetProcessId(&sessionPid)) || sessionPid == 0) continue;
 
-            bool isMatch = (sessionPid == processId);
-            if (!isMatch && sessionPid != 0)
-                isMatch = IsChildOfProcess(sessionPid, processId);
+            SessionSample sample = { static_cast<uint32_t>(sessionPid), 0.0f, false };
 
-            if (isMatch) {
-                AudioSessionState state;
-                if (SUCCEEDED(sessionControl->GetState(&state))) {
-                    if (state == AudioSessionStateActive)
-                        return true;
-                }
+            ComPtr<IAudioMeterInformation> meter;
+            if (SUCCEEDED(sessionControl.As(&meter))) {
+                float peakLevel = 0.0f;
+                if (SUCCEEDED(meter->GetPeakValue(&peakLevel))) sample.peak = peakLevel;
             }
+
+            AudioSessionState state;
+            if (SUCCEEDED(sessionControl->GetState(&state)))
+                sample.active = (state == AudioSessionStateActive);
+
+            sessions.push_back(sample);
         }
     }
-    return false;
+    return true;
+}
+
+float AudioSessionMonitor::GetProcessPeakLevel(DWORD processId, const ProcessSnapshot& snap) {
+    return ScanAllSessions(snap).Find(processId).peak;
 }
 
 // ============================================================
-// Bug 4: Snapshot-based IsSessionActive (hot path)
+// IsSessionActive — legacy (no snapshot)
 // ============================================================
-bool AudioSessionMonitor::IsSessionActive(DWORD processId, const ProcessSnapshot& snap) {
-    if (!EnsureEnumeratorInitialized()) return false;
-
-    ComPtr<IMMDeviceCollection> deviceCollection;
-    if (FAILED(m_deviceEnumerator->EnumAudioEndpoints(eRender, DEVICE_STATE_ACTIVE, &deviceCollection)) || !deviceCollection)
-        return false;
-
-    UINT deviceCount = 0;
-    deviceCollection->GetCount(&deviceCount);
-
-    for (UINT d = 0; d < deviceCount; d++) {
-        ComPtr<IMMDevice> device;
-        if (FAILED(deviceCollection->Item(d, &device)) || !device) continue;
-
-        ComPtr<IAudioSessionManager2> sessionManager;
-        if (FAILED(device->Activate(__uuidof(IAudioSessionManager2), CLSCTX_ALL,
-            nullptr, reinterpret_cast<void**>(sessionManager.GetAddressOf()))) || !sessionManager) continue;
+bool AudioSessionMonitor::IsSessionActive(DWORD processId) {
+    const auto& devices = m_deviceCache.GetDevices();
 
+    for (size_t d = 0; d < devices.size(); d++) {
         ComPtr<IAudioSessionEnumerator> sessionEnumerator;
-        if (FAILED(sessionManager->GetSessionEnumerator(&sessionEnumerator)) || !sessionEnumerator) continue;
+        if (!OpenSessionEnumerator(devices[d], sessionEnumerator)) continue;
 
         int sessionCount = 0;
         sessionEnumerator->GetCount(&sessionCount);
@@ -291,7 +230,7 @@ bool AudioSessionMonitor::IsSessionActive(DWORD processId, const ProcessSnapshot
 
             bool isMatch = (sessionPid == processId);
             if (!isMatch && sessionPid != 0)
-                isMatch = IsChildOfProcess(sessionPid, processId, snap);
+                isMatch = IsChildOfProcess(sessionPid, processId);
 
             if (isMatch) {
                 AudioSessionState state;
@@ -305,34 +244,21 @@ bool AudioSessionMonitor::IsSessionActive(DWORD processId, const ProcessSnapshot
     return false;
 }
 
+bool AudioSessionMonitor::IsSessionActive(DWORD processId, const ProcessSnapshot& snap) {
+    return ScanAllSessions(snap).Find(processId).active;
+}
+
 // ============================================================
 // DumpAudioSessions — legacy (no snapshot)
 // ============================================================
 void AudioSessionMonitor::DumpAudioSessions() {
-    if (!EnsureEnumeratorInitialized()) return;
-
-    ComPtr<IMMDeviceCollection> deviceCollection;
-    if (FAILED(m_deviceEnumerator->EnumAudioEndpoints(eRender, DEVICE_STATE_ACTIVE, &deviceCollection)) || !deviceCollection)
-        return;
-
-    UINT deviceCount = 0;
-    deviceCollection->GetCount(&deviceCount);
-
-    for (UINT d = 0; d < deviceCount; d++) {
-        ComPtr<IMMDevice> device;
-        if (FAILED(deviceCollection->Item(d, &device)) || !device) continue;
-
-        LPWSTR deviceId = nullptr;
-        device->GetId(&deviceId);
-        std::wstring devIdStr = deviceId ? deviceId : L"(unknown)";
-        if (deviceId) CoTaskMemFree(deviceId);
+    const auto& devices = m_deviceCache.GetDevices();
 
-        ComPtr<IAudioSessionManager2> sessionManager;
-        if (FAILED(device->Activate(__uuidof(IAudioSessionManager2), CLSCTX_ALL,
-            nullptr, reinterpret_cast<void**>(sessionManager.GetAddressOf()))) || !sessionManager) continue;
+    for (size_t d = 0; d < devices.size(); d++) {
+        std::wstring devIdStr = devices[d].id.empty() ? L"(unknown)" : devices[d].id;
 
         ComPtr<IAudioSessionEnumerator> sessionEnumerator;
-        if (FAILED(sessionManager->GetSessionEnumerator(&sessionEnumerator)) || !sessionEnumerator) continue;
+        if (!OpenSessionEnumerator(devices[d], sessionEnumerator)) continue;
 
         int sessionCount = 0;
         sessionEnumerator->GetCount(&sessionCount);
@@ -367,30 +293,13 @@ void AudioSessionMonitor::DumpAudioSessions() {
 // Bug 4: Snapshot-based DumpAudioSessions
 // ============================================================
 void AudioSessionMonitor::DumpAudioSessions(const ProcessSnapshot& snap) {
-    if (!EnsureEnumeratorInitialized()) return;
+    const auto& devices = m_deviceCache.GetDevices();
 
-    ComPtr<IMMDeviceCollection> deviceCollection;
-    if (FAILED(m_deviceEnumerator->EnumAudioEndpoints(eRender, DEVICE_STATE_ACTIVE, &deviceCollection)) || !deviceCollection)
-        return;
-
-    UINT deviceCount = 0;
-    deviceCollection->GetCount(&deviceCount);
-
-    for (UINT d = 0; d < deviceCount; d++) {
-        ComPtr<IMMDevice> device;
-        if (FAILED(deviceCollection->Item(d, &device)) || !device) continue;
-
-        LPWSTR deviceId = nullptr;
-        device->GetId(&deviceId);
-        std::wstring devIdStr = deviceId ? deviceId : L"(unknown)";
-        if (deviceId) CoTaskMemFree(deviceId);
-
-        ComPtr<IAudioSessionManager2> sessionManager;
-        if (FAILED(device->Activate(__uuidof(IAudioSessionManager2), CLSCTX_ALL,
-            nullptr, reinterpret_cast<void**>(sessionManager.GetAddressOf()))) || !sessionManager) continue;
+    for (size_t d = 0; d < devices.size(); d++) {
+        std::wstring devIdStr = devices[d].id.empty() ? L"(unknown)" : devices[d].id;
 
         ComPtr<IAudioSessionEnumerator> sessionEnumerator;
-        if (FAILED(sessionManager->GetSessionEnumerator(&sessionEnumerator)) || !sessionEnumerator) continue;
+        if (!OpenSessionEnumerator(devices[d], sessionEnumerator)) continue;
 
         int sessionCount = 0;
         sessionEnumerator->GetCount(&sessionCount);
@@ -427,25 +336,11 @@ void AudioSessionMonitor::DumpAudioSessions(const ProcessSnapshot& snap) {
 std::vector<AudioSessionMonitor::DetectedSession> AudioSessionMonitor::FindActiveTargetSessions(
     const std::vector<std::wstring>& targetNames, float threshold) {
     std::vector<DetectedSession> result;
-    if (!EnsureEnumeratorInitialized()) return result;
-
-    ComPtr<IMMDeviceCollection> deviceCollection;
-    if (FAILED(m_deviceEnumerator->EnumAudioEndpoints(eRender, DEVICE_STATE_ACTIVE, &deviceCollection)) || !deviceCollection)
-        return result;
-
-    UINT deviceCount = 0;
-    deviceCollection->GetCount(&deviceCount);
-
-    for (UINT d = 0; d < deviceCount; d++) {
-        ComPtr<IMMDevice> device;
-        if (FAILED(deviceCollection->Item(d, &device)) || !device) continue;
-
-        ComPtr<IAudioSessionManager2> sessionManager;
-        if (FAILED(device->Activate(__uuidof(IAudioSessionManager2), CLSCTX_ALL,
-            nullptr, reinterpret_cast<void**>(sessionManager.GetAddressOf()))) || !sessionManager) continue;
+    const auto& devices = m_deviceCache.GetDevices();
 
+    for (size_t d = 0; d < devices.size(); d++) {
         ComPtr<IAudioSessionEnumerator> sessionEnumerator;
-        if (FAILED(sessionManager->GetSessionEnumerator(&sessionEnumerator)) || !sessionEnumerator) continue;
+        if (!OpenSessionEnumerator(devices[d], sessionEnumerator)) continue;
 
         int sessionCount = 0;
         sessionEnumerator->GetCount(&sessionCount);
@@ -491,15 +386,22 @@ std::vector<AudioSessionMonitor::DetectedSession> AudioSessionMonitor::FindActiv
 // Reset & init
 // ============================================================
 void AudioSessionMonitor::Reset() {
-    m_deviceEnumerator.Reset();
-    m_initialized = false;
+    m_deviceCache.Reset();
+}
+
+RenderDeviceCache::Stats AudioSessionMonitor::GetDeviceCacheStats() const {
+    return m_deviceCache.GetStats();
 }
 
-bool AudioSessionMonitor::EnsureEnumeratorInitialized() {
-    if (m_initialized && m_deviceEnumerator) return true;
-    m_deviceEnumerator.Reset();
-    if (FAILED(CoCreateInstance(__uuidof(MMDeviceEnumerator), nullptr, CLSCTX_ALL, IID_PPV_ARGS(&m_deviceEnumerator))))
+bool AudioSessionMonitor::OpenSessionEnumerator(const RenderDeviceCache::Device& device,
+    ComPtr<IAudioSessionEnumerator>& sessionEnumerator) {
+    if (!device.sessionManager) return false;
+
+    // A cached manager whose device went away fails here, possibly before
+    // the removal notification arrives
+    if (FAILED(device.sessionManager->GetSessionEnumerator(&sessionEnumerator)) || !sessionEnumerator) {
+        m_deviceCache.Invalidate();
         return false;
-    m_initialized = true;
+    }
     return true;
 }
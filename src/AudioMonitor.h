@@ -8,12 +8,17 @@
 #include <endpointvolume.h>
 #include <wrl/client.h>
 #include "CaptureManager.h"
+#include "Config.h"
 #include "AudioDeviceEnumerator.h"
 #include "ProcessUtils.h"
+#include "RenderDeviceCache.h"
+#include "SessionScan.h"
 
 using Microsoft::WRL::ComPtr;
 
 AudioFormat GetAudioFormatFromConfig();
+LimiterSettings GetLimiterSettingsFromConfig(const AgentConfig& config);
+UINT32 GetEncoderQualityFromConfig(const AgentConfig& config, AudioFormat format);
 std::wstring GetFileExtension(AudioFormat format);
 std::wstring BuildOutputPath(const std::wstring& processName, AudioFormat format);
 
@@ -25,6 +30,9 @@ struct MicInfo {
 
 MicInfo GetDefaultMicrophone();
 
+// Session walks go through a RenderDeviceCache: the render devices and
+// their session managers are activated once and kept until a device
+// notification (added, removed, state or default changed) drops them.
 class AudioSessionMonitor {
 public:
     AudioSessionMonitor() = default;
@@ -36,7 +44,14 @@ public:
     bool IsSessionActive(DWORD processId);
     void DumpAudioSessions();
 
-    // Snapshot-based overloads (use these in hot path)
+    // One pass over every session on every render device, building peak and
+    // active state per process (sessions of child processes count for their
+    // parents). Call once per poll cycle and look the target pids up in the
+    // result; it stays valid until the next scan.
+    const SessionActivityTable& ScanAllSessions(const ProcessSnapshot& snap);
+
+    // Snapshot-based overloads: each one is a full scan, so for several
+    // pids per cycle use ScanAllSessions
     float GetProcessPeakLevel(DWORD processId, const ProcessSnapshot& snap);
     bool IsSessionActive(DWORD processId, const ProcessSnapshot& snap);
     void DumpAudioSessions(const ProcessSnapshot& snap);
@@ -51,11 +66,23 @@ public:
 
     std::vector<DetectedSession> FindActiveTargetSessions(
         const std::vector<std::wstring>& targetNames, float threshold = 0.01f);
+
+    // Drop the device cache and its notification registration; the next
+    // call starts over. Call before CoUninitialize.
     void Reset();
 
+    RenderDeviceCache::Stats GetDeviceCacheStats() const;
+
 private:
-    bool EnsureEnumeratorInitialized();
+    // Session enumerator of a cached device; a failure invalidates the cache
+    bool OpenSessionEnumerator(const RenderDeviceCache::Device& device,
+        ComPtr<IAudioSessionEnumerator>& sessionEnumerator);
+
+    // Peak and state of every process session on the active render devices
+    bool CollectSessions(std::vector<SessionSample>& sessions);
+
+    RenderDeviceCache m_deviceCache;
 
-    ComPtr<IMMDeviceEnumerator> m_deviceEnumerator;
-    bool m_initialized = false;
+    std::vector<SessionSample> m_samples;   // Reused between scans
+    SessionActivityTable m_sessionTable;
 };
@@ -0,0 +1,339 @@
+#include "AudioSessionTracker.h"
+#include "Logger.h"
+
+// ============================================================
+// COM callbacks: update the shared table and queue work, nothing else
+// (no registering or unregistering from inside a notification)
+// ============================================================
+
+class AudioSessionTracker::SessionNotifier : public IAudioSessionNotification {
+public:
+    SessionNotifier(std::shared_ptr<Shared> shared, uint32_t device)
+        : m_refCount(1), m_shared(std::move(shared)), m_device(device) {}
+
+    STDMETHODIMP QueryInterface(REFIID riid, void** ppvObject) override {
+        if (!ppvObject) return E_POINTER;
+        if (riid == __uuidof(IUnknown) || riid == __uuidof(IAudioSessionNotification)) {
+            *ppvObject = static_cast<IAudioSessionNotification*>(this);
+            AddRef();
+            return S_OK;
+        }
+        *ppvObject = nullptr;
+        return E_NOINTERFACE;
+    }
+    STDMETHODIMP_(ULONG) AddRef() override { return InterlockedIncrement(&m_refCount); }
+    STDMETHODIMP_(ULONG) Release() override {
+        LONG refCount = InterlockedDecrement(&m_refCount);
+        if (refCount == 0) delete this;
+        return refCount;
+    }
+
+    STDMETHODIMP OnSessionCreated(IAudioSessionControl* session) override {
+        if (!session) return S_OK;
+        std::lock_guard<std::mutex> lock(m_shared->mutex);
+        m_shared->created.emplace_back(m_device, session);
+        if (m_shared->wake) m_shared->wake->Raise(PollScheduler::kSessionChange);
+        return S_OK;
+    }
+
+private:
+    LONG m_refCount;
+    std::shared_ptr<Shared> m_shared;
+    uint32_t m_device;
+};
+
+class AudioSessionTracker::SessionEvents : public IAudioSessionEvents {
+public:
+    SessionEvents(std::shared_ptr<Shared> shared, uint64_t key)
+        : m_refCount(1), m_shared(std::move(shared)), m_key(key) {}
+
+    STDMETHODIMP QueryInterface(REFIID riid, void** ppvObject) override {
+        if (!ppvObject) return E_POINTER;
+        if (riid == __uuidof(IUnknown) || riid == __uuidof(IAudioSessionEvents)) {
+            *ppvObject = static_cast<IAudioSessionEvents*>(this);
+            AddRef();
+            return S_OK;
+        }
+        *ppvObject = nullptr;
+        return E_NOINTERFACE;
+    }
+    STDMETHODIMP_(ULONG) AddRef() override { return InterlockedIncrement(&m_refCount); }
+    STDMETHODIMP_(ULONG) Release() override {
+        LONG refCount = InterlockedDecrement(&m_refCount);
+        if (refCount == 0) delete this;
+        return refCount;
+    }
+
+    STDMETHODIMP OnStateChanged(AudioSessionState state) override {
+        std::lock_guard<std::mutex> lock(m_shared->mutex);
+        if (state == AudioSessionStateExpired) {
+            Gone();
+        } else {
+            m_shared->table.SetActive(m_key, state == AudioSessionStateActive);
+        }
+        Notify();
+        return S_OK;
+    }
+
+    STDMETHODIMP OnSessionDisconnected(AudioSessionDisconnectReason) override {
+        std::lock_guard<std::mutex> lock(m_shared->mutex);
+        Gone();
+        Notify();
+        return S_OK;
+    }
+
+    // Not used for detection
+    STDMETHODIMP OnDisplayNameChanged(LPCWSTR, LPCGUID) override { return S_OK; }
+    STDMETHODIMP OnIconPathChanged(LPCWSTR, LPCGUID) override { return S_OK; }
+    STDMETHODIMP OnSimpleVolumeChanged(float, BOOL, LPCGUID) override { return S_OK; }
+    STDMETHODIMP OnChannelVolumeChanged(DWORD, float[], DWORD, LPCGUID) override { return S_OK; }
+    STDMETHODIMP OnGroupingParamChanged(LPCGUID, LPCGUID) override { return S_OK; }
+
+private:
+    // With m_shared->mutex held
+    void Gone() {
+        m_shared->table.Remove(m_key);
+        m_shared->gone.push_back(m_key);
+    }
+
+    // Only a target's sessions are worth an early poll cycle
+    void Notify() {
+        if (m_shared->watched.count(m_key) && m_shared->wake)
+            m_shared->wake->Raise(PollScheduler::kSessionChange);
+    }
+
+    LONG m_refCount;
+    std::shared_ptr<Shared> m_shared;
+    uint64_t m_key;
+};
+
+// ============================================================
+// AudioSessionTracker
+// ============================================================
+
+AudioSessionTracker::AudioSessionTracker()
+    : m_shared(std::make_shared<Shared>()), m_started(false), m_deviceGeneration(0),
+      m_nextKey(1), m_nextDevice(0) {}
+
+AudioSessionTracker::~AudioSessionTracker() {
+    Stop();
+}
+
+bool AudioSessionTracker::Start() {
+    if (m_started) return true;
+    if (!m_deviceCache.Initialize()) return false;
+
+    m_started = true;
+    SyncDevices();
+    Log(L"Session tracker: " + std::to_wstring(m_devices.size()) + L" render devices, " +
+        std::to_wstring(m_sessions.size()) + L" sessions", LogLevel::LOG_DEBUG);
+    return true;
+}
+
+void AudioSessionTracker::Stop() {
+    while (!m_devices.empty()) {
+        RemoveDevice(m_devices.begin()->first);
+    }
+    m_deviceCache.Reset();
+    m_deviceGeneration = 0;
+    m_started = false;
+
+    std::lock_guard<std::mutex> lock(m_shared->mutex);
+    m_shared->created.clear();
+    m_shared->gone.clear();
+    m_shared->watched.clear();
+}
+
+void AudioSessionTracker::SyncDevices() {
+    // Only compare device lists after a device notification rebuilt the cache
+    const auto& devices = m_deviceCache.GetDevices();
+    if (m_deviceCache.GetGeneration() == m_deviceGeneration) return;
+    m_deviceGeneration = m_deviceCache.GetGeneration();
+
+    std::set<std::wstring> present;
+    for (const auto& device : devices) {
+        if (device.id.empty() || !device.sessionManager) continue;
+
+        present.insert(device.id);
+        if (m_devices.find(device.id) == m_devices.end()) {
+            AddDevice(device.id, device.sessionManager.Get());
+        }
+    }
+
+    for (auto it = m_devices.begin(); it != m_devices.end();) {
+        const std::wstring id = (it++)->first;
+        if (present.find(id) == present.end()) {
+            RemoveDevice(id);
+        }
+    }
+}
+
+bool AudioSessionTracker::AddDevice(const std::wstring& deviceId, IAudioSessionManager2* manager) {
+    Device entry;
+    entry.index = m_nextDevice++;
+    entry.manager = manager;
+
+    entry.notifier.Attach(new SessionNotifier(m_shared, entry.index));
+    if (FAILED(entry.manager->RegisterSessionNotification(entry.notifier.Get())))
+        return false;
+
+    // Creation notifications only start once the session enumerator has
+    // been taken after registering; it also gives the sessions already there
+    ComPtr<IAudioSessionEnumerator> sessionEnumerator;
+    if (SUCCEEDED(entry.manager->GetSessionEnumerator(&sessionEnumerator)) && sessionEnumerator) {
+        int sessionCount = 0;
+        sessionEnumerator->GetCount(&sessionCount);
+        for (int i = 0; i < sessionCount; i++) {
+            ComPtr<IAudioSessionControl> sessionControl;
+            if (SUCCEEDED(sessionEnumerator->GetSession(i, &sessionControl)) && sessionControl)
+                AddSession(entry.index, sessionControl.Get());
+        }
+    }
+
+    m_devices[deviceId] = std::move(entry);
+    return true;
+}
+
+void AudioSessionTracker::RemoveDevice(const std::wstring& deviceId) {
+    auto it = m_devices.find(deviceId);
+    if (it == m_devices.end()) return;
+
+    Device device = std::move(it->second);
+    m_devices.erase(it);
+    device.manager->UnregisterSessionNotification(device.notifier.Get());
+
+    std::vector<uint64_t> keys;
+    for (const auto& pair : m_sessions) {
+        if (pair.second.device == device.index) keys.push_back(pair.first);
+    }
+    for (uint64_t key : keys) {
+        RemoveSession(key);
+    }
+
+    std::lock_guard<std::mutex> lock(m_shared->mutex);
+    m_shared->table.RemoveDevice(device.index);
+}
+
+void AudioSessionTracker::AddSession(uint32_t device, IAudioSessionControl* control) {
+    ComPtr<IAudioSessionControl2> control2;
+    if (FAILED(control->QueryInterface(IID_PPV_ARGS(&control2)))) return;
+
+    // A session can be both enumerated and reported as created
+    LPWSTR instanceId = nullptr;
+    if (FAILED(control2->GetSessionInstanceIdentifier(&instanceId)) || !instanceId) return;
+    std::wstring instance = instanceId;
+    CoTaskMemFree(instanceId);
+    if (m_instanceKeys.find(instance) != m_instanceKeys.end()) return;
+
+    // System sounds and multi-process sessions belong to no single process
+    DWORD pid = 0;
+    if (control2->GetProcessId(&pid) != S_OK || pid == 0) return;
+
+    AudioSessionState state = AudioSessionStateInactive;
+    if (FAILED(control->GetState(&state)) || state == AudioSessionStateExpired) return;
+
+    Session session;
+    session.device = device;
+    session.instanceId = instance;
+    session.control = control;
+    control->QueryInterface(IID_PPV_ARGS(&session.meter));
+
+    const uint64_t key = m_nextKey++;
+    session.events.Attach(new SessionEvents(m_shared, key));
+
+    // In the table before registering, so the first event finds it
+    {
+        std::lock_guard<std::mutex> lock(m_shared->mutex);
+        m_shared->table.Add(key, device, static_cast<uint32_t>(pid), state == AudioSessionStateActive);
+    }
+    if (FAILED(control->RegisterAudioSessionNotification(session.events.Get()))) {
+        std::lock_guard<std::mutex> lock(m_shared->mutex);
+        m_shared->table.Remove(key);
+        return;
+    }
+
+    // The state may have changed before the registration took effect
+    if (SUCCEEDED(control->GetState(&state)) && state != AudioSessionStateExpired) {
+        std::lock_guard<std::mutex> lock(m_shared->mutex);
+        m_shared->table.SetActive(key, state == AudioSessionStateActive);
+    }
+
+    m_instanceKeys[instance] = key;
+    m_sessions[key] = std::move(session);
+}
+
+void AudioSessionTracker::RemoveSession(uint64_t key) {
+    auto it = m_sessions.find(key);
+    if (it == m_sessions.end()) return;
+
+    it->second.control->UnregisterAudioSessionNotification(it->second.events.Get());
+    m_instanceKeys.erase(it->second.instanceId);
+    m_sessions.erase(it);
+
+    std::lock_guard<std::mutex> lock(m_shared->mutex);
+    m_shared->table.Remove(key);
+    m_shared->watched.erase(key);
+}
+
+const SessionActivityTable& AudioSessionTracker::Sample(const std::vector<DWORD>& targets,
+                                                        const ProcessSnapshot& snap) {
+    if (!m_started) {
+        m_activity.Clear();
+        return m_activity;
+    }
+
+    // Registration work the callbacks queued
+    std::vector<std::pair<uint32_t, ComPtr<IAudioSessionControl>>> created;
+    std::vector<uint64_t> gone;
+    {
+        std::lock_guard<std::mutex> lock(m_shared->mutex);
+        created.swap(m_shared->created);
+        gone.swap(m_shared->gone);
+    }
+    for (uint64_t key : gone) {
+        RemoveSession(key);
+    }
+    for (const auto& pair : created) {
+        for (const auto& device : m_devices) {
+            if (device.second.index == pair.first) {
+                AddSession(pair.first, pair.second.Get());
+                break;
+            }
+        }
+    }
+
+    SyncDevices();
+
+    // Which sessions belong to the targets, and their state
+    std::vector<uint32_t> targetPids(targets.begin(), targets.end());
+    auto parentOf = [&snap](uint32_t pid) {
+        return static_cast<uint32_t>(GetParentProcessId(pid, snap));
+    };
+    {
+        std::lock_guard<std::mutex> lock(m_shared->mutex);
+        m_shared->table.SelectTargets(targetPids, parentOf, m_keys, m_samples);
+        m_shared->watched = std::set<uint64_t>(m_keys.begin(), m_keys.end());
+    }
+
+    // Meters of the active ones only
+    for (size_t i = 0; i < m_keys.size(); i++) {
+        if (!m_samples[i].active) continue;
+        auto it = m_sessions.find(m_keys[i]);
+        if (it == m_sessions.end() || !it->second.meter) continue;
+        float peakLevel = 0.0f;
+        if (SUCCEEDED(it->second.meter->GetPeakValue(&peakLevel))) m_samples[i].peak = peakLevel;
+    }
+
+    m_activity.Build(m_samples, parentOf);
+    return m_activity;
+}
+
+void AudioSessionTracker::SetWakeSignal(std::shared_ptr<WakeSignal> wake) {
+    std::lock_guard<std::mutex> lock(m_shared->mutex);
+    m_shared->wake = std::move(wake);
+}
+
+size_t AudioSessionTracker::GetSessionCount() {
+    std::lock_guard<std::mutex> lock(m_shared->mutex);
+    return m_shared->table.Size();
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <windows.h>
+#include <mmdeviceapi.h>
+#include <audiopolicy.h>
+#include <endpointvolume.h>
+#include <wrl/client.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "PollScheduler.h"
+#include "ProcessUtils.h"
+#include "RenderDeviceCache.h"
+#include "SessionScan.h"
+
+using Microsoft::WRL::ComPtr;
+
+// Event-driven view of the audio sessions on all render devices.
+//
+// Instead of enumerating every device and session each poll cycle, the
+// tracker registers for session-created notifications on each device and
+// for state-changed / disconnected events on each session, and keeps a
+// SessionEventTable current from those callbacks. A poll cycle then only
+// reads the meters of the active sessions that belong to target processes.
+//
+// Callbacks arrive on system threads and only update the table and queue
+// work; registering and unregistering (which must not happen inside a
+// callback) is done by Sample(), on the monitor thread.
+class AudioSessionTracker {
+public:
+    AudioSessionTracker();
+    ~AudioSessionTracker();
+
+    AudioSessionTracker(const AudioSessionTracker&) = delete;
+    AudioSessionTracker& operator=(const AudioSessionTracker&) = delete;
+
+    // Register on every active render device and take in their current
+    // sessions. Call on an MTA thread.
+    bool Start();
+    void Stop();
+
+    bool IsStarted() const { return m_started; }
+
+    // Once per poll cycle: register sessions created since the last call,
+    // drop the ones that went away, follow added or removed render devices,
+    // and read the meters of the active sessions of `targets` (and their
+    // child processes). The result answers for the target pids only, and
+    // stays valid until the next call.
+    const SessionActivityTable& Sample(const std::vector<DWORD>& targets, const ProcessSnapshot& snap);
+
+    // Raise kSessionChange on `wake` when a session is created or a
+    // target's session starts, stops or goes away
+    void SetWakeSignal(std::shared_ptr<WakeSignal> wake);
+
+    size_t GetSessionCount();
+
+    RenderDeviceCache::Stats GetDeviceCacheStats() const { return m_deviceCache.GetStats(); }
+
+private:
+    class SessionNotifier;   // IAudioSessionNotification, one per device
+    class SessionEvents;     // IAudioSessionEvents, one per session
+
+    // State shared with the COM callbacks, which may outlive the tracker by
+    // a late call
+    struct Shared {
+        std::mutex mutex;
+        std::shared_ptr<WakeSignal> wake;
+        SessionEventTable table;
+        std::vector<std::pair<uint32_t, ComPtr<IAudioSessionControl>>> created;  // device, session
+        std::vector<uint64_t> gone;           // Disconnected or expired, to unregister
+        std::set<uint64_t> watched;           // Sessions of targets: their state changes wake the monitor
+    };
+
+    struct Device {
+        uint32_t index;
+        ComPtr<IAudioSessionManager2> manager;
+        ComPtr<SessionNotifier> notifier;
+    };
+
+    struct Session {
+        uint32_t device;
+        std::wstring instanceId;
+        ComPtr<IAudioSessionControl> control;
+        ComPtr<IAudioMeterInformation> meter;
+        ComPtr<SessionEvents> events;
+    };
+
+    // Add render devices that appeared, drop the ones that went away (only
+    // after the device cache was rebuilt)
+    void SyncDevices();
+    bool AddDevice(const std::wstring& deviceId, IAudioSessionManager2* manager);
+    void RemoveDevice(const std::wstring& deviceId);
+
+    // Register for a session's events and put it in the table (once per
+    // session instance)
+    void AddSession(uint32_t device, IAudioSessionControl* control);
+    void RemoveSession(uint64_t key);
+
+    std::shared_ptr<Shared> m_shared;
+    RenderDeviceCache m_deviceCache;
+    bool m_started;
+    uint64_t m_deviceGeneration;                      // Cache generation last synced
+    std::map<std::wstring, Device> m_devices;        // By endpoint id
+    std::map<uint64_t, Session> m_sessions;           // Monitor thread only
+    std::map<std::wstring, uint64_t> m_instanceKeys;  // Session instance id -> key
+    uint64_t m_nextKey;
+    uint32_t m_nextDevice;
+
+    std::vector<uint64_t> m_keys;
+    std::vector<SessionSample> m_samples;
+    SessionActivityTable m_activity;
+};
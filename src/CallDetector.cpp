@@ -0,0 +1,171 @@
+#include "CallDetector.h"
+#include <cstddef>
+#include <numeric>
+
+CallDetector::Step CallDetector::Observe(const Observation& observation, double nowSeconds) {
+    State& state = m_states[observation.pid];
+
+    // Rolling peak history for the average-peak silence check
+    state.peakHistory.push_back(observation.peak);
+    while ((int)state.peakHistory.size() > m_settings.peakHistorySize)
+        state.peakHistory.pop_front();
+
+    return state.recording
+        ? Recording(state, observation, nowSeconds)
+        : Waiting(state, observation, nowSeconds);
+}
+
+bool CallDetector::HasVoice(const Observation& observation) const {
+    if (observation.speechRatio >= 0.0f)
+        return observation.speechRatio >= m_settings.speechRatioThreshold;
+    return observation.peak > m_settings.peakThreshold;
+}
+
+CallDetector::Step CallDetector::Waiting(State& state, const Observation& observation, double nowSeconds) {
+    Step step;
+    const bool hasRealAudio = HasVoice(observation);
+    bool shouldStart = false;
+
+    if (observation.telegram) {
+        // Telegram: require call window + REAL audio from Telegram's process.
+        // sessionActive alone caused false positives: Telegram can hold an
+        // Active session from notifications while another app (MicroSIP,
+        // etc.) produces the actual sound.
+        if (hasRealAudio && observation.callWindow) {
+            state.startCounter++;
+            step.reason = Reason::Counting;
+            shouldStart = (state.startCounter >= m_settings.startThreshold);
+        } else {
+            if (state.startCounter > 0) state.startCounter--;
+            if (observation.callWindow)
+                step.reason = Reason::TelegramNoAudio;
+            else if (hasRealAudio)
+                step.reason = Reason::TelegramNoWindow;
+        }
+    } else {
+        // Non-Telegram: audio peak + session state
+        if (hasRealAudio && observation.sessionActive) {
+            state.startCounter++;
+            step.reason = Reason::Counting;
+            shouldStart = (state.startCounter >= m_settings.startThreshold);
+        } else {
+            if (state.startCounter > 0) state.startCounter--;
+        }
+    }
+    step.counter = state.startCounter;
+
+    if (!shouldStart) {
+        // Bug 7: don't let the history grow unbounded for non-recording processes
+        if (state.peakHistory.size() > (size_t)m_settings.peakHistorySize * 2)
+            state.peakHistory.clear();
+        return step;
+    }
+
+    state.startCounter = 0;
+    state.silenceCounter = 0;
+    state.inactiveCounter = 0;
+    state.recording = true;
+    state.startTime = nowSeconds;
+
+    step.decision = Decision::Start;
+    step.reason = Reason::Started;
+    return step;
+}
+
+CallDetector::Step CallDetector::Recording(State& state, const Observation& observation, double nowSeconds) {
+    Step step;
+    step.elapsedSeconds = (int)(nowSeconds - state.startTime);
+    const bool pastMinDuration = (step.elapsedSeconds >= m_settings.minRecordingSeconds);
+    const bool pastMaxDuration = (step.elapsedSeconds >= m_settings.maxRecordingSeconds);
+    bool shouldStop = false;
+
+    // Safety net: force stop if recording exceeds max duration
+    if (pastMaxDuration) {
+        step.reason = Reason::MaxDuration;
+        shouldStop = true;
+    }
+
+    // Average peak, so single notification sounds don't reset the silence counter
+    if (!state.peakHistory.empty()) {
+        step.averagePeak = std::accumulate(state.peakHistory.begin(), state.peakHistory.end(), 0.0f) /
+                           (float)state.peakHistory.size();
+    }
+    const bool hasSustainedAudio = (step.averagePeak > m_settings.peakThreshold) ||
+                                   (observation.speechRatio >= m_settings.speechRatioThreshold);
+
+    if (!shouldStop && observation.telegram) {
+        // Telegram: call window gone, or the window stays open (chat) but
+        // the audio session is dead
+        if (!observation.callWindow || !observation.sessionActive) {
+            state.inactiveCounter++;
+            step.reason = !observation.callWindow ? Reason::TelegramWindowGone : Reason::TelegramSessionInactive;
+            step.counter = state.inactiveCounter;
+            if (state.inactiveCounter >= m_settings.telegramSilenceCycles)
+                shouldStop = true;
+        } else {
+            state.inactiveCounter = 0;
+            step.reason = Reason::Active;
+        }
+    } else if (!shouldStop) {
+        // Non-Telegram: PRIMARY stop signal is the session becoming Inactive
+        if (!observation.sessionActive) {
+            state.inactiveCounter++;
+            state.silenceCounter = 0;
+            step.reason = Reason::SessionInactive;
+            step.counter = state.inactiveCounter;
+
+            // Wait a few cycles to confirm (session might briefly go inactive)
+            if (state.inactiveCounter >= m_settings.inactiveThreshold && pastMinDuration)
+                shouldStop = true;
+        } else {
+            state.inactiveCounter = 0;
+
+            // Fallback: only sustained audio (real conversation) resets the counter
+            if (!hasSustainedAudio) {
+                state.silenceCounter++;
+                step.reason = Reason::Silence;
+                step.counter = state.silenceCounter;
+                if (state.silenceCounter >= m_settings.silenceThreshold && pastMinDuration)
+                    shouldStop = true;
+            } else {
+                state.silenceCounter = 0;
+                step.reason = Reason::Active;
+            }
+        }
+    }
+
+    // MinRecordingSeconds protection — don't stop too early
+    if (shouldStop && !pastMinDuration && !pastMaxDuration) {
+        step.reason = Reason::MinDurationHold;
+        shouldStop = false;
+    }
+
+    if (shouldStop) {
+        state.recording = false;
+        state.silenceCounter = 0;
+        state.inactiveCounter = 0;
+        state.peakHistory.clear();
+        step.decision = Decision::Stop;
+    }
+    return step;
+}
+
+void CallDetector::Abort(uint32_t pid) {
+    auto it = m_states.find(pid);
+    if (it != m_states.end()) it->second.recording = false;
+}
+
+void CallDetector::MarkRecording(uint32_t pid, double nowSeconds) {
+    State& state = m_states[pid];
+    state.recording = true;
+    state.startTime = nowSeconds;
+}
+
+bool CallDetector::IsRecording(uint32_t pid) const {
+    auto it = m_states.find(pid);
+    return it != m_states.end() && it->second.recording;
+}
+
+void CallDetector::Remove(uint32_t pid) {
+    m_states.erase(pid);
+}
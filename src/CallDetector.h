@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <tuple>
+
+// Start/stop decisions for call recording, from what one poll cycle saw of
+// each target process (platform-neutral, no I/O, time passed in).
+//
+// START:
+//   - Telegram: voice while its call window is open
+//   - Other apps: voice while the session is Active
+//   either one for startThreshold cycles (a miss takes one off the count).
+//   Voice is a speech ratio of at least speechRatioThreshold when the
+//   capture's voice-activity detector reports one, else the peak above
+//   peakThreshold.
+//
+// STOP:
+//   - Telegram: call window gone, or session Inactive, for
+//     telegramSilenceCycles cycles
+//   - Other apps: session Inactive for inactiveThreshold cycles, or
+//     (fallback) the AVERAGE peak over peakHistorySize cycles below the
+//     threshold (and no speech this cycle) for silenceThreshold cycles, so
+//     a single notification sound doesn't keep a finished call recording
+//   - Never before minRecordingSeconds; always at maxRecordingSeconds
+class CallDetector {
+public:
+    struct Settings {
+        int startThreshold = 2;
+        int silenceThreshold = 15;
+        int inactiveThreshold = 3;
+        int telegramSilenceCycles = 3;
+        int peakHistorySize = 5;
+        int minRecordingSeconds = 60;
+        int maxRecordingSeconds = 7200;
+        float peakThreshold = 0.01f;
+        float speechRatioThreshold = 0.2f;
+
+        bool operator==(const Settings& other) const {
+            return std::tie(startThreshold, silenceThreshold, inactiveThreshold, telegramSilenceCycles,
+                            peakHistorySize, minRecordingSeconds, maxRecordingSeconds, peakThreshold,
+                            speechRatioThreshold) ==
+                   std::tie(other.startThreshold, other.silenceThreshold, other.inactiveThreshold,
+                            other.telegramSilenceCycles, other.peakHistorySize, other.minRecordingSeconds,
+                            other.maxRecordingSeconds, other.peakThreshold, other.speechRatioThreshold);
+        }
+        bool operator!=(const Settings& other) const { return !(*this == other); }
+    };
+
+    // One target process in one poll cycle
+    struct Observation {
+        uint32_t pid;
+        float peak;            // Session meter peak, 0..1
+        bool sessionActive;    // AudioSessionStateActive
+        bool telegram;         // Detected by its call window
+        bool callWindow;       // Telegram call window open
+        float speechRatio;     // Share of speech frames since the last cycle, < 0 if unknown
+    };
+
+    enum class Decision { None, Start, Stop };
+
+    enum class Reason {
+        // Not recording
+        Idle,
+        Counting,              // Audio seen, start counter going up
+        TelegramNoAudio,       // Call window open, no audio yet
+        TelegramNoWindow,      // Audio without a call window (notification, voice message)
+        Started,
+        // Recording
+        Active,
+        Silence,               // Average peak below the threshold
+        SessionInactive,
+        TelegramWindowGone,
+        TelegramSessionInactive,
+        MinDurationHold,       // Would stop, but minRecordingSeconds hasn't passed
+        MaxDuration
+    };
+
+    struct Step {
+        Decision decision = Decision::None;
+        Reason reason = Reason::Idle;
+        int counter = 0;          // The start, silence or inactive count the reason is about
+        int elapsedSeconds = 0;   // Recording time so far
+        float averagePeak = 0.0f;
+    };
+
+    CallDetector() = default;
+    explicit CallDetector(const Settings& settings) : m_settings(settings) {}
+
+    const Settings& GetSettings() const { return m_settings; }
+    void SetSettings(const Settings& settings) { m_settings = settings; }
+
+    // One cycle for one process. `nowSeconds` is a monotonic clock. A Start
+    // puts the process in the recording state; a Stop takes it out.
+    Step Observe(const Observation& observation, double nowSeconds);
+
+    // The recording a Start decided on could not be started
+    void Abort(uint32_t pid);
+
+    // Recording started without a Start decision (forced by the user)
+    void MarkRecording(uint32_t pid, double nowSeconds);
+
+    bool IsRecording(uint32_t pid) const;
+
+    // The process exited
+    void Remove(uint32_t pid);
+
+    // Forget every process (all recordings stopped by the user)
+    void Clear() { m_states.clear(); }
+
+private:
+    struct State {
+        bool recording = false;
+        double startTime = 0.0;
+        int startCounter = 0;
+        int silenceCounter = 0;
+        int inactiveCounter = 0;
+        std::deque<float> peakHistory;
+    };
+
+    // Voice in this cycle: the speech ratio when known, else the peak
+    bool HasVoice(const Observation& observation) const;
+
+    Step Waiting(State& state, const Observation& observation, double nowSeconds);
+    Step Recording(State& state, const Observation& observation, double nowSeconds);
+
+    Settings m_settings;
+    std::map<uint32_t, State> m_states;
+};
@@ -0,0 +1,168 @@
+#include "CallTrace.h"
+#include <algorithm>
+#include <cstring>
+
+namespace CallTrace {
+
+static const char kMagic[4] = { 'R', 'C', 'D', 'T' };
+
+// ============================================================
+// Writer
+// ============================================================
+
+bool Writer::Open(const std::filesystem::path& path) {
+    Close();
+    m_file.open(path, std::ios::binary | std::ios::trunc);
+    if (!m_file.is_open()) return false;
+
+    m_size = 0;
+    m_buffer.clear();
+    Put(kMagic, sizeof(kMagic));
+    PutValue<uint16_t>(kVersion);
+    Commit();
+    return m_file.good();
+}
+
+void Writer::Close() {
+    if (m_file.is_open()) m_file.close();
+}
+
+void Writer::WriteSettings(const CallDetector::Settings& settings) {
+    if (!IsOpen()) return;
+    PutValue<uint8_t>(Record::Settings);
+    PutValue<int32_t>(settings.startThreshold);
+    PutValue<int32_t>(settings.silenceThreshold);
+    PutValue<int32_t>(settings.inactiveThreshold);
+    PutValue<int32_t>(settings.telegramSilenceCycles);
+    PutValue<int32_t>(settings.peakHistorySize);
+    PutValue<int32_t>(settings.minRecordingSeconds);
+    PutValue<int32_t>(settings.maxRecordingSeconds);
+    PutValue<float>(settings.peakThreshold);
+    PutValue<float>(settings.speechRatioThreshold);
+    Commit();
+}
+
+void Writer::WriteCycle(uint32_t timeMs, const std::vector<CallDetector::Observation>& observations) {
+    if (!IsOpen()) return;
+    const uint16_t count = (uint16_t)(std::min)(observations.size(), (size_t)0xFFFF);
+    PutValue<uint8_t>(Record::Cycle);
+    PutValue<uint32_t>(timeMs);
+    PutValue<uint16_t>(count);
+    for (uint16_t i = 0; i < count; i++) {
+        const CallDetector::Observation& observation = observations[i];
+        uint8_t flags = 0;
+        if (observation.sessionActive) flags |= kSessionActive;
+        if (observation.telegram) flags |= kTelegram;
+        if (observation.callWindow) flags |= kCallWindow;
+        PutValue<uint32_t>(observation.pid);
+        PutValue<float>(observation.peak);
+        PutValue<uint8_t>(flags);
+        PutValue<float>(observation.speechRatio);
+    }
+    Commit();
+
+    // A trace is read after a crash as often as not
+    m_file.flush();
+}
+
+void Writer::WriteControl(Action action, uint32_t pid) {
+    if (!IsOpen()) return;
+    PutValue<uint8_t>(Record::Control);
+    PutValue<uint8_t>(static_cast<uint8_t>(action));
+    PutValue<uint32_t>(pid);
+    Commit();
+}
+
+void Writer::WriteLabel(uint32_t pid, bool inCall) {
+    if (!IsOpen()) return;
+    PutValue<uint8_t>(Record::Label);
+    PutValue<uint32_t>(pid);
+    PutValue<uint8_t>(inCall ? 1 : 0);
+    Commit();
+}
+
+void Writer::Commit() {
+    m_file.write(reinterpret_cast<const char*>(m_buffer.data()), m_buffer.size());
+    m_buffer.clear();
+}
+
+void Writer::Put(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    m_buffer.insert(m_buffer.end(), bytes, bytes + size);
+    m_size += size;
+}
+
+// ============================================================
+// Reader
+// ============================================================
+
+bool Reader::Open(const std::filesystem::path& path) {
+    m_version = 0;
+    m_file.open(path, std::ios::binary);
+    if (!m_file.is_open()) return false;
+
+    char magic[4];
+    return Get(magic, sizeof(magic)) && memcmp(magic, kMagic, sizeof(kMagic)) == 0 &&
+           GetValue(m_version) && m_version >= 1 && m_version <= kVersion;
+}
+
+bool Reader::Next(Record& record) {
+    uint8_t type = 0;
+    if (!GetValue(type)) return false;
+
+    switch (type) {
+        case Record::Settings: {
+            int32_t values[7];
+            if (!Get(values, sizeof(values)) || !GetValue(record.settings.peakThreshold)) return false;
+            record.settings.speechRatioThreshold = CallDetector::Settings().speechRatioThreshold;
+            if (m_version >= 2 && !GetValue(record.settings.speechRatioThreshold)) return false;
+            record.settings.startThreshold = values[0];
+            record.settings.silenceThreshold = values[1];
+            record.settings.inactiveThreshold = values[2];
+            record.settings.telegramSilenceCycles = values[3];
+            record.settings.peakHistorySize = values[4];
+            record.settings.minRecordingSeconds = values[5];
+            record.settings.maxRecordingSeconds = values[6];
+            break;
+        }
+        case Record::Cycle: {
+            uint16_t count = 0;
+            if (!GetValue(record.timeMs) || !GetValue(count)) return false;
+            record.observations.resize(count);
+            for (CallDetector::Observation& observation : record.observations) {
+                uint8_t flags = 0;
+                if (!GetValue(observation.pid) || !GetValue(observation.peak) || !GetValue(flags)) return false;
+                observation.sessionActive = (flags & kSessionActive) != 0;
+                observation.telegram = (flags & kTelegram) != 0;
+                observation.callWindow = (flags & kCallWindow) != 0;
+                observation.speechRatio = -1.0f;
+                if (m_version >= 2 && !GetValue(observation.speechRatio)) return false;
+            }
+            break;
+        }
+        case Record::Control: {
+            uint8_t action = 0;
+            if (!GetValue(action) || !GetValue(record.pid)) return false;
+            if (action < (uint8_t)Action::Abort || action > (uint8_t)Action::Clear) return false;
+            record.action = static_cast<Action>(action);
+            break;
+        }
+        case Record::Label: {
+            uint8_t inCall = 0;
+            if (!GetValue(record.pid) || !GetValue(inCall)) return false;
+            record.inCall = (inCall != 0);
+            break;
+        }
+        default:
+            return false;
+    }
+    record.type = static_cast<Record::Type>(type);
+    return true;
+}
+
+bool Reader::Get(void* data, size_t size) {
+    m_file.read(static_cast<char*>(data), size);
+    return (size_t)m_file.gcount() == size;
+}
+
+} // namespace CallTrace
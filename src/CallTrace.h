@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include "CallDetector.h"
+
+// Compact binary trace of what CallDetector saw, for replaying call
+// detection offline (tools/CallReplay.cpp). Platform-neutral.
+//
+// File: "RCDT", u16 version, then records, each a one-byte type:
+//   'S' settings   i32 x7 (the int Settings fields in declaration order),
+//                  f32 peakThreshold, f32 speechRatioThreshold
+//   'C' cycle      u32 milliseconds since the trace began, u16 count,
+//                  count x { u32 pid, f32 peak, u8 flags, f32 speechRatio }
+//                  (13 bytes per process)
+//   'A' control    u8 action, u32 pid: what the monitor did outside Observe()
+//   'L' label      u32 pid, u8 inCall: ground truth, from synthesized traces
+// Little-endian, no padding. Settings come before the first cycle and again
+// whenever they change. Version 1 traces (no speech fields) still read, with
+// speechRatio -1 (unknown) and the default speechRatioThreshold.
+namespace CallTrace {
+
+constexpr uint16_t kVersion = 2;
+
+enum ObservationFlags : uint8_t {
+    kSessionActive = 1,
+    kTelegram = 2,
+    kCallWindow = 4
+};
+
+enum class Action : uint8_t {
+    Abort = 1,           // CallDetector::Abort
+    MarkRecording = 2,   // CallDetector::MarkRecording
+    Remove = 3,          // CallDetector::Remove
+    Clear = 4            // CallDetector::Clear (pid 0)
+};
+
+struct Record {
+    enum Type : uint8_t { Settings = 'S', Cycle = 'C', Control = 'A', Label = 'L' };
+    Type type;
+    uint32_t timeMs = 0;                                     // Cycle
+    std::vector<CallDetector::Observation> observations;     // Cycle
+    CallDetector::Settings settings;                         // Settings
+    Action action = Action::Abort;                           // Control
+    uint32_t pid = 0;                                        // Control, Label
+    bool inCall = false;                                     // Label
+};
+
+class Writer {
+public:
+    ~Writer() { Close(); }
+
+    bool Open(const std::filesystem::path& path);
+    void Close();
+    bool IsOpen() const { return m_file.is_open(); }
+
+    // Bytes written so far (for rotating by size)
+    uint64_t Size() const { return m_size; }
+
+    void WriteSettings(const CallDetector::Settings& settings);
+    void WriteCycle(uint32_t timeMs, const std::vector<CallDetector::Observation>& observations);
+    void WriteControl(Action action, uint32_t pid);
+    void WriteLabel(uint32_t pid, bool inCall);
+
+private:
+    // Records are built in m_buffer and written whole
+    void Commit();
+    void Put(const void* data, size_t size);
+    template <typename T> void PutValue(T value) { Put(&value, sizeof(value)); }
+
+    std::ofstream m_file;
+    std::vector<uint8_t> m_buffer;
+    uint64_t m_size = 0;
+};
+
+class Reader {
+public:
+    // False if the file can't be opened (IsOpen() false), isn't a trace, or
+    // is a version this build doesn't read (GetVersion() tells which)
+    bool Open(const std::filesystem::path& path);
+    bool IsOpen() const { return m_file.is_open(); }
+
+    // Version from the header, 0 until one was read
+    uint16_t GetVersion() const { return m_version; }
+
+    // False at the end of the file or on a malformed record
+    bool Next(Record& record);
+
+private:
+    bool Get(void* data, size_t size);
+    template <typename T> bool GetValue(T& value) { return Get(&value, sizeof(value)); }
+
+    std::ifstream m_file;
+    uint16_t m_version = 0;
+};
+
+} // namespace CallTrace
@@ -67,9 +67,35 @@ bool LoadConfig(AgentConfig& config) {
         config.mp3Bitrate = static_cast<UINT32>(rawBitrate);
     }
 
+    config.flacCompressionLevel = GetIniInt(L"Recording", L"FlacCompressionLevel", config.flacCompressionLevel, iniPath);
+    if (config.flacCompressionLevel < 1) config.flacCompressionLevel = 1;
+    if (config.flacCompressionLevel > 8) config.flacCompressionLevel = 8;
+
+    config.splitStereo = GetIniBool(L"Recording", L"SplitStereo", config.splitStereo, iniPath);
+
+    // Limiter on the mixed recording
+    config.limiterEnabled = GetIniBool(L"Recording", L"LimiterEnabled", config.limiterEnabled, iniPath);
+    std::wstring ceilingStr = GetIniString(L"Recording", L"LimiterCeilingDb", L"-1.0", iniPath);
+    config.limiterCeilingDb = (float)_wtof(ceilingStr.c_str());
+    config.limiterAttackMs  = GetIniInt(L"Recording", L"LimiterAttackMs", config.limiterAttackMs, iniPath);
+    config.limiterReleaseMs = GetIniInt(L"Recording", L"LimiterReleaseMs", config.limiterReleaseMs, iniPath);
+    if (config.limiterCeilingDb < -24.0f) config.limiterCeilingDb = -24.0f;
+    if (config.limiterCeilingDb > 0.0f) config.limiterCeilingDb = 0.0f;
+    if (config.limiterAttackMs < 0) config.limiterAttackMs = 0;
+    if (config.limiterAttackMs > 50) config.limiterAttackMs = 50;
+    if (config.limiterReleaseMs < 1) config.limiterReleaseMs = 1;
+    if (config.limiterReleaseMs > 5000) config.limiterReleaseMs = 5000;
+
     config.pollIntervalSeconds = GetIniInt(L"Monitoring", L"PollInterval", config.pollIntervalSeconds, iniPath);
+    config.idlePollSeconds     = GetIniInt(L"Monitoring", L"IdlePollInterval", config.idlePollSeconds, iniPath);
+    config.burstPollMs         = GetIniInt(L"Monitoring", L"BurstPollMs", config.burstPollMs, iniPath);
     config.silenceThreshold    = GetIniInt(L"Monitoring", L"SilenceThreshold", config.silenceThreshold, iniPath);
     config.startThreshold      = GetIniInt(L"Monitoring", L"StartThreshold", config.startThreshold, iniPath);
+    config.preRollSeconds      = GetIniInt(L"Monitoring", L"PreRollSeconds", config.preRollSeconds, iniPath);
+    config.preRollMemoryMB     = GetIniInt(L"Monitoring", L"PreRollMemoryMB", config.preRollMemoryMB, iniPath);
+    config.voiceDetection      = GetIniBool(L"Monitoring", L"VoiceDetection", config.voiceDetection, iniPath);
+    std::wstring speechStr = GetIniString(L"Monitoring", L"SpeechRatioThreshold", L"0.2", iniPath);
+    config.speechRatioThreshold = (float)_wtof(speechStr.c_str());
     config.minRecordingSeconds = GetIniInt(L"Monitoring", L"MinRecordingSeconds", config.minRecordingSeconds, iniPath);
     config.maxRecordingSeconds = GetIniInt(L"Monitoring", L"MaxRecordingSeconds", config.maxRecordingSeconds, iniPath);
 
@@ -81,10 +107,20 @@ bool LoadConfig(AgentConfig& config) {
 
     if (config.pollIntervalSeconds < 1) config.pollIntervalSeconds = 1;
     if (config.pollIntervalSeconds > 60) config.pollIntervalSeconds = 60;
+    if (config.idlePollSeconds < config.pollIntervalSeconds) config.idlePollSeconds = config.pollIntervalSeconds;
+    if (config.idlePollSeconds > 300) config.idlePollSeconds = 300;
+    if (config.burstPollMs < 500) config.burstPollMs = 500;
+    if (config.burstPollMs > config.pollIntervalSeconds * 1000) config.burstPollMs = config.pollIntervalSeconds * 1000;
     if (config.silenceThreshold < 1) config.silenceThreshold = 1;
     if (config.silenceThreshold > 100) config.silenceThreshold = 100;
     if (config.startThreshold < 1) config.startThreshold = 1;
     if (config.startThreshold > 100) config.startThreshold = 100;
+    if (config.preRollSeconds < 0) config.preRollSeconds = 0;
+    if (config.preRollSeconds > 30) config.preRollSeconds = 30;
+    if (config.preRollMemoryMB < 1) config.preRollMemoryMB = 1;
+    if (config.preRollMemoryMB > 64) config.preRollMemoryMB = 64;
+    if (config.speechRatioThreshold < 0.01f) config.speechRatioThreshold = 0.01f;
+    if (config.speechRatioThreshold > 1.0f) config.speechRatioThreshold = 1.0f;
     if (config.minRecordingSeconds < 0) config.minRecordingSeconds = 0;
     if (config.minRecordingSeconds > 600) config.minRecordingSeconds = 600;
     if (config.maxRecordingSeconds < 60) config.maxRecordingSeconds = 60;
@@ -105,6 +141,7 @@ bool LoadConfig(AgentConfig& config) {
     config.maxLogSizeMB  = GetIniInt(L"Logging", L"MaxLogSizeMB", config.maxLogSizeMB, iniPath);
     if (config.maxLogSizeMB < 1) config.maxLogSizeMB = 1;
     if (config.maxLogSizeMB > 1000) config.maxLogSizeMB = 1000;
+    config.detectorTrace = GetIniBool(L"Logging", L"DetectorTrace", config.detectorTrace, iniPath);
 
     config.hideConsole         = GetIniBool(L"Advanced", L"HideConsole", config.hideConsole, iniPath);
     config.useMutex            = GetIniBool(L"Advanced", L"UseMutex", config.useMutex, iniPath);
@@ -126,9 +163,27 @@ void SaveConfig() {
     WritePrivateProfileStringW(L"Recording", L"RecordingPath", g_config.recordingPath.c_str(), iniPath.c_str());
     WritePrivateProfileStringW(L"Recording", L"AudioFormat", g_config.audioFormat.c_str(), iniPath.c_str());
     WritePrivateProfileStringW(L"Recording", L"MP3Bitrate", std::to_wstring(g_config.mp3Bitrate).c_str(), iniPath.c_str());
+    WritePrivateProfileStringW(L"Recording", L"FlacCompressionLevel", std::to_wstring(g_config.flacCompressionLevel).c_str(), iniPath.c_str());
+    WritePrivateProfileStringW(L"Recording", L"SplitStereo", g_config.splitStereo ? L"true" : L"false", iniPath.c_str());
+
+    // Limiter on the mixed recording
+    wchar_t ceilingBuf[32];
+    swprintf_s(ceilingBuf, 32, L"%.3f", g_config.limiterCeilingDb);
+    WritePrivateProfileStringW(L"Recording", L"LimiterEnabled", g_config.limiterEnabled ? L"true" : L"false", iniPath.c_str());
+    WritePrivateProfileStringW(L"Recording", L"LimiterCeilingDb", ceilingBuf, iniPath.c_str());
+    WritePrivateProfileStringW(L"Recording", L"LimiterAttackMs", std::to_wstring(g_config.limiterAttackMs).c_str(), iniPath.c_str());
+    WritePrivateProfileStringW(L"Recording", L"LimiterReleaseMs", std::to_wstring(g_config.limiterReleaseMs).c_str(), iniPath.c_str());
     WritePrivateProfileStringW(L"Monitoring", L"PollInterval", std::to_wstring(g_config.pollIntervalSeconds).c_str(), iniPath.c_str());
+    WritePrivateProfileStringW(L"Monitoring", L"IdlePollInterval", std::to_wstring(g_config.idlePollSeconds).c_str(), iniPath.c_str());
+    WritePrivateProfileStringW(L"Monitoring", L"BurstPollMs", std::to_wstring(g_config.burstPollMs).c_str(), iniPath.c_str());
     WritePrivateProfileStringW(L"Monitoring", L"SilenceThreshold", std::to_wstring(g_config.silenceThreshold).c_str(), iniPath.c_str());
     WritePrivateProfileStringW(L"Monitoring", L"StartThreshold", std::to_wstring(g_config.startThreshold).c_str(), iniPath.c_str());
+    WritePrivateProfileStringW(L"Monitoring", L"PreRollSeconds", std::to_wstring(g_config.preRollSeconds).c_str(), iniPath.c_str());
+    WritePrivateProfileStringW(L"Monitoring", L"PreRollMemoryMB", std::to_wstring(g_config.preRollMemoryMB).c_str(), iniPath.c_str());
+    wchar_t speechBuf[32];
+    swprintf_s(speechBuf, 32, L"%.2f", g_config.speechRatioThreshold);
+    WritePrivateProfileStringW(L"Monitoring", L"VoiceDetection", g_config.voiceDetection ? L"true" : L"false", iniPath.c_str());
+    WritePrivateProfileStringW(L"Monitoring", L"SpeechRatioThreshold", speechBuf, iniPath.c_str());
     WritePrivateProfileStringW(L"Monitoring", L"MinRecordingSeconds", std::to_wstring(g_config.minRecordingSeconds).c_str(), iniPath.c_str());
     WritePrivateProfileStringW(L"Monitoring", L"MaxRecordingSeconds", std::to_wstring(g_config.maxRecordingSeconds).c_str(), iniPath.c_str());
 
@@ -149,6 +204,7 @@ void SaveConfig() {
     WritePrivateProfileStringW(L"Logging", L"EnableLogging", g_config.enableLogging ? L"true" : L"false", iniPath.c_str());
     WritePrivateProfileStringW(L"Logging", L"LogLevel", g_config.logLevel.c_str(), iniPath.c_str());
     WritePrivateProfileStringW(L"Logging", L"MaxLogSizeMB", std::to_wstring(g_config.maxLogSizeMB).c_str(), iniPath.c_str());
+    WritePrivateProfileStringW(L"Logging", L"DetectorTrace", g_config.detectorTrace ? L"true" : L"false", iniPath.c_str());
     WritePrivateProfileStringW(L"Advanced", L"HideConsole", g_config.hideConsole ? L"true" : L"false", iniPath.c_str());
     WritePrivateProfileStringW(L"Advanced", L"AutoRegisterStartup", g_config.autoRegisterStartup ? L"true" : L"false", iniPath.c_str());
     WritePrivateProfileStringW(L"Advanced", L"ProcessPriority", g_config.processPriority.c_str(), iniPath.c_str());
@@ -9,9 +9,21 @@ struct AgentConfig {
     std::wstring recordingPath = L"";
     std::wstring audioFormat = L"mp3";
     UINT32 mp3Bitrate = 128000;
+    int flacCompressionLevel = 5;    // 1 (fastest) to 8 (smallest files)
+    bool splitStereo = false;         // Mic on the left, application audio on the right
+    bool limiterEnabled = true;       // Mixed recording: look-ahead limiter instead of hard clipping
+    float limiterCeilingDb = -1.0f;
+    int limiterAttackMs = 5;
+    int limiterReleaseMs = 150;
     int pollIntervalSeconds = 2;
+    int idlePollSeconds = 10;        // Poll interval with no target process running
+    int burstPollMs = 1000;          // Poll interval while a call is being detected
     int silenceThreshold = 15;
     int startThreshold = 2;
+    int preRollSeconds = 0;          // Audio kept from before a call is detected (0 = off, opt-in)
+    int preRollMemoryMB = 4;         // Pre-roll memory cap per target process
+    bool voiceDetection = false;     // Start on detected speech in the pre-roll audio, not the peak meter
+    float speechRatioThreshold = 0.2f;   // Share of speech frames in a cycle that counts as voice
     int minRecordingSeconds = 60;
     int maxRecordingSeconds = 7200;  // 2 hours safety net
     float telegramSilencePeakThreshold = 0.03f;
@@ -21,6 +33,7 @@ struct AgentConfig {
     bool enableLogging = true;
     std::wstring logLevel = L"INFO";
     int maxLogSizeMB = 10;
+    bool detectorTrace = false;      // Write logs/detector.trace for CallReplay
     bool hideConsole = true;
     bool useMutex = true;
     std::wstring mutexName = L"Local\\RDPCallRecorderAgentMutex";
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Endpoint changes, as IMMNotificationClient reports them
+enum class DeviceEvent {
+    Added,
+    Removed,
+    StateChanged,
+    DefaultRenderChanged,
+    DefaultCaptureChanged,
+    PropertyChanged,
+};
+
+// Where a DeviceCache gets its devices (IMMDeviceEnumerator on Windows,
+// fakes in tests and benchmarks)
+template <typename Device>
+class DeviceSource {
+public:
+    virtual ~DeviceSource() = default;
+
+    // Get ready to list devices. False if the platform service is missing.
+    virtual bool Open() = 0;
+
+    // Report device changes to `onEvent`, from any thread, until Close().
+    // False if notifications are unavailable.
+    virtual bool Subscribe(std::function<void(DeviceEvent)> onEvent) = 0;
+
+    // Stop notifications and release everything Open() acquired
+    virtual void Close() = 0;
+
+    // Replace `devices` with the active devices, each activated. False if
+    // the list couldn't be read.
+    virtual bool List(std::vector<Device>& devices) = 0;
+
+    // A listed device whose activation succeeded
+    virtual bool IsActivated(const Device& device) const = 0;
+};
+
+struct DeviceCacheStats {
+    uint64_t hits = 0;           // Activated devices served from the cache
+    uint64_t misses = 0;         // Device activations
+    uint64_t invalidations = 0;  // Device notifications and Invalidate() calls
+};
+
+// The active devices, listed and activated once and kept across poll cycles
+// (platform-neutral).
+//
+// A device being added, removed, changing state or becoming the default
+// render device marks the cache stale; the next GetDevices() lists and
+// activates again. Capture default changes and property changes don't.
+// Without notifications every GetDevices() lists again. Callers that see a
+// cached device fail (invalidated before the notification arrived) call
+// Invalidate().
+template <typename Device>
+class DeviceCache {
+public:
+    using Stats = DeviceCacheStats;
+
+    explicit DeviceCache(std::unique_ptr<DeviceSource<Device>> source)
+        : m_source(std::move(source)), m_flags(std::make_shared<Flags>()) {}
+
+    ~DeviceCache() { Reset(); }
+
+    DeviceCache(const DeviceCache&) = delete;
+    DeviceCache& operator=(const DeviceCache&) = delete;
+
+    // Open the source and subscribe to device changes. Called by
+    // GetDevices() as needed.
+    bool Initialize() {
+        if (m_open) return true;
+        if (!m_source->Open()) return false;
+        m_open = true;
+
+        std::shared_ptr<Flags> flags = m_flags;
+        m_notified = m_source->Subscribe([flags](DeviceEvent event) {
+            if (event == DeviceEvent::DefaultCaptureChanged || event == DeviceEvent::PropertyChanged) return;
+            flags->stale = true;
+            flags->invalidations++;
+        });
+        m_flags->stale = true;
+        return true;
+    }
+
+    // Drop the devices and close the source (before CoUninitialize)
+    void Reset() {
+        m_devices.clear();
+        if (m_open) m_source->Close();
+        m_open = false;
+        m_notified = false;
+        m_flags->stale = true;
+    }
+
+    // The cached devices, listed again first if they are stale. The
+    // reference stays valid until the next call.
+    const std::vector<Device>& GetDevices() {
+        if (!Initialize()) {
+            m_devices.clear();
+            return m_devices;
+        }
+
+        if (m_flags->stale.exchange(false) || !m_notified) {
+            Rebuild();
+        } else {
+            for (const Device& device : m_devices) {
+                if (m_source->IsActivated(device)) m_hits++;
+            }
+        }
+        return m_devices;
+    }
+
+    void Invalidate() {
+        m_flags->stale = true;
+        m_flags->invalidations++;
+    }
+
+    // Bumped on every rebuild, so holders of per-device state can tell
+    // when to compare device lists
+    uint64_t GetGeneration() const { return m_generation; }
+
+    Stats GetStats() const {
+        Stats stats;
+        stats.hits = m_hits;
+        stats.misses = m_misses;
+        stats.invalidations = m_flags->invalidations;
+        return stats;
+    }
+
+private:
+    // Shared with the notification callback, which may run until the
+    // source is closed
+    struct Flags {
+        std::atomic<bool> stale{ true };
+        std::atomic<uint64_t> invalidations{ 0 };
+    };
+
+    void Rebuild() {
+        m_devices.clear();
+        m_generation++;
+        if (!m_source->List(m_devices)) {
+            // Try again next time
+            m_devices.clear();
+            m_flags->stale = true;
+            return;
+        }
+        m_misses += m_devices.size();
+    }
+
+    std::unique_ptr<DeviceSource<Device>> m_source;
+    std::shared_ptr<Flags> m_flags;
+    std::vector<Device> m_devices;
+    bool m_open = false;
+    bool m_notified = false;
+    uint64_t m_generation = 0;
+    uint64_t m_hits = 0;
+    uint64_t m_misses = 0;
+};
@@ -42,6 +42,10 @@ static fs::path GetLogDir() {
     return fs::path(GetExePath()).parent_path() / L"logs";
 }
 
+std::wstring GetLogDirectory() {
+    return GetLogDir().wstring();
+}
+
 static void EnsureLogFileOpen(const fs::path& logDir) {
     fs::path logFile = logDir / L"agent.log";
     std::wstring logPath = logFile.wstring();
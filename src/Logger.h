@@ -16,3 +16,6 @@ void InitLogger();
 void Log(const std::wstring& message, LogLevel level = LogLevel::LOG_INFO);
 void UpdateLoggerConfig();
 void CloseLogFile();
+
+// {ExeDir}/logs
+std::wstring GetLogDirectory();
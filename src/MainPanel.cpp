@@ -4,6 +4,7 @@
 #include "Utils.h"
 #include "Logger.h"
 #include "AutoUpdate.h"
+#include "MonitorThread.h"
 #include <commctrl.h>
 #include <shlobj.h>
 #include <shellapi.h>
@@ -585,10 +586,12 @@ static LRESULT CALLBACK PanelWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM
         }
         else if (wmId == IDC_STOP_REC_BTN) {
             g_forceStopRecording = true;
+            WakeMonitorThread();
             Log(L"[UI] Stop Recording button pressed");
         }
         else if (wmId == IDC_START_REC_BTN) {
             g_forceStartRecording = true;
+            WakeMonitorThread();
             Log(L"[UI] Start Recording button pressed");
         }
         return 0;
@@ -5,375 +5,458 @@
 #include "Globals.h"
 #include "ProcessUtils.h"
 #include "AudioMonitor.h"
+#include "AudioSessionTracker.h"
 #include "WindowUtils.h"
 #include "TrayIcon.h"
 #include "MainPanel.h"
 #include "CaptureManager.h"
 #include "ProcessEnumerator.h"
+#include "CallDetector.h"
+#include "CallTrace.h"
+#include "PollScheduler.h"
 #include <roapi.h>
 #include <map>
+#include <memory>
 #include <set>
-#include <deque>
 #include <thread>
 #include <chrono>
 #include <algorithm>
-#include <numeric>
 #include <filesystem>
 
 namespace fs = std::filesystem;
 
 // ============================================================
-// Call detection strategy (hybrid approach):
+// Call detection strategy (hybrid approach): CallDetector decides from
+// each cycle's peak, session state and (Telegram) call window when a
+// target's recording starts and stops; see CallDetector.h for the rules.
 //
-// START recording:
-//   - Telegram: hasRealAudio (audio peak > threshold) + IsTelegramInCall() (window title check)
-//   - Other apps: audio peak detected (startThreshold cycles)
-//
-// STOP recording:
-//   - Telegram: IsTelegramInCall() returns false (call window closed)
-//              OR AudioSessionState becomes Inactive (call ended but chat window stays open)
-//   - Other apps: AudioSessionState becomes Inactive (Windows reports session ended)
-//   - Safety net: MinRecordingSeconds — first N seconds never stop
-//   - Safety net: MaxRecordingSeconds — force stop after N seconds (default 2 hours)
-//   - Fallback: SilenceThreshold with AVERAGE peak (not instant)
-//     Single notification sounds don't reset silence counter
-//     Only sustained audio (real conversation) resets it
-//
-// This eliminates recording fragmentation because:
+// Session state is the primary stop signal, which eliminates recording
+// fragmentation because:
 //   - AudioSessionState stays Active for the entire call duration
 //   - Pauses in conversation do NOT change session state
 //   - Session becomes Inactive only when the call truly ends
 //   - Average peak prevents notification sounds from extending recording
+//
+// SESSIONS: peak and state come from AudioSessionTracker, which follows
+// session notifications and reads only the targets' active meters; a
+// target's session starting or stopping ends the poll wait early.
+//
+// PROCESSES: one Toolhelp snapshot per cycle (ProcessTracker) serves the
+// target list and every parent/name lookup, including force start.
+//
+// DEVICES: render devices and their session managers are activated once
+// (RenderDeviceCache) and dropped only when a device notification says the
+// set changed, instead of resetting the enumerator every 30 seconds.
+//
+// TRACE: with DetectorTrace=true every cycle's observations are written to
+// logs/detector.trace, so tools/CallReplay can run them through CallDetector
+// again with other settings.
+//
+// POLLING: PollScheduler sets the wait after each cycle: long with no
+// target running, short bursts while a call is being detected, PollInterval
+// otherwise. UI force start/stop wakes the thread at once.
+//
+// PRE-ROLL: while a target process isn't recorded, its last PreRollSeconds
+// of audio are kept in memory. StartCapture takes that capture over, so the
+// recording begins before the startThreshold cycles that detected the call.
+//
+// VOICE: with VoiceDetection=true a VoiceActivityDetector runs on that
+// pre-roll capture, and each cycle's share of speech frames replaces the
+// peak meter as the start signal (and counts as sustained audio while
+// recording), so notifications, ringback and music no longer start one.
 // ============================================================
 
+// Raised by session events, the UI and shutdown
+static const std::shared_ptr<WakeSignal> s_monitorWake = std::make_shared<WakeSignal>();
+
+void WakeMonitorThread() {
+    s_monitorWake->Raise(PollScheduler::kRequest);
+}
+
+static uint64_t SteadyMs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 static bool IsTelegramProcess(const std::wstring& name) {
     std::wstring lower = name;
     std::transform(lower.begin(), lower.end(), lower.begin(), ::towlower);
     return lower.find(L"telegram") != std::wstring::npos;
 }
 
+// Running targets without the parents of other targets
+// (Bug 11: e.g. WhatsApp.exe + WhatsApp.Root.exe)
+static std::vector<FoundProcess> GetTargetProcesses(const ProcessTracker& tracker, const ProcessSnapshot& snap) {
+    std::vector<FoundProcess> result;
+    for (const auto& target : tracker.GetTargets())
+        result.push_back({ target.pid, target.name });
+
+    std::set<DWORD> pidsToRemove;
+    for (auto& tp1 : result) {
+        for (auto& tp2 : result) {
+            if (tp1.pid != tp2.pid && IsChildOfProcess(tp1.pid, tp2.pid, snap)) {
+                pidsToRemove.insert(tp2.pid);  // remove parent
+            }
+        }
+    }
+    result.erase(
+        std::remove_if(result.begin(), result.end(),
+            [&](const FoundProcess& fp) { return pidsToRemove.count(fp.pid) > 0; }),
+        result.end());
+    return result;
+}
+
+static PollScheduler::Settings GetPollSettings(const AgentConfig& config) {
+    PollScheduler::Settings settings;
+    settings.idleMs = (uint32_t)config.idlePollSeconds * 1000;
+    settings.pollMs = (uint32_t)config.pollIntervalSeconds * 1000;
+    settings.burstMs = (uint32_t)config.burstPollMs;
+    return settings;
+}
+
+static CallDetector::Settings GetDetectorSettings(const AgentConfig& config) {
+    CallDetector::Settings settings;
+    settings.startThreshold = config.startThreshold;
+    settings.silenceThreshold = config.silenceThreshold;
+    settings.telegramSilenceCycles = config.telegramSilenceCycles;
+    settings.peakHistorySize = config.telegramPeakHistorySize;
+    settings.minRecordingSeconds = config.minRecordingSeconds;
+    settings.maxRecordingSeconds = config.maxRecordingSeconds;
+    settings.peakThreshold = AUDIO_PEAK_THRESHOLD;
+    settings.speechRatioThreshold = config.speechRatioThreshold;
+    return settings;
+}
+
+// logs/detector.trace, the previous one kept as detector.trace.old
+static bool OpenDetectorTrace(CallTrace::Writer& trace) {
+    fs::path logDir = GetLogDirectory();
+    fs::path tracePath = logDir / L"detector.trace";
+    try {
+        fs::create_directories(logDir);
+        fs::path backup = logDir / L"detector.trace.old";
+        if (fs::exists(tracePath)) {
+            if (fs::exists(backup)) fs::remove(backup);
+            fs::rename(tracePath, backup);
+        }
+    } catch (...) {}
+
+    if (!trace.Open(tracePath)) {
+        Log(L"Cannot write detector trace: " + tracePath.wstring(), LogLevel::LOG_WARN);
+        return false;
+    }
+    Log(L"Detector trace: " + tracePath.wstring());
+    return true;
+}
+
+static void LogDetectorStep(const std::wstring& name, const CallDetector::Observation& observation,
+                            const CallDetector::Step& step, const AgentConfig& config) {
+    if (g_logLevel.load(std::memory_order_relaxed) > LogLevel::LOG_DEBUG &&
+        step.reason != CallDetector::Reason::MaxDuration)
+        return;
+
+    const std::wstring pid = std::to_wstring(observation.pid);
+    std::wstring peak = L" peak=" + std::to_wstring(observation.peak);
+    if (observation.speechRatio >= 0.0f) peak += L" speech=" + std::to_wstring(observation.speechRatio);
+    const std::wstring avgPeak = L" avgPeak=" + std::to_wstring(step.averagePeak);
+    const std::wstring session = std::wstring(L" sessionActive=") + (observation.sessionActive ? L"YES" : L"NO");
+    const std::wstring elapsed = L" elapsed=" + std::to_wstring(step.elapsedSeconds) + L"s";
+    const std::wstring counter = std::to_wstring(step.counter);
+
+    switch (step.reason) {
+        case CallDetector::Reason::Counting:
+            if (observation.telegram) {
+                Log(L"[TG] Call detected: PID=" + pid + peak + session + L" callWindow=YES" +
+                    L" count=" + counter + L"/" + std::to_wstring(config.startThreshold), LogLevel::LOG_DEBUG);
+            } else {
+                Log(L"Audio detected: " + name + L" PID=" + pid + peak + session +
+                    L" count=" + counter + L"/" + std::to_wstring(config.startThreshold), LogLevel::LOG_DEBUG);
+            }
+            break;
+        case CallDetector::Reason::TelegramNoAudio:
+            Log(L"[TG] Call window YES but NO audio session: PID=" + pid + peak + session +
+                L" - waiting for audio", LogLevel::LOG_DEBUG);
+            break;
+        case CallDetector::Reason::TelegramNoWindow:
+            Log(L"[TG] Audio but NO call window: PID=" + pid + peak +
+                L" - ignoring (notification/voice msg)", LogLevel::LOG_DEBUG);
+            break;
+        case CallDetector::Reason::Active:
+            if (observation.telegram)
+                Log(L"[TG] Call active: PID=" + pid + peak + avgPeak + session + elapsed, LogLevel::LOG_DEBUG);
+            break;
+        case CallDetector::Reason::Silence:
+            Log(std::wstring(step.decision == CallDetector::Decision::Stop ? L"Fallback silence stop: " : L"Silence: ") +
+                name + L" PID=" + pid + peak + avgPeak + L" silenceCount=" + counter +
+                L"/" + std::to_wstring(config.silenceThreshold) + elapsed, LogLevel::LOG_DEBUG);
+            break;
+        case CallDetector::Reason::SessionInactive:
+            Log(L"Session INACTIVE: " + name + L" PID=" + pid + L" inactiveCount=" + counter + elapsed, LogLevel::LOG_DEBUG);
+            break;
+        case CallDetector::Reason::TelegramWindowGone:
+            Log(L"[TG] Call window GONE: PID=" + pid + L" counter=" + counter +
+                L"/" + std::to_wstring(config.telegramSilenceCycles) + elapsed, LogLevel::LOG_DEBUG);
+            break;
+        case CallDetector::Reason::TelegramSessionInactive:
+            Log(L"[TG] Window open but session INACTIVE: PID=" + pid + L" counter=" + counter +
+                L"/" + std::to_wstring(config.telegramSilenceCycles) + elapsed, LogLevel::LOG_DEBUG);
+            break;
+        case CallDetector::Reason::MinDurationHold:
+            Log(L"Stop blocked by MinRecordingSeconds: " + name + elapsed +
+                L" min=" + std::to_wstring(config.minRecordingSeconds), LogLevel::LOG_DEBUG);
+            break;
+        case CallDetector::Reason::MaxDuration:
+            Log(L"MAX DURATION reached: " + name + L" PID=" + pid + elapsed +
+                L" max=" + std::to_wstring(config.maxRecordingSeconds) + L"s", LogLevel::LOG_WARN);
+            break;
+        default:
+            break;
+    }
+}
+
 void MonitorThread() {
     HRESULT hr = RoInitialize(RO_INIT_MULTITHREADED);
     if (FAILED(hr) && hr != RPC_E_CHANGED_MODE && hr != S_FALSE)
         hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
 
     CaptureManager captureManager;
+    captureManager.SetLogCallback([](const std::wstring& message, bool warning) {
+        Log(L"[Capture] " + message, warning ? LogLevel::LOG_WARN : LogLevel::LOG_INFO);
+    });
     ProcessEnumerator processEnum;
     AudioFormat audioFormat = GetAudioFormatFromConfig();
     AudioSessionMonitor audioMonitor;
 
+    // Session events instead of re-enumerating every cycle; polling stays as the fallback
+    AudioSessionTracker sessionTracker;
+    const bool sessionEvents = sessionTracker.Start();
+    if (sessionEvents)
+        sessionTracker.SetWakeSignal(s_monitorWake);
+    else
+        Log(L"Audio session notifications unavailable, polling sessions instead", LogLevel::LOG_WARN);
+    PollScheduler scheduler;
+
+    // Bug 4: one process snapshot per cycle, shared by every lookup; the
+    // tracker diffs it against the previous one to keep the targets current
+    ProcessTracker processTracker(std::make_unique<ToolhelpProcessSource>());
+    ProcessSnapshot procSnap;
+
+    // Start/stop decisions come from the detector; callState holds what
+    // each recording needs to be stopped and shown in the UI
+    CallDetector detector;
     std::map<DWORD, CallRecordingState> callState;
-    std::map<DWORD, int> silenceCounter;     // fallback silence counter
-    std::map<DWORD, int> inactiveCounter;    // session inactive counter
-    std::map<DWORD, int> startCounter;
-    std::map<DWORD, std::deque<float>> peakHistory;
+    CallTrace::Writer trace;
+    CallDetector::Settings tracedSettings;
+    bool traceNeedsSettings = true;
+    std::vector<CallDetector::Observation> observations;
+    std::vector<DWORD> abortedPids;
+    const auto monitorStart = std::chrono::steady_clock::now();
+    auto traceStart = monitorStart;
     DWORD nextMicSessionId = MIC_SESSION_ID_BASE;
     int activeMixedCount = 0;
+    long long lastCycleMicros = 0;           // Work of the last poll cycle, without the wait
+    bool voiceDetection = false;             // VAD currently enabled on the captures
 
     while (g_running) {
+        const auto cycleStart = std::chrono::steady_clock::now();
+        const double nowSeconds = std::chrono::duration<double>(cycleStart - monitorStart).count();
         AgentConfig config = GetConfigSnapshot();
+        PollScheduler::Activity pollActivity;
         try {
             audioFormat = GetAudioFormatFromConfig();
 
             // Bug 9: update cached logger config each cycle
             UpdateLoggerConfig();
 
-            // Bug 4: one snapshot per cycle for all process lookups
-            ProcessSnapshot procSnap;
-            procSnap.Refresh();
-
-            // Bug 3: periodically reset WASAPI enumerator (~30 sec)
-            static int deviceResetCounter = 0;
-            if (++deviceResetCounter >= 15) {
-                deviceResetCounter = 0;
-                audioMonitor.Reset();
+            const CallDetector::Settings detectorSettings = GetDetectorSettings(config);
+            detector.SetSettings(detectorSettings);
+            if (voiceDetection != (config.voiceDetection && config.preRollSeconds > 0)) {
+                voiceDetection = !voiceDetection;
+                captureManager.EnableVoiceActivity(voiceDetection);
             }
-
-            std::vector<FoundProcess> targetProcs = FindTargetProcesses(config);
-
-            // Bug 11: deduplicate parent/child (e.g. WhatsApp.exe + WhatsApp.Root.exe)
-            {
-                std::set<DWORD> pidsToRemove;
-                for (auto& tp1 : targetProcs) {
-                    for (auto& tp2 : targetProcs) {
-                        if (tp1.pid != tp2.pid && IsChildOfProcess(tp1.pid, tp2.pid, procSnap)) {
-                            pidsToRemove.insert(tp2.pid);  // remove parent
-                        }
+            if (!config.detectorTrace) {
+                trace.Close();
+            } else if (!trace.IsOpen() || trace.Size() > (uint64_t)config.maxLogSizeMB * 1024 * 1024) {
+                if (OpenDetectorTrace(trace)) {
+                    traceStart = cycleStart;
+                    traceNeedsSettings = true;
+                }
+            }
+            if (trace.IsOpen() && (traceNeedsSettings || detectorSettings != tracedSettings)) {
+                trace.WriteSettings(detectorSettings);
+                tracedSettings = detectorSettings;
+
+                // A new file (first or rotated) starts with the recordings
+                // already running, so a replay of it alone knows about them
+                if (traceNeedsSettings) {
+                    for (const auto& [pid, cs] : callState) {
+                        if (detector.IsRecording(pid)) trace.WriteControl(CallTrace::Action::MarkRecording, pid);
                     }
                 }
-                targetProcs.erase(
-                    std::remove_if(targetProcs.begin(), targetProcs.end(),
-                        [&](const FoundProcess& fp) { return pidsToRemove.count(fp.pid) > 0; }),
-                    targetProcs.end());
+                traceNeedsSettings = false;
+            }
+
+            processTracker.SetTargets(config.targetProcesses);
+            if (!processTracker.Refresh(procSnap.table))
+                Log(L"Process snapshot failed, keeping the previous targets", LogLevel::LOG_WARN);
+            for (const auto& event : processTracker.GetEvents()) {
+                Log(std::wstring(event.type == ProcessTracker::Event::Started ? L"Target started: " : L"Target exited: ") +
+                    event.name + L" PID=" + std::to_wstring(event.pid), LogLevel::LOG_DEBUG);
             }
 
+            std::vector<FoundProcess> targetProcs = GetTargetProcesses(processTracker, procSnap);
+            pollActivity.targets = targetProcs.size();
+
             std::set<DWORD> currentPids;
 
             for (auto& tp : targetProcs)
                 Log(L"[DIAG] Found target: " + tp.name + L" PID=" + std::to_wstring(tp.pid), LogLevel::LOG_DEBUG);
 
             static int diagCounter = 0;
-            if (++diagCounter >= 15) { diagCounter = 0; audioMonitor.DumpAudioSessions(procSnap); }
+            if (++diagCounter >= 15) {
+                diagCounter = 0;
+                audioMonitor.DumpAudioSessions(procSnap);
+
+                // The previous cycle: this one is slowed down by the dump
+                const RenderDeviceCache::Stats cacheStats = sessionEvents
+                    ? sessionTracker.GetDeviceCacheStats()
+                    : audioMonitor.GetDeviceCacheStats();
+                Log(L"[DIAG] Poll cycle " + std::to_wstring(lastCycleMicros) + L" us; device cache hits=" +
+                    std::to_wstring(cacheStats.hits) + L" misses=" + std::to_wstring(cacheStats.misses) +
+                    L" invalidations=" + std::to_wstring(cacheStats.invalidations), LogLevel::LOG_DEBUG);
+
+                const PollScheduler::Stats& pollStats = scheduler.GetStats();
+                Log(L"[DIAG] Poll mode " + std::wstring(PollScheduler::ModeName(scheduler.GetMode())) + L", " +
+                    std::to_wstring((int)scheduler.GetWakeupsPerHour(SteadyMs())) + L" wakeups/h (timeout=" +
+                    std::to_wstring(pollStats.timeouts) + L" session=" + std::to_wstring(pollStats.sessionWakes) +
+                    L" request=" + std::to_wstring(pollStats.requestWakes) + L")", LogLevel::LOG_DEBUG);
+
+                const EncoderWorkerPool::Stats encoderStats = captureManager.GetEncoderStats();
+                Log(L"[DIAG] Encoders: packets=" + std::to_wstring(encoderStats.packetsWritten) +
+                    L" queued=" + std::to_wstring(encoderStats.bytesQueued) + L" bytes backpressure=" +
+                    std::to_wstring(encoderStats.backpressureEvents) + L" rejected=" +
+                    std::to_wstring(encoderStats.rejectedPackets) + L" failures=" +
+                    std::to_wstring(encoderStats.writeFailures), LogLevel::LOG_DEBUG);
+            }
 
+            // Peak and state of every target's sessions for this cycle
+            std::vector<DWORD> targetPids;
+            for (auto& tp : targetProcs) targetPids.push_back(tp.pid);
+            const SessionActivityTable& sessionTable = sessionEvents
+                ? sessionTracker.Sample(targetPids, procSnap)
+                : audioMonitor.ScanAllSessions(procSnap);
+
+            observations.clear();
+            abortedPids.clear();
             for (auto& tp : targetProcs) {
                 DWORD pid = tp.pid;
                 std::wstring name = tp.name;
                 currentPids.insert(pid);
 
+                auto& cs = callState[pid];
                 bool isTelegram = IsTelegramProcess(name);
-                // Bug 4: use snapshot-based overloads
-                float currentPeak = audioMonitor.GetProcessPeakLevel(pid, procSnap);
-                bool hasRealAudio = (currentPeak > AUDIO_PEAK_THRESHOLD);
-                bool sessionActive = audioMonitor.IsSessionActive(pid, procSnap);
+                SessionActivity activity = sessionTable.Find(pid);
 
-                // For Telegram: check if call window exists
-                bool telegramCallActive = false;
-                if (isTelegram) {
-                    telegramCallActive = IsTelegramInCall(pid);
-                }
+                // Speech in what its capture delivered since the last cycle
+                // (-1 without a detector or before its first frame)
+                VoiceActivityDetector::Counts speech;
+                const float speechRatio = captureManager.TakeVoiceActivity(pid, speech) ? speech.GetRatio() : -1.0f;
 
-                // Maintain rolling peak history
-                auto& history = peakHistory[pid];
-                history.push_back(currentPeak);
-                if ((int)history.size() > config.telegramPeakHistorySize)
-                    history.pop_front();
+                // For Telegram: check if call window exists
+                const CallDetector::Observation observation = {
+                    pid, activity.peak, activity.active, isTelegram, isTelegram && IsTelegramInCall(pid), speechRatio };
+                observations.push_back(observation);
 
-                // ===== START RECORDING =====
-                if (!callState[pid].isRecording) {
-                    bool shouldStart = false;
-
-                    if (isTelegram) {
-                        // Telegram: require call window + REAL audio from Telegram's process
-                        // Previously used (sessionActive || hasRealAudio), but sessionActive alone
-                        // caused false positives: Telegram can hold an Active audio session from
-                        // notifications while another app (MicroSIP, etc.) produces the actual sound.
-                        // Now we require actual audio peak from Telegram's process to avoid this.
-                        bool telegramAudioProof = hasRealAudio;
-
-                        if (telegramAudioProof && telegramCallActive) {
-                            startCounter[pid]++;
-                            Log(L"[TG] Call detected: PID=" + std::to_wstring(pid) +
-                                L" peak=" + std::to_wstring(currentPeak) +
-                                L" sessionActive=" + (sessionActive ? L"YES" : L"NO") +
-                                L" callWindow=YES" +
-                                L" count=" + std::to_wstring(startCounter[pid]) + L"/" + std::to_wstring(config.startThreshold), LogLevel::LOG_DEBUG);
-                            if (startCounter[pid] >= config.startThreshold)
-                                shouldStart = true;
-                        } else if (telegramCallActive && !telegramAudioProof) {
-                            // Call window present but no audio session yet
-                            if (startCounter[pid] > 0) startCounter[pid]--;
-                            Log(L"[TG] Call window YES but NO audio session: PID=" + std::to_wstring(pid) +
-                                L" peak=" + std::to_wstring(currentPeak) +
-                                L" sessionActive=" + (sessionActive ? L"YES" : L"NO") +
-                                L" - waiting for audio", LogLevel::LOG_DEBUG);
-                        } else {
-                            if (startCounter[pid] > 0) startCounter[pid]--;
-                            if (hasRealAudio && !telegramCallActive) {
-                                Log(L"[TG] Audio but NO call window: PID=" + std::to_wstring(pid) +
-                                    L" peak=" + std::to_wstring(currentPeak) +
-                                    L" - ignoring (notification/voice msg)", LogLevel::LOG_DEBUG);
-                            }
-                        }
-                    } else {
-                        // Non-Telegram: use audio peak + session state for start
-                        if (hasRealAudio && sessionActive) {
-                            startCounter[pid]++;
-                            Log(L"Audio detected: " + name + L" PID=" + std::to_wstring(pid) +
-                                L" peak=" + std::to_wstring(currentPeak) +
-                                L" sessionActive=YES" +
-                                L" count=" + std::to_wstring(startCounter[pid]) + L"/" + std::to_wstring(config.startThreshold), LogLevel::LOG_DEBUG);
-                            if (startCounter[pid] >= config.startThreshold)
-                                shouldStart = true;
-                        } else {
-                            if (startCounter[pid] > 0) startCounter[pid]--;
-                        }
-                    }
+                // Keep the last seconds of its audio so the recording
+                // includes what played while the call was being detected
+                if (!detector.IsRecording(pid) && config.preRollSeconds > 0)
+                    captureManager.StartPreRoll(pid, config.preRollSeconds, (size_t)config.preRollMemoryMB * 1024 * 1024);
 
-                    if (!shouldStart) {
-                        // Bug 7: don't let peakHistory grow unbounded for non-recording processes
-                        if (peakHistory[pid].size() > (size_t)config.telegramPeakHistorySize * 2)
-                            peakHistory[pid].clear();
-                        continue;
-                    }
+                const CallDetector::Step step = detector.Observe(observation, nowSeconds);
+                LogDetectorStep(name, observation, step, config);
+                if (step.reason == CallDetector::Reason::Counting || step.reason == CallDetector::Reason::TelegramNoAudio)
+                    pollActivity.rampingUp = true;
 
-                    // === Begin recording ===
-                    startCounter[pid] = 0;
-                    silenceCounter[pid] = 0;
-                    inactiveCounter[pid] = 0;
+                // ===== START RECORDING =====
+                if (step.decision == CallDetector::Decision::Start) {
                     std::wstring outputPath = BuildOutputPath(name, audioFormat);
                     DWORD micSessId = nextMicSessionId++;
                     if (nextMicSessionId >= 0xFFFFFFFF) nextMicSessionId = MIC_SESSION_ID_BASE;
+                    const UINT32 quality = GetEncoderQualityFromConfig(config, audioFormat);
 
-                    bool procStarted = captureManager.StartCapture(pid, name, outputPath, audioFormat, config.mp3Bitrate, false, L"", true);
-                    if (!procStarted) { Log(L"REC FAIL (process): " + name, LogLevel::LOG_ERROR); continue; }
+                    bool procStarted = captureManager.StartCapture(pid, name, outputPath, audioFormat, quality, false, L"", true);
+                    if (!procStarted) {
+                        Log(L"REC FAIL (process): " + name, LogLevel::LOG_ERROR);
+                        detector.Abort(pid);
+                        abortedPids.push_back(pid);
+                        continue;
+                    }
 
                     bool micStarted = false;
                     MicInfo mic = GetDefaultMicrophone();
                     if (mic.found) {
                         micStarted = captureManager.StartCaptureFromDevice(micSessId, mic.friendlyName, mic.deviceId, true,
-                            outputPath, audioFormat, config.mp3Bitrate, false, true);
+                            outputPath, audioFormat, quality, false, true);
                         if (!micStarted) Log(L"Mic capture failed: " + mic.friendlyName, LogLevel::LOG_WARN);
                     }
 
-                    bool mixedOk = captureManager.EnableMixedRecording(outputPath, audioFormat, config.mp3Bitrate);
+                    captureManager.SetMixLimiter(GetLimiterSettingsFromConfig(config));
+                    bool mixedOk = config.splitStereo
+                        ? captureManager.EnableSplitStereoRecording(outputPath, audioFormat, quality)
+                        : captureManager.EnableMixedRecording(outputPath, audioFormat, quality);
                     if (!mixedOk) {
                         Log(L"Mixed recording failed, falling back to process-only", LogLevel::LOG_WARN);
                         captureManager.StopCapture(pid);
                         if (micStarted) captureManager.StopCapture(micSessId);
-                        bool directStarted = captureManager.StartCapture(pid, name, outputPath, audioFormat, config.mp3Bitrate, false, L"", false);
-                        if (!directStarted) { Log(L"REC FAIL (fallback): " + name, LogLevel::LOG_ERROR); continue; }
+                        bool directStarted = captureManager.StartCapture(pid, name, outputPath, audioFormat, quality, false, L"", false);
+                        if (!directStarted) {
+                            Log(L"REC FAIL (fallback): " + name, LogLevel::LOG_ERROR);
+                            detector.Abort(pid);
+                            abortedPids.push_back(pid);
+                            continue;
+                        }
                         micSessId = 0;
                     }
 
-                    callState[pid] = { true, outputPath, name, pid, micStarted ? micSessId : (DWORD)0, mixedOk,
-                                       std::chrono::steady_clock::now() };
+                    cs = { true, outputPath, name, pid, micStarted ? micSessId : (DWORD)0, mixedOk,
+                           std::chrono::steady_clock::now() };
                     g_activeRecordings++;
                     if (mixedOk) activeMixedCount++;
                     Log(L"REC START: " + name + L" PID=" + std::to_wstring(pid) + L" -> " + outputPath);
                     UpdateTrayTooltip();
                     ShowTrayBalloon(L"Recording Started", name + L" — call recording in progress");
 
-                } else if (callState[pid].isRecording) {
+                } else if (step.decision == CallDetector::Decision::Stop && cs.isRecording) {
                     // ===== STOP RECORDING =====
-                    bool shouldStop = false;
-                    auto& cs = callState[pid];
-
-                    // Calculate how long we've been recording
-                    auto elapsed = std::chrono::steady_clock::now() - cs.startTime;
-                    int elapsedSeconds = (int)std::chrono::duration_cast<std::chrono::seconds>(elapsed).count();
-                    bool pastMinDuration = (elapsedSeconds >= config.minRecordingSeconds);
-                    bool pastMaxDuration = (elapsedSeconds >= config.maxRecordingSeconds);
-
-                    // Safety net: force stop if recording exceeds max duration
-                    if (pastMaxDuration) {
-                        Log(L"MAX DURATION reached: " + name + L" PID=" + std::to_wstring(pid) +
-                            L" elapsed=" + std::to_wstring(elapsedSeconds) +
-                            L"s max=" + std::to_wstring(config.maxRecordingSeconds) + L"s", LogLevel::LOG_WARN);
-                        shouldStop = true;
+                    if (cs.mixedEnabled) {
+                        activeMixedCount--;
+                        if (activeMixedCount <= 0) { captureManager.DisableMixedRecording(); activeMixedCount = 0; }
                     }
+                    if (cs.micSessionId != 0) captureManager.StopCapture(cs.micSessionId);
+                    captureManager.StopCapture(pid);
 
-                    // Calculate average peak from rolling history for smarter silence detection
-                    // Single notification sounds won't reset silence counter
-                    float avgPeak = 0.0f;
-                    auto& hist = peakHistory[pid];
-                    if (!hist.empty()) {
-                        avgPeak = std::accumulate(hist.begin(), hist.end(), 0.0f) / (float)hist.size();
-                    }
-                    bool hasSustainedAudio = (avgPeak > AUDIO_PEAK_THRESHOLD);
-
-                    if (!shouldStop && isTelegram) {
-                        // Telegram STOP: two signals (either one triggers stop)
-                        // 1. Call window disappeared (telegramCallActive=false)
-                        // 2. Audio session became Inactive (call ended but chat window stays open)
-                        bool tgSessionInactive = !sessionActive;
-
-                        if (!telegramCallActive) {
-                            // Signal 1: call window gone
-                            inactiveCounter[pid]++;
-                            Log(L"[TG] Call window GONE: PID=" + std::to_wstring(pid) +
-                                L" counter=" + std::to_wstring(inactiveCounter[pid]) +
-                                L"/" + std::to_wstring(config.telegramSilenceCycles) +
-                                L" elapsed=" + std::to_wstring(elapsedSeconds) + L"s", LogLevel::LOG_DEBUG);
-                            if (inactiveCounter[pid] >= config.telegramSilenceCycles)
-                                shouldStop = true;
-                        } else if (tgSessionInactive) {
-                            // Signal 2: window still open (chat window) but audio session is dead
-                            // This happens when call ends but chat remains open
-                            inactiveCounter[pid]++;
-                            Log(L"[TG] Window open but session INACTIVE: PID=" + std::to_wstring(pid) +
-                                L" counter=" + std::to_wstring(inactiveCounter[pid]) +
-                                L"/" + std::to_wstring(config.telegramSilenceCycles) +
-                                L" elapsed=" + std::to_wstring(elapsedSeconds) + L"s", LogLevel::LOG_DEBUG);
-                            if (inactiveCounter[pid] >= config.telegramSilenceCycles)
-                                shouldStop = true;
-                        } else {
-                            inactiveCounter[pid] = 0;
-                            Log(L"[TG] Call active: PID=" + std::to_wstring(pid) +
-                                L" peak=" + std::to_wstring(currentPeak) +
-                                L" avgPeak=" + std::to_wstring(avgPeak) +
-                                L" sessionActive=YES" +
-                                L" elapsed=" + std::to_wstring(elapsedSeconds) + L"s", LogLevel::LOG_DEBUG);
-                        }
-                    } else if (!shouldStop) {
-                        // Non-Telegram: PRIMARY stop signal is AudioSessionState becoming Inactive
-                        if (!sessionActive) {
-                            // Session is Inactive — call likely ended
-                            inactiveCounter[pid]++;
-                            silenceCounter[pid] = 0;
-                            Log(L"Session INACTIVE: " + name + L" PID=" + std::to_wstring(pid) +
-                                L" inactiveCount=" + std::to_wstring(inactiveCounter[pid]) +
-                                L" elapsed=" + std::to_wstring(elapsedSeconds) + L"s", LogLevel::LOG_DEBUG);
-
-                            // Wait a few cycles to confirm (session might briefly go inactive)
-                            if (inactiveCounter[pid] >= 3 && pastMinDuration)
-                                shouldStop = true;
-                        } else {
-                            // Session still Active — call ongoing
-                            inactiveCounter[pid] = 0;
-
-                            // Fallback: use AVERAGE peak instead of instant peak
-                            // This prevents single notification sounds from resetting the silence counter
-                            // Only sustained audio (real conversation) resets the counter
-                            if (!hasSustainedAudio) {
-                                silenceCounter[pid]++;
-                                Log(L"Silence: " + name + L" PID=" + std::to_wstring(pid) +
-                                    L" peak=" + std::to_wstring(currentPeak) +
-                                    L" avgPeak=" + std::to_wstring(avgPeak) +
-                                    L" silenceCount=" + std::to_wstring(silenceCounter[pid]) +
-                                    L"/" + std::to_wstring(config.silenceThreshold) +
-                                    L" elapsed=" + std::to_wstring(elapsedSeconds) + L"s", LogLevel::LOG_DEBUG);
-                                if (silenceCounter[pid] >= config.silenceThreshold && pastMinDuration) {
-                                    Log(L"Fallback silence stop: " + name + L" PID=" + std::to_wstring(pid) +
-                                        L" silenceCount=" + std::to_wstring(silenceCounter[pid]) +
-                                        L" avgPeak=" + std::to_wstring(avgPeak) +
-                                        L" elapsed=" + std::to_wstring(elapsedSeconds) + L"s", LogLevel::LOG_DEBUG);
-                                    shouldStop = true;
-                                }
-                            } else {
-                                silenceCounter[pid] = 0;
-                            }
+                    // Bug 15: delete tiny/empty recordings (likely false triggers)
+                    try {
+                        auto fileSize = fs::file_size(cs.outputPath);
+                        if (fileSize < 10000) {  // < 10KB — not a real recording
+                            fs::remove(cs.outputPath);
+                            Log(L"Deleted tiny recording (" + std::to_wstring(fileSize) +
+                                L" bytes): " + cs.outputPath, LogLevel::LOG_WARN);
                         }
-                    }
-
-                    // MinRecordingSeconds protection — don't stop too early
-                    if (shouldStop && !pastMinDuration && !pastMaxDuration) {
-                        Log(L"Stop blocked by MinRecordingSeconds: " + name +
-                            L" elapsed=" + std::to_wstring(elapsedSeconds) +
-                            L" min=" + std::to_wstring(config.minRecordingSeconds), LogLevel::LOG_DEBUG);
-                        shouldStop = false;
-                    }
+                    } catch (...) {}
 
-                    if (shouldStop) {
-                        if (cs.mixedEnabled) {
-                            activeMixedCount--;
-                            if (activeMixedCount <= 0) { captureManager.DisableMixedRecording(); activeMixedCount = 0; }
-                        }
-                        if (cs.micSessionId != 0) captureManager.StopCapture(cs.micSessionId);
-                        captureManager.StopCapture(pid);
-
-                        // Bug 15: delete tiny/empty recordings (likely false triggers)
-                        try {
-                            auto fileSize = fs::file_size(cs.outputPath);
-                            if (fileSize < 10000) {  // < 10KB — not a real recording
-                                fs::remove(cs.outputPath);
-                                Log(L"Deleted tiny recording (" + std::to_wstring(fileSize) +
-                                    L" bytes): " + cs.outputPath, LogLevel::LOG_WARN);
-                            }
-                        } catch (...) {}
-
-                        Log(L"REC STOP: " + cs.processName + L" PID=" + std::to_wstring(pid) +
-                            L" duration=" + std::to_wstring(elapsedSeconds) + L"s -> " + cs.outputPath);
-                        ShowTrayBalloon(L"Recording Stopped", cs.processName + L" — recording saved");
-                        cs = {};
-                        silenceCounter[pid] = 0;
-                        inactiveCounter[pid] = 0;
-                        peakHistory.erase(pid);
-                        g_activeRecordings--;
-                        UpdateTrayTooltip();
-                    }
+                    Log(L"REC STOP: " + cs.processName + L" PID=" + std::to_wstring(pid) +
+                        L" duration=" + std::to_wstring(step.elapsedSeconds) + L"s -> " + cs.outputPath);
+                    ShowTrayBalloon(L"Recording Stopped", cs.processName + L" — recording saved");
+                    cs = {};
+                    g_activeRecordings--;
+                    UpdateTrayTooltip();
                 }
             }
 
+            trace.WriteCycle((uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(cycleStart - traceStart).count(),
+                             observations);
+            for (DWORD p : abortedPids) trace.WriteControl(CallTrace::Action::Abort, p);
+
             std::vector<DWORD> toRemove;
             for (auto& [pid, cs] : callState) {
                 if (currentPids.find(pid) == currentPids.end()) {
@@ -404,9 +487,12 @@ void MonitorThread() {
                 }
             }
             for (DWORD p : toRemove) {
-                callState.erase(p); silenceCounter.erase(p); startCounter.erase(p);
-                peakHistory.erase(p); inactiveCounter.erase(p);
+                callState.erase(p);
+                detector.Remove(p);
+                trace.WriteControl(CallTrace::Action::Remove, p);
+                captureManager.StopPreRoll(p);
             }
+            if (config.preRollSeconds <= 0) captureManager.StopAllPreRolls();
             UpdateTrayTooltip();
 
             // Push active recordings to shared StatusData for UI
@@ -436,24 +522,9 @@ void MonitorThread() {
         if (g_forceStartRecording.exchange(false)) {
             Log(L"[UI] Force start recording requested");
             AgentConfig cfgStart = GetConfigSnapshot();
-            std::vector<FoundProcess> forceProcs = FindTargetProcesses(cfgStart);
-
-            // Deduplicate parent/child (same as main loop) to avoid recording from wrong process
-            // Use legacy IsChildOfProcess (no snapshot) since procSnap is out of scope here
-            {
-                std::set<DWORD> pidsToRemove;
-                for (auto& tp1 : forceProcs) {
-                    for (auto& tp2 : forceProcs) {
-                        if (tp1.pid != tp2.pid && IsChildOfProcess(tp1.pid, tp2.pid)) {
-                            pidsToRemove.insert(tp2.pid);
-                        }
-                    }
-                }
-                forceProcs.erase(
-                    std::remove_if(forceProcs.begin(), forceProcs.end(),
-                        [&](const FoundProcess& fp) { return pidsToRemove.count(fp.pid) > 0; }),
-                    forceProcs.end());
-            }
+            // This cycle's snapshot and targets, deduplicated as in the main loop
+            // to avoid recording from the wrong process
+            std::vector<FoundProcess> forceProcs = GetTargetProcesses(processTracker, procSnap);
 
             for (auto& tp : forceProcs) {
                 DWORD pid = tp.pid;
@@ -461,30 +532,36 @@ void MonitorThread() {
                 std::wstring outputPath = BuildOutputPath(tp.name, audioFormat);
                 DWORD micSessId = nextMicSessionId++;
                 if (nextMicSessionId >= 0xFFFFFFFF) nextMicSessionId = MIC_SESSION_ID_BASE;
+                const UINT32 quality = GetEncoderQualityFromConfig(cfgStart, audioFormat);
 
-                bool procStarted = captureManager.StartCapture(pid, tp.name, outputPath, audioFormat, cfgStart.mp3Bitrate, false, L"", true);
+                bool procStarted = captureManager.StartCapture(pid, tp.name, outputPath, audioFormat, quality, false, L"", true);
                 if (!procStarted) { Log(L"REC FAIL (forced): " + tp.name, LogLevel::LOG_ERROR); continue; }
 
                 bool micStarted = false;
                 MicInfo mic = GetDefaultMicrophone();
                 if (mic.found) {
                     micStarted = captureManager.StartCaptureFromDevice(micSessId, mic.friendlyName, mic.deviceId, true,
-                        outputPath, audioFormat, cfgStart.mp3Bitrate, false, true);
+                        outputPath, audioFormat, quality, false, true);
                     if (!micStarted) Log(L"Mic capture failed: " + mic.friendlyName, LogLevel::LOG_WARN);
                 }
 
-                bool mixedOk = captureManager.EnableMixedRecording(outputPath, audioFormat, cfgStart.mp3Bitrate);
+                captureManager.SetMixLimiter(GetLimiterSettingsFromConfig(cfgStart));
+                bool mixedOk = cfgStart.splitStereo
+                    ? captureManager.EnableSplitStereoRecording(outputPath, audioFormat, quality)
+                    : captureManager.EnableMixedRecording(outputPath, audioFormat, quality);
                 if (!mixedOk) {
                     Log(L"Mixed recording failed, falling back to process-only", LogLevel::LOG_WARN);
                     captureManager.StopCapture(pid);
                     if (micStarted) captureManager.StopCapture(micSessId);
-                    bool directStarted = captureManager.StartCapture(pid, tp.name, outputPath, audioFormat, cfgStart.mp3Bitrate, false, L"", false);
+                    bool directStarted = captureManager.StartCapture(pid, tp.name, outputPath, audioFormat, quality, false, L"", false);
                     if (!directStarted) { Log(L"REC FAIL (forced fallback): " + tp.name, LogLevel::LOG_ERROR); continue; }
                     micSessId = 0;
                 }
 
                 callState[pid] = { true, outputPath, tp.name, pid, micStarted ? micSessId : (DWORD)0, mixedOk,
                                    std::chrono::steady_clock::now() };
+                detector.MarkRecording(pid, nowSeconds);
+                trace.WriteControl(CallTrace::Action::MarkRecording, pid);
                 g_activeRecordings++;
                 if (mixedOk) activeMixedCount++;
                 Log(L"REC START (forced): " + tp.name + L" PID=" + std::to_wstring(pid) + L" -> " + outputPath);
@@ -510,20 +587,31 @@ void MonitorThread() {
                 }
             }
             callState.clear();
-            silenceCounter.clear();
-            inactiveCounter.clear();
-            startCounter.clear();
-            peakHistory.clear();
+            detector.Clear();
+            trace.WriteControl(CallTrace::Action::Clear, 0);
             g_statusData.SetRecordings({});
             UpdateTrayTooltip();
         }
 
+        lastCycleMicros = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - cycleStart).count();
+
         // Bug 6: reuse config from beginning of cycle (declared before try block)
-        for (int i = 0; i < config.pollIntervalSeconds * 10 && g_running; i++)
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        for (auto& [pid, cs] : callState) {
+            if (cs.isRecording) pollActivity.recording++;
+        }
+        scheduler.SetSettings(GetPollSettings(config));
+        scheduler.Plan(pollActivity, SteadyMs());
+        uint32_t pendingWakes = 0;
+        while (g_running && !scheduler.ShouldWake(pendingWakes, SteadyMs())) {
+            pendingWakes |= s_monitorWake->Wait(
+                std::chrono::milliseconds(scheduler.GetSleepMs(pendingWakes, SteadyMs())));
+        }
     }
 
     captureManager.DisableMixedRecording();
     captureManager.StopAllCaptures();
+    sessionTracker.Stop();
+    audioMonitor.Reset();
     RoUninitialize();
 }
@@ -15,3 +15,6 @@ struct CallRecordingState {
 };
 
 void MonitorThread();
+
+// End the monitor's wait now (force start/stop requested, shutting down)
+void WakeMonitorThread();
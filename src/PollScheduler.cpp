@@ -0,0 +1,95 @@
+#include "PollScheduler.h"
+#include <algorithm>
+
+// ============================================================
+// PollScheduler
+// ============================================================
+
+void PollScheduler::Plan(const Activity& activity, uint64_t nowMs) {
+    if (!m_planned) {
+        m_planned = true;
+        m_firstPlan = nowMs;
+    }
+
+    // A burst is cut off after maxBurstCycles (audio that never turns
+    // into a start) until the target stops ramping up
+    if (!activity.rampingUp) m_burstCycles = 0;
+
+    uint32_t intervalMs;
+    if (activity.rampingUp && m_burstCycles < m_settings.maxBurstCycles) {
+        m_burstCycles++;
+        m_mode = Mode::Burst;
+        intervalMs = (std::min)(m_settings.burstMs, m_settings.pollMs);
+    } else if (activity.recording > 0) {
+        m_mode = Mode::Recording;
+        intervalMs = m_settings.pollMs;
+    } else if (activity.targets > 0) {
+        m_mode = Mode::Watching;
+        intervalMs = m_settings.pollMs;
+    } else {
+        m_mode = Mode::Idle;
+        intervalMs = (std::max)(m_settings.idleMs, m_settings.pollMs);
+    }
+
+    m_waitStart = nowMs;
+    m_deadline = nowMs + intervalMs;
+}
+
+bool PollScheduler::ShouldWake(uint32_t pending, uint64_t nowMs) {
+    if (pending & kRequest) {
+        m_stats.requestWakes++;
+    } else if (nowMs >= m_deadline) {
+        m_stats.timeouts++;
+    } else if ((pending & kSessionChange) && nowMs >= m_waitStart + m_settings.minGapMs) {
+        m_stats.sessionWakes++;
+    } else {
+        return false;
+    }
+
+    m_stats.wakeups++;
+    m_stats.modeWakeups[static_cast<int>(m_mode)]++;
+    return true;
+}
+
+uint64_t PollScheduler::GetSleepMs(uint32_t pending, uint64_t nowMs) const {
+    if (pending & kRequest) return 0;
+
+    uint64_t until = m_deadline;
+    if (pending & kSessionChange) until = (std::min)(until, m_waitStart + m_settings.minGapMs);
+    return until > nowMs ? until - nowMs : 0;
+}
+
+double PollScheduler::GetWakeupsPerHour(uint64_t nowMs) const {
+    if (!m_planned || nowMs <= m_firstPlan) return 0.0;
+    return (double)m_stats.wakeups * 3600000.0 / (double)(nowMs - m_firstPlan);
+}
+
+const wchar_t* PollScheduler::ModeName(Mode mode) {
+    switch (mode) {
+        case Mode::Idle: return L"idle";
+        case Mode::Watching: return L"watching";
+        case Mode::Burst: return L"burst";
+        case Mode::Recording: return L"recording";
+    }
+    return L"?";
+}
+
+// ============================================================
+// WakeSignal
+// ============================================================
+
+void WakeSignal::Raise(uint32_t wakes) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending |= wakes;
+    }
+    m_raised.notify_all();
+}
+
+uint32_t WakeSignal::Wait(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_raised.wait_for(lock, timeout, [this] { return m_pending != 0; });
+    const uint32_t wakes = m_pending;
+    m_pending = 0;
+    return wakes;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+// How long MonitorThread waits between poll cycles, from what the last
+// cycle saw (platform-neutral; time is passed in as milliseconds of a
+// monotonic clock, so it runs on a virtual one too).
+//
+//   Idle       no target process running: idleMs (session events still wake it)
+//   Watching   targets running, nothing happening: pollMs
+//   Burst      a target not recorded yet is counting up to a start (or
+//              Telegram is ringing): burstMs, so startThreshold cycles pass
+//              quickly; at most maxBurstCycles in a row. startThreshold x
+//              burstMs is then the shortest sound that starts a recording.
+//   Recording  pollMs: the stop thresholds are counted in cycles of it
+//
+// A request (UI force start/stop, shutdown) ends the wait at once. A
+// session change ends it once minGapMs have passed, so that a burst of
+// events doesn't spin the loop and StartThreshold still means sustained audio.
+class PollScheduler {
+public:
+    struct Settings {
+        uint32_t idleMs = 10000;
+        uint32_t pollMs = 2000;
+        uint32_t burstMs = 1000;
+        uint32_t minGapMs = 500;
+        int maxBurstCycles = 20;
+    };
+
+    enum class Mode { Idle, Watching, Burst, Recording };
+
+    // What can end a wait (a mask of these)
+    enum Wake : uint32_t {
+        kTimeout = 1,
+        kSessionChange = 2,
+        kRequest = 4
+    };
+
+    // What the last cycle saw
+    struct Activity {
+        size_t targets = 0;
+        size_t recording = 0;
+        bool rampingUp = false;
+    };
+
+    struct Stats {
+        uint64_t wakeups = 0;
+        uint64_t timeouts = 0;
+        uint64_t sessionWakes = 0;
+        uint64_t requestWakes = 0;
+        uint64_t modeWakeups[4] = {};   // By the mode of the wait they ended
+    };
+
+    PollScheduler() = default;
+    explicit PollScheduler(const Settings& settings) : m_settings(settings) {}
+
+    const Settings& GetSettings() const { return m_settings; }
+    void SetSettings(const Settings& settings) { m_settings = settings; }
+
+    // After a cycle: pick the mode and start the wait
+    void Plan(const Activity& activity, uint64_t nowMs);
+
+    Mode GetMode() const { return m_mode; }
+    uint64_t GetDeadline() const { return m_deadline; }
+
+    // Whether the wait ends at `nowMs`, given the wakes raised so far.
+    // Counts the wakeup when it does.
+    bool ShouldWake(uint32_t pending, uint64_t nowMs);
+
+    // How long to sleep before asking ShouldWake again
+    uint64_t GetSleepMs(uint32_t pending, uint64_t nowMs) const;
+
+    const Stats& GetStats() const { return m_stats; }
+    double GetWakeupsPerHour(uint64_t nowMs) const;
+
+    static const wchar_t* ModeName(Mode mode);
+
+private:
+    Settings m_settings;
+    Mode m_mode = Mode::Watching;
+    int m_burstCycles = 0;
+    uint64_t m_waitStart = 0;
+    uint64_t m_deadline = 0;
+    bool m_planned = false;
+    uint64_t m_firstPlan = 0;
+    Stats m_stats;
+};
+
+// Wakes for the monitor thread, raised from any thread
+class WakeSignal {
+public:
+    void Raise(uint32_t wakes);
+
+    // Up to `timeout`; returns and clears what was raised (0 on timeout)
+    uint32_t Wait(std::chrono::milliseconds timeout);
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_raised;
+    uint32_t m_pending = 0;
+};
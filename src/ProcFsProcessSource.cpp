@@ -0,0 +1,56 @@
+#include "ProcFsProcessSource.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+ProcFsProcessSource::ProcFsProcessSource(const char* root)
+    : m_root(root), m_uid(static_cast<unsigned>(getuid())) {}
+
+bool ProcFsProcessSource::Enumerate(ProcessTable& table) {
+    table.Clear();
+    DIR* dir = opendir(m_root.c_str());
+    if (!dir) {
+        table.Finish();
+        return false;
+    }
+
+    std::string path;
+    std::wstring name;
+    char line[512];
+    while (dirent* entry = readdir(dir)) {
+        char* end = nullptr;
+        const unsigned long pid = strtoul(entry->d_name, &end, 10);
+        if (pid == 0 || *end != '\0') continue;
+
+        // "pid (comm) state ppid ...": comm may hold spaces and parentheses
+        path = m_root + "/" + entry->d_name + "/stat";
+        FILE* file = fopen(path.c_str(), "r");
+        if (!file) continue;   // Exited meanwhile
+        const size_t length = fread(line, 1, sizeof(line) - 1, file);
+        fclose(file);
+        line[length] = '\0';
+
+        const char* open = strchr(line, '(');
+        const char* close = strrchr(line, ')');
+        if (!open || !close || close < open) continue;
+
+        char state = 0;
+        unsigned long parent = 0;
+        if (sscanf(close + 1, " %c %lu", &state, &parent) != 2) continue;
+
+        name.assign(open + 1, close);   // comm is ASCII in practice
+        table.Add(static_cast<uint32_t>(pid), static_cast<uint32_t>(parent), name.c_str());
+    }
+    closedir(dir);
+    table.Finish();
+    return true;
+}
+
+bool ProcFsProcessSource::IsInCurrentSession(uint32_t pid) {
+    struct stat info;
+    const std::string path = m_root + "/" + std::to_string(pid);
+    return ::stat(path.c_str(), &info) == 0 && info.st_uid == m_uid;
+}
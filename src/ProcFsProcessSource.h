@@ -0,0 +1,20 @@
+#pragma once
+
+#include "ProcessTracker.h"
+
+// ProcessTracker backend reading /proc, so the tracker can be driven on
+// Linux in tests and benchmarks. Not part of the Windows build.
+//
+// The name is the kernel's comm (at most 15 characters); "the current
+// session" is processes owned by this user.
+class ProcFsProcessSource : public ProcessSource {
+public:
+    explicit ProcFsProcessSource(const char* root = "/proc");
+
+    bool Enumerate(ProcessTable& table) override;
+    bool IsInCurrentSession(uint32_t pid) override;
+
+private:
+    std::string m_root;
+    unsigned m_uid;
+};
@@ -0,0 +1,132 @@
+#include "ProcessTable.h"
+#include <cwchar>
+
+namespace {
+
+// Windows pids are multiples of 4: mix before masking off the low bits
+inline uint32_t HashPid(uint32_t pid) {
+    pid ^= pid >> 16;
+    pid *= 0x7FEB352Du;
+    pid ^= pid >> 15;
+    return pid;
+}
+
+inline uint32_t HashName(const wchar_t* name) {
+    uint32_t hash = 2166136261u;
+    for (; *name; name++) {
+        hash = (hash ^ static_cast<uint32_t>(*name)) * 16777619u;
+    }
+    return hash;
+}
+
+inline size_t SlotCountFor(size_t count) {
+    size_t slots = 16;
+    while (slots < count * 2) slots <<= 1;
+    return slots;
+}
+
+} // namespace
+
+ProcessTable::ProcessTable() {
+    RehashNames(SlotCountFor(0));
+}
+
+void ProcessTable::Clear() {
+    m_entries.clear();
+    m_slots.clear();
+    if (m_names.size() > kMaxNames) {
+        m_names.clear();
+        RehashNames(SlotCountFor(0));
+    }
+}
+
+void ProcessTable::Add(uint32_t pid, uint32_t parent, const wchar_t* name) {
+    Entry entry = {};
+    entry.pid = pid;
+    entry.parent = parent;
+    entry.name = Intern(name ? name : L"");
+    m_entries.push_back(entry);
+}
+
+void ProcessTable::Finish() {
+    m_slots.assign(SlotCountFor(m_entries.size()), kEmpty);
+    const uint32_t mask = static_cast<uint32_t>(m_slots.size() - 1);
+
+    for (uint32_t i = 0; i < m_entries.size(); i++) {
+        uint32_t slot = HashPid(m_entries[i].pid) & mask;
+        while (m_slots[slot] != kEmpty && m_entries[m_slots[slot]].pid != m_entries[i].pid) {
+            slot = (slot + 1) & mask;
+        }
+        m_slots[slot] = i;
+    }
+
+    // Same walk IsChildOfProcess did per query, once per process
+    for (Entry& entry : m_entries) {
+        uint32_t current = entry.pid;
+        for (int depth = 0; depth < kAncestorDepth; depth++) {
+            const uint32_t parent = ParentOf(current);
+            if (parent == 0 || parent == current) break;
+            entry.ancestors[depth] = parent;
+            current = parent;
+        }
+    }
+}
+
+uint32_t ProcessTable::ParentOf(uint32_t pid) const {
+    const Entry* entry = Find(pid);
+    return entry ? entry->parent : 0;
+}
+
+const std::wstring* ProcessTable::NameOf(uint32_t pid) const {
+    const Entry* entry = Find(pid);
+    return entry ? &m_names[entry->name] : nullptr;
+}
+
+bool ProcessTable::IsDescendant(uint32_t child, uint32_t ancestor) const {
+    const Entry* entry = Find(child);
+    if (!entry) return false;
+
+    for (int depth = 0; depth < kAncestorDepth && entry->ancestors[depth] != 0; depth++) {
+        if (entry->ancestors[depth] == ancestor) return true;
+    }
+    return false;
+}
+
+const ProcessTable::Entry* ProcessTable::Find(uint32_t pid) const {
+    if (m_slots.empty()) return nullptr;
+
+    const uint32_t mask = static_cast<uint32_t>(m_slots.size() - 1);
+    for (uint32_t slot = HashPid(pid) & mask; m_slots[slot] != kEmpty; slot = (slot + 1) & mask) {
+        const Entry& entry = m_entries[m_slots[slot]];
+        if (entry.pid == pid) return &entry;
+    }
+    return nullptr;
+}
+
+uint32_t ProcessTable::Intern(const wchar_t* name) {
+    const uint32_t mask = static_cast<uint32_t>(m_nameSlots.size() - 1);
+    uint32_t slot = HashName(name) & mask;
+    while (m_nameSlots[slot] != kEmpty) {
+        if (wcscmp(m_names[m_nameSlots[slot]].c_str(), name) == 0) return m_nameSlots[slot];
+        slot = (slot + 1) & mask;
+    }
+
+    const uint32_t index = static_cast<uint32_t>(m_names.size());
+    m_names.emplace_back(name);
+    m_nameSlots[slot] = index;
+    if (m_names.size() * 2 > m_nameSlots.size()) {
+        RehashNames(m_nameSlots.size() * 2);
+    }
+    return index;
+}
+
+void ProcessTable::RehashNames(size_t slotCount) {
+    m_nameSlots.assign(slotCount, kEmpty);
+    const uint32_t mask = static_cast<uint32_t>(slotCount - 1);
+
+    for (uint32_t i = 0; i < m_names.size(); i++) {
+        uint32_t slot = HashName(m_names[i].c_str()) & mask;
+        while (m_nameSlots[slot] != kEmpty) slot = (slot + 1) & mask;
+        m_nameSlots[slot] = i;
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The process list of one snapshot, flat (platform-neutral; ProcessSnapshot
+// fills it from Toolhelp).
+//
+// Entries live in one vector indexed by an open-addressed pid hash, and
+// executable names are interned: a refresh on a host with thousands of
+// processes copies only the names it hasn't seen before. Each entry also
+// carries its ancestor chain up to kAncestorDepth, computed once per
+// snapshot, so "is X a child of Y" is a few compares instead of a lookup
+// per generation.
+class ProcessTable {
+public:
+    // How far IsDescendant looks up the tree (as IsChildOfProcess always has)
+    static constexpr int kAncestorDepth = 3;
+
+    ProcessTable();
+
+    // Start a new snapshot. Interned names are kept for the next one.
+    void Clear();
+
+    // Add a process; for a pid added twice the last one wins
+    void Add(uint32_t pid, uint32_t parent, const wchar_t* name);
+
+    // Index the added processes and compute their ancestor chains. Lookups
+    // are valid after this until the next Clear().
+    void Finish();
+
+    size_t Size() const { return m_entries.size(); }
+
+    // 0 for an unknown pid
+    uint32_t ParentOf(uint32_t pid) const;
+
+    // Null for an unknown pid
+    const std::wstring* NameOf(uint32_t pid) const;
+
+    // `ancestor` is the parent, grandparent or great-grandparent of `child`.
+    // The chain stops at pid 0 or a process that is its own parent; a parent
+    // pid that is no longer in the snapshot still counts, but ends the chain.
+    bool IsDescendant(uint32_t child, uint32_t ancestor) const;
+
+    // Call `fn(pid, parent, name)` for every process, in snapshot order
+    template <typename Fn>
+    void ForEach(Fn&& fn) const {
+        for (const Entry& entry : m_entries) {
+            if (Find(entry.pid) != &entry) continue;   // Replaced by a later Add()
+            fn(entry.pid, entry.parent, m_names[entry.name]);
+        }
+    }
+
+private:
+    struct Entry {
+        uint32_t pid;
+        uint32_t parent;
+        uint32_t name;                        // Into m_names
+        uint32_t ancestors[kAncestorDepth];   // Parent first, 0-terminated
+    };
+
+    static constexpr uint32_t kEmpty = 0xFFFFFFFFu;
+
+    // Interned names beyond this are dropped at the next Clear()
+    static constexpr size_t kMaxNames = 8192;
+
+    const Entry* Find(uint32_t pid) const;
+    uint32_t Intern(const wchar_t* name);
+    void RehashNames(size_t slotCount);
+
+    std::vector<Entry> m_entries;
+    std::vector<uint32_t> m_slots;       // Entry index or kEmpty; size is a power of two
+    std::vector<std::wstring> m_names;
+    std::vector<uint32_t> m_nameSlots;   // Name index or kEmpty; size is a power of two
+};
@@ -0,0 +1,107 @@
+#include "ProcessTracker.h"
+#include <algorithm>
+#include <cwctype>
+#include <iterator>
+
+ProcessTracker::ProcessTracker(std::unique_ptr<ProcessSource> source)
+    : m_source(std::move(source)), m_targetsChanged(false) {}
+
+void ProcessTracker::SetTargets(const std::vector<std::wstring>& names) {
+    if (names == m_targetNames) return;
+    m_targetNames = names;
+    m_targetsChanged = true;
+}
+
+bool ProcessTracker::Refresh(ProcessTable& table) {
+    if (!m_source->Enumerate(table)) return false;
+
+    m_events.clear();
+    m_current.clear();
+    table.ForEach([this](uint32_t pid, uint32_t parent, const std::wstring&) {
+        m_current.push_back({ pid, parent });
+    });
+    std::sort(m_current.begin(), m_current.end());
+
+    // Exits before starts, so a reused pid leaves and comes back
+    std::vector<Identity> changed;
+    std::set_difference(m_previous.begin(), m_previous.end(), m_current.begin(), m_current.end(),
+                        std::back_inserter(changed));
+    for (const Identity& process : changed) {
+        Exited(process.pid);
+        m_otherSession.erase(process.pid);
+    }
+
+    if (m_targetsChanged) {
+        m_otherSession.clear();
+        m_targetsChanged = false;
+        std::vector<uint32_t> dropped;
+        for (const auto& pair : m_targets) {
+            if (!IsTargetName(pair.second.name)) dropped.push_back(pair.first);
+        }
+        for (uint32_t pid : dropped) {
+            Exited(pid);
+        }
+        for (const Identity& process : m_current) {
+            Started(table, process.pid);
+        }
+    } else {
+        // The session check can fail for a process that has only just
+        // started, so one it refused is asked again every cycle
+        const std::vector<uint32_t> retry(m_otherSession.begin(), m_otherSession.end());
+        for (uint32_t pid : retry) {
+            Started(table, pid);
+        }
+
+        changed.clear();
+        std::set_difference(m_current.begin(), m_current.end(), m_previous.begin(), m_previous.end(),
+                            std::back_inserter(changed));
+        for (const Identity& process : changed) {
+            Started(table, process.pid);
+        }
+    }
+
+    m_previous.swap(m_current);
+
+    if (!m_events.empty()) {
+        m_targetList.clear();
+        for (const auto& pair : m_targets) {
+            m_targetList.push_back(pair.second);
+        }
+    }
+    return true;
+}
+
+bool ProcessTracker::IsTargetName(const std::wstring& name) const {
+    for (const std::wstring& target : m_targetNames) {
+        if (target.size() != name.size()) continue;
+        if (std::equal(target.begin(), target.end(), name.begin(), [](wchar_t a, wchar_t b) {
+                return towlower(a) == towlower(b);
+            })) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ProcessTracker::Started(const ProcessTable& table, uint32_t pid) {
+    if (m_targets.find(pid) != m_targets.end()) return;
+
+    const std::wstring* name = table.NameOf(pid);
+    if (!name || !IsTargetName(*name)) return;
+    if (!m_source->IsInCurrentSession(pid)) {
+        m_otherSession.insert(pid);
+        return;
+    }
+
+    m_otherSession.erase(pid);
+    m_targets[pid] = { pid, *name };
+    m_events.push_back({ Event::Started, pid, *name });
+}
+
+void ProcessTracker::Exited(uint32_t pid) {
+    auto it = m_targets.find(pid);
+    if (it == m_targets.end()) return;
+
+    m_events.push_back({ Event::Exited, pid, it->second.name });
+    m_targets.erase(it);
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "ProcessTable.h"
+
+// Where the process list comes from (Toolhelp on Windows, /proc in tests
+// and benchmarks on Linux)
+class ProcessSource {
+public:
+    virtual ~ProcessSource() = default;
+
+    // Fill `table` with every running process: Clear(), Add() each one,
+    // Finish(). On failure the table is left finished and empty.
+    virtual bool Enumerate(ProcessTable& table) = 0;
+
+    // The process belongs to the user this agent runs for (on a multi-user
+    // RDP host, other users' messengers are not ours to record)
+    virtual bool IsInCurrentSession(uint32_t pid) = 0;
+};
+
+// The running target processes, kept current from one process snapshot
+// per cycle (platform-neutral).
+//
+// Each Refresh() takes one snapshot into the caller's ProcessTable, which
+// the rest of the cycle shares for parent and name lookups, and diffs it
+// against the previous one: only processes that started since are matched
+// against the target names, and targets that are gone are dropped. A
+// process is identified by pid and parent pid. Processes with a target name
+// that failed the session check are checked again each Refresh() until
+// they pass or exit.
+class ProcessTracker {
+public:
+    struct Target {
+        uint32_t pid;
+        std::wstring name;
+    };
+
+    struct Event {
+        enum Type { Started, Exited };
+        Type type;
+        uint32_t pid;
+        std::wstring name;
+    };
+
+    explicit ProcessTracker(std::unique_ptr<ProcessSource> source);
+
+    // Executable names, compared case-insensitively. A changed list is
+    // applied to every process at the next Refresh().
+    void SetTargets(const std::vector<std::wstring>& names);
+
+    // Snapshot into `table` and update the targets. On failure the targets
+    // and events are left as they were.
+    bool Refresh(ProcessTable& table);
+
+    // Running targets in the current session, by pid
+    const std::vector<Target>& GetTargets() const { return m_targetList; }
+
+    // Targets that started or exited in the last Refresh()
+    const std::vector<Event>& GetEvents() const { return m_events; }
+
+private:
+    struct Identity {
+        uint32_t pid;
+        uint32_t parent;
+        bool operator<(const Identity& other) const {
+            return pid != other.pid ? pid < other.pid : parent < other.parent;
+        }
+        bool operator==(const Identity& other) const {
+            return pid == other.pid && parent == other.parent;
+        }
+    };
+
+    bool IsTargetName(const std::wstring& name) const;
+    void Started(const ProcessTable& table, uint32_t pid);
+    void Exited(uint32_t pid);
+
+    std::unique_ptr<ProcessSource> m_source;
+    std::vector<std::wstring> m_targetNames;
+    bool m_targetsChanged;
+
+    std::vector<Identity> m_previous;   // Sorted
+    std::vector<Identity> m_current;
+    std::map<uint32_t, Target> m_targets;
+    std::set<uint32_t> m_otherSession;   // Target names refused by IsInCurrentSession
+    std::vector<Target> m_targetList;
+    std::vector<Event> m_events;
+};
@@ -1,33 +1,36 @@
 #include "ProcessUtils.h"
-#include "Config.h"
 #include <tlhelp32.h>
 
-std::vector<FoundProcess> FindTargetProcesses(const AgentConfig& config) {
-    std::vector<FoundProcess> result;
-    DWORD currentSessionId = 0;
-    ProcessIdToSessionId(GetCurrentProcessId(), &currentSessionId);
+// ============================================================
+// ProcessTracker backend
+// ============================================================
 
-    HANDLE hSnapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
-    if (hSnapshot == INVALID_HANDLE_VALUE) return result;
+ToolhelpProcessSource::ToolhelpProcessSource() : m_sessionId(0) {
+    ProcessIdToSessionId(GetCurrentProcessId(), &m_sessionId);
+}
 
+bool ToolhelpProcessSource::Enumerate(ProcessTable& table) {
+    table.Clear();
+    HANDLE hSnapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+    if (hSnapshot == INVALID_HANDLE_VALUE) {
+        table.Finish();
+        return false;
+    }
     PROCESSENTRY32W pe32;
     pe32.dwSize = sizeof(PROCESSENTRY32W);
-
     if (Process32FirstW(hSnapshot, &pe32)) {
         do {
-            for (const auto& target : config.targetProcesses) {
-                if (_wcsicmp(pe32.szExeFile, target.c_str()) == 0) {
-                    DWORD processSessionId = 0;
-                    ProcessIdToSessionId(pe32.th32ProcessID, &processSessionId);
-                    if (processSessionId == currentSessionId) {
-                        result.push_back({ pe32.th32ProcessID, pe32.szExeFile });
-                    }
-                }
-            }
+            table.Add(pe32.th32ProcessID, pe32.th32ParentProcessID, pe32.szExeFile);
         } while (Process32NextW(hSnapshot, &pe32));
     }
     CloseHandle(hSnapshot);
-    return result;
+    table.Finish();
+    return true;
+}
+
+bool ToolhelpProcessSource::IsInCurrentSession(uint32_t pid) {
+    DWORD processSessionId = 0;
+    return ProcessIdToSessionId(pid, &processSessionId) && processSessionId == m_sessionId;
 }
 
 // ============================================================
@@ -82,40 +85,21 @@ bool IsChildOfProcess(DWORD childPid, DWORD parentPid) {
 // ============================================================
 
 void ProcessSnapshot::Refresh() {
-    parentMap.clear();
-    nameMap.clear();
-    HANDLE hSnapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
-    if (hSnapshot == INVALID_HANDLE_VALUE) return;
-    PROCESSENTRY32W pe32;
-    pe32.dwSize = sizeof(PROCESSENTRY32W);
-    if (Process32FirstW(hSnapshot, &pe32)) {
-        do {
-            parentMap[pe32.th32ProcessID] = pe32.th32ParentProcessID;
-            nameMap[pe32.th32ProcessID] = pe32.szExeFile;
-        } while (Process32NextW(hSnapshot, &pe32));
-    }
-    CloseHandle(hSnapshot);
+    ToolhelpProcessSource().Enumerate(table);
 }
 
 std::wstring GetProcessNameByPid(DWORD pid, const ProcessSnapshot& snap) {
     if (pid == 0) return L"(system)";
-    auto it = snap.nameMap.find(pid);
-    return (it != snap.nameMap.end()) ? it->second : L"(unknown)";
+    const std::wstring* name = snap.table.NameOf(pid);
+    return name ? *name : L"(unknown)";
 }
 
 DWORD GetParentProcessId(DWORD pid, const ProcessSnapshot& snap) {
     if (pid == 0) return 0;
-    auto it = snap.parentMap.find(pid);
-    return (it != snap.parentMap.end()) ? it->second : 0;
+    return snap.table.ParentOf(pid);
 }
 
+// Ancestor chains are precomputed by ProcessTable::Finish
 bool IsChildOfProcess(DWORD childPid, DWORD parentPid, const ProcessSnapshot& snap) {
-    DWORD current = childPid;
-    for (int depth = 0; depth < 3; depth++) {
-        DWORD parent = GetParentProcessId(current, snap);
-        if (parent == 0 || parent == current) return false;
-        if (parent == parentPid) return true;
-        current = parent;
-    }
-    return false;
+    return snap.table.IsDescendant(childPid, parentPid);
 }
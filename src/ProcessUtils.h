@@ -4,8 +4,8 @@
 #include <vector>
 #include <map>
 #include <windows.h>
-
-struct AgentConfig;
+#include "ProcessTable.h"
+#include "ProcessTracker.h"
 
 struct FoundProcess {
     DWORD pid;
@@ -14,12 +14,21 @@ struct FoundProcess {
 
 // Snapshot-based process lookup (one CreateToolhelp32Snapshot per cycle)
 struct ProcessSnapshot {
-    std::map<DWORD, DWORD> parentMap;      // pid -> parent pid
-    std::map<DWORD, std::wstring> nameMap;  // pid -> exe name
+    ProcessTable table;   // pid -> parent, exe name, ancestor chain
     void Refresh();
 };
 
-std::vector<FoundProcess> FindTargetProcesses(const AgentConfig& config);
+// ProcessTracker backend: CreateToolhelp32Snapshot, and the terminal
+// services session of this agent
+class ToolhelpProcessSource : public ProcessSource {
+public:
+    ToolhelpProcessSource();
+    bool Enumerate(ProcessTable& table) override;
+    bool IsInCurrentSession(uint32_t pid) override;
+
+private:
+    DWORD m_sessionId;
+};
 
 // Legacy functions (each creates its own snapshot — avoid in hot path)
 std::wstring GetProcessNameByPid(DWORD pid);
@@ -0,0 +1,116 @@
+#include "RenderDeviceCache.h"
+
+namespace {
+
+// Forwards device changes to the cache; runs on a system thread, so nothing else
+class NotificationClient : public IMMNotificationClient {
+public:
+    explicit NotificationClient(std::function<void(DeviceEvent)> onEvent)
+        : m_refCount(1), m_onEvent(std::move(onEvent)) {}
+
+    STDMETHODIMP QueryInterface(REFIID riid, void** ppvObject) override {
+        if (!ppvObject) return E_POINTER;
+        if (riid == __uuidof(IUnknown) || riid == __uuidof(IMMNotificationClient)) {
+            *ppvObject = static_cast<IMMNotificationClient*>(this);
+            AddRef();
+            return S_OK;
+        }
+        *ppvObject = nullptr;
+        return E_NOINTERFACE;
+    }
+    STDMETHODIMP_(ULONG) AddRef() override { return InterlockedIncrement(&m_refCount); }
+    STDMETHODIMP_(ULONG) Release() override {
+        LONG refCount = InterlockedDecrement(&m_refCount);
+        if (refCount == 0) delete this;
+        return refCount;
+    }
+
+    STDMETHODIMP OnDeviceStateChanged(LPCWSTR, DWORD) override { return Notify(DeviceEvent::StateChanged); }
+    STDMETHODIMP OnDeviceAdded(LPCWSTR) override { return Notify(DeviceEvent::Added); }
+    STDMETHODIMP OnDeviceRemoved(LPCWSTR) override { return Notify(DeviceEvent::Removed); }
+    STDMETHODIMP OnDefaultDeviceChanged(EDataFlow flow, ERole, LPCWSTR) override {
+        return Notify(flow == eCapture ? DeviceEvent::DefaultCaptureChanged : DeviceEvent::DefaultRenderChanged);
+    }
+    STDMETHODIMP OnPropertyValueChanged(LPCWSTR, const PROPERTYKEY) override {
+        return Notify(DeviceEvent::PropertyChanged);
+    }
+
+private:
+    HRESULT Notify(DeviceEvent event) {
+        m_onEvent(event);
+        return S_OK;
+    }
+
+    LONG m_refCount;
+    std::function<void(DeviceEvent)> m_onEvent;
+};
+
+class MMDeviceSource : public DeviceSource<RenderDevice> {
+public:
+    ~MMDeviceSource() override { Close(); }
+
+    bool Open() override {
+        if (FAILED(CoCreateInstance(__uuidof(MMDeviceEnumerator), nullptr, CLSCTX_ALL, IID_PPV_ARGS(&m_enumerator)))) {
+            m_enumerator.Reset();
+            return false;
+        }
+        return true;
+    }
+
+    bool Subscribe(std::function<void(DeviceEvent)> onEvent) override {
+        m_client.Attach(new NotificationClient(std::move(onEvent)));
+        if (FAILED(m_enumerator->RegisterEndpointNotificationCallback(m_client.Get()))) {
+            m_client.Reset();
+            return false;
+        }
+        return true;
+    }
+
+    void Close() override {
+        if (m_enumerator && m_client) {
+            m_enumerator->UnregisterEndpointNotificationCallback(m_client.Get());
+        }
+        m_client.Reset();
+        m_enumerator.Reset();
+    }
+
+    bool List(std::vector<RenderDevice>& devices) override {
+        ComPtr<IMMDeviceCollection> deviceCollection;
+        if (FAILED(m_enumerator->EnumAudioEndpoints(eRender, DEVICE_STATE_ACTIVE, &deviceCollection)) ||
+            !deviceCollection) {
+            return false;
+        }
+
+        UINT deviceCount = 0;
+        deviceCollection->GetCount(&deviceCount);
+
+        for (UINT d = 0; d < deviceCount; d++) {
+            RenderDevice entry;
+            if (FAILED(deviceCollection->Item(d, &entry.device)) || !entry.device) continue;
+
+            LPWSTR deviceId = nullptr;
+            if (SUCCEEDED(entry.device->GetId(&deviceId)) && deviceId) {
+                entry.id = deviceId;
+                CoTaskMemFree(deviceId);
+            }
+
+            if (FAILED(entry.device->Activate(__uuidof(IAudioSessionManager2), CLSCTX_ALL,
+                nullptr, reinterpret_cast<void**>(entry.sessionManager.GetAddressOf())))) {
+                entry.sessionManager.Reset();
+            }
+            devices.push_back(std::move(entry));
+        }
+        return true;
+    }
+
+    bool IsActivated(const RenderDevice& device) const override { return device.sessionManager != nullptr; }
+
+private:
+    ComPtr<IMMDeviceEnumerator> m_enumerator;
+    ComPtr<NotificationClient> m_client;
+};
+
+} // namespace
+
+RenderDeviceCache::RenderDeviceCache()
+    : DeviceCache<RenderDevice>(std::make_unique<MMDeviceSource>()) {}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <windows.h>
+#include <mmdeviceapi.h>
+#include <audiopolicy.h>
+#include <wrl/client.h>
+#include <string>
+#include "DeviceCache.h"
+
+using Microsoft::WRL::ComPtr;
+
+// An active render endpoint with its IAudioSessionManager2
+struct RenderDevice {
+    std::wstring id;
+    ComPtr<IMMDevice> device;
+    ComPtr<IAudioSessionManager2> sessionManager;   // Null if activation failed
+};
+
+// The active render endpoints with their session managers, activated once
+// and kept across poll cycles: a DeviceCache over IMMDeviceEnumerator, made
+// stale by an IMMNotificationClient. Initialize() and GetDevices() must run
+// on an MTA thread, Reset() before CoUninitialize.
+class RenderDeviceCache : public DeviceCache<RenderDevice> {
+public:
+    using Device = RenderDevice;
+
+    RenderDeviceCache();
+};
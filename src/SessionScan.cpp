@@ -0,0 +1,84 @@
+#include "SessionScan.h"
+#include <algorithm>
+
+void SessionActivityTable::Build(const std::vector<SessionSample>& sessions, const ParentLookup& parentOf) {
+    m_byPid.clear();
+
+    for (const SessionSample& session : sessions) {
+        // System sounds belong to no process
+        if (session.pid == 0) continue;
+
+        Merge(session.pid, session);
+
+        uint32_t current = session.pid;
+        for (int depth = 0; depth < kAncestorDepth; depth++) {
+            uint32_t parent = parentOf(current);
+            if (parent == 0 || parent == current) break;
+            Merge(parent, session);
+            current = parent;
+        }
+    }
+}
+
+SessionActivity SessionActivityTable::Find(uint32_t pid) const {
+    auto it = m_byPid.find(pid);
+    return it != m_byPid.end() ? it->second : SessionActivity{};
+}
+
+void SessionActivityTable::Merge(uint32_t pid, const SessionSample& session) {
+    SessionActivity& entry = m_byPid[pid];
+    entry.peak = (std::max)(entry.peak, session.peak);
+    entry.active = entry.active || session.active;
+}
+
+void SessionEventTable::Add(uint64_t key, uint32_t device, uint32_t pid, bool active) {
+    m_sessions[key] = { device, pid, active };
+}
+
+void SessionEventTable::SetActive(uint64_t key, bool active) {
+    auto it = m_sessions.find(key);
+    if (it == m_sessions.end()) return;
+    it->second.active = active;
+}
+
+void SessionEventTable::Remove(uint64_t key) {
+    m_sessions.erase(key);
+}
+
+void SessionEventTable::RemoveDevice(uint32_t device) {
+    for (auto it = m_sessions.begin(); it != m_sessions.end();) {
+        if (it->second.device == device) {
+            it = m_sessions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void SessionEventTable::SelectTargets(const std::vector<uint32_t>& targets,
+                                      const SessionActivityTable::ParentLookup& parentOf,
+                                      std::vector<uint64_t>& keys, std::vector<SessionSample>& samples) const {
+    keys.clear();
+    samples.clear();
+    auto isTarget = [&targets](uint32_t pid) {
+        return std::find(targets.begin(), targets.end(), pid) != targets.end();
+    };
+
+    for (const auto& pair : m_sessions) {
+        const Entry& entry = pair.second;
+        if (entry.pid == 0) continue;
+
+        uint32_t current = entry.pid;
+        bool belongs = isTarget(current);
+        for (int depth = 0; !belongs && depth < SessionActivityTable::kAncestorDepth; depth++) {
+            uint32_t parent = parentOf(current);
+            if (parent == 0 || parent == current) break;
+            belongs = isTarget(parent);
+            current = parent;
+        }
+        if (!belongs) continue;
+
+        keys.push_back(pair.first);
+        samples.push_back({ entry.pid, 0.0f, entry.active });
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+// One audio session as seen during a scan (platform-neutral)
+struct SessionSample {
+    uint32_t pid;      // Process that owns the session (0 = system sounds)
+    float peak;        // Meter peak, 0..1
+    bool active;       // AudioSessionStateActive
+};
+
+// What a process and its child processes are doing on all render devices
+struct SessionActivity {
+    float peak = 0.0f;
+    bool active = false;
+};
+
+// Per-pid session state built from one pass over every session.
+//
+// A session counts for its own process and for up to kAncestorDepth
+// ancestors (the same depth IsChildOfProcess walks), so a target's entry
+// covers audio played by its helper processes: the largest peak and
+// whether any of the sessions is active.
+class SessionActivityTable {
+public:
+    static constexpr int kAncestorDepth = 3;
+
+    // pid -> parent pid, 0 when unknown
+    using ParentLookup = std::function<uint32_t(uint32_t)>;
+
+    void Build(const std::vector<SessionSample>& sessions, const ParentLookup& parentOf);
+
+    // A process with no session (of its own or below it) reads as silent and inactive
+    SessionActivity Find(uint32_t pid) const;
+
+    size_t Size() const { return m_byPid.size(); }
+    void Clear() { m_byPid.clear(); }
+
+private:
+    void Merge(uint32_t pid, const SessionSample& session);
+
+    std::unordered_map<uint32_t, SessionActivity> m_byPid;
+};
+
+// Audio sessions kept current from notifications instead of re-enumerated
+// every cycle (platform-neutral; AudioSessionTracker feeds it from the
+// session callbacks). Sessions are identified by a key the caller assigns.
+class SessionEventTable {
+public:
+    // A session appeared on `device`, enumerated or reported as created
+    void Add(uint64_t key, uint32_t device, uint32_t pid, bool active);
+
+    // State change reported for a session; unknown keys are ignored
+    void SetActive(uint64_t key, bool active);
+
+    // Disconnected or expired
+    void Remove(uint64_t key);
+
+    // The device went away, and every session on it
+    void RemoveDevice(uint32_t device);
+
+    bool Contains(uint64_t key) const { return m_sessions.find(key) != m_sessions.end(); }
+    size_t Size() const { return m_sessions.size(); }
+
+    // The sessions that belong to one of `targets` (the process itself or a
+    // descendant within SessionActivityTable::kAncestorDepth): their keys,
+    // and in the same order samples for SessionActivityTable::Build with
+    // the peak left at 0. Only the active ones can be playing, so those are
+    // the only meters the caller needs to read.
+    void SelectTargets(const std::vector<uint32_t>& targets, const SessionActivityTable::ParentLookup& parentOf,
+                       std::vector<uint64_t>& keys, std::vector<SessionSample>& samples) const;
+
+private:
+    struct Entry {
+        uint32_t device;
+        uint32_t pid;
+        bool active;
+    };
+
+    std::map<uint64_t, Entry> m_sessions;
+};
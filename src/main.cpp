@@ -133,6 +133,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
     }
 
     g_running = false;
+    WakeMonitorThread();
     // Release single-instance mutex FIRST so a new instance can start
     // while we're still cleaning up threads
     if (hMutexSingle) { ReleaseMutex(hMutexSingle); CloseHandle(hMutexSingle); hMutexSingle = nullptr; }
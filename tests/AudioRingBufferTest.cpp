@@ -0,0 +1,192 @@
+// AudioRingBuffer wrap-around and overflow policy, the mixer's trimming of a
+// source that runs ahead, as reported by GetDroppedFrameCount(), and the
+// final drain that gives back what the mixer holds at the end.
+
+#include "AudioMixer.h"
+#include "AudioRingBuffer.h"
+#include "TestCheck.h"
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+// Frames of one int32 each, numbered from `first`
+std::vector<int32_t> Frames(int32_t first, size_t count) {
+    std::vector<int32_t> frames(count);
+    for (size_t i = 0; i < count; i++) frames[i] = first + (int32_t)i;
+    return frames;
+}
+
+void Write(AudioRingBuffer& ring, const std::vector<int32_t>& frames) {
+    ring.Write(reinterpret_cast<const uint8_t*>(frames.data()), frames.size());
+}
+
+std::vector<int32_t> Read(AudioRingBuffer& ring, size_t count) {
+    std::vector<int32_t> frames(count);
+    frames.resize(ring.Read(reinterpret_cast<uint8_t*>(frames.data()), count));
+    return frames;
+}
+
+void TestWrap() {
+    AudioRingBuffer ring;
+    CHECK(!ring.IsAllocated());
+    ring.Reset(sizeof(int32_t), 6);
+    CHECK(ring.Capacity() == 8);
+
+    // Odd-sized writes and reads walk the positions around the storage many times
+    int32_t next = 0, expected = 0;
+    for (int pass = 0; pass < 200; pass++) {
+        const size_t writeCount = 1 + pass % 5;
+        Write(ring, Frames(next, writeCount));
+        next += (int32_t)writeCount;
+        for (int32_t frame : Read(ring, 1 + pass % 4)) CHECK(frame == expected++);
+        while (ring.Available() > 3) {
+            for (int32_t frame : Read(ring, 2)) CHECK(frame == expected++);
+        }
+        CHECK(ring.Available() == (size_t)(next - expected));
+    }
+    CHECK(ring.DroppedFrames() == 0);
+    CHECK(ring.WriteIndex() == (uint64_t)next);
+    CHECK(ring.ReadIndex() == (uint64_t)expected);
+
+    // Peek leaves the frames in place, across the wrap
+    std::vector<int32_t> peeked(ring.Available());
+    CHECK(ring.Peek(reinterpret_cast<uint8_t*>(peeked.data()), peeked.size()) == peeked.size());
+    CHECK(Read(ring, peeked.size()) == peeked);
+}
+
+void TestOverflow() {
+    AudioRingBuffer ring;
+    ring.Reset(sizeof(int32_t), 8);
+
+    // Full buffer: the oldest go first, and are counted
+    Write(ring, Frames(0, 6));
+    Write(ring, Frames(6, 5));
+    CHECK(ring.Available() == 8);
+    CHECK(ring.DroppedFrames() == 3);
+    CHECK(Read(ring, 8) == Frames(3, 8));
+
+    // A write larger than the buffer keeps only its newest part
+    Write(ring, Frames(100, 3));
+    Write(ring, Frames(200, 20));
+    CHECK(ring.DroppedFrames() == 3 + 3 + 12);
+    CHECK(ring.Available() == 8);
+    CHECK(Read(ring, 8) == Frames(212, 8));
+
+    // Silence follows the same policy
+    Write(ring, Frames(300, 5));
+    ring.WriteSilence(6);
+    CHECK(ring.DroppedFrames() == 18 + 3);
+    CHECK(Read(ring, 8) == std::vector<int32_t>({ 303, 304, 0, 0, 0, 0, 0, 0 }));
+    ring.WriteSilence(11);
+    CHECK(ring.DroppedFrames() == 21 + 3);
+    CHECK(ring.Available() == 8);
+
+    CHECK(ring.DropOldest(5) == 5);
+    CHECK(ring.DropOldest(5) == 3);
+    CHECK(ring.DroppedFrames() == 24 + 8);
+
+    ring.Reset(sizeof(int32_t), 8);
+    CHECK(ring.DroppedFrames() == 0);
+    CHECK(ring.Available() == 0);
+}
+
+WAVEFORMATEX FloatFormat(uint32_t rate, WORD channels) {
+    WAVEFORMATEX format = {};
+    format.wFormatTag = WAVE_FORMAT_IEEE_FLOAT;
+    format.nChannels = channels;
+    format.nSamplesPerSec = rate;
+    format.wBitsPerSample = 32;
+    format.nBlockAlign = (WORD)(channels * 4);
+    format.nAvgBytesPerSec = rate * format.nBlockAlign;
+    return format;
+}
+
+// A source fed with nothing mixed out is trimmed to the newest
+// kKeepBufferedSeconds once it holds more than kMaxBufferedSeconds
+void TestMixerTrim() {
+    const uint32_t rate = 8000;
+    const WAVEFORMATEX format = FloatFormat(rate, 1);
+    AudioMixer mixer;
+    CHECK(mixer.Initialize(&format));
+    mixer.SetDriftCompensation(false);
+    LimiterSettings bypass;
+    bypass.enabled = false;
+    mixer.SetLimiter(bypass);
+
+    // 100 ms packets; every sample carries its packet number
+    const size_t packetFrames = rate / 10;
+    std::vector<float> packet(packetFrames);
+    const int packets = 70;
+    for (int p = 0; p < packets; p++) {
+        std::fill(packet.begin(), packet.end(), (float)p * 1e-3f);
+        mixer.AddAudioData(1, reinterpret_cast<const BYTE*>(packet.data()),
+                           (UINT32)(packet.size() * sizeof(float)), &format);
+    }
+    const UINT64 dropped = mixer.GetDroppedFrameCount();
+    CHECK(dropped > 0);
+
+    // What is left is the newest audio, in order
+    const size_t left = packets * packetFrames - (size_t)dropped;
+    CHECK(left >= 2 * rate && left <= 5 * rate + packetFrames);
+    std::vector<BYTE> mixed;
+    CHECK(mixer.GetMixedAudio(mixed, left));
+    const float* samples = reinterpret_cast<const float*>(mixed.data());
+    CHECK(samples[left - 1] == (float)(packets - 1) * 1e-3f);
+    CHECK(samples[0] == (float)((int)(dropped / packetFrames)) * 1e-3f);
+
+    // Removing the source keeps its drops in the total; Clear() starts over
+    mixer.AddAudioData(2, reinterpret_cast<const BYTE*>(packet.data()),
+                       (UINT32)(packet.size() * sizeof(float)), &format);
+    mixer.RemoveSource(1);
+    CHECK(mixer.GetDroppedFrameCount() == dropped);
+    mixer.Clear();
+    CHECK(mixer.GetDroppedFrameCount() == 0);
+}
+
+// With drift compensation the mixer holds kTargetLatencyMs back and the
+// limiter a few ms more; the drain at the end of a recording gives them back
+void TestMixerDrain() {
+    const uint32_t rate = 48000;
+    const WAVEFORMATEX format = FloatFormat(rate, 1);
+    AudioMixer mixer;
+    CHECK(mixer.Initialize(&format));
+
+    // One second of 10 ms packets, mixed in 20 ms blocks as they become ready
+    const size_t packetFrames = rate / 100;
+    const std::vector<float> packet(packetFrames, 0.5f);
+    std::vector<BYTE> mixed;
+    size_t audible = 0;
+    auto count = [&]() {
+        const float* samples = reinterpret_cast<const float*>(mixed.data());
+        for (size_t i = 0; i < mixed.size() / sizeof(float); i++) {
+            if (std::fabs(samples[i] - 0.5f) < 1e-3f) audible++;
+        }
+    };
+    for (int p = 0; p < 100; p++) {
+        mixer.AddAudioData(1, reinterpret_cast<const BYTE*>(packet.data()),
+                           (UINT32)(packet.size() * sizeof(float)), &format);
+        while (mixer.GetMixedAudio(mixed, rate / 50)) count();
+    }
+    const size_t beforeDrain = audible;
+    CHECK(beforeDrain < rate - rate / 20);
+
+    // Only the few frames still inside the resampler's filter stay behind
+    CHECK(mixer.DrainMixedAudio(mixed));
+    count();
+    if (!CHECK(audible > rate - 64 && audible <= rate)) {
+        fprintf(stderr, "  drain: %zu of %u frames out (%zu before the drain)\n", audible, rate, beforeDrain);
+    }
+    CHECK(!mixer.DrainMixedAudio(mixed));
+}
+
+} // namespace
+
+int main() {
+    TestWrap();
+    TestOverflow();
+    TestMixerTrim();
+    TestMixerDrain();
+    return test::TestResult();
+}
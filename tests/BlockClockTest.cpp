@@ -0,0 +1,155 @@
+// BlockClock scheduling in virtual time: a fake TimeSource jumps straight to
+// the next deadline or producer event, so minutes of mixer-thread pacing run
+// in milliseconds and every number is deterministic.
+
+#include "BlockClock.h"
+#include "TestCheck.h"
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using Duration = BlockClock::Duration;
+using std::chrono::milliseconds;
+using std::chrono::microseconds;
+
+const Duration kPeriod = milliseconds(20);
+
+// Producer events (a block's input becoming ready, with or without a
+// Notify()) on a virtual clock that only moves inside WaitUntil
+class VirtualTime : public BlockClock::TimeSource {
+public:
+    struct Event {
+        Duration time;
+        bool notify;
+    };
+
+    explicit VirtualTime(std::vector<Event> events) : m_events(std::move(events)) {}
+
+    void Attach(BlockClock* clock) { m_clock = clock; }
+
+    Duration Now() override { return m_now; }
+
+    void WaitUntil(std::condition_variable&, std::unique_lock<std::mutex>& lock, Duration deadline) override {
+        Duration next = deadline;
+        if (m_next < m_events.size() && m_events[m_next].time < next) next = m_events[m_next].time;
+        if (next > m_now) m_now = next;
+
+        // Producers run without the clock's lock, as on their own threads
+        lock.unlock();
+        while (m_next < m_events.size() && m_events[m_next].time <= m_now) {
+            if (m_events[m_next++].notify) m_clock->Notify();
+        }
+        lock.lock();
+    }
+
+    // Blocks whose input is ready so far
+    size_t Ready() const { return m_next; }
+    bool Done() const { return m_next == m_events.size(); }
+
+private:
+    std::vector<Event> m_events;
+    size_t m_next = 0;
+    Duration m_now{0};
+    BlockClock* m_clock = nullptr;
+};
+
+// The mixer thread's loop: produce every ready block, once per Wait()
+BlockClock::Stats Run(VirtualTime& time) {
+    BlockClock clock(kPeriod, &time);
+    time.Attach(&clock);
+    size_t produced = 0;
+    while (clock.Wait()) {
+        for (; produced < time.Ready(); produced++) clock.CompleteTick();
+        if (time.Done()) clock.Stop();
+    }
+    return clock.GetStats();
+}
+
+// Blocks every period * (1 - ppm), with a deterministic +-jitter
+std::vector<VirtualTime::Event> Steady(size_t blocks, double ppm, Duration jitter, Duration start = Duration(0)) {
+    std::vector<VirtualTime::Event> events;
+    const double period = (double)kPeriod.count() * (1.0 - ppm * 1e-6);
+    for (size_t k = 0; k < blocks; k++) {
+        const int64_t wobble = jitter.count() * (int64_t)((k * 7919) % 201 - 100) / 100;
+        events.push_back({ start + Duration((int64_t)(period * (double)(k + 1)) + wobble), true });
+    }
+    return events;
+}
+
+double Ms(Duration d) { return std::chrono::duration<double, std::milli>(d).count(); }
+
+// Ten minutes of a producer clock +-200 ppm off the system clock with 3 ms
+// jitter: no misses, lateness bounded, one wakeup per block
+void TestDrift() {
+    for (double ppm : { 200.0, -200.0 }) {
+        const size_t blocks = 30000;
+        VirtualTime time(Steady(blocks, ppm, milliseconds(3)));
+        const BlockClock::Stats stats = Run(time);
+        if (!CHECK(stats.ticks == blocks && stats.deadlineMisses == 0 && stats.resyncs == 0 &&
+                   stats.maxLateness < milliseconds(8) && stats.wakeups <= blocks + 1)) {
+            fprintf(stderr, "  %+.0f ppm: %llu ticks, %llu misses, %llu resyncs, %.2f ms late, %llu wakeups\n", ppm,
+                    (unsigned long long)stats.ticks, (unsigned long long)stats.deadlineMisses,
+                    (unsigned long long)stats.resyncs, Ms(stats.maxLateness), (unsigned long long)stats.wakeups);
+        }
+    }
+}
+
+// A 100 ms stall is one miss, not five; a 1 s stall restarts the schedule
+// without one
+void TestStalls() {
+    std::vector<VirtualTime::Event> events = Steady(100, 0.0, Duration(0));
+    for (const VirtualTime::Event& e : Steady(100, 0.0, Duration(0), events.back().time + milliseconds(100))) {
+        events.push_back(e);
+    }
+    for (const VirtualTime::Event& e : Steady(100, 0.0, Duration(0), events.back().time + milliseconds(1000))) {
+        events.push_back(e);
+    }
+    VirtualTime time(events);
+    const BlockClock::Stats stats = Run(time);
+    if (!CHECK(stats.ticks == 300 && stats.deadlineMisses == 1 && stats.resyncs == 1)) {
+        fprintf(stderr, "  stalls: %llu ticks, %llu misses, %llu resyncs\n", (unsigned long long)stats.ticks,
+                (unsigned long long)stats.deadlineMisses, (unsigned long long)stats.resyncs);
+    }
+    CHECK(stats.maxLateness >= milliseconds(100) && stats.maxLateness < milliseconds(140));
+}
+
+// Notifications that never come: the timer still produces each block
+// within half a period of its due time, and an overdue block is polled
+// once a period instead of spun on
+void TestLostNotifications() {
+    std::vector<VirtualTime::Event> events = Steady(500, 0.0, Duration(0));
+    for (VirtualTime::Event& e : events) e.notify = false;
+    VirtualTime time(events);
+    const BlockClock::Stats stats = Run(time);
+    CHECK(stats.ticks == 500 && stats.deadlineMisses == 0);
+    CHECK(stats.maxLateness <= kPeriod / 2 + microseconds(1));
+    CHECK(stats.wakeups <= 2 * 500);
+
+    // Nothing at all for two seconds after the first block
+    std::vector<VirtualTime::Event> quiet = Steady(1, 0.0, Duration(0));
+    quiet.push_back({ quiet[0].time + milliseconds(2000), false });
+    VirtualTime idle(quiet);
+    const BlockClock::Stats idleStats = Run(idle);
+    CHECK(idleStats.ticks == 2 && idleStats.resyncs == 1);
+    CHECK(idleStats.wakeups >= 90 && idleStats.wakeups <= 110);
+}
+
+// Wait() after Stop() returns false at once
+void TestStop() {
+    BlockClock clock(kPeriod);
+    clock.Stop();
+    CHECK(!clock.Wait());
+    CHECK(clock.GetStats().wakeups == 1);
+}
+
+} // namespace
+
+int main() {
+    TestDrift();
+    TestStalls();
+    TestLostNotifications();
+    TestStop();
+    return test::TestResult();
+}
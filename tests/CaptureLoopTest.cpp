@@ -0,0 +1,351 @@
+// RunCaptureLoop against fake CaptureSources: a scripted one that logs every
+// call, for what each wait result does and that every queued packet is read
+// per wakeup; and a threaded one standing in for WasapiCaptureSource, with an
+// auto-reset "event" or, when the endpoint rejected EVENTCALLBACK, polling
+// every period, for Wake() unblocking Stop() and the polling fallback still
+// delivering everything.
+
+#include "CaptureSource.h"
+#include "TestCheck.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Wait results returned in order (Failed once they run out), packets queued
+// before each wait. Logs "W:S", "W:T", "W:F" for waits, "A<frames>" for each
+// packet handed out and "R<frames>" for each release.
+class ScriptedSource : public CaptureSource {
+public:
+    struct Step {
+        CaptureWaitResult result;
+        std::vector<uint32_t> queued;   // Frames of the packets that arrive before this wait returns
+    };
+
+    std::vector<Step> steps;
+    size_t nextStep = 0;
+    std::deque<uint32_t> queue;
+    std::string log;
+    bool failSize = false;
+    bool failAcquire = false;
+    bool failRelease = false;
+    int wakes = 0;
+
+    CaptureWaitResult WaitForData() override {
+        if (nextStep == steps.size()) {
+            log += "W:F ";
+            return CaptureWaitResult::Failed;
+        }
+        const Step& step = steps[nextStep++];
+        queue.insert(queue.end(), step.queued.begin(), step.queued.end());
+        log += step.result == CaptureWaitResult::Signaled ? "W:S " : step.result == CaptureWaitResult::Timeout ? "W:T "
+                                                                                                               : "W:F ";
+        return step.result;
+    }
+
+    void Wake() override { wakes++; }
+
+    bool GetNextPacketSize(uint32_t& frames) override {
+        frames = queue.empty() ? 0 : queue.front();
+        return !failSize;
+    }
+
+    bool AcquirePacket(CapturePacket& packet) override {
+        if (failAcquire || queue.empty()) return false;
+        packet.frames = queue.front();
+        packet.silent = packet.frames % 2 == 1;
+        packet.data = packet.silent ? nullptr : m_payload;
+        log += "A" + std::to_string(packet.frames) + " ";
+        return true;
+    }
+
+    bool ReleasePacket(uint32_t frames) override {
+        log += "R" + std::to_string(frames) + " ";
+        if (!queue.empty()) queue.pop_front();
+        return !failRelease;
+    }
+
+private:
+    uint8_t m_payload[16] = {};
+};
+
+std::string Run(ScriptedSource& source, std::atomic<bool>& running, std::vector<uint32_t>* delivered = nullptr,
+                uint32_t stopAfter = 0) {
+    RunCaptureLoop(source, running, [&](const CapturePacket& packet) {
+        if (delivered) delivered->push_back(packet.frames);
+        if (packet.frames == stopAfter) running = false;
+    });
+    return source.log;
+}
+
+void TestWaitResults() {
+    using R = CaptureWaitResult;
+
+    // Signaled: every queued packet before the next wait. Timeout: drained
+    // too (loopback may never signal), and nothing to read is fine. Failed:
+    // the loop ends without touching the queue.
+    {
+        ScriptedSource source;
+        source.steps = { { R::Signaled, { 480, 480, 96 } }, { R::Timeout, { 480 } }, { R::Timeout, {} },
+                         { R::Failed, { 480 } } };
+        std::atomic<bool> running{true};
+        std::vector<uint32_t> delivered;
+        const std::string log = Run(source, running, &delivered);
+        if (!CHECK(log == "W:S A480 R480 A480 R480 A96 R96 W:T A480 R480 W:T W:F ")) {
+            fprintf(stderr, "  %s\n", log.c_str());
+        }
+        CHECK(delivered == std::vector<uint32_t>({ 480, 480, 96, 480 }));
+        CHECK(source.queue.size() == 1);
+    }
+
+    // Packets that arrive while draining are read in the same wakeup
+    {
+        class Arriving : public ScriptedSource {
+        public:
+            bool ReleasePacket(uint32_t frames) override {
+                if (extra-- > 0) queue.push_back(100 + extra * 2);
+                return ScriptedSource::ReleasePacket(frames);
+            }
+            int extra = 2;
+        } source;
+        source.steps = { { R::Signaled, { 480 } } };
+        std::atomic<bool> running{true};
+        const std::string log = Run(source, running);
+        if (!CHECK(log == "W:S A480 R480 A102 R102 A100 R100 W:F ")) fprintf(stderr, "  %s\n", log.c_str());
+    }
+
+    // Silent packets reach the handler flagged, without data
+    {
+        ScriptedSource source;
+        source.steps = { { R::Signaled, { 481, 480 } } };
+        std::atomic<bool> running{true};
+        std::vector<bool> silent;
+        RunCaptureLoop(source, running, [&](const CapturePacket& packet) {
+            silent.push_back(packet.silent && packet.data == nullptr);
+        });
+        CHECK(silent == std::vector<bool>({ true, false }));
+    }
+}
+
+void TestStopsAndFailures() {
+    using R = CaptureWaitResult;
+
+    // Cleared by the handler: the packet in hand is released, no more read
+    {
+        ScriptedSource source;
+        source.steps = { { R::Signaled, { 480, 7, 480 } }, { R::Signaled, {} } };
+        std::atomic<bool> running{true};
+        const std::string log = Run(source, running, nullptr, 7);
+        if (!CHECK(log == "W:S A480 R480 A7 R7 ")) fprintf(stderr, "  %s\n", log.c_str());
+    }
+
+    // Cleared before the loop starts: no wait at all
+    {
+        ScriptedSource source;
+        source.steps = { { R::Signaled, { 480 } } };
+        std::atomic<bool> running{false};
+        CHECK(Run(source, running).empty());
+    }
+
+    // GetNextPacketSize failing ends the loop
+    {
+        ScriptedSource source;
+        source.steps = { { R::Signaled, { 480 } }, { R::Signaled, {} } };
+        source.failSize = true;
+        std::atomic<bool> running{true};
+        CHECK(Run(source, running) == "W:S ");
+    }
+
+    // A failed GetBuffer or ReleaseBuffer gives up on this wakeup only
+    {
+        ScriptedSource source;
+        source.steps = { { R::Signaled, { 480, 480 } }, { R::Timeout, {} } };
+        source.failAcquire = true;
+        std::atomic<bool> running{true};
+        CHECK(Run(source, running) == "W:S W:T W:F ");
+    }
+    {
+        ScriptedSource source;
+        source.steps = { { R::Signaled, { 480, 96 } }, { R::Timeout, {} } };
+        source.failRelease = true;
+        std::atomic<bool> running{true};
+        const std::string log = Run(source, running);
+        if (!CHECK(log == "W:S A480 R480 W:T A96 R96 W:F ")) fprintf(stderr, "  %s\n", log.c_str());
+    }
+}
+
+// WasapiCaptureSource's behaviour on a condition variable: event-driven, it
+// waits for the auto-reset event up to a timeout; without an event (the
+// polling fallback) it sleeps one period and Wake() does nothing
+class FakeDevice : public CaptureSource {
+public:
+    FakeDevice(bool eventDriven, std::chrono::milliseconds eventTimeout, std::chrono::milliseconds period)
+        : m_eventDriven(eventDriven), m_eventTimeout(eventTimeout), m_period(period) {}
+
+    std::atomic<int> signaled{0};
+    std::atomic<int> timeouts{0};
+
+    // A packet from the engine; the event is signaled only if `signal`
+    void Push(uint32_t frames, bool signal = true) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(frames);
+        if (signal && m_eventDriven) {
+            m_event = true;
+            m_changed.notify_one();
+        }
+    }
+
+    CaptureWaitResult WaitForData() override {
+        if (!m_eventDriven) {
+            std::this_thread::sleep_for(m_period);
+            timeouts++;
+            return CaptureWaitResult::Timeout;
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_changed.wait_for(lock, m_eventTimeout, [this] { return m_event; })) {
+            m_event = false;
+            signaled++;
+            return CaptureWaitResult::Signaled;
+        }
+        timeouts++;
+        return CaptureWaitResult::Timeout;
+    }
+
+    void Wake() override {
+        if (!m_eventDriven) return;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_event = true;
+        m_changed.notify_one();
+    }
+
+    bool GetNextPacketSize(uint32_t& frames) override {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        frames = m_queue.empty() ? 0 : m_queue.front();
+        return true;
+    }
+
+    bool AcquirePacket(CapturePacket& packet) override {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_queue.empty()) return false;
+        packet.frames = m_queue.front();
+        packet.data = m_payload;
+        return true;
+    }
+
+    bool ReleasePacket(uint32_t) override {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.pop_front();
+        return true;
+    }
+
+private:
+    const bool m_eventDriven;
+    const std::chrono::milliseconds m_eventTimeout;
+    const std::chrono::milliseconds m_period;
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    bool m_event = false;
+    std::deque<uint32_t> m_queue;
+    uint8_t m_payload[16] = {};
+};
+
+// The capture thread and AudioCapture::Start()/Stop() around it
+class Capture {
+public:
+    explicit Capture(CaptureSource& source) : m_source(source) {
+        m_thread = std::thread([this] {
+            RunCaptureLoop(m_source, m_running, [this](const CapturePacket& packet) {
+                frames += packet.frames;
+                packets++;
+            });
+        });
+    }
+
+    ~Capture() { Stop(); }
+
+    // Returns how long it took
+    std::chrono::milliseconds Stop() {
+        const auto begin = std::chrono::steady_clock::now();
+        if (m_thread.joinable()) {
+            m_running = false;
+            m_source.Wake();
+            m_thread.join();
+        }
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin);
+    }
+
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> packets{0};
+
+private:
+    CaptureSource& m_source;
+    std::atomic<bool> m_running{true};
+    std::thread m_thread;
+};
+
+bool WaitFor(const std::atomic<uint64_t>& value, uint64_t expected) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (value < expected) {
+        if (std::chrono::steady_clock::now() > deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+void TestWakeUnblocksStop() {
+    // Waiting far longer than the test allows: only Wake() can end it
+    FakeDevice device(true, std::chrono::milliseconds(60000), std::chrono::milliseconds(10));
+    Capture capture(device);
+    for (int i = 0; i < 50; i++) device.Push(480);
+    CHECK(WaitFor(capture.packets, 50));
+    const std::chrono::milliseconds took = capture.Stop();
+    if (!CHECK(took < std::chrono::milliseconds(5000))) fprintf(stderr, "  Stop took %lld ms\n", (long long)took.count());
+    CHECK(device.timeouts == 0 && capture.frames == 50 * 480u);
+}
+
+void TestPollingFallback() {
+    // No event: every wait is a timeout, every packet still read, and Stop
+    // returns within a period although Wake() has nothing to signal
+    {
+        FakeDevice device(false, std::chrono::milliseconds(100), std::chrono::milliseconds(2));
+        Capture capture(device);
+        for (int i = 0; i < 200; i++) {
+            device.Push(480);
+            if (i % 20 == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        CHECK(WaitFor(capture.packets, 200));
+        const std::chrono::milliseconds took = capture.Stop();
+        CHECK(took < std::chrono::milliseconds(5000));
+        CHECK(device.signaled == 0 && device.timeouts > 0 && capture.frames == 200 * 480u);
+    }
+
+    // An event that stops being signaled (loopback on older Windows): the
+    // wait timeout drains what arrives
+    {
+        FakeDevice device(true, std::chrono::milliseconds(5), std::chrono::milliseconds(10));
+        Capture capture(device);
+        for (int i = 0; i < 10; i++) device.Push(480);
+        CHECK(WaitFor(capture.packets, 10));
+        for (int i = 0; i < 10; i++) device.Push(96, false);
+        CHECK(WaitFor(capture.packets, 20));
+        capture.Stop();
+        CHECK(device.timeouts > 0 && capture.frames == 10 * 480u + 10 * 96u);
+    }
+}
+
+} // namespace
+
+int main() {
+    TestWaitResults();
+    TestStopsAndFailures();
+    TestWakeUnblocksStop();
+    TestPollingFallback();
+    return test::TestResult();
+}
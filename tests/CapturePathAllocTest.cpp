@@ -0,0 +1,157 @@
+// Steady-state capture path must not touch the heap: packets from a fake
+// CaptureSource go through RunCaptureLoop and PublishCapturedPacket (the
+// capture side of AudioCapture::ProcessPacket) into the delivery ring, are
+// drained into an AudioMixer with a second, resampled source, and mixed in
+// fixed blocks. After a warm-up, every operator new is counted.
+
+#include "AudioMixer.h"
+#include "CaptureSource.h"
+#include "CapturedPacket.h"
+#include "TestCheck.h"
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+namespace {
+
+std::atomic<bool> g_counting{false};
+std::atomic<uint64_t> g_allocations{0};
+std::atomic<uint64_t> g_allocatedBytes{0};
+
+} // namespace
+
+void* operator new(size_t size) {
+    if (g_counting.load(std::memory_order_relaxed)) {
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+        g_allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    }
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+namespace {
+
+constexpr uint32_t kRate = 48000;
+constexpr uint32_t kChannels = 2;
+constexpr uint32_t kPeriodFrames = 480;   // 10 ms
+constexpr uint64_t kTicksPerPeriod = 100000;
+
+// Loopback-like source: 10 ms float packets, every fifth one flagged silent
+class FakeSource : public CaptureSource {
+public:
+    FakeSource(std::atomic<bool>& running, uint32_t packets)
+        : m_running(running), m_remaining(packets), m_samples(kPeriodFrames * kChannels) {}
+
+    CaptureWaitResult WaitForData() override { return CaptureWaitResult::Signaled; }
+    void Wake() override {}
+
+    bool GetNextPacketSize(uint32_t& frames) override {
+        frames = kPeriodFrames;
+        return true;
+    }
+
+    bool AcquirePacket(CapturePacket& packet) override {
+        for (uint32_t i = 0; i < kPeriodFrames; i++) {
+            const float v = 0.25f * (float)std::sin(m_phase);
+            m_phase += 2.0 * 3.14159265358979 * 440.0 / kRate;
+            m_samples[i * 2] = v;
+            m_samples[i * 2 + 1] = v;
+        }
+        packet.data = reinterpret_cast<const uint8_t*>(m_samples.data());
+        packet.frames = kPeriodFrames;
+        packet.silent = m_sequence % 5 == 4;
+        packet.timestamp = 1000000 + m_sequence * kTicksPerPeriod;
+        return true;
+    }
+
+    bool ReleasePacket(uint32_t) override {
+        m_sequence++;
+        if (--m_remaining == 0) m_running = false;
+        return true;
+    }
+
+private:
+    std::atomic<bool>& m_running;
+    uint32_t m_remaining;
+    std::vector<float> m_samples;
+    double m_phase = 0.0;
+    uint64_t m_sequence = 0;
+};
+
+WAVEFORMATEX MakeFormat(WORD tag, uint32_t rate, WORD channels, WORD bits) {
+    WAVEFORMATEX format = {};
+    format.wFormatTag = tag;
+    format.nChannels = channels;
+    format.nSamplesPerSec = rate;
+    format.wBitsPerSample = bits;
+    format.nBlockAlign = (WORD)(channels * bits / 8);
+    format.nAvgBytesPerSec = rate * format.nBlockAlign;
+    return format;
+}
+
+} // namespace
+
+int main() {
+    const WAVEFORMATEX output = MakeFormat(WAVE_FORMAT_IEEE_FLOAT, kRate, kChannels, 32);
+    const WAVEFORMATEX loopback = output;
+    const WAVEFORMATEX mic = MakeFormat(WAVE_FORMAT_PCM, 44100, 1, 16);
+
+    AudioMixer mixer;
+    CHECK(mixer.Initialize(&output));
+
+    CapturedPacket prototype;
+    prototype.data.resize(kPeriodFrames * loopback.nBlockAlign * 2);
+    SpscRing<CapturedPacket> ring(32, prototype);
+    static const uint8_t zeroPage[kPeriodFrames * kChannels * sizeof(float)] = {};
+
+    std::vector<int16_t> micPacket(441);
+    for (size_t i = 0; i < micPacket.size(); i++) micPacket[i] = (int16_t)(3000 * ((i / 20) % 2 ? 1 : -1));
+
+    std::vector<BYTE> mixed;
+    mixed.reserve(kRate / 50 * output.nBlockAlign);
+
+    constexpr uint32_t kWarmupPackets = 300;
+    constexpr uint32_t kPackets = 3000;
+    std::atomic<bool> running{true};
+    FakeSource source(running, kWarmupPackets + kPackets);
+    uint32_t delivered = 0;
+    uint64_t micTimestamp = 1000000;
+    size_t blocks = 0;
+
+    RunCaptureLoop(source, running, [&](const CapturePacket& packet) {
+        // Capture side; the chunk handler stands in for volume and passthrough
+        PublishCapturedPacket(ring, packet, loopback.nBlockAlign, loopback.nSamplesPerSec, [](uint8_t*, uint32_t) {});
+
+        // Delivery side
+        while (CapturedPacket* slot = ring.Front()) {
+            mixer.AddAudioData(1, slot->silent ? zeroPage : slot->data.data(), slot->size, &loopback,
+                               slot->timing.timestamp);
+            ring.Pop();
+            mixer.AddAudioData(2, reinterpret_cast<const BYTE*>(micPacket.data()),
+                               (UINT32)(micPacket.size() * sizeof(int16_t)), &mic, micTimestamp);
+            micTimestamp += kTicksPerPeriod;
+            delivered++;
+        }
+
+        // Mixer thread
+        while (mixer.GetMixedAudio(mixed, kRate / 50)) blocks++;
+
+        if (delivered == kWarmupPackets) g_counting = true;
+    });
+    g_counting = false;
+
+    CHECK(delivered == kWarmupPackets + kPackets);
+    CHECK(ring.Overruns() == 0);
+    CHECK(blocks > (kWarmupPackets + kPackets) / 2 - 10);
+    CHECK(g_allocations == 0);
+    if (g_allocations != 0) {
+        fprintf(stderr, "steady state: %llu allocations, %llu bytes\n",
+                (unsigned long long)g_allocations.load(), (unsigned long long)g_allocatedBytes.load());
+    }
+    return test::TestResult();
+}
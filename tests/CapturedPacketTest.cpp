@@ -0,0 +1,160 @@
+// PublishCapturedPacket, the capture-thread half of AudioCapture::ProcessPacket:
+// silent packets as a flag and a length, data copied and split over slots
+// in whole frames with timestamps that advance per slot, the discontinuity
+// on the first slot only, the chunk handler run on every copy, and a full
+// ring dropping the rest of a packet.
+
+#include "CapturedPacket.h"
+#include "TestCheck.h"
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t kRate = 48000;
+constexpr uint32_t kBlockAlign = 8;        // Float stereo
+constexpr uint32_t kSlotFrames = 960;      // Two 10 ms periods
+constexpr uint64_t kStart = 5000000;
+
+SpscRing<CapturedPacket> MakeRing(size_t slots) {
+    CapturedPacket prototype;
+    prototype.data.resize(kSlotFrames * kBlockAlign);
+    return SpscRing<CapturedPacket>(slots, prototype);
+}
+
+std::vector<uint8_t> Pattern(uint32_t frames) {
+    std::vector<uint8_t> bytes(frames * kBlockAlign);
+    for (size_t i = 0; i < bytes.size(); i++) bytes[i] = (uint8_t)(i * 7 + 3);
+    return bytes;
+}
+
+CapturePacket Packet(const std::vector<uint8_t>& bytes, uint64_t timestamp = kStart, bool discontinuity = false) {
+    CapturePacket packet;
+    packet.data = bytes.data();
+    packet.frames = (uint32_t)(bytes.size() / kBlockAlign);
+    packet.timestamp = timestamp;
+    packet.discontinuity = discontinuity;
+    return packet;
+}
+
+// Halves every byte, as a stand-in for the volume ramp
+auto Halve(int& calls) {
+    return [&calls](uint8_t* chunk, uint32_t bytes) {
+        calls++;
+        for (uint32_t i = 0; i < bytes; i++) chunk[i] /= 2;
+    };
+}
+
+void TestSingleSlot() {
+    SpscRing<CapturedPacket> ring(MakeRing(8));
+    const std::vector<uint8_t> bytes = Pattern(480);
+    int calls = 0;
+    CHECK(PublishCapturedPacket(ring, Packet(bytes, kStart, true), kBlockAlign, kRate, Halve(calls)));
+    CHECK(calls == 1 && ring.SizeApprox() == 1);
+
+    const CapturedPacket* slot = ring.Front();
+    CHECK(slot->size == bytes.size() && !slot->silent);
+    CHECK(slot->timing.timestamp == kStart && slot->timing.discontinuity);
+    bool same = true;
+    for (size_t i = 0; i < bytes.size(); i++) same = same && slot->data[i] == bytes[i] / 2;
+    CHECK(same);
+    ring.Pop();
+
+    // A slot reused for a later packet: no leftover flags
+    CHECK(PublishCapturedPacket(ring, Packet(Pattern(10)), kBlockAlign, kRate, Halve(calls)));
+    slot = ring.Front();
+    CHECK(slot->size == 10 * kBlockAlign && !slot->timing.discontinuity);
+    ring.Pop();
+}
+
+void TestSilent() {
+    SpscRing<CapturedPacket> ring(MakeRing(4));
+    CapturePacket packet;
+    packet.frames = 5000;            // Larger than a slot: still one, there is nothing to copy
+    packet.silent = true;
+    packet.timestamp = kStart;
+    packet.discontinuity = true;
+    int calls = 0;
+    CHECK(PublishCapturedPacket(ring, packet, kBlockAlign, kRate, Halve(calls)));
+    CHECK(calls == 0 && ring.SizeApprox() == 1);
+    const CapturedPacket* slot = ring.Front();
+    CHECK(slot->silent && slot->size == 5000 * kBlockAlign);
+    CHECK(slot->timing.timestamp == kStart && slot->timing.discontinuity);
+}
+
+void TestSplit() {
+    // 2.5 slots' worth, with one frame over
+    SpscRing<CapturedPacket> ring(MakeRing(8));
+    const uint32_t frames = kSlotFrames * 2 + kSlotFrames / 2 + 1;
+    const std::vector<uint8_t> bytes = Pattern(frames);
+    int calls = 0;
+    CHECK(PublishCapturedPacket(ring, Packet(bytes, kStart, true), kBlockAlign, kRate, Halve(calls)));
+    CHECK(calls == 3 && ring.SizeApprox() == 3);
+
+    std::vector<uint8_t> joined;
+    uint64_t expectedTimestamp = kStart;
+    for (int i = 0; i < 3; i++) {
+        const CapturedPacket* slot = ring.Front();
+        if (!CHECK(slot->timing.timestamp == expectedTimestamp)) {
+            fprintf(stderr, "  slot %d: timestamp %llu, expected %llu\n", i,
+                    (unsigned long long)slot->timing.timestamp, (unsigned long long)expectedTimestamp);
+        }
+        CHECK(slot->timing.discontinuity == (i == 0) && slot->size % kBlockAlign == 0);
+        joined.insert(joined.end(), slot->data.begin(), slot->data.begin() + slot->size);
+        expectedTimestamp += (uint64_t)(slot->size / kBlockAlign) * 10000000ull / kRate;
+        ring.Pop();
+    }
+    bool same = joined.size() == bytes.size();
+    for (size_t i = 0; same && i < bytes.size(); i++) same = joined[i] == bytes[i] / 2;
+    CHECK(same);
+
+    // Unknown capture time stays unknown in every slot
+    CHECK(PublishCapturedPacket(ring, Packet(bytes, 0), kBlockAlign, kRate, Halve(calls)));
+    bool unknown = true;
+    while (const CapturedPacket* slot = ring.Front()) {
+        unknown = unknown && slot->timing.timestamp == 0;
+        ring.Pop();
+    }
+    CHECK(unknown);
+}
+
+void TestFullRing() {
+    // Two slots free, a packet needing three: the third is dropped and counted
+    SpscRing<CapturedPacket> ring(MakeRing(2));
+    const std::vector<uint8_t> bytes = Pattern(kSlotFrames * 3);
+    int calls = 0;
+    CHECK(PublishCapturedPacket(ring, Packet(bytes), kBlockAlign, kRate, Halve(calls)));
+    CHECK(calls == 2 && ring.SizeApprox() == 2 && ring.Overruns() == 1);
+
+    // Full before the packet: nothing published, still reported as captured
+    CapturePacket silent;
+    silent.frames = 480;
+    silent.silent = true;
+    CHECK(PublishCapturedPacket(ring, silent, kBlockAlign, kRate, Halve(calls)));
+    CHECK(ring.SizeApprox() == 2 && ring.Overruns() == 2);
+}
+
+void TestRejected() {
+    SpscRing<CapturedPacket> ring(MakeRing(4));
+    int calls = 0;
+    CapturePacket empty;
+    CHECK(!PublishCapturedPacket(ring, empty, kBlockAlign, kRate, Halve(calls)));
+    CapturePacket noData;
+    noData.frames = 480;
+    CHECK(!PublishCapturedPacket(ring, noData, kBlockAlign, kRate, Halve(calls)));
+    CHECK(calls == 0 && ring.SizeApprox() == 0 && ring.Overruns() == 0);
+
+    CHECK(TimestampAfter(kStart, 48000 * kBlockAlign, kBlockAlign, kRate) == kStart + 10000000);
+    CHECK(TimestampAfter(0, 4800, kBlockAlign, kRate) == 0);
+}
+
+} // namespace
+
+int main() {
+    TestSingleSlot();
+    TestSilent();
+    TestSplit();
+    TestFullRing();
+    TestRejected();
+    return test::TestResult();
+}
@@ -0,0 +1,238 @@
+// DeviceCache over a fake device source standing in for
+// IMMDeviceEnumerator: devices are listed and activated once and then
+// served from the cache, a device added, removed, changing state or
+// becoming the default render device empties it, capture and property
+// changes don't, and without notifications or after a failed listing every
+// call lists again.
+
+#include "DeviceCache.h"
+#include "TestCheck.h"
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct FakeDevice {
+    std::wstring id;
+    bool activated;
+};
+
+// The endpoints and what the cache asked for. Shared with the test, which
+// keeps it after handing the source to the cache.
+struct FakeEndpoints {
+    std::vector<FakeDevice> devices;
+    std::function<void(DeviceEvent)> onEvent;
+    bool openFails = false;
+    bool subscribeFails = false;
+    bool listFails = false;
+    int opens = 0;
+    int closes = 0;
+    int lists = 0;
+
+    void Fire(DeviceEvent event) {
+        if (onEvent) onEvent(event);
+    }
+};
+
+class FakeSource : public DeviceSource<FakeDevice> {
+public:
+    explicit FakeSource(FakeEndpoints& endpoints) : m_endpoints(endpoints) {}
+
+    bool Open() override {
+        m_endpoints.opens++;
+        return !m_endpoints.openFails;
+    }
+    bool Subscribe(std::function<void(DeviceEvent)> onEvent) override {
+        if (m_endpoints.subscribeFails) return false;
+        m_endpoints.onEvent = std::move(onEvent);
+        return true;
+    }
+    void Close() override {
+        m_endpoints.closes++;
+        m_endpoints.onEvent = nullptr;
+    }
+    bool List(std::vector<FakeDevice>& devices) override {
+        m_endpoints.lists++;
+        if (m_endpoints.listFails) {
+            devices.push_back({ L"half-listed", true });   // The cache must not keep this
+            return false;
+        }
+        devices = m_endpoints.devices;
+        return true;
+    }
+    bool IsActivated(const FakeDevice& device) const override { return device.activated; }
+
+private:
+    FakeEndpoints& m_endpoints;
+};
+
+std::unique_ptr<DeviceSource<FakeDevice>> Source(FakeEndpoints& endpoints) {
+    return std::make_unique<FakeSource>(endpoints);
+}
+
+std::vector<std::wstring> Ids(const std::vector<FakeDevice>& devices) {
+    std::vector<std::wstring> ids;
+    for (const FakeDevice& device : devices) ids.push_back(device.id);
+    return ids;
+}
+
+void TestHitsAndMisses() {
+    FakeEndpoints endpoints;
+    endpoints.devices = { { L"speakers", true }, { L"headset", true }, { L"broken", false } };
+    DeviceCache<FakeDevice> cache(Source(endpoints));
+
+    // First call lists and activates all three: misses
+    CHECK(cache.GetDevices().size() == 3);
+    CHECK(endpoints.opens == 1 && endpoints.lists == 1 && cache.GetGeneration() == 1);
+    DeviceCache<FakeDevice>::Stats stats = cache.GetStats();
+    CHECK(stats.misses == 3 && stats.hits == 0 && stats.invalidations == 0);
+
+    // Then served from the cache: a hit per activated device, no listing
+    for (int i = 0; i < 10; i++) cache.GetDevices();
+    stats = cache.GetStats();
+    CHECK(endpoints.lists == 1 && cache.GetGeneration() == 1 && endpoints.opens == 1);
+    CHECK(stats.misses == 3 && stats.hits == 20);
+
+    // A device change the cache hasn't been told about isn't seen
+    endpoints.devices.pop_back();
+    CHECK(cache.GetDevices().size() == 3);
+}
+
+void TestInvalidatingEvents() {
+    const DeviceEvent events[] = { DeviceEvent::Added, DeviceEvent::Removed, DeviceEvent::StateChanged,
+                                   DeviceEvent::DefaultRenderChanged };
+    for (DeviceEvent event : events) {
+        FakeEndpoints endpoints;
+        endpoints.devices = { { L"speakers", true }, { L"headset", true } };
+        DeviceCache<FakeDevice> cache(Source(endpoints));
+        cache.GetDevices();
+        cache.GetDevices();
+        CHECK(endpoints.onEvent != nullptr);
+
+        // The headset is unplugged and a dock appears
+        endpoints.devices = { { L"speakers", true }, { L"dock", true } };
+        endpoints.Fire(event);
+        const std::vector<std::wstring> ids = Ids(cache.GetDevices());
+        if (!CHECK(ids == std::vector<std::wstring>({ L"speakers", L"dock" }) && endpoints.lists == 2)) {
+            fprintf(stderr, "  event %d: %zu devices after %d listings\n", (int)event, ids.size(), endpoints.lists);
+        }
+        const DeviceCache<FakeDevice>::Stats stats = cache.GetStats();
+        CHECK(cache.GetGeneration() == 2 && stats.invalidations == 1 && stats.misses == 4 && stats.hits == 2);
+
+        // One listing per burst of notifications
+        endpoints.Fire(event);
+        endpoints.Fire(event);
+        cache.GetDevices();
+        cache.GetDevices();
+        CHECK(endpoints.lists == 3 && cache.GetStats().invalidations == 3);
+    }
+}
+
+void TestIgnoredEvents() {
+    FakeEndpoints endpoints;
+    endpoints.devices = { { L"speakers", true } };
+    DeviceCache<FakeDevice> cache(Source(endpoints));
+    cache.GetDevices();
+    endpoints.Fire(DeviceEvent::DefaultCaptureChanged);
+    endpoints.Fire(DeviceEvent::PropertyChanged);
+    cache.GetDevices();
+    CHECK(endpoints.lists == 1 && cache.GetStats().invalidations == 0 && cache.GetStats().hits == 1);
+}
+
+// A caller whose cached device failed
+void TestInvalidate() {
+    FakeEndpoints endpoints;
+    endpoints.devices = { { L"speakers", true } };
+    DeviceCache<FakeDevice> cache(Source(endpoints));
+    cache.GetDevices();
+    cache.Invalidate();
+    cache.GetDevices();
+    CHECK(endpoints.lists == 2 && cache.GetGeneration() == 2 && cache.GetStats().invalidations == 1);
+}
+
+void TestFailures() {
+    // No enumerator: empty, and tried again on the next call
+    FakeEndpoints endpoints;
+    endpoints.devices = { { L"speakers", true } };
+    endpoints.openFails = true;
+    DeviceCache<FakeDevice> cache(Source(endpoints));
+    CHECK(!cache.Initialize());
+    CHECK(cache.GetDevices().empty() && endpoints.opens == 2 && endpoints.lists == 0);
+    endpoints.openFails = false;
+    CHECK(cache.GetDevices().size() == 1 && endpoints.opens == 3);
+
+    // A failed listing leaves nothing behind and is retried
+    endpoints.listFails = true;
+    cache.Invalidate();
+    CHECK(cache.GetDevices().empty());
+    CHECK(cache.GetDevices().empty() && endpoints.lists == 3);
+    endpoints.listFails = false;
+    CHECK(cache.GetDevices().size() == 1 && endpoints.lists == 4);
+    cache.GetDevices();
+    CHECK(endpoints.lists == 4);
+
+    // Without notifications nothing would tell it the list changed: list every time
+    FakeEndpoints unnotified;
+    unnotified.devices = { { L"speakers", true } };
+    unnotified.subscribeFails = true;
+    DeviceCache<FakeDevice> polling(Source(unnotified));
+    for (int i = 0; i < 5; i++) polling.GetDevices();
+    CHECK(unnotified.lists == 5 && polling.GetStats().hits == 0 && polling.GetStats().misses == 5);
+}
+
+void TestReset() {
+    FakeEndpoints endpoints;
+    endpoints.devices = { { L"speakers", true } };
+    {
+        DeviceCache<FakeDevice> cache(Source(endpoints));
+        cache.GetDevices();
+        cache.Reset();
+        CHECK(endpoints.closes == 1 && endpoints.onEvent == nullptr);
+
+        // Opened and listed afresh
+        cache.GetDevices();
+        CHECK(endpoints.opens == 2 && endpoints.lists == 2);
+    }
+    CHECK(endpoints.closes == 2);
+}
+
+// Notifications arrive on a system thread while the poll thread reads
+void TestEventsFromAnotherThread() {
+    FakeEndpoints endpoints;
+    endpoints.devices = { { L"speakers", true }, { L"headset", true } };
+    DeviceCache<FakeDevice> cache(Source(endpoints));
+    cache.GetDevices();
+
+    const std::function<void(DeviceEvent)> onEvent = endpoints.onEvent;
+    std::atomic<bool> done{ false };
+    std::thread notifier([&] {
+        for (int i = 0; i < 10000; i++) onEvent(DeviceEvent::StateChanged);
+        done = true;
+    });
+    while (!done) CHECK(cache.GetDevices().size() == 2);
+    notifier.join();
+
+    CHECK(cache.GetStats().invalidations == 10000);
+
+    // And still heard afterwards
+    const int lists = endpoints.lists;
+    onEvent(DeviceEvent::Removed);
+    cache.GetDevices();
+    CHECK(endpoints.lists == lists + 1 && cache.GetStats().invalidations == 10001);
+}
+
+} // namespace
+
+int main() {
+    TestHitsAndMisses();
+    TestInvalidatingEvents();
+    TestIgnoredEvents();
+    TestInvalidate();
+    TestFailures();
+    TestReset();
+    TestEventsFromAnotherThread();
+    return test::TestResult();
+}
@@ -0,0 +1,166 @@
+// DriftController convergence on a synthetic source running +-200 ppm off
+// the reference: alone against a simulated fill level (both tunings, with
+// the packet sawtooth the fill-level loop has to live with), and inside an
+// AudioMixer fed in virtual time. The mixer runs two simulated minutes by
+// default; --long runs twenty, as registered under the "long" ctest label
+// (-DLONG_TESTS=ON).
+
+#include "AudioMixer.h"
+#include "DriftController.h"
+#include "TestCheck.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+struct LoopResult {
+    double finalPpm;      // Correction at the end
+    double maxErrorMs;    // Largest fill error while locking
+    double ripplePpm;     // Correction's spread over the last minute
+};
+
+// The source gains `offsetPpm` on the reference; the correction takes it
+// back. Updated every 20 ms of output, like the mixer's blocks. The error
+// the loop sees carries a sawtooth of `sawtoothMs` (packet granularity).
+LoopResult RunLoop(const DriftController::Tuning& tuning, double offsetPpm, double seconds, double sawtoothMs) {
+    DriftController drift;
+    drift.SetTuning(tuning);
+    const double dt = 0.020;
+    double error = 0.0;   // Seconds the source's fill is ahead
+    LoopResult result = { 0.0, 0.0, 0.0 };
+    double lastMin = 1e9, lastMax = -1e9;
+    const int steps = (int)(seconds / dt);
+    for (int i = 0; i < steps; i++) {
+        error += (offsetPpm * 1e-6 - drift.GetCorrection()) * dt;
+        const double sawtooth = sawtoothMs * 1e-3 * (std::fmod(i * dt, 0.01) / 0.01 - 0.5);
+        drift.Update(error + sawtooth, dt);
+        result.maxErrorMs = (std::max)(result.maxErrorMs, std::fabs(error) * 1000.0);
+        if (i * dt >= seconds - 60.0) {
+            lastMin = (std::min)(lastMin, drift.GetDriftPpm());
+            lastMax = (std::max)(lastMax, drift.GetDriftPpm());
+        }
+    }
+    result.finalPpm = drift.GetDriftPpm();
+    result.ripplePpm = lastMax - lastMin;
+    return result;
+}
+
+void TestController() {
+    for (double offset : { 200.0, -200.0 }) {
+        // Timestamps: locks in under a minute within a few ms
+        const LoopResult timed = RunLoop(DriftController::kTimestampTuning, offset, 180.0, 0.0);
+        if (!CHECK(std::fabs(timed.finalPpm - offset) < 2.0 && timed.maxErrorMs < 3.0)) {
+            fprintf(stderr, "  timestamp tuning, %+.0f ppm: %.1f ppm, max error %.2f ms\n",
+                    offset, timed.finalPpm, timed.maxErrorMs);
+        }
+
+        // Fill level: minutes to lock, under 20 ms off, little ripple from a
+        // full-packet sawtooth
+        const LoopResult fill = RunLoop(DriftController::kFillLevelTuning, offset, 1200.0, 10.0);
+        if (!CHECK(std::fabs(fill.finalPpm - offset) < 10.0 && fill.maxErrorMs < 20.0 && fill.ripplePpm < 50.0)) {
+            fprintf(stderr, "  fill tuning, %+.0f ppm: %.1f ppm, max error %.2f ms, ripple %.1f ppm\n",
+                    offset, fill.finalPpm, fill.maxErrorMs, fill.ripplePpm);
+        }
+    }
+
+    // Past the clamp the integrator holds, and recovers without windup
+    DriftController drift;
+    drift.SetTuning(DriftController::kTimestampTuning);
+    for (int i = 0; i < 1000; i++) drift.Update(1.0, 0.02);
+    CHECK(drift.GetCorrection() == DriftController::kMaxCorrection);
+    double error = 0.0;
+    for (int i = 0; i < 9000; i++) {
+        error += (200e-6 - drift.GetCorrection()) * 0.02;
+        drift.Update(error, 0.02);
+    }
+    CHECK(std::fabs(drift.GetDriftPpm() - 200.0) < 2.0);
+
+    // ResetError keeps what was learned
+    drift.ResetError();
+    CHECK(std::fabs(drift.GetDriftPpm() - 200.0) < 5.0);
+    drift.Reset();
+    CHECK(drift.GetCorrection() == 0.0);
+}
+
+WAVEFORMATEX FloatFormat(uint32_t rate, WORD channels) {
+    WAVEFORMATEX format = {};
+    format.wFormatTag = WAVE_FORMAT_IEEE_FLOAT;
+    format.nChannels = channels;
+    format.nSamplesPerSec = rate;
+    format.wBitsPerSample = 32;
+    format.nBlockAlign = (WORD)(channels * 4);
+    format.nAvgBytesPerSec = rate * format.nBlockAlign;
+    return format;
+}
+
+// Two untimestamped 10 ms sources, one `offsetPpm` fast, mixed in 20 ms
+// blocks on the other's clock for `seconds`: the mixer must learn the offset
+// (to `tolerancePpm`; it is still settling after a few minutes) and never
+// run the fast source dry or let it pile up
+void TestMixer(double offsetPpm, double seconds, double tolerancePpm) {
+    const uint32_t rate = 48000;
+    const WAVEFORMATEX format = FloatFormat(rate, 1);
+    AudioMixer mixer;
+    CHECK(mixer.Initialize(&format));
+
+    std::vector<float> packet(rate / 100, 0.1f);
+    std::vector<BYTE> mixed;
+    const double period = 0.010;
+    double nextReference = 0.0, nextSource = 0.004, nextMix = 0.1;
+    double worstLatencyMs = 0.0;
+    double ppmSum = 0.0;
+    size_t ppmCount = 0;
+    size_t quietBlocks = 0;
+    bool sourceIsReference = false;
+    for (double t = 0.0; t < seconds; t += 0.001) {
+        while (nextReference <= t) {
+            mixer.AddAudioData(1, reinterpret_cast<const BYTE*>(packet.data()),
+                               (UINT32)(packet.size() * sizeof(float)), &format);
+            nextReference += period;
+        }
+        while (nextSource <= t) {
+            mixer.AddAudioData(2, reinterpret_cast<const BYTE*>(packet.data()),
+                               (UINT32)(packet.size() * sizeof(float)), &format);
+            nextSource += period / (1.0 + offsetPpm * 1e-6);
+        }
+        if (t >= nextMix) {
+            nextMix += 0.020;
+            if (!mixer.GetMixedAudio(mixed, rate / 50)) continue;
+            // Both sources present: 0.2 once the limiter's look-ahead has passed
+            const float* samples = reinterpret_cast<const float*>(mixed.data());
+            if (t > 60.0 && std::fabs(samples[0] - 0.2f) > 0.01f) quietBlocks++;
+            for (const AudioMixer::SourceClockStats& stats : mixer.GetClockStats()) {
+                if (t > seconds / 2) worstLatencyMs = (std::max)(worstLatencyMs, stats.latencyMs);
+                // The proportional term follows the packet sawtooth; average
+                // the last quarter
+                if (stats.sourceId == 2 && t > seconds * 0.75) {
+                    ppmSum += stats.driftPpm;
+                    ppmCount++;
+                    sourceIsReference = stats.reference;
+                }
+            }
+        }
+    }
+
+    const double sourcePpm = ppmCount ? ppmSum / (double)ppmCount : 0.0;
+    CHECK(ppmCount > 0 && !sourceIsReference);
+    if (!CHECK(std::fabs(sourcePpm - offsetPpm) < tolerancePpm && quietBlocks == 0 && worstLatencyMs < 120.0)) {
+        fprintf(stderr, "  mixer, %+.0f ppm: learned %.1f ppm on average, %zu blocks short, latency up to %.1f ms\n",
+                offsetPpm, sourcePpm, quietBlocks, worstLatencyMs);
+    }
+    CHECK(mixer.GetDroppedFrameCount() == 0);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const bool longRun = argc > 1 && strcmp(argv[1], "--long") == 0;
+    const double mixerSeconds = longRun ? 1200.0 : 120.0;
+    const double tolerancePpm = longRun ? 20.0 : 50.0;
+    TestController();
+    TestMixer(200.0, mixerSeconds, tolerancePpm);
+    TestMixer(-200.0, mixerSeconds, tolerancePpm);
+    return test::TestResult();
+}
@@ -0,0 +1,126 @@
+// EncoderSinkRegistry and NullSink, and a sink driven through
+// EncoderWorkerPool the way CaptureManager uses one: opened, fed packets
+// from one thread, closed. Built without any Windows header.
+
+#include "EncoderSink.h"
+#include "EncoderWorkerPool.h"
+#include "TestCheck.h"
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+// Keeps everything written, and counts the calls
+class RecordingSink : public IEncoderSink {
+public:
+    struct Log {
+        std::mutex mutex;
+        std::vector<uint8_t> bytes;
+        int opens = 0;
+        int writes = 0;
+        int closes = 0;
+    };
+
+    explicit RecordingSink(std::shared_ptr<Log> log) : m_log(std::move(log)) {}
+
+    bool Open(const std::wstring&, const WAVEFORMATEX*, uint32_t) override {
+        std::lock_guard<std::mutex> lock(m_log->mutex);
+        m_log->opens++;
+        return true;
+    }
+    bool Write(const uint8_t* data, uint32_t size) override {
+        std::lock_guard<std::mutex> lock(m_log->mutex);
+        m_log->bytes.insert(m_log->bytes.end(), data, data + size);
+        m_log->writes++;
+        return true;
+    }
+    void Close() override {
+        std::lock_guard<std::mutex> lock(m_log->mutex);
+        m_log->closes++;
+    }
+
+private:
+    std::shared_ptr<Log> m_log;
+};
+
+void TestRegistry() {
+    EncoderSinkRegistry registry;
+    CHECK(!registry.IsRegistered(AudioFormat::WAV));
+    CHECK(registry.Create(AudioFormat::WAV) == nullptr);
+
+    auto log = std::make_shared<RecordingSink::Log>();
+    registry.Register(AudioFormat::WAV, [log] { return std::make_unique<RecordingSink>(log); });
+    CHECK(registry.IsRegistered(AudioFormat::WAV));
+    CHECK(!registry.IsRegistered(AudioFormat::MP3));
+
+    // A fresh, unopened sink per call
+    std::unique_ptr<IEncoderSink> first = registry.Create(AudioFormat::WAV);
+    std::unique_ptr<IEncoderSink> second = registry.Create(AudioFormat::WAV);
+    CHECK(first && second && first != second);
+    CHECK(log->opens == 0);
+
+    // Registering again replaces the factory
+    registry.Register(AudioFormat::WAV, [] { return std::make_unique<NullSink>(); });
+    CHECK(dynamic_cast<NullSink*>(registry.Create(AudioFormat::WAV).get()) != nullptr);
+
+    // An empty factory stays registered but creates nothing
+    registry.Register(AudioFormat::FLAC, EncoderSinkRegistry::Factory());
+    CHECK(registry.IsRegistered(AudioFormat::FLAC));
+    CHECK(registry.Create(AudioFormat::FLAC) == nullptr);
+}
+
+void TestNullSink() {
+    NullSink sink;
+    CHECK(sink.Open(L"ignored", nullptr, 0));
+    const uint8_t packet[100] = {};
+    for (int i = 0; i < 10; i++) CHECK(sink.Write(packet, sizeof(packet)));
+    sink.Flush();
+    sink.Close();
+    sink.Close();
+    CHECK(sink.GetBytesWritten() == 1000);
+}
+
+// Packets reach the sink whole and in order, and the sink is closed once
+void TestThroughPool() {
+    auto log = std::make_shared<RecordingSink::Log>();
+    EncoderSinkRegistry registry;
+    registry.Register(AudioFormat::WAV, [log] { return std::make_unique<RecordingSink>(log); });
+
+    EncoderWorkerPool pool(2);
+    std::unique_ptr<IEncoderSink> sink = registry.Create(AudioFormat::WAV);
+    CHECK(sink->Open(L"out.wav", nullptr, 0));
+    std::shared_ptr<EncoderWorkerPool::Stream> stream = pool.OpenStream(std::move(sink), 1 << 20, 1 << 22);
+    CHECK(stream != nullptr);
+    CHECK(pool.OpenStream(nullptr, 1, 1) == nullptr);
+
+    std::vector<uint8_t> expected;
+    std::vector<uint8_t> packet;
+    for (int p = 0; p < 500; p++) {
+        packet.resize(1 + (p * 37) % 300);
+        for (size_t i = 0; i < packet.size(); i++) packet[i] = (uint8_t)(p + i);
+        expected.insert(expected.end(), packet.begin(), packet.end());
+        CHECK(pool.Submit(*stream, packet.data(), (uint32_t)packet.size()) == EncoderWorkerPool::SubmitResult::Queued);
+    }
+    pool.CloseStream(*stream);
+    pool.CloseStream(*stream);
+
+    CHECK(log->opens == 1 && log->writes == 500 && log->closes == 1);
+    CHECK(log->bytes == expected);
+    const EncoderWorkerPool::Stats stats = pool.GetStats();
+    CHECK(stats.packetsWritten == 500 && stats.bytesWritten == expected.size());
+    CHECK(stats.bytesQueued == 0 && stats.writeFailures == 0 && stats.rejectedPackets == 0);
+
+    // Closed: refused and counted
+    CHECK(pool.Submit(*stream, packet.data(), (uint32_t)packet.size()) == EncoderWorkerPool::SubmitResult::Rejected);
+    CHECK(pool.GetStreamStats(*stream).rejectedPackets == 1);
+}
+
+} // namespace
+
+int main() {
+    TestRegistry();
+    TestNullSink();
+    TestThroughPool();
+    return test::TestResult();
+}
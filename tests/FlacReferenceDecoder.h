@@ -0,0 +1,489 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// A small, strict FLAC decoder for the tests, written from the format
+// specification and sharing no code with FlacStreamEncoder. Decodes every
+// subframe type (CONSTANT, VERBATIM, FIXED, LPC, wasted bits, escaped Rice
+// partitions) and channel assignment, checks both CRCs, the frame numbering
+// and every STREAMINFO field it can, and hashes the output with its own MD5.
+
+namespace flactest {
+
+// RFC 1321
+class Md5 {
+public:
+    Md5() {
+        m_state[0] = 0x67452301;
+        m_state[1] = 0xefcdab89;
+        m_state[2] = 0x98badcfe;
+        m_state[3] = 0x10325476;
+    }
+
+    void Update(const uint8_t* data, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            m_block[m_length++ % 64] = data[i];
+            if (m_length % 64 == 0) Transform(m_block);
+        }
+    }
+
+    void Final(uint8_t digest[16]) {
+        const uint64_t bits = m_length * 8;
+        const uint8_t pad = 0x80, zero = 0;
+        Update(&pad, 1);
+        while (m_length % 64 != 56) Update(&zero, 1);
+        for (int i = 0; i < 8; i++) {
+            const uint8_t byte = static_cast<uint8_t>(bits >> (8 * i));
+            Update(&byte, 1);
+        }
+        for (int i = 0; i < 16; i++) digest[i] = static_cast<uint8_t>(m_state[i / 4] >> (8 * (i % 4)));
+    }
+
+private:
+    static uint32_t Rotate(uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+
+    void Transform(const uint8_t* block) {
+        static const int shifts[64] = { 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+                                        5, 9,  14, 20, 5, 9,  14, 20, 5, 9,  14, 20, 5, 9,  14, 20,
+                                        4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+                                        6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21 };
+        static const uint32_t sines[64] = {
+            0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+            0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+            0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+            0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+            0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+            0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+            0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+            0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+        };
+        uint32_t m[16];
+        for (int i = 0; i < 16; i++) {
+            m[i] = block[i * 4] | (block[i * 4 + 1] << 8) | (block[i * 4 + 2] << 16) |
+                   (static_cast<uint32_t>(block[i * 4 + 3]) << 24);
+        }
+        uint32_t a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3];
+        for (int i = 0; i < 64; i++) {
+            uint32_t f;
+            int g;
+            if (i < 16) {
+                f = (b & c) | (~b & d);
+                g = i;
+            } else if (i < 32) {
+                f = (d & b) | (~d & c);
+                g = (5 * i + 1) % 16;
+            } else if (i < 48) {
+                f = b ^ c ^ d;
+                g = (3 * i + 5) % 16;
+            } else {
+                f = c ^ (b | ~d);
+                g = (7 * i) % 16;
+            }
+            const uint32_t next = d;
+            d = c;
+            c = b;
+            b = b + Rotate(a + f + sines[i] + m[g], shifts[i]);
+            a = next;
+        }
+        m_state[0] += a;
+        m_state[1] += b;
+        m_state[2] += c;
+        m_state[3] += d;
+    }
+
+    uint32_t m_state[4];
+    uint8_t m_block[64] = {};
+    uint64_t m_length = 0;
+};
+
+// MD5 of interleaved samples as FLAC hashes them: little-endian, in the
+// stream's whole-byte width
+inline void SampleMd5(const int32_t* samples, size_t count, uint32_t bitsPerSample, uint8_t digest[16]) {
+    Md5 md5;
+    const uint32_t width = (bitsPerSample + 7) / 8;
+    for (size_t i = 0; i < count; i++) {
+        uint8_t bytes[4];
+        for (uint32_t b = 0; b < width; b++) bytes[b] = static_cast<uint8_t>(static_cast<uint32_t>(samples[i]) >> (8 * b));
+        md5.Update(bytes, width);
+    }
+    md5.Final(digest);
+}
+
+struct StreamInfo {
+    uint32_t minBlockSize = 0;
+    uint32_t maxBlockSize = 0;
+    uint32_t minFrameBytes = 0;
+    uint32_t maxFrameBytes = 0;
+    uint32_t sampleRate = 0;
+    uint32_t channels = 0;
+    uint32_t bitsPerSample = 0;
+    uint64_t totalSamples = 0;
+    uint8_t md5[16] = {};
+};
+
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t size) : m_data(data), m_size(size) {}
+
+    bool Ok() const { return m_ok; }
+    size_t BytePosition() const { return m_bit / 8; }
+    void AlignToByte() { m_bit = (m_bit + 7) & ~static_cast<size_t>(7); }
+
+    uint32_t Read(uint32_t bits) {
+        uint64_t value = 0;
+        for (uint32_t i = 0; i < bits; i++) value = (value << 1) | Bit();
+        return static_cast<uint32_t>(value);
+    }
+
+    int64_t ReadSigned(uint32_t bits) {
+        if (bits == 0) return 0;
+        int64_t value = Read(bits);
+        if (value >> (bits - 1)) value -= int64_t(1) << bits;
+        return value;
+    }
+
+    uint32_t ReadUnary() {
+        uint32_t zeros = 0;
+        while (m_ok && Bit() == 0) zeros++;
+        return zeros;
+    }
+
+private:
+    uint32_t Bit() {
+        if (m_bit >= m_size * 8) {
+            m_ok = false;
+            return 0;
+        }
+        const uint32_t bit = (m_data[m_bit / 8] >> (7 - m_bit % 8)) & 1;
+        m_bit++;
+        return bit;
+    }
+
+    const uint8_t* m_data;
+    size_t m_size;
+    size_t m_bit = 0;
+    bool m_ok = true;
+};
+
+class Decoder {
+public:
+    // Decode a whole stream. On failure Error() says where it stopped.
+    bool Decode(const std::vector<uint8_t>& stream) {
+        m_samples.clear();
+        m_frameBytes.clear();
+        m_lastBlockShort = false;
+        m_constantSubframes = m_verbatimSubframes = m_fixedSubframes = m_lpcSubframes = 0;
+        if (stream.size() < 4 || memcmp(stream.data(), "fLaC", 4) != 0) return Fail("no fLaC marker");
+
+        // Metadata: STREAMINFO first, the rest skipped
+        size_t pos = 4;
+        bool last = false, haveInfo = false;
+        while (!last) {
+            if (pos + 4 > stream.size()) return Fail("truncated metadata");
+            last = (stream[pos] & 0x80) != 0;
+            const uint32_t type = stream[pos] & 0x7F;
+            const size_t length = (stream[pos + 1] << 16) | (stream[pos + 2] << 8) | stream[pos + 3];
+            pos += 4;
+            if (pos + length > stream.size()) return Fail("truncated metadata block");
+            if (type == 0) {
+                if (haveInfo || length != 34) return Fail("bad STREAMINFO");
+                BitReader r(stream.data() + pos, length);
+                m_info.minBlockSize = r.Read(16);
+                m_info.maxBlockSize = r.Read(16);
+                m_info.minFrameBytes = r.Read(24);
+                m_info.maxFrameBytes = r.Read(24);
+                m_info.sampleRate = r.Read(20);
+                m_info.channels = r.Read(3) + 1;
+                m_info.bitsPerSample = r.Read(5) + 1;
+                m_info.totalSamples = static_cast<uint64_t>(r.Read(4)) << 32;
+                m_info.totalSamples |= r.Read(32);
+                for (uint8_t& byte : m_info.md5) byte = static_cast<uint8_t>(r.Read(8));
+                haveInfo = true;
+            } else if (!haveInfo) {
+                return Fail("STREAMINFO is not the first block");
+            }
+            pos += length;
+        }
+        if (m_info.minBlockSize < 16 || m_info.maxBlockSize < m_info.minBlockSize) return Fail("bad block sizes");
+
+        uint64_t frameNumber = 0;
+        while (pos < stream.size()) {
+            const size_t size = DecodeFrame(stream.data() + pos, stream.size() - pos, frameNumber);
+            if (size == 0) return false;
+            m_frameBytes.push_back(static_cast<uint32_t>(size));
+            pos += size;
+            frameNumber++;
+        }
+        return true;
+    }
+
+    const StreamInfo& Info() const { return m_info; }
+    const std::vector<int32_t>& Samples() const { return m_samples; }   // Interleaved
+    const std::vector<uint32_t>& FrameBytes() const { return m_frameBytes; }
+    const std::string& Error() const { return m_error; }
+    uint32_t ConstantSubframes() const { return m_constantSubframes; }
+    uint32_t VerbatimSubframes() const { return m_verbatimSubframes; }
+    uint32_t FixedSubframes() const { return m_fixedSubframes; }
+    uint32_t LpcSubframes() const { return m_lpcSubframes; }
+
+private:
+    bool Fail(const std::string& error) {
+        m_error = error;
+        return false;
+    }
+
+    size_t FailFrame(uint64_t frameNumber, const std::string& error) {
+        m_error = "frame " + std::to_string(frameNumber) + ": " + error;
+        return 0;
+    }
+
+    static uint8_t Crc8(const uint8_t* data, size_t size) {
+        uint8_t crc = 0;
+        for (size_t i = 0; i < size; i++) {
+            crc ^= data[i];
+            for (int b = 0; b < 8; b++) crc = static_cast<uint8_t>(crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1);
+        }
+        return crc;
+    }
+
+    static uint16_t Crc16(const uint8_t* data, size_t size) {
+        uint16_t crc = 0;
+        for (size_t i = 0; i < size; i++) {
+            crc ^= static_cast<uint16_t>(data[i] << 8);
+            for (int b = 0; b < 8; b++) crc = static_cast<uint16_t>(crc & 0x8000 ? (crc << 1) ^ 0x8005 : crc << 1);
+        }
+        return crc;
+    }
+
+    // Bytes the frame took, 0 on error
+    size_t DecodeFrame(const uint8_t* data, size_t size, uint64_t expectedNumber) {
+        BitReader r(data, size);
+        if (r.Read(14) != 0x3FFE) return FailFrame(expectedNumber, "lost sync");
+        if (r.Read(1) != 0) return FailFrame(expectedNumber, "reserved bit set");
+        const bool variableBlocks = r.Read(1) != 0;
+        const uint32_t blockCode = r.Read(4);
+        const uint32_t rateCode = r.Read(4);
+        const uint32_t assignment = r.Read(4);
+        const uint32_t sizeCode = r.Read(3);
+        if (r.Read(1) != 0) return FailFrame(expectedNumber, "reserved bit set");
+
+        // UTF-8 style coded frame (or sample) number
+        uint64_t number = r.Read(8);
+        int extra = 0;
+        if (number >= 0xFE) return FailFrame(expectedNumber, "bad coded number");
+        for (uint32_t mask = 0x80; number & mask; mask >>= 1) extra++;
+        if (extra == 1) return FailFrame(expectedNumber, "bad coded number");
+        if (extra > 0) number &= (1u << (7 - extra)) - 1;
+        for (int i = 1; i < extra; i++) {
+            const uint32_t byte = r.Read(8);
+            if ((byte & 0xC0) != 0x80) return FailFrame(expectedNumber, "bad coded number");
+            number = (number << 6) | (byte & 0x3F);
+        }
+        if (variableBlocks || number != expectedNumber) return FailFrame(expectedNumber, "out of sequence");
+
+        uint32_t blockSize = 0;
+        if (blockCode == 0) return FailFrame(expectedNumber, "reserved block size");
+        else if (blockCode == 1) blockSize = 192;
+        else if (blockCode <= 5) blockSize = 576u << (blockCode - 2);
+        else if (blockCode == 6) blockSize = r.Read(8) + 1;
+        else if (blockCode == 7) blockSize = r.Read(16) + 1;
+        else blockSize = 256u << (blockCode - 8);
+
+        static const uint32_t rates[12] = { 0, 88200, 176400, 192000, 8000, 16000, 22050, 24000, 32000, 44100, 48000, 96000 };
+        uint32_t rate = 0;
+        if (rateCode == 0) rate = m_info.sampleRate;
+        else if (rateCode < 12) rate = rates[rateCode];
+        else if (rateCode == 12) rate = r.Read(8) * 1000;
+        else if (rateCode == 13) rate = r.Read(16);
+        else if (rateCode == 14) rate = r.Read(16) * 10;
+        else return FailFrame(expectedNumber, "bad sample rate code");
+        if (rate != m_info.sampleRate) return FailFrame(expectedNumber, "sample rate differs from STREAMINFO");
+
+        static const uint32_t sizes[8] = { 0, 8, 12, 0, 16, 20, 24, 32 };
+        const uint32_t bps = sizeCode == 0 ? m_info.bitsPerSample : sizes[sizeCode];
+        if (bps != m_info.bitsPerSample) return FailFrame(expectedNumber, "sample size differs from STREAMINFO");
+
+        const uint32_t channels = assignment < 8 ? assignment + 1 : 2;
+        if (assignment > 10 || channels != m_info.channels) return FailFrame(expectedNumber, "bad channel assignment");
+
+        const size_t headerBytes = r.BytePosition();
+        const uint8_t crc8 = static_cast<uint8_t>(r.Read(8));
+        if (!r.Ok() || crc8 != Crc8(data, headerBytes)) return FailFrame(expectedNumber, "header CRC mismatch");
+
+        // Fixed-size blocks; only the last may be shorter
+        if (blockSize > m_info.maxBlockSize || m_lastBlockShort) return FailFrame(expectedNumber, "bad block size");
+        m_lastBlockShort = blockSize != m_info.maxBlockSize;
+
+        std::vector<std::vector<int64_t>> planes(channels, std::vector<int64_t>(blockSize));
+        for (uint32_t ch = 0; ch < channels; ch++) {
+            uint32_t channelBits = bps;
+            if ((assignment == 8 && ch == 1) || (assignment == 9 && ch == 0) || (assignment == 10 && ch == 1)) {
+                channelBits++;   // Side channel
+            }
+            std::string error;
+            if (!DecodeSubframe(r, blockSize, channelBits, planes[ch].data(), error)) {
+                return FailFrame(expectedNumber, "channel " + std::to_string(ch) + ": " + error);
+            }
+        }
+        r.AlignToByte();
+        const size_t bodyBytes = r.BytePosition();
+        const uint16_t crc16 = static_cast<uint16_t>(r.Read(16));
+        if (!r.Ok()) return FailFrame(expectedNumber, "truncated");
+        if (crc16 != Crc16(data, bodyBytes)) return FailFrame(expectedNumber, "frame CRC mismatch");
+
+        // Undo the stereo decorrelation
+        for (uint32_t i = 0; i < blockSize && assignment >= 8; i++) {
+            int64_t& a = planes[0][i];
+            int64_t& b = planes[1][i];
+            if (assignment == 8) {
+                b = a - b;
+            } else if (assignment == 9) {
+                a = a + b;
+            } else {
+                const int64_t mid = (a * 2) | (b & 1);
+                const int64_t side = b;
+                a = (mid + side) >> 1;
+                b = (mid - side) >> 1;
+            }
+        }
+
+        const int64_t lowest = -(int64_t(1) << (bps - 1)), highest = (int64_t(1) << (bps - 1)) - 1;
+        for (uint32_t i = 0; i < blockSize; i++) {
+            for (uint32_t ch = 0; ch < channels; ch++) {
+                const int64_t value = planes[ch][i];
+                if (value < lowest || value > highest) return FailFrame(expectedNumber, "sample out of range");
+                m_samples.push_back(static_cast<int32_t>(value));
+            }
+        }
+        return bodyBytes + 2;
+    }
+
+    bool DecodeSubframe(BitReader& r, uint32_t blockSize, uint32_t bps, int64_t* out, std::string& error) {
+        if (r.Read(1) != 0) {
+            error = "subframe padding bit set";
+            return false;
+        }
+        const uint32_t type = r.Read(6);
+        uint32_t wasted = 0;
+        if (r.Read(1)) wasted = r.ReadUnary() + 1;
+        if (wasted >= bps) {
+            error = "all bits wasted";
+            return false;
+        }
+        bps -= wasted;
+
+        if (type == 0) {
+            const int64_t value = r.ReadSigned(bps);
+            for (uint32_t i = 0; i < blockSize; i++) out[i] = value;
+            m_constantSubframes++;
+        } else if (type == 1) {
+            for (uint32_t i = 0; i < blockSize; i++) out[i] = r.ReadSigned(bps);
+            m_verbatimSubframes++;
+        } else if (type >= 8 && type <= 12) {
+            const uint32_t order = type & 7;
+            if (order > blockSize) {
+                error = "predictor order past the block";
+                return false;
+            }
+            for (uint32_t i = 0; i < order; i++) out[i] = r.ReadSigned(bps);
+            if (!DecodeResidual(r, blockSize, order, out, error)) return false;
+            static const int64_t coefficients[5][4] = { {}, { 1 }, { 2, -1 }, { 3, -3, 1 }, { 4, -6, 4, -1 } };
+            for (uint32_t i = order; i < blockSize; i++) {
+                int64_t prediction = 0;
+                for (uint32_t j = 0; j < order; j++) prediction += coefficients[order][j] * out[i - 1 - j];
+                out[i] += prediction;
+            }
+            m_fixedSubframes++;
+        } else if (type >= 32) {
+            const uint32_t order = (type & 31) + 1;
+            if (order > blockSize) {
+                error = "predictor order past the block";
+                return false;
+            }
+            for (uint32_t i = 0; i < order; i++) out[i] = r.ReadSigned(bps);
+            const uint32_t precision = r.Read(4) + 1;
+            if (precision == 16) {
+                error = "invalid coefficient precision";
+                return false;
+            }
+            const int64_t shift = r.ReadSigned(5);
+            if (shift < 0) {
+                error = "negative LPC shift";
+                return false;
+            }
+            int64_t qlp[32];
+            for (uint32_t j = 0; j < order; j++) qlp[j] = r.ReadSigned(precision);
+            if (!DecodeResidual(r, blockSize, order, out, error)) return false;
+            for (uint32_t i = order; i < blockSize; i++) {
+                int64_t prediction = 0;
+                for (uint32_t j = 0; j < order; j++) prediction += qlp[j] * out[i - 1 - j];
+                out[i] += prediction >> shift;
+            }
+            m_lpcSubframes++;
+        } else {
+            error = "reserved subframe type " + std::to_string(type);
+            return false;
+        }
+
+        for (uint32_t i = 0; i < blockSize; i++) out[i] *= int64_t(1) << wasted;
+        if (!r.Ok()) {
+            error = "truncated";
+            return false;
+        }
+        return true;
+    }
+
+    // Stores the residual after the `order` warm-up samples; the caller adds
+    // the prediction
+    bool DecodeResidual(BitReader& r, uint32_t blockSize, uint32_t order, int64_t* out, std::string& error) {
+        const uint32_t method = r.Read(2);
+        if (method > 1) {
+            error = "reserved residual coding method";
+            return false;
+        }
+        const uint32_t parameterBits = method == 0 ? 4 : 5;
+        const uint32_t escape = (1u << parameterBits) - 1;
+        const uint32_t partitionOrder = r.Read(4);
+        const uint32_t partitions = 1u << partitionOrder;
+        if (blockSize % partitions != 0 || (blockSize >> partitionOrder) < order) {
+            error = "bad partition order";
+            return false;
+        }
+        uint32_t i = order;
+        for (uint32_t p = 0; p < partitions; p++) {
+            const uint32_t count = (blockSize >> partitionOrder) - (p == 0 ? order : 0);
+            const uint32_t parameter = r.Read(parameterBits);
+            if (parameter == escape) {
+                const uint32_t bits = r.Read(5);
+                for (uint32_t k = 0; k < count; k++) out[i++] = r.ReadSigned(bits);
+            } else {
+                for (uint32_t k = 0; k < count; k++) {
+                    const uint64_t folded = (static_cast<uint64_t>(r.ReadUnary()) << parameter) | r.Read(parameter);
+                    out[i++] = static_cast<int64_t>(folded >> 1) ^ -static_cast<int64_t>(folded & 1);
+                    if (!r.Ok()) break;
+                }
+            }
+            if (!r.Ok()) {
+                error = "truncated residual";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    StreamInfo m_info;
+    std::vector<int32_t> m_samples;
+    std::vector<uint32_t> m_frameBytes;
+    std::string m_error;
+    bool m_lastBlockShort = false;
+    uint32_t m_constantSubframes = 0;
+    uint32_t m_verbatimSubframes = 0;
+    uint32_t m_fixedSubframes = 0;
+    uint32_t m_lpcSubframes = 0;
+};
+
+} // namespace flactest
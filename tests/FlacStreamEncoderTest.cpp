@@ -0,0 +1,292 @@
+// FlacStreamEncoder round trips: every compression level, 1/2/6 channels,
+// 16- and 24-bit input, on tonal audio, silence and full-scale noise, and a
+// stream written in odd-sized pieces whose STREAMINFO is only patched at
+// Close(). Decoded samples must equal the input, and STREAMINFO's sample
+// count, frame sizes and MD5 must match it. Decoded with the in-tree
+// reference decoder (FlacReferenceDecoder.h), and also with `flac -t` and
+// `flac -d` when the flac tool is on the PATH.
+
+#include "FlacReferenceDecoder.h"
+#include "FlacStreamEncoder.h"
+#include "TestCheck.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+#ifdef _WIN32
+const char* kQuiet = " >NUL 2>&1";
+#else
+const char* kQuiet = " >/dev/null 2>&1";
+#endif
+
+bool g_haveFlacTool = false;
+
+struct Input {
+    const char* name;
+    uint32_t channels;
+    uint32_t bitsPerSample;
+    std::vector<int32_t> samples;   // Interleaved
+
+    size_t Frames() const { return samples.size() / channels; }
+};
+
+// A different tone per channel with a little noise, a loud transient and a
+// stretch of digital silence in the middle
+Input Tonal(uint32_t channels, uint32_t bitsPerSample, size_t frames) {
+    Input input = { "tonal", channels, bitsPerSample, std::vector<int32_t>(frames * channels) };
+    const double scale = std::ldexp(1.0, bitsPerSample - 1) - 1.0;
+    std::mt19937 rng(15 + channels + bitsPerSample);
+    std::normal_distribution<double> noise(0.0, 0.002);
+    for (size_t n = 0; n < frames; n++) {
+        for (uint32_t ch = 0; ch < channels; ch++) {
+            double value = 0.4 * std::sin(2.0 * 3.14159265358979 * (220.0 + 110.0 * ch) * n / 48000.0) + noise(rng);
+            if (n >= frames / 3 && n < frames / 3 + 64) value = (n % 2 ? 0.98 : -0.98);
+            if (n >= frames / 2 && n < frames / 2 + 5000) value = 0.0;
+            input.samples[n * channels + ch] = static_cast<int32_t>(std::lround(value * scale));
+        }
+    }
+    return input;
+}
+
+Input Silence(uint32_t channels, uint32_t bitsPerSample, size_t frames) {
+    return { "silence", channels, bitsPerSample, std::vector<int32_t>(frames * channels, 0) };
+}
+
+// Uniform over the whole range, with runs pinned to both extremes and, in
+// stereo, left and right at opposite extremes (the widest side channel)
+Input FullScaleNoise(uint32_t channels, uint32_t bitsPerSample, size_t frames) {
+    Input input = { "noise", channels, bitsPerSample, std::vector<int32_t>(frames * channels) };
+    const int32_t highest = (1 << (bitsPerSample - 1)) - 1;
+    const int32_t lowest = -highest - 1;
+    std::mt19937 rng(8 + channels + bitsPerSample);
+    std::uniform_int_distribution<int32_t> dist(lowest, highest);
+    for (size_t n = 0; n < frames; n++) {
+        for (uint32_t ch = 0; ch < channels; ch++) {
+            int32_t value = dist(rng);
+            if (n % 1000 < 20) value = (n + ch) % 2 ? highest : lowest;
+            input.samples[n * channels + ch] = value;
+        }
+    }
+    return input;
+}
+
+// Encode in `chunk`-frame writes; the bytes the stream holds once closed
+std::vector<uint8_t> Encode(const Input& input, uint32_t level, size_t chunk) {
+    std::stringstream out(std::ios::in | std::ios::out | std::ios::binary);
+    FlacStreamEncoder encoder;
+    if (!CHECK(encoder.Open(&out, 48000, input.channels, input.bitsPerSample, level))) return {};
+    for (size_t frame = 0; frame < input.Frames(); frame += chunk) {
+        const size_t frames = (std::min)(chunk, input.Frames() - frame);
+        CHECK(encoder.Write(input.samples.data() + frame * input.channels, frames));
+    }
+    CHECK(encoder.Close());
+    CHECK(encoder.GetSamplesWritten() == input.Frames());
+    const std::string bytes = out.str();
+    return std::vector<uint8_t>(bytes.begin(), bytes.end());
+}
+
+// The input as `flac -d --force-raw-format` writes it: little-endian samples
+// in the stream's whole-byte width
+std::vector<uint8_t> RawBytes(const Input& input) {
+    const uint32_t width = (input.bitsPerSample + 7) / 8;
+    std::vector<uint8_t> raw;
+    raw.reserve(input.samples.size() * width);
+    for (int32_t sample : input.samples) {
+        for (uint32_t b = 0; b < width; b++) raw.push_back(static_cast<uint8_t>(static_cast<uint32_t>(sample) >> (8 * b)));
+    }
+    return raw;
+}
+
+bool RunFlacTool(const std::vector<uint8_t>& stream, const Input& input) {
+    const std::filesystem::path dir = std::filesystem::temp_directory_path();
+    const std::string flacPath = (dir / "FlacStreamEncoderTest.flac").string();
+    const std::string rawPath = (dir / "FlacStreamEncoderTest.raw").string();
+    {
+        std::ofstream file(flacPath, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(stream.data()), static_cast<std::streamsize>(stream.size()));
+    }
+    const bool tested = std::system(("flac -t -s \"" + flacPath + "\"" + kQuiet).c_str()) == 0;
+    const bool decoded = std::system(("flac -d -s -f --force-raw-format --endian=little --sign=signed -o \"" +
+                                      rawPath + "\" \"" + flacPath + "\"" + kQuiet).c_str()) == 0;
+    std::ifstream file(rawPath, std::ios::binary);
+    const std::vector<uint8_t> raw((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
+    std::filesystem::remove(flacPath);
+    std::filesystem::remove(rawPath);
+    return tested && decoded && raw == RawBytes(input);
+}
+
+// Decode and compare against the input; the decoder for subframe statistics
+bool RoundTrip(const Input& input, uint32_t level, size_t chunk, flactest::Decoder& decoder) {
+    const std::vector<uint8_t> stream = Encode(input, level, chunk);
+    if (!decoder.Decode(stream)) {
+        fprintf(stderr, "  %s, level %u, %u ch, %u-bit: %s\n", input.name, level, input.channels,
+                input.bitsPerSample, decoder.Error().c_str());
+        return false;
+    }
+
+    const flactest::StreamInfo& info = decoder.Info();
+    uint8_t md5[16];
+    flactest::SampleMd5(input.samples.data(), input.samples.size(), input.bitsPerSample, md5);
+    const std::vector<uint32_t>& frameBytes = decoder.FrameBytes();
+    const bool ok = decoder.Samples() == input.samples && info.sampleRate == 48000 &&
+                    info.channels == input.channels && info.bitsPerSample == input.bitsPerSample &&
+                    info.totalSamples == input.Frames() && std::equal(md5, md5 + 16, info.md5) &&
+                    !frameBytes.empty() &&
+                    info.minFrameBytes == *std::min_element(frameBytes.begin(), frameBytes.end()) &&
+                    info.maxFrameBytes == *std::max_element(frameBytes.begin(), frameBytes.end());
+    if (!ok) {
+        fprintf(stderr, "  %s, level %u, %u ch, %u-bit: decoded %zu of %zu samples, %s, STREAMINFO %llu frames\n",
+                input.name, level, input.channels, input.bitsPerSample, decoder.Samples().size(),
+                input.samples.size(), decoder.Samples() == input.samples ? "identical" : "different",
+                static_cast<unsigned long long>(info.totalSamples));
+        return false;
+    }
+
+    if (g_haveFlacTool && !RunFlacTool(stream, input)) {
+        fprintf(stderr, "  %s, level %u, %u ch, %u-bit: flac -t/-d rejected the stream or decoded it differently\n",
+                input.name, level, input.channels, input.bitsPerSample);
+        return false;
+    }
+    return true;
+}
+
+void TestLevels() {
+    // Neither a multiple of 1152 nor of 4096: every stream ends on a short block
+    const size_t frames = 20000;
+    for (uint32_t bits : { 16u, 24u }) {
+        for (uint32_t channels : { 1u, 2u, 6u }) {
+            const Input inputs[] = { Tonal(channels, bits, frames), Silence(channels, bits, frames),
+                                     FullScaleNoise(channels, bits, frames) };
+            for (const Input& input : inputs) {
+                size_t previousBytes = 0;
+                for (uint32_t level = 0; level <= 8; level++) {
+                    flactest::Decoder decoder;
+                    CHECK(RoundTrip(input, level, 4800, decoder));
+                    const uint32_t subframes = decoder.ConstantSubframes() + decoder.VerbatimSubframes() +
+                                               decoder.FixedSubframes() + decoder.LpcSubframes();
+
+                    // Silence is CONSTANT throughout; LPC only from level 3
+                    const std::string name = input.name;
+                    if (name == "silence") {
+                        CHECK(decoder.ConstantSubframes() == subframes);
+                    }
+                    CHECK(level >= 3 || decoder.LpcSubframes() == 0);
+
+                    // Tonal audio compresses, and higher levels never do much worse
+                    if (name == "tonal") {
+                        const size_t bytes = [&] {
+                            size_t total = 0;
+                            for (uint32_t size : decoder.FrameBytes()) total += size;
+                            return total;
+                        }();
+                        CHECK(bytes < input.samples.size() * (bits / 8) * 3 / 4);
+                        if (level == 3) CHECK(decoder.LpcSubframes() > 0);
+                        if (level > 0 && !CHECK(bytes <= previousBytes + previousBytes / 50)) {
+                            fprintf(stderr, "  level %u: %zu bytes, level %u: %zu bytes\n", level - 1,
+                                    previousBytes, level, bytes);
+                        }
+                        previousBytes = bytes;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Written a few frames at a time, the stream is decodable before Close()
+// (totals and MD5 still zero, as for a live recording) and complete after it
+void TestStreaming() {
+    for (uint32_t level : { 0u, 5u, 8u }) {
+        const Input input = Tonal(2, 16, 30000);
+        std::stringstream out(std::ios::in | std::ios::out | std::ios::binary);
+        FlacStreamEncoder encoder;
+        CHECK(encoder.Open(&out, 48000, input.channels, input.bitsPerSample, level));
+        const size_t chunks[] = { 1, 7, 441, 480, 4097, 3 };
+        size_t frame = 0;
+        for (size_t i = 0; frame < input.Frames(); i++) {
+            const size_t frames = (std::min)(chunks[i % 6], input.Frames() - frame);
+            CHECK(encoder.Write(input.samples.data() + frame * input.channels, frames));
+            frame += frames;
+        }
+
+        // Mid-stream: whole blocks so far, STREAMINFO still the placeholder
+        const std::string partial = out.str();
+        flactest::Decoder decoder;
+        if (!CHECK(decoder.Decode(std::vector<uint8_t>(partial.begin(), partial.end())))) {
+            fprintf(stderr, "  level %u, before Close: %s\n", level, decoder.Error().c_str());
+        }
+        const size_t blockSize = decoder.Info().maxBlockSize;
+        const size_t decodedFrames = decoder.Samples().size() / input.channels;
+        const uint8_t zeros[16] = {};
+        CHECK(decoder.Info().totalSamples == 0 && std::equal(zeros, zeros + 16, decoder.Info().md5));
+        CHECK(decodedFrames == input.Frames() / blockSize * blockSize);
+        CHECK(std::equal(decoder.Samples().begin(), decoder.Samples().end(), input.samples.begin()));
+
+        // Close patches the totals and MD5 in place and leaves the frames be
+        CHECK(encoder.Close());
+        const std::string closed = out.str();
+        CHECK(closed.size() > partial.size() && closed.compare(42, partial.size() - 42, partial, 42) == 0);
+        CHECK(decoder.Decode(std::vector<uint8_t>(closed.begin(), closed.end())));
+        uint8_t md5[16];
+        flactest::SampleMd5(input.samples.data(), input.samples.size(), input.bitsPerSample, md5);
+        CHECK(decoder.Samples() == input.samples);
+        CHECK(decoder.Info().totalSamples == input.Frames() && std::equal(md5, md5 + 16, decoder.Info().md5));
+
+        // Chunking doesn't change the stream
+        const std::vector<uint8_t> whole = Encode(input, level, input.Frames());
+        CHECK(std::vector<uint8_t>(closed.begin(), closed.end()) == whole);
+    }
+}
+
+// MD5 against RFC 1321's test vectors, so a broken hash can't pass both sides
+void TestMd5() {
+    const char* messages[] = { "", "abc", "message digest",
+                               "12345678901234567890123456789012345678901234567890123456789012345678901234567890" };
+    const char* digests[] = { "d41d8cd98f00b204e9800998ecf8427e", "900150983cd24fb0d6963f7d28e17f72",
+                              "f96b697d7cb7938d525a2f31aaf161d0", "57edf4a22be3c955ac49da2e2107b67a" };
+    for (int i = 0; i < 4; i++) {
+        flactest::Md5 md5;
+        md5.Update(reinterpret_cast<const uint8_t*>(messages[i]), strlen(messages[i]));
+        uint8_t digest[16];
+        md5.Final(digest);
+        char hex[33];
+        for (int b = 0; b < 16; b++) snprintf(hex + 2 * b, 3, "%02x", digest[b]);
+        CHECK(strcmp(hex, digests[i]) == 0);
+    }
+}
+
+void TestRejected() {
+    std::stringstream out(std::ios::in | std::ios::out | std::ios::binary);
+    FlacStreamEncoder encoder;
+    CHECK(!encoder.Open(&out, 48000, 0, 16, 5));
+    CHECK(!encoder.Open(&out, 48000, 9, 16, 5));
+    CHECK(!encoder.Open(&out, 48000, 2, 32, 5));
+    CHECK(!encoder.Open(&out, 0, 2, 16, 5));
+    CHECK(!encoder.Open(nullptr, 48000, 2, 16, 5));
+    CHECK(!encoder.Write(nullptr, 0) && !encoder.Close());
+}
+
+} // namespace
+
+int main() {
+    g_haveFlacTool = std::system((std::string("flac --version") + kQuiet).c_str()) == 0;
+    printf("%s\n", g_haveFlacTool ? "decoding with the reference decoder and flac"
+                                  : "flac not found, decoding with the reference decoder only");
+    TestMd5();
+    TestRejected();
+    TestLevels();
+    TestStreaming();
+    return test::TestResult();
+}
@@ -0,0 +1,109 @@
+// GainKernel: every SIMD level this CPU runs must match the scalar reference
+// bit for bit, across lengths that exercise the vector tails, saturating
+// int16 gains and ramps over every channel layout.
+
+#include "GainKernel.h"
+#include "TestCheck.h"
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+const size_t kLengths[] = { 0, 1, 3, 7, 8, 9, 15, 16, 17, 31, 33, 63, 64, 65, 960, 4801 };
+const float kGains[] = { 0.0f, 0.001f, 0.5f, 0.7071f, 1.0f, 1.3f, 4.0f, 100.0f, -1.0f };
+const unsigned kChannels[] = { 1, 2, 3, 4, 6, 8 };
+
+std::vector<float> RandomFloats(std::mt19937& rng, size_t count) {
+    std::uniform_real_distribution<float> dist(-1.5f, 1.5f);
+    std::vector<float> samples(count);
+    for (float& s : samples) s = dist(rng);
+    return samples;
+}
+
+// Full range, with the extremes and round-half cases mixed in
+std::vector<int16_t> RandomInt16(std::mt19937& rng, size_t count) {
+    std::uniform_int_distribution<int> dist(-32768, 32767);
+    const int16_t edges[] = { -32768, 32767, 0, 1, -1, 3, -3 };
+    std::vector<int16_t> samples(count);
+    for (size_t i = 0; i < count; i++) samples[i] = i % 5 == 0 ? edges[(i / 5) % 7] : (int16_t)dist(rng);
+    return samples;
+}
+
+template <typename T>
+bool SameBits(const std::vector<T>& a, const std::vector<T>& b) {
+    return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+}
+
+void TestLevel(const GainKernels& scalar, const GainKernels& simd) {
+    std::mt19937 rng(1234);
+    for (size_t length : kLengths) {
+        for (float gain : kGains) {
+            const std::vector<float> floats = RandomFloats(rng, length);
+            std::vector<float> expected = floats, actual = floats;
+            scalar.applyFloat(expected.data(), length, gain);
+            simd.applyFloat(actual.data(), length, gain);
+            CHECK(SameBits(expected, actual));
+
+            const std::vector<int16_t> ints = RandomInt16(rng, length);
+            std::vector<int16_t> expected16 = ints, actual16 = ints;
+            scalar.applyInt16(expected16.data(), length, gain);
+            simd.applyInt16(actual16.data(), length, gain);
+            CHECK(SameBits(expected16, actual16));
+        }
+
+        for (unsigned channels : kChannels) {
+            const float ramps[][2] = { { 0.0f, 1.0f }, { 1.0f, 0.25f }, { 0.5f, 3.0f }, { 1.0f, 1.0f } };
+            for (const auto& ramp : ramps) {
+                const std::vector<float> floats = RandomFloats(rng, length * channels);
+                std::vector<float> expected = floats, actual = floats;
+                scalar.rampFloat(expected.data(), length, channels, ramp[0], ramp[1]);
+                simd.rampFloat(actual.data(), length, channels, ramp[0], ramp[1]);
+                CHECK(SameBits(expected, actual));
+
+                const std::vector<int16_t> ints = RandomInt16(rng, length * channels);
+                std::vector<int16_t> expected16 = ints, actual16 = ints;
+                scalar.rampInt16(expected16.data(), length, channels, ramp[0], ramp[1]);
+                simd.rampInt16(actual16.data(), length, channels, ramp[0], ramp[1]);
+                CHECK(SameBits(expected16, actual16));
+            }
+        }
+    }
+}
+
+// The reference itself: rounding and saturation
+void TestReference() {
+    const GainKernels scalar = GetGainKernels(SimdLevel::Scalar);
+    std::vector<int16_t> samples = { 32767, -32768, 1, -1, 3, 5, 1000 };
+    scalar.applyInt16(samples.data(), samples.size(), 0.5f);
+    const std::vector<int16_t> halved = { 16384, -16384, 0, 0, 2, 2, 500 };   // Half to even
+    CHECK(samples == halved);
+
+    samples = { 20000, -20000, 100 };
+    scalar.applyInt16(samples.data(), samples.size(), 2.0f);
+    const std::vector<int16_t> saturated = { 32767, -32768, 200 };
+    CHECK(samples == saturated);
+
+    // Ramp: one gain per frame, reaching `to` only at the next buffer
+    std::vector<float> frames(8, 1.0f);
+    scalar.rampFloat(frames.data(), 4, 2, 0.0f, 1.0f);
+    const std::vector<float> ramped = { 0.0f, 0.0f, 0.25f, 0.25f, 0.5f, 0.5f, 0.75f, 0.75f };
+    CHECK(frames == ramped);
+}
+
+} // namespace
+
+int main() {
+    TestReference();
+
+    const GainKernels scalar = GetGainKernels(SimdLevel::Scalar);
+    const SimdLevel best = DetectSimdLevel();
+    for (SimdLevel level : { SimdLevel::SSE2, SimdLevel::AVX2 }) {
+        if (level > best) break;
+        const GainKernels simd = GetGainKernels(level);
+        if (simd.level != level) continue;   // Not compiled in on this target
+        printf("%s\n", SimdLevelName(level));
+        TestLevel(scalar, simd);
+    }
+    return test::TestResult();
+}
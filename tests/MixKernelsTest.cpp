@@ -0,0 +1,122 @@
+// MixKernels: every SIMD level this CPU runs must mix bit-identically to the
+// scalar reference, for 1 to 16 sources over lengths that leave vector tails,
+// with sums far past full scale saturating to exactly +-1.0 (and on to
+// int16 full scale through the mixer's output conversion).
+
+#include "MixKernels.h"
+#include "SampleFormat.h"
+#include "TestCheck.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace {
+
+const size_t kLengths[] = { 0, 1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 63, 64, 65, 960, 4095, 4801 };
+const size_t kSourceCounts[] = { 1, 2, 3, 5, 8, 16 };
+
+// Mostly in range, with full scale, just past it and far past it mixed in
+std::vector<float> RandomSource(std::mt19937& rng, size_t count) {
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    const float edges[] = { 1.0f, -1.0f, 1.0000001f, -1.0000001f, 0.0f, -0.0f, 8.0f, -8.0f, 0.99999994f };
+    std::vector<float> samples(count);
+    for (size_t i = 0; i < count; i++) samples[i] = i % 7 == 3 ? edges[(i / 7) % 9] : dist(rng);
+    return samples;
+}
+
+// AudioMixer::MixSamples' kernel sequence: load, add the rest, saturate
+std::vector<float> Mix(const MixKernels& kernels, const std::vector<std::vector<float>>& sources, size_t count) {
+    std::vector<float> acc(count + 1, 42.0f);   // The extra slot must stay untouched
+    kernels.loadFloat(acc.data(), sources[0].data(), count);
+    for (size_t s = 1; s < sources.size(); s++) kernels.addFloat(acc.data(), sources[s].data(), count);
+    kernels.storeFloat(acc.data(), acc.data(), count);
+    return acc;
+}
+
+bool SameBits(const std::vector<float>& a, const std::vector<float>& b) {
+    return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0);
+}
+
+void TestLevel(const MixKernels& scalar, const MixKernels& simd) {
+    std::mt19937 rng(606);
+    int mismatches = 0;
+    for (size_t length : kLengths) {
+        for (size_t sourceCount : kSourceCounts) {
+            std::vector<std::vector<float>> sources;
+            for (size_t s = 0; s < sourceCount; s++) sources.push_back(RandomSource(rng, length));
+            const std::vector<float> expected = Mix(scalar, sources, length);
+            const std::vector<float> actual = Mix(simd, sources, length);
+            if (!SameBits(expected, actual) && mismatches++ < 5) {
+                fprintf(stderr, "  %zu samples, %zu sources: differs from scalar\n", length, sourceCount);
+            }
+
+            // Separate output buffer, as for float32 output
+            std::vector<float> acc = expected;
+            std::vector<float> out(length + 1, -42.0f), outScalar(length + 1, -42.0f);
+            simd.storeFloat(out.data(), acc.data(), length);
+            scalar.storeFloat(outScalar.data(), acc.data(), length);
+            if (!SameBits(out, outScalar) && mismatches++ < 5) {
+                fprintf(stderr, "  %zu samples: store into another buffer differs\n", length);
+            }
+        }
+    }
+    CHECK(mismatches == 0);
+
+    // Non-finite sums: NaN passes through unchanged, infinities saturate
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    const float inf = std::numeric_limits<float>::infinity();
+    std::vector<float> odd(37);
+    for (size_t i = 0; i < odd.size(); i++) odd[i] = i % 3 == 0 ? nan : (i % 3 == 1 ? inf : -inf);
+    std::vector<float> a(odd.size()), b(odd.size());
+    scalar.storeFloat(a.data(), odd.data(), odd.size());
+    simd.storeFloat(b.data(), odd.data(), odd.size());
+    CHECK(SameBits(a, b));
+    CHECK(std::isnan(a[0]) && a[1] == 1.0f && a[2] == -1.0f);
+}
+
+// The reference: exact sums, saturation at +-1.0 whatever the headroom used
+void TestSaturation(const MixKernels& kernels) {
+    for (size_t length : { (size_t)5, (size_t)64, (size_t)4801 }) {
+        std::vector<std::vector<float>> loud(16, std::vector<float>(length));
+        for (size_t s = 0; s < loud.size(); s++) {
+            for (size_t i = 0; i < length; i++) loud[s][i] = i % 2 == 0 ? 1.0f : -1.0f;
+        }
+        const std::vector<float> mixed = Mix(kernels, loud, length);
+        bool saturated = mixed[length] == 42.0f;
+        for (size_t i = 0; i < length; i++) saturated = saturated && mixed[i] == (i % 2 == 0 ? 1.0f : -1.0f);
+        CHECK(saturated);
+
+        // Through the int16 output conversion: full scale, never wrapped
+        std::vector<int16_t> pcm(length);
+        ConvertFromFloat(mixed.data(), length, SampleType::Int16, pcm.data());
+        bool fullScale = true;
+        for (size_t i = 0; i < length; i++) fullScale = fullScale && (i % 2 == 0 ? pcm[i] == 32767 : pcm[i] <= -32767);
+        CHECK(fullScale);
+    }
+
+    // In range: the plain sum, no clamping
+    std::vector<std::vector<float>> quiet = { { 0.25f, -0.5f, 0.125f }, { 0.5f, -0.25f, 0.875f } };
+    const std::vector<float> mixed = Mix(kernels, quiet, 3);
+    CHECK(mixed[0] == 0.75f && mixed[1] == -0.75f && mixed[2] == 1.0f);
+}
+
+} // namespace
+
+int main() {
+    const MixKernels scalar = GetMixKernels(SimdLevel::Scalar);
+    TestSaturation(scalar);
+
+    const SimdLevel best = DetectSimdLevel();
+    for (SimdLevel level : { SimdLevel::SSE2, SimdLevel::AVX2 }) {
+        if (level > best) break;
+        const MixKernels simd = GetMixKernels(level);
+        if (simd.level != level) continue;   // Not compiled in on this target
+        printf("%s\n", SimdLevelName(level));
+        TestLevel(scalar, simd);
+        TestSaturation(simd);
+    }
+    return test::TestResult();
+}
@@ -0,0 +1,193 @@
+// PeakLimiter on synthetic overs: the output never exceeds the ceiling, the
+// envelope (not the final clamp) does the limiting, audio under the ceiling
+// passes through untouched, and the gain recovers afterwards.
+
+#include "AudioMixer.h"
+#include "PeakLimiter.h"
+#include "TestCheck.h"
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+
+const uint32_t kRate = 48000;
+const double kPi = 3.14159265358979323846;
+
+// Interleaved test signal: channel 0 carries `shape`, channel c is it at
+// (1 - 0.25 c), so every frame's loudest sample is on channel 0
+typedef float (*Shape)(size_t n, std::mt19937& random);
+
+float Spikes(size_t n, std::mt19937&) { return n % 997 == 500 ? (n % 2 ? 8.0f : -8.0f) : 0.1f; }
+float Bursts(size_t n, std::mt19937&) { return (n / 240) % 10 == 3 ? 2.5f : 0.3f; }
+float LoudSine(size_t n, std::mt19937&) { return 4.0f * (float)std::sin(2.0 * kPi * 440.0 * n / kRate); }
+float Noise(size_t, std::mt19937& random) {
+    return std::uniform_real_distribution<float>(-3.0f, 3.0f)(random);
+}
+float Steps(size_t n, std::mt19937&) {
+    // Levels jump up and down every 3 ms, from under the ceiling to +18 dB
+    static const float levels[] = { 0.2f, 1.5f, 0.5f, 8.0f, 0.9f, 0.95f, 3.0f, -1.2f };
+    return levels[(n / 144) % 8];
+}
+
+std::vector<float> Signal(Shape shape, size_t frames, uint32_t channels) {
+    std::mt19937 random(7);
+    std::vector<float> samples(frames * channels);
+    for (size_t n = 0; n < frames; n++) {
+        const float value = shape(n, random);
+        for (uint32_t ch = 0; ch < channels; ch++) samples[n * channels + ch] = value * (1.0f - 0.25f * ch);
+    }
+    return samples;
+}
+
+// Run `input` through a limiter in blocks of varying size
+std::vector<float> Limit(PeakLimiter& limiter, const std::vector<float>& input, uint32_t channels) {
+    std::vector<float> output = input;
+    const size_t frames = input.size() / channels;
+    size_t offset = 0;
+    for (size_t block = 1; offset < frames; block = block * 7 % 2053 + 1) {
+        const size_t count = (std::min)(block, frames - offset);
+        limiter.Process(output.data() + offset * channels, count);
+        offset += count;
+    }
+    return output;
+}
+
+void TestOvers() {
+    const Shape shapes[] = { Spikes, Bursts, LoudSine, Noise, Steps };
+    const char* names[] = { "spikes", "bursts", "sine", "noise", "steps" };
+    const float ceilings[] = { 0.0f, -1.0f, -6.0f };
+    const float attacks[] = { 0.0f, 1.0f, 5.0f, 50.0f };
+    const size_t frames = kRate * 2;
+
+    for (uint32_t channels = 1; channels <= 3; channels++) {
+        for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+            const std::vector<float> input = Signal(shapes[s], frames, channels);
+            for (float ceilingDb : ceilings) {
+                for (float attackMs : attacks) {
+                    LimiterSettings settings;
+                    settings.ceilingDb = ceilingDb;
+                    settings.attackMs = attackMs;
+                    settings.releaseMs = 50.0f;
+                    PeakLimiter limiter;
+                    CHECK(limiter.Initialize(settings, kRate, channels));
+                    const std::vector<float> output = Limit(limiter, input, channels);
+                    const float ceiling = limiter.GetCeiling();
+                    const size_t latency = limiter.GetLatencyFrames();
+
+                    float peak = 0.0f;
+                    double worstRatio = 0.0;
+                    for (size_t n = latency; n < frames; n++) {
+                        const float* in = &input[(n - latency) * channels];
+                        const float* out = &output[n * channels];
+                        for (uint32_t ch = 0; ch < channels; ch++) peak = (std::max)(peak, std::fabs(out[ch]));
+                        // One shared gain: had the clamp cut the loudest channel,
+                        // the quieter ones would keep a higher gain than it
+                        if (in[0] == 0.0f) continue;
+                        const double gain = (double)out[0] / in[0];
+                        for (uint32_t ch = 1; ch < channels; ch++) {
+                            if (in[ch] == 0.0f) continue;
+                            worstRatio = (std::max)(worstRatio, std::fabs((double)out[ch] / in[ch] - gain) / gain);
+                        }
+                    }
+                    if (!CHECK(peak <= ceiling && worstRatio < 1e-5)) {
+                        fprintf(stderr, "  %s, %u ch, %.0f dB, %.0f ms: peak %.6f (ceiling %.6f), gain mismatch %.2e\n",
+                                names[s], channels, ceilingDb, attackMs, peak, ceiling, worstRatio);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Under the ceiling the limiter is a pure delay; after an over the gain
+// comes back within a few release times
+void TestTransparency() {
+    for (uint32_t channels = 1; channels <= 2; channels++) {
+        LimiterSettings settings;
+        PeakLimiter limiter;
+        CHECK(limiter.Initialize(settings, kRate, channels));
+        const size_t latency = limiter.GetLatencyFrames();
+        CHECK(latency == kRate * 5 / 1000 - 1);
+
+        const size_t frames = kRate;
+        std::vector<float> input(frames * channels);
+        for (size_t n = 0; n < frames; n++) {
+            for (uint32_t ch = 0; ch < channels; ch++) {
+                input[n * channels + ch] = 0.85f * (float)std::sin(2.0 * kPi * (300.0 + 200.0 * ch) * n / kRate);
+            }
+        }
+        const std::vector<float> output = Limit(limiter, input, channels);
+        bool delayed = true;
+        for (size_t i = 0; i < latency * channels; i++) delayed = delayed && output[i] == 0.0f;
+        for (size_t i = latency * channels; i < output.size(); i++) {
+            delayed = delayed && output[i] == input[i - latency * channels];
+        }
+        CHECK(delayed);
+
+        // One over, then quiet audio: back to within 1% after 5 release times
+        std::vector<float> recovery(frames * channels, 0.5f);
+        recovery[1000 * channels] = 10.0f;
+        limiter.Process(recovery.data(), frames);
+        const size_t settled = 1000 + latency + (size_t)(5 * settings.releaseMs * kRate / 1000.0f);
+        CHECK(recovery[(1000 + latency) * channels] <= limiter.GetCeiling());
+        CHECK(recovery[settled * channels] > 0.495f && recovery[settled * channels] <= 0.5f);
+    }
+
+    // Disabled: no delay, no change, even over the ceiling
+    LimiterSettings off;
+    off.enabled = false;
+    PeakLimiter limiter;
+    CHECK(limiter.Initialize(off, kRate, 1) && !limiter.IsEnabled() && limiter.GetLatencyFrames() == 0);
+    float sample = 3.0f;
+    limiter.Process(&sample, 1);
+    CHECK(sample == 3.0f);
+}
+
+// Two full-scale sources summed in the mixer stay under -1 dBFS in 16-bit output
+void TestMixerSum() {
+    WAVEFORMATEX format = {};
+    format.wFormatTag = WAVE_FORMAT_PCM;
+    format.nChannels = 2;
+    format.nSamplesPerSec = kRate;
+    format.wBitsPerSample = 16;
+    format.nBlockAlign = 4;
+    format.nAvgBytesPerSec = kRate * 4;
+    AudioMixer mixer;
+    CHECK(mixer.Initialize(&format));
+    mixer.SetDriftCompensation(false);
+
+    std::vector<int16_t> packet(kRate / 100 * 2);
+    int peak = 0;
+    std::vector<BYTE> mixed;
+    for (size_t p = 0; p < 200; p++) {
+        for (DWORD source = 1; source <= 2; source++) {
+            for (size_t n = 0; n < packet.size() / 2; n++) {
+                const double t = (double)(p * packet.size() / 2 + n) / kRate;
+                const int16_t value = (int16_t)(32767.0 * std::sin(2.0 * kPi * (source == 1 ? 200.0 : 330.0) * t));
+                packet[2 * n] = packet[2 * n + 1] = value;
+            }
+            mixer.AddAudioData(source, reinterpret_cast<const BYTE*>(packet.data()),
+                               (UINT32)(packet.size() * sizeof(int16_t)), &format);
+        }
+        if (mixer.GetMixedAudio(mixed)) {
+            const int16_t* samples = reinterpret_cast<const int16_t*>(mixed.data());
+            for (size_t i = 0; i < mixed.size() / 2; i++) peak = (std::max)(peak, std::abs((int)samples[i]));
+        }
+    }
+    // Float to int16 scales by 32768
+    const int ceiling = (int)std::lround(std::pow(10.0, -1.0 / 20.0) * 32768.0);
+    if (!CHECK(peak <= ceiling && peak > ceiling * 9 / 10)) {
+        fprintf(stderr, "  mixer: peak %d, ceiling %d\n", peak, ceiling);
+    }
+}
+
+} // namespace
+
+int main() {
+    TestOvers();
+    TestTransparency();
+    TestMixerSum();
+    return test::TestResult();
+}
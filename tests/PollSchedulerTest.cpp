@@ -0,0 +1,232 @@
+// PollScheduler on a virtual clock, driven the way MonitorThread drives it:
+// Plan() after each cycle, then ShouldWake() / GetSleepMs() until the wait
+// ends, with wakes raised at scripted times. Hours of polling run in
+// microseconds, so cadence per mode, burst limits, request latency, session
+// change debouncing and wakeups per hour are all exact. WakeSignal is
+// checked with real threads.
+
+#include "PollScheduler.h"
+#include "TestCheck.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Mode = PollScheduler::Mode;
+
+// Wakes raised at given times, in time order
+struct Raise {
+    uint64_t atMs;
+    uint32_t wakes;
+};
+
+class VirtualLoop {
+public:
+    explicit VirtualLoop(const PollScheduler::Settings& settings = PollScheduler::Settings())
+        : scheduler(settings) {}
+
+    PollScheduler scheduler;
+    uint64_t now = 0;
+    std::vector<Raise> raises;
+    size_t nextRaise = 0;
+
+    // One MonitorThread iteration after a cycle that saw `activity`: returns
+    // how long the wait lasted and what ended it
+    uint64_t Wait(const PollScheduler::Activity& activity, uint32_t* ended = nullptr) {
+        scheduler.Plan(activity, now);
+        const uint64_t start = now;
+        uint32_t pending = 0;
+        while (!scheduler.ShouldWake(pending, now)) {
+            // WakeSignal::Wait: the sleep, cut short by the next raise
+            const uint64_t until = now + scheduler.GetSleepMs(pending, now);
+            if (nextRaise < raises.size() && raises[nextRaise].atMs <= until) {
+                now = (std::max)(now, raises[nextRaise].atMs);
+                pending |= raises[nextRaise++].wakes;
+            } else {
+                now = until;
+            }
+        }
+        if (ended) *ended = pending;
+        return now - start;
+    }
+
+    // Cycles with the same activity until `endMs`
+    void RunUntil(uint64_t endMs, const PollScheduler::Activity& activity) {
+        while (now < endMs) Wait(activity);
+    }
+};
+
+PollScheduler::Activity Targets(size_t targets, size_t recording = 0, bool rampingUp = false) {
+    PollScheduler::Activity activity;
+    activity.targets = targets;
+    activity.recording = recording;
+    activity.rampingUp = rampingUp;
+    return activity;
+}
+
+const uint64_t kHourMs = 3600000;
+
+// An hour in each steady state: one wakeup per interval, all timeouts
+void TestCadence() {
+    struct Case {
+        PollScheduler::Activity activity;
+        Mode mode;
+        double perHour;
+    };
+    const Case cases[] = {
+        { Targets(0), Mode::Idle, 360.0 },
+        { Targets(2), Mode::Watching, 1800.0 },
+        { Targets(2, 1), Mode::Recording, 1800.0 },
+    };
+    for (const Case& c : cases) {
+        VirtualLoop loop;
+        loop.RunUntil(kHourMs, c.activity);
+        const PollScheduler::Stats& stats = loop.scheduler.GetStats();
+        const double perHour = loop.scheduler.GetWakeupsPerHour(loop.now);
+        if (!CHECK(loop.scheduler.GetMode() == c.mode && perHour == c.perHour && stats.timeouts == stats.wakeups &&
+                   stats.modeWakeups[static_cast<int>(c.mode)] == stats.wakeups)) {
+            fprintf(stderr, "  %ls: %.1f wakeups/h, expected %.1f\n", PollScheduler::ModeName(c.mode), perHour,
+                    c.perHour);
+        }
+    }
+
+    // Nothing planned yet: no rate
+    PollScheduler fresh;
+    CHECK(fresh.GetWakeupsPerHour(1000) == 0.0);
+}
+
+// Ramping up polls every burstMs, at most maxBurstCycles in a row; the
+// limit resets once the target stops ramping. A burst outranks recording.
+void TestBurst() {
+    VirtualLoop loop;
+    const PollScheduler::Settings& settings = loop.scheduler.GetSettings();
+    for (int i = 0; i < settings.maxBurstCycles; i++) {
+        CHECK(loop.Wait(Targets(1, 0, true)) == settings.burstMs);
+        CHECK(loop.scheduler.GetMode() == Mode::Burst);
+    }
+    // Sound that never becomes a call: back to the normal cadence
+    CHECK(loop.Wait(Targets(1, 0, true)) == settings.pollMs && loop.scheduler.GetMode() == Mode::Watching);
+    CHECK(loop.Wait(Targets(1, 0, true)) == settings.pollMs);
+
+    CHECK(loop.Wait(Targets(1)) == settings.pollMs);
+    CHECK(loop.Wait(Targets(2, 1, true)) == settings.burstMs && loop.scheduler.GetMode() == Mode::Burst);
+    CHECK(loop.Wait(Targets(2, 1)) == settings.pollMs && loop.scheduler.GetMode() == Mode::Recording);
+}
+
+// From sound starting mid-idle to a Start decision: the session change
+// ends the idle wait, then startThreshold burst cycles
+void TestStartLatency() {
+    const int startThreshold = 3;
+    VirtualLoop loop;
+    const PollScheduler::Settings& settings = loop.scheduler.GetSettings();
+    loop.RunUntil(60000, Targets(1));
+    const uint64_t soundAt = loop.now + 1234;
+    loop.raises.push_back({ soundAt, PollScheduler::kSessionChange });
+
+    // The detector counts a cycle for each poll that hears the sound, and
+    // starts on the startThreshold-th
+    int counter = 0;
+    for (;;) {
+        const bool heard = loop.now >= soundAt;
+        if (heard && ++counter == startThreshold) break;
+        loop.Wait(Targets(1, 0, heard));
+    }
+    const uint64_t latency = loop.now - soundAt;
+    if (!CHECK(latency <= (uint64_t)(startThreshold - 1) * settings.burstMs + settings.minGapMs)) {
+        fprintf(stderr, "  start latency %llu ms\n", (unsigned long long)latency);
+    }
+    CHECK(loop.scheduler.GetStats().sessionWakes == 1);
+}
+
+// A request ends any wait at once; a session change only after minGapMs,
+// and a storm of them costs one wakeup per gap at most
+void TestWakes() {
+    VirtualLoop loop;
+    const PollScheduler::Settings& settings = loop.scheduler.GetSettings();
+    uint32_t ended = 0;
+
+    loop.raises.push_back({ 3000, PollScheduler::kRequest });
+    CHECK(loop.Wait(Targets(0), &ended) == 3000 && (ended & PollScheduler::kRequest));
+    CHECK(loop.scheduler.GetStats().requestWakes == 1);
+
+    // Raised 100 ms into the wait: held until the gap has passed
+    loop.raises.push_back({ loop.now + 100, PollScheduler::kSessionChange });
+    CHECK(loop.Wait(Targets(1), &ended) == settings.minGapMs && ended == PollScheduler::kSessionChange);
+
+    // Raised after the gap: at once
+    loop.raises.push_back({ loop.now + 1500, PollScheduler::kSessionChange });
+    CHECK(loop.Wait(Targets(1)) == 1500);
+
+    // A request during the gap isn't held back by it
+    loop.raises.push_back({ loop.now + 50, PollScheduler::kSessionChange });
+    loop.raises.push_back({ loop.now + 60, PollScheduler::kRequest });
+    CHECK(loop.Wait(Targets(1), &ended) == 60 && (ended & PollScheduler::kRequest));
+
+    // An event every 10 ms for ten seconds
+    const uint64_t stormStart = loop.now;
+    for (uint64_t t = 10; t <= 10000; t += 10) loop.raises.push_back({ stormStart + t, PollScheduler::kSessionChange });
+    const uint64_t before = loop.scheduler.GetStats().wakeups;
+    loop.RunUntil(stormStart + 10000, Targets(1));
+    const uint64_t wakeups = loop.scheduler.GetStats().wakeups - before;
+    if (!CHECK(wakeups <= 10000 / settings.minGapMs + 1)) {
+        fprintf(stderr, "  storm: %llu wakeups in 10 s\n", (unsigned long long)wakeups);
+    }
+}
+
+// Settings that make no sense are brought in line: a burst never polls
+// slower than pollMs, idle never faster
+void TestSettings() {
+    PollScheduler::Settings settings;
+    settings.pollMs = 1500;
+    settings.burstMs = 4000;
+    settings.idleMs = 200;
+    settings.maxBurstCycles = 2;
+    VirtualLoop loop(settings);
+    CHECK(loop.Wait(Targets(1, 0, true)) == 1500);
+    CHECK(loop.Wait(Targets(0)) == 1500 && loop.scheduler.GetMode() == Mode::Idle);
+    CHECK(loop.scheduler.GetDeadline() == loop.now);
+
+    // Changed between cycles: the next wait uses the new ones
+    settings.idleMs = 30000;
+    loop.scheduler.SetSettings(settings);
+    CHECK(loop.Wait(Targets(0)) == 30000);
+    CHECK(PollScheduler::ModeName(Mode::Recording) == std::wstring(L"recording"));
+}
+
+void TestWakeSignal() {
+    WakeSignal signal;
+    CHECK(signal.Wait(std::chrono::milliseconds(1)) == 0);
+
+    // Raised before the wait: returned at once, then cleared
+    signal.Raise(PollScheduler::kSessionChange);
+    signal.Raise(PollScheduler::kRequest);
+    CHECK(signal.Wait(std::chrono::milliseconds(10000)) == (PollScheduler::kSessionChange | PollScheduler::kRequest));
+    CHECK(signal.Wait(std::chrono::milliseconds(0)) == 0);
+
+    // From another thread, well before the timeout
+    const auto begin = std::chrono::steady_clock::now();
+    std::thread raiser([&signal] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        signal.Raise(PollScheduler::kRequest);
+    });
+    const uint32_t wakes = signal.Wait(std::chrono::milliseconds(10000));
+    raiser.join();
+    CHECK(wakes == PollScheduler::kRequest);
+    CHECK(std::chrono::steady_clock::now() - begin < std::chrono::seconds(5));
+}
+
+} // namespace
+
+int main() {
+    TestCadence();
+    TestBurst();
+    TestStartLatency();
+    TestWakes();
+    TestSettings();
+    TestWakeSignal();
+    return test::TestResult();
+}
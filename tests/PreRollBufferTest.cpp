@@ -0,0 +1,164 @@
+// PreRollBuffer: oldest-first eviction within the byte budget, packets that
+// wrap around the end of the storage, packets larger than the whole buffer,
+// and a long random run checked against a plain model.
+
+#include "PreRollBuffer.h"
+#include "TestCheck.h"
+#include <cstdio>
+#include <deque>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct Seen {
+    std::vector<uint8_t> bytes;
+    uint64_t timestamp;
+    bool discontinuity;
+};
+
+// Packet `id` of `size` bytes, each byte derived from both
+std::vector<uint8_t> Bytes(uint32_t id, size_t size) {
+    std::vector<uint8_t> bytes(size);
+    for (size_t i = 0; i < size; i++) bytes[i] = (uint8_t)(id * 31 + i);
+    return bytes;
+}
+
+void Push(PreRollBuffer& buffer, uint32_t id, size_t size, bool discontinuity = false) {
+    const std::vector<uint8_t> bytes = Bytes(id, size);
+    buffer.Push(bytes.data(), bytes.size(), 1000 + id, discontinuity);
+}
+
+std::vector<Seen> Contents(PreRollBuffer& buffer) {
+    std::vector<Seen> seen;
+    buffer.ForEach([&seen](const uint8_t* data, size_t size, uint64_t timestamp, bool discontinuity) {
+        seen.push_back({ std::vector<uint8_t>(data, data + size), timestamp, discontinuity });
+    });
+    return seen;
+}
+
+// The buffer holds exactly packets `ids` (sizes `sizes`), oldest first
+bool Holds(PreRollBuffer& buffer, const std::vector<uint32_t>& ids, const std::vector<size_t>& sizes) {
+    const std::vector<Seen> seen = Contents(buffer);
+    if (seen.size() != ids.size() || buffer.PacketCount() != ids.size()) return false;
+    size_t total = 0;
+    for (size_t i = 0; i < ids.size(); i++) {
+        if (seen[i].bytes != Bytes(ids[i], sizes[i]) || seen[i].timestamp != 1000 + ids[i]) return false;
+        total += sizes[i];
+    }
+    return buffer.BufferedBytes() == total;
+}
+
+void TestEviction() {
+    PreRollBuffer buffer(100);
+    CHECK(buffer.Capacity() == 100 && buffer.Empty());
+    Push(buffer, 1, 30);
+    Push(buffer, 2, 30);
+    Push(buffer, 3, 30, true);
+    CHECK(Holds(buffer, { 1, 2, 3 }, { 30, 30, 30 }) && buffer.DroppedBytes() == 0);
+    CHECK(Contents(buffer)[2].discontinuity && !Contents(buffer)[0].discontinuity);
+
+    // 10 free: the oldest goes, whole
+    Push(buffer, 4, 20);
+    CHECK(Holds(buffer, { 2, 3, 4 }, { 30, 30, 20 }) && buffer.DroppedBytes() == 30);
+
+    // Needs two evictions
+    Push(buffer, 5, 65);
+    CHECK(Holds(buffer, { 4, 5 }, { 20, 65 }) && buffer.DroppedBytes() == 90);
+
+    // Exactly the capacity: everything else goes
+    Push(buffer, 6, 100);
+    CHECK(Holds(buffer, { 6 }, { 100 }) && buffer.DroppedBytes() == 175);
+
+    // Empty packets are ignored
+    buffer.Push(nullptr, 10, 0, false);
+    const uint8_t byte = 0;
+    buffer.Push(&byte, 0, 0, false);
+    CHECK(Holds(buffer, { 6 }, { 100 }) && buffer.DroppedBytes() == 175);
+}
+
+// Packets split across the end of the storage come out whole, every time
+void TestWrapAround() {
+    PreRollBuffer buffer(100);
+    Push(buffer, 1, 70);
+    Push(buffer, 2, 40);    // Evicts 1, wraps at offset 70
+    CHECK(Holds(buffer, { 2 }, { 40 }));
+    Push(buffer, 3, 50);    // Starts at 10
+    Push(buffer, 4, 45);    // Evicts 2, wraps at offset 60
+    CHECK(Holds(buffer, { 3, 4 }, { 50, 45 }));
+
+    // Drain hands everything over, then the buffer starts again from empty
+    std::vector<uint64_t> drained;
+    buffer.Drain([&drained](const uint8_t*, size_t, uint64_t timestamp, bool) { drained.push_back(timestamp); });
+    CHECK(drained.size() == 2 && drained[0] == 1003 && drained[1] == 1004);
+    CHECK(buffer.Empty() && buffer.BufferedBytes() == 0);
+    Push(buffer, 5, 100);
+    CHECK(Holds(buffer, { 5 }, { 100 }));
+}
+
+// A packet larger than the buffer can't be kept with anything before it
+void TestOversize() {
+    PreRollBuffer buffer(100);
+    Push(buffer, 1, 40);
+    Push(buffer, 2, 40);
+    Push(buffer, 3, 101);
+    CHECK(buffer.Empty() && buffer.BufferedBytes() == 0 && buffer.DroppedBytes() == 181);
+
+    // And the buffer carries on afterwards
+    Push(buffer, 4, 60);
+    Push(buffer, 5, 60);
+    CHECK(Holds(buffer, { 5 }, { 60 }) && buffer.DroppedBytes() == 241);
+}
+
+// Random sizes against a deque of whole packets trimmed the same way
+void TestRandom() {
+    const size_t capacity = 4096;
+    PreRollBuffer buffer(capacity);
+    std::deque<uint32_t> ids;
+    std::deque<size_t> sizes;
+    size_t modelBytes = 0;
+    uint64_t modelDropped = 0;
+    std::mt19937 random(11);
+    bool ok = true;
+    for (uint32_t id = 0; id < 20000 && ok; id++) {
+        // Mostly capture-sized packets, now and then one too big or empty
+        const uint32_t roll = random() % 100;
+        const size_t size = roll < 2 ? capacity + 1 + random() % 100 : roll < 4 ? 0 : 1 + random() % 1500;
+        Push(buffer, id, size);
+
+        if (size > capacity) {
+            modelDropped += modelBytes + size;
+            ids.clear();
+            sizes.clear();
+            modelBytes = 0;
+        } else if (size > 0) {
+            while (capacity - modelBytes < size) {
+                modelDropped += sizes.front();
+                modelBytes -= sizes.front();
+                ids.pop_front();
+                sizes.pop_front();
+            }
+            ids.push_back(id);
+            sizes.push_back(size);
+            modelBytes += size;
+        }
+
+        if (id % 97 == 0 || buffer.DroppedBytes() != modelDropped) {
+            ok = Holds(buffer, std::vector<uint32_t>(ids.begin(), ids.end()),
+                       std::vector<size_t>(sizes.begin(), sizes.end())) &&
+                 buffer.DroppedBytes() == modelDropped;
+            if (!ok) fprintf(stderr, "  random: mismatch after packet %u\n", id);
+        }
+    }
+    CHECK(ok);
+}
+
+} // namespace
+
+int main() {
+    TestEviction();
+    TestWrapAround();
+    TestOversize();
+    TestRandom();
+    return test::TestResult();
+}
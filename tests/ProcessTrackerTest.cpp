@@ -0,0 +1,213 @@
+// ProcessTracker driven by a scripted ProcessSource (starts, exits, reused
+// pids, a changed target list, and a session check that fails at first),
+// and by ProcFsProcessSource over a fake /proc tree and over the real one.
+
+#include "ProcFsProcessSource.h"
+#include "ProcessTracker.h"
+#include "TestCheck.h"
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// Processes as the test sets them; pids in `otherSession` fail the session
+// check, and every check is counted
+class ScriptedSource : public ProcessSource {
+public:
+    struct Process {
+        uint32_t parent;
+        std::wstring name;
+    };
+
+    std::map<uint32_t, Process> processes;
+    std::set<uint32_t> otherSession;
+    bool fail = false;
+    int sessionChecks = 0;
+
+    bool Enumerate(ProcessTable& table) override {
+        table.Clear();
+        if (!fail) {
+            for (const auto& pair : processes) table.Add(pair.first, pair.second.parent, pair.second.name.c_str());
+        }
+        table.Finish();
+        return !fail;
+    }
+
+    bool IsInCurrentSession(uint32_t pid) override {
+        sessionChecks++;
+        return otherSession.find(pid) == otherSession.end();
+    }
+};
+
+std::set<uint32_t> Pids(const ProcessTracker& tracker) {
+    std::set<uint32_t> pids;
+    for (const ProcessTracker::Target& target : tracker.GetTargets()) pids.insert(target.pid);
+    return pids;
+}
+
+// "+pid" for each start and "-pid" for each exit, in order
+std::string Events(const ProcessTracker& tracker) {
+    std::string events;
+    for (const ProcessTracker::Event& event : tracker.GetEvents()) {
+        events += (event.type == ProcessTracker::Event::Started ? "+" : "-") + std::to_string(event.pid) + " ";
+    }
+    return events;
+}
+
+void TestScripted() {
+    auto owned = std::make_unique<ScriptedSource>();
+    ScriptedSource& source = *owned;
+    ProcessTracker tracker(std::move(owned));
+    tracker.SetTargets({ L"Telegram.exe", L"zoom.exe" });
+    ProcessTable table;
+
+    source.processes = { { 4, { 0, L"System" } }, { 100, { 4, L"explorer.exe" } },
+                         { 200, { 100, L"telegram.EXE" } }, { 300, { 100, L"notepad.exe" } } };
+    CHECK(tracker.Refresh(table));
+    CHECK(Events(tracker) == "+200 " && Pids(tracker) == std::set<uint32_t>({ 200 }));
+    CHECK(table.Size() == 4 && table.ParentOf(200) == 100);
+
+    // Nothing changed: no events, and no process is asked about again
+    const int checks = source.sessionChecks;
+    CHECK(tracker.Refresh(table) && Events(tracker).empty() && source.sessionChecks == checks);
+
+    // A failed snapshot leaves targets and events as they were
+    source.processes[400] = { 100, L"Zoom.exe" };
+    source.fail = true;
+    CHECK(!tracker.Refresh(table) && Pids(tracker) == std::set<uint32_t>({ 200 }));
+    source.fail = false;
+    CHECK(tracker.Refresh(table) && Events(tracker) == "+400 ");
+
+    // A pid reused by another process (new parent) exits and starts again
+    source.processes[200] = { 300, L"Telegram.exe" };
+    CHECK(tracker.Refresh(table) && Events(tracker) == "-200 +200 ");
+    source.processes.erase(400);
+    CHECK(tracker.Refresh(table) && Events(tracker) == "-400 " && Pids(tracker) == std::set<uint32_t>({ 200 }));
+
+    // A process that fails the session check when it first appears is
+    // tracked once it passes
+    source.processes[500] = { 100, L"Telegram.exe" };
+    source.otherSession.insert(500);
+    CHECK(tracker.Refresh(table) && Events(tracker).empty());
+    CHECK(tracker.Refresh(table) && Events(tracker).empty());
+    source.otherSession.erase(500);
+    CHECK(tracker.Refresh(table) && Events(tracker) == "+500 ");
+    CHECK(Pids(tracker) == std::set<uint32_t>({ 200, 500 }));
+
+    // One that exits while refused is forgotten: its pid coming back as
+    // another user's process is checked afresh, and not tracked
+    source.processes[600] = { 100, L"zoom.exe" };
+    source.otherSession.insert(600);
+    CHECK(tracker.Refresh(table) && Events(tracker).empty());
+    source.processes.erase(600);
+    CHECK(tracker.Refresh(table) && Events(tracker).empty());
+    const int before = source.sessionChecks;
+    CHECK(tracker.Refresh(table) && source.sessionChecks == before);
+    source.processes[600] = { 300, L"zoom.exe" };
+    CHECK(tracker.Refresh(table) && Events(tracker).empty() && source.sessionChecks == before + 1);
+
+    // A changed target list applies to every running process
+    tracker.SetTargets({ L"notepad.exe", L"zoom.exe" });
+    CHECK(tracker.Refresh(table) && Pids(tracker) == std::set<uint32_t>({ 300 }));
+    CHECK(Events(tracker) == "-200 -500 +300 ");
+    source.otherSession.erase(600);
+    CHECK(tracker.Refresh(table) && Events(tracker) == "+600 ");
+}
+
+// A /proc look-alike in a temporary directory
+class FakeProc {
+public:
+    FakeProc() {
+        char pattern[] = "/tmp/proctrackerXXXXXX";
+        const char* made = mkdtemp(pattern);
+        m_root = made ? made : "";
+    }
+
+    ~FakeProc() {
+        for (const std::string& dir : m_dirs) Remove(dir);
+        rmdir(m_root.c_str());
+    }
+
+    const std::string& Root() const { return m_root; }
+
+    // `stat` is the whole contents of <root>/<entry>/stat (none if empty)
+    void Set(const std::string& entry, const std::string& stat) {
+        const std::string dir = m_root + "/" + entry;
+        if (mkdir(dir.c_str(), 0700) == 0) m_dirs.insert(entry);
+        if (stat.empty()) return;
+        FILE* file = fopen((dir + "/stat").c_str(), "w");
+        if (!file) return;
+        fputs(stat.c_str(), file);
+        fclose(file);
+    }
+
+    void Remove(const std::string& entry) {
+        const std::string dir = m_root + "/" + entry;
+        unlink((dir + "/stat").c_str());
+        rmdir(dir.c_str());
+    }
+
+private:
+    std::string m_root;
+    std::set<std::string> m_dirs;
+};
+
+void TestProcFsFake() {
+    FakeProc proc;
+    if (!CHECK(!proc.Root().empty())) return;
+    proc.Set("1", "1 (init) S 0 1 1 0 -1");
+    proc.Set("42", "42 (Telegram) S 1 42 42 0 -1");
+    proc.Set("43", "43 (tele (gram) x) R 42 42 42 0 -1");   // comm with spaces and parentheses
+    proc.Set("44", "44 (no parent");                         // Malformed: skipped
+    proc.Set("45", "");                                      // Exited between readdir and open
+    proc.Set("self", "99 (self) S 1");                       // Not a pid
+    proc.Set("0", "0 (zero) S 0");
+
+    ProcessTracker tracker(std::make_unique<ProcFsProcessSource>(proc.Root().c_str()));
+    tracker.SetTargets({ L"telegram", L"tele (gram) x" });
+    ProcessTable table;
+    CHECK(tracker.Refresh(table));
+    CHECK(table.Size() == 3 && table.ParentOf(43) == 42 && table.ParentOf(42) == 1);
+    CHECK(table.NameOf(43) && *table.NameOf(43) == L"tele (gram) x");
+    CHECK(Pids(tracker) == std::set<uint32_t>({ 42, 43 }));
+
+    proc.Remove("42");
+    CHECK(tracker.Refresh(table) && Events(tracker) == "-42 " && Pids(tracker) == std::set<uint32_t>({ 43 }));
+
+    // A root that isn't there: the tracker keeps what it had
+    ProcessTracker missing(std::make_unique<ProcFsProcessSource>("/nonexistent/proc"));
+    CHECK(!missing.Refresh(table) && table.Size() == 0);
+}
+
+// This very process, found in the real /proc with its parent
+void TestProcFsReal() {
+    ProcFsProcessSource source;
+    ProcessTable table;
+    if (!source.Enumerate(table)) {
+        fprintf(stderr, "  no /proc here, skipped\n");
+        return;
+    }
+    const uint32_t self = static_cast<uint32_t>(getpid());
+    CHECK(table.Size() > 1 && table.NameOf(self) != nullptr);
+    CHECK(table.ParentOf(self) == static_cast<uint32_t>(getppid()));
+    CHECK(source.IsInCurrentSession(self));
+
+    ProcessTracker tracker(std::make_unique<ProcFsProcessSource>());
+    tracker.SetTargets({ *table.NameOf(self) });
+    CHECK(tracker.Refresh(table) && Pids(tracker).count(self) == 1);
+}
+
+} // namespace
+
+int main() {
+    TestScripted();
+    TestProcFsFake();
+    TestProcFsReal();
+    return test::TestResult();
+}
@@ -0,0 +1,212 @@
+// Resampler: THD+N of a converted sine against the ideal one for every
+// quality and the usual rate pairs, packet-split invariance, and a long run
+// with drift adjustments whose frame accounting must not slip.
+
+#include "Resampler.h"
+#include "TestCheck.h"
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+struct RatePair {
+    uint32_t input;
+    uint32_t output;
+};
+
+const RatePair kPairs[] = {
+    { 44100, 48000 }, { 48000, 44100 }, { 16000, 48000 }, { 48000, 16000 },
+    { 48000, 48000 }, { 11025, 48000 }, { 32000, 48000 }, { 48000, 96000 }
+};
+
+// THD+N ceilings in dB, nominal ratio and with a drift adjustment
+const double kNominalLimitDb[] = { -50.0, -85.0, -110.0 };
+const double kAdjustedLimitDb[] = { -50.0, -85.0, -88.0 };
+
+const char* QualityName(ResamplerQuality quality) {
+    switch (quality) {
+    case ResamplerQuality::Low: return "low";
+    case ResamplerQuality::Medium: return "medium";
+    default: return "high";
+    }
+}
+
+std::vector<float> Sine(uint32_t rate, double frequency, size_t frames, uint32_t channels) {
+    std::vector<float> samples(frames * channels);
+    for (size_t i = 0; i < frames; i++) {
+        const float v = (float)(0.5 * std::sin(2.0 * kPi * frequency * (double)i / rate));
+        for (uint32_t ch = 0; ch < channels; ch++) samples[i * channels + ch] = v;
+    }
+    return samples;
+}
+
+// Packets of random size (1..maxPacket frames)
+size_t ProcessSplit(Resampler& resampler, const std::vector<float>& input, uint32_t channels,
+                    std::vector<float>& output, std::mt19937& rng, size_t maxPacket) {
+    const size_t frames = input.size() / channels;
+    size_t produced = 0;
+    for (size_t pos = 0; pos < frames;) {
+        const size_t count = (std::min)(frames - pos, (size_t)(1 + rng() % maxPacket));
+        produced += resampler.Process(input.data() + pos * channels, count, output);
+        pos += count;
+    }
+    return produced;
+}
+
+// Error power of channel 0 against the ideal sine, relative to the signal,
+// skipping the first quarter (filter start-up)
+double ThdNoiseDb(const std::vector<float>& output, uint32_t channels, double step, uint32_t inputRate,
+                  double frequency, size_t firstFrame = 0) {
+    const size_t frames = output.size() / channels;
+    double error = 0.0, signal = 0.0;
+    for (size_t k = (std::max)(firstFrame, frames / 4); k < frames; k++) {
+        const double reference = 0.5 * std::sin(2.0 * kPi * frequency * (double)(k * step) / inputRate);
+        const double e = output[k * channels] - reference;
+        error += e * e;
+        signal += reference * reference;
+    }
+    return 10.0 * std::log10(error / signal + 1e-30);
+}
+
+void TestQuality() {
+    for (const RatePair& pair : kPairs) {
+        for (int q = 0; q < 3; q++) {
+            const ResamplerQuality quality = (ResamplerQuality)q;
+            for (double frequency : { 1000.0, 3000.0 }) {
+                for (double adjust : { 1.0, 1.0002 }) {
+                    Resampler resampler;
+                    CHECK(resampler.Initialize(pair.input, pair.output, 2, quality));
+                    resampler.SetRateAdjust(adjust);
+                    const std::vector<float> input = Sine(pair.input, frequency, pair.input * 3, 2);
+                    std::vector<float> output;
+                    resampler.Process(input.data(), input.size() / 2, output);
+
+                    const double step = (double)pair.input / pair.output * adjust;
+                    const double db = ThdNoiseDb(output, 2, step, pair.input, frequency);
+                    const double limit = adjust == 1.0 ? kNominalLimitDb[q] : kAdjustedLimitDb[q];
+                    if (!CHECK(db <= limit)) {
+                        fprintf(stderr, "  %u -> %u %s, %.0f Hz, adjust %.4f: THD+N %.1f dB\n",
+                                pair.input, pair.output, QualityName(quality), frequency, adjust, db);
+                    }
+
+                    // Both channels get the same filter
+                    bool same = true;
+                    for (size_t k = 0; k < output.size(); k += 2) same = same && output[k] == output[k + 1];
+                    CHECK(same);
+                }
+            }
+        }
+    }
+}
+
+// Packet boundaries must not change a single output sample
+void TestSplitInvariance() {
+    std::mt19937 rng(7);
+    for (const RatePair& pair : kPairs) {
+        for (double adjust : { 1.0, 0.9997 }) {
+            const std::vector<float> input = Sine(pair.input, 997.0, pair.input, 2);
+            Resampler whole, split;
+            CHECK(whole.Initialize(pair.input, pair.output, 2));
+            CHECK(split.Initialize(pair.input, pair.output, 2));
+            whole.SetRateAdjust(adjust);
+            split.SetRateAdjust(adjust);
+
+            std::vector<float> expected, actual;
+            whole.Process(input.data(), input.size() / 2, expected);
+            ProcessSplit(split, input, 2, actual, rng, 700);
+            CHECK(expected == actual);
+        }
+    }
+}
+
+// Half an hour of 44.1 -> 48 kHz in capture-sized packets, with the drift
+// loop's small corrections changing every few seconds: every input frame is
+// accounted for (consumed by the output position or still buffered), and
+// the output is still clean at the end
+void TestLongRun() {
+    const uint32_t inputRate = 44100, outputRate = 48000;
+    const double frequency = 1000.0;
+    const double seconds = 1800.0;
+    const size_t packet = inputRate / 100;
+
+    Resampler resampler;
+    CHECK(resampler.Initialize(inputRate, outputRate, 1));
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<double> adjustDist(-300e-6, 300e-6);
+
+    std::vector<float> input(packet), output;
+    double phase = 0.0;
+    double consumed = 0.0;   // Input frames the output position has passed
+    double adjust = 1.0;
+    size_t inputFrames = 0, outputFrames = 0;
+    const size_t totalPackets = (size_t)(seconds * 100);
+    size_t tailStart = 0;
+    for (size_t p = 0; p < totalPackets; p++) {
+        if (p % 500 == 0 && p + 500 < totalPackets) {
+            adjust = 1.0 + adjustDist(rng);
+            resampler.SetRateAdjust(adjust);
+        } else if (p + 500 == totalPackets) {
+            // Settle on nominal for the clean-output check
+            adjust = 1.0;
+            resampler.SetRateAdjust(adjust);
+            tailStart = outputFrames;
+        }
+        for (float& s : input) {
+            s = (float)(0.5 * std::sin(phase));
+            phase = std::fmod(phase + 2.0 * kPi * frequency / inputRate, 2.0 * kPi);
+        }
+        output.clear();
+        const size_t produced = resampler.Process(input.data(), packet, output);
+        consumed += produced * (double)inputRate / outputRate * adjust;
+        inputFrames += packet;
+        outputFrames += produced;
+    }
+
+    const double accounted = consumed + resampler.GetBufferedInputFrames();
+    if (!CHECK(std::fabs(accounted - (double)inputFrames) < 0.01)) {
+        fprintf(stderr, "  long run: %zu input frames, %.4f accounted for\n", inputFrames, accounted);
+    }
+    const double expectedOutput = (double)inputFrames * outputRate / inputRate;
+    CHECK(std::fabs((double)outputFrames - expectedOutput) < 2000.0);   // Drift moved it by < 300 ppm
+    CHECK(tailStart > 0 && outputFrames - tailStart > (size_t)outputRate);
+
+    // Last packet's output against the least-squares sine of that
+    // frequency (free phase): what is left is distortion and noise
+    double ss = 0.0, sc = 0.0, cc = 0.0, ys = 0.0, yc = 0.0;
+    for (size_t k = 0; k < output.size(); k++) {
+        const double w = 2.0 * kPi * frequency * (double)k / outputRate;
+        const double sn = std::sin(w), cs = std::cos(w);
+        ss += sn * sn;
+        sc += sn * cs;
+        cc += cs * cs;
+        ys += output[k] * sn;
+        yc += output[k] * cs;
+    }
+    const double det = ss * cc - sc * sc;
+    const double a = (ys * cc - yc * sc) / det;
+    const double b = (yc * ss - ys * sc) / det;
+    double error = 0.0, signal = 0.0;
+    for (size_t k = 0; k < output.size(); k++) {
+        const double w = 2.0 * kPi * frequency * (double)k / outputRate;
+        const double fit = a * std::sin(w) + b * std::cos(w);
+        error += (output[k] - fit) * (output[k] - fit);
+        signal += fit * fit;
+    }
+    const double tailDb = 10.0 * std::log10(error / signal + 1e-30);
+    if (!CHECK(tailDb < -80.0 && std::fabs(std::sqrt(a * a + b * b) - 0.5) < 0.001)) {
+        fprintf(stderr, "  long run tail: THD+N %.1f dB, amplitude %.4f\n", tailDb, std::sqrt(a * a + b * b));
+    }
+}
+
+} // namespace
+
+int main() {
+    TestQuality();
+    TestSplitInvariance();
+    TestLongRun();
+    return test::TestResult();
+}
@@ -0,0 +1,190 @@
+// SampleFormat conversions over every sample type and channel layout: packed
+// and padded frames through DeinterleaveToFloat, a ChannelMatrix to each
+// common output layout, and back out through InterleaveFromFloat.
+
+#include "SampleFormat.h"
+#include "TestCheck.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+const SampleType kTypes[] = { SampleType::Int16, SampleType::Int24, SampleType::Int32, SampleType::Float32 };
+
+struct Layout {
+    uint32_t channels;
+    uint32_t mask;   // 0 = positions unknown (DefaultChannelMask applies)
+};
+
+const Layout kSourceLayouts[] = {
+    { 1, 0 }, { 2, 0 }, { 3, 0 }, { 4, 0 }, { 5, 0 }, { 6, 0 }, { 7, 0 }, { 8, 0 },
+    { 2, kSpeakerFrontLeft | kSpeakerFrontRight },
+    { 6, kSpeakerFrontLeft | kSpeakerFrontRight | kSpeakerFrontCenter | kSpeakerLowFrequency |
+         kSpeakerSideLeft | kSpeakerSideRight },   // 5.1 (side)
+    { 3, kSpeakerFrontLeft | kSpeakerFrontRight | kSpeakerLowFrequency },   // 2.1
+    { 10, 0 }   // No conventional layout
+};
+
+const Layout kDestLayouts[] = { { 1, 0 }, { 2, 0 }, { 6, 0 }, { 8, 0 } };
+
+constexpr size_t kFrames = 1500;   // Several of the converters' internal blocks
+
+const char* TypeName(SampleType type) {
+    switch (type) {
+    case SampleType::Int16: return "int16";
+    case SampleType::Int24: return "int24";
+    case SampleType::Int32: return "int32";
+    default: return "float";
+    }
+}
+
+// What a float sample reads back as after a trip through `type`
+float Quantize(float value, SampleType type) {
+    uint8_t packed[4];
+    float result;
+    ConvertFromFloat(&value, 1, type, packed);
+    ConvertToFloat(packed, type, 1, &result);
+    return result;
+}
+
+std::vector<float*> Pointers(std::vector<std::vector<float>>& planes) {
+    std::vector<float*> pointers;
+    for (auto& plane : planes) pointers.push_back(plane.data());
+    return pointers;
+}
+
+void TestRoundTrip() {
+    // Every int16 value survives float exactly
+    std::vector<int16_t> all(65536), back(65536);
+    for (int i = 0; i < 65536; i++) all[i] = (int16_t)(i - 32768);
+    std::vector<float> floats(65536);
+    ConvertToFloat(all.data(), SampleType::Int16, all.size(), floats.data());
+    ConvertFromFloat(floats.data(), floats.size(), SampleType::Int16, back.data());
+    CHECK(all == back);
+
+    // Saturation at both ends, for every integer type
+    const float overs[] = { 1.5f, 1.0f, -1.0f, -1.5f, 100.0f, -100.0f };
+    int16_t s16[6];
+    ConvertFromFloat(overs, 6, SampleType::Int16, s16);
+    CHECK(s16[0] == 32767 && s16[1] == 32767 && s16[2] == -32768 && s16[3] == -32768);
+    CHECK(s16[4] == 32767 && s16[5] == -32768);
+    int32_t s32[6];
+    ConvertFromFloat(overs, 6, SampleType::Int32, s32);
+    CHECK(s32[0] > 2147483000 && s32[1] > 2147483000 && s32[2] == INT32_MIN && s32[3] == INT32_MIN);
+    uint8_t s24[18];
+    ConvertFromFloat(overs, 6, SampleType::Int24, s24);
+    float back24[6];
+    ConvertToFloat(s24, SampleType::Int24, 6, back24);
+    CHECK(back24[0] == 8388607.0f / 8388608.0f && back24[3] == -1.0f && back24[4] == back24[0]);
+
+    CHECK(Quantize(0.5f, SampleType::Int16) == 0.5f);
+    CHECK(Quantize(-0.25f, SampleType::Int24) == -0.25f);
+    CHECK(Quantize(0.1f, SampleType::Float32) == 0.1f);
+}
+
+// Gains the layout rules promise
+void TestMatrixRules() {
+    ChannelMatrix m;
+
+    m.Build(1, 0, 2, 0);   // Mono mic -> both fronts at unity
+    CHECK(m.Gain(0, 0) == 1.0f && m.Gain(1, 0) == 1.0f);
+
+    m.Build(2, 0, 1, 0);   // Stereo -> mono, normalized
+    CHECK(m.Gain(0, 0) == 0.5f && m.Gain(0, 1) == 0.5f);
+
+    m.Build(2, 0, 2, 0);
+    CHECK(m.IsIdentity());
+    m.Build(6, 0, 6, 0);
+    CHECK(m.IsIdentity());
+
+    m.Build(6, 0, 2, 0);   // 5.1 -> stereo: FL FR FC LFE BL BR
+    CHECK(m.Gain(0, 0) > m.Gain(0, 2) && m.Gain(0, 2) > 0.0f && m.Gain(0, 4) > 0.0f);
+    CHECK(m.Gain(0, 1) == 0.0f && m.Gain(0, 5) == 0.0f);
+    CHECK(m.Gain(0, 3) == 0.0f && m.Gain(1, 3) == 0.0f);   // LFE dropped
+    for (uint32_t s = 0; s < 6; s++) CHECK(m.Gain(0, s) == m.Gain(1, s ^ (s < 2 || s >= 4 ? 1 : 0)));
+
+    m.Build(8, 0, 6, 0);   // 7.1 -> 5.1: sides fold onto the backs
+    CHECK(m.Gain(4, 6) > 0.0f && m.Gain(5, 7) > 0.0f && m.Gain(4, 7) == 0.0f);
+}
+
+// One type x source layout x dest layout cell of the matrix
+void TestCell(SampleType type, const Layout& source, const Layout& dest, bool padded, std::mt19937& rng) {
+    const uint32_t sampleBytes = SampleTypeBytes(type);
+    const uint32_t stride = source.channels * sampleBytes + (padded ? 4 : 0);
+    std::uniform_real_distribution<float> dist(-0.9f, 0.9f);
+
+    // Source frames in `type`, and the float values they stand for
+    std::vector<std::vector<float>> expected(source.channels, std::vector<float>(kFrames));
+    std::vector<uint8_t> frames(kFrames * stride, 0xAB);
+    for (size_t f = 0; f < kFrames; f++) {
+        for (uint32_t ch = 0; ch < source.channels; ch++) {
+            const float value = dist(rng);
+            ConvertFromFloat(&value, 1, type, &frames[f * stride + ch * sampleBytes]);
+            expected[ch][f] = Quantize(value, type);
+        }
+    }
+
+    std::vector<std::vector<float>> planes(source.channels, std::vector<float>(kFrames));
+    std::vector<float*> planePointers = Pointers(planes);
+    DeinterleaveToFloat(frames.data(), type, source.channels, stride, kFrames, planePointers.data());
+    bool exact = true;
+    for (uint32_t ch = 0; ch < source.channels; ch++) exact = exact && planes[ch] == expected[ch];
+
+    ChannelMatrix matrix;
+    matrix.Build(source.channels, source.mask, dest.channels, dest.mask);
+    std::vector<std::vector<float>> mixed(dest.channels, std::vector<float>(kFrames));
+    std::vector<float*> mixedPointers = Pointers(mixed);
+    matrix.Apply(planePointers.data(), mixedPointers.data(), kFrames);
+
+    // Against the gains in double; rows never sum above unity
+    bool matches = true, bounded = true;
+    for (uint32_t d = 0; d < dest.channels; d++) {
+        double rowSum = 0.0;
+        for (uint32_t s = 0; s < source.channels; s++) rowSum += std::fabs(matrix.Gain(d, s));
+        bounded = bounded && rowSum <= 1.0 + 1e-6;
+        for (size_t f = 0; f < kFrames; f++) {
+            double sum = 0.0;
+            for (uint32_t s = 0; s < source.channels; s++) sum += (double)matrix.Gain(d, s) * expected[s][f];
+            matches = matches && std::fabs(mixed[d][f] - sum) < 1e-5;
+        }
+    }
+
+    // Back out as `type`, tightly packed, and in again unchanged
+    const std::vector<float*> mixedConst(mixedPointers.begin(), mixedPointers.end());
+    std::vector<uint8_t> out(kFrames * dest.channels * sampleBytes);
+    InterleaveFromFloat(mixedConst.data(), dest.channels, kFrames, type, out.data());
+    std::vector<std::vector<float>> reread(dest.channels, std::vector<float>(kFrames));
+    std::vector<float*> rereadPointers = Pointers(reread);
+    DeinterleaveToFloat(out.data(), type, dest.channels, dest.channels * sampleBytes, kFrames, rereadPointers.data());
+    bool roundTrip = true;
+    for (uint32_t d = 0; d < dest.channels; d++) {
+        for (size_t f = 0; f < kFrames; f++) roundTrip = roundTrip && reread[d][f] == Quantize(mixed[d][f], type);
+    }
+
+    if (!CHECK(exact && matches && bounded && roundTrip)) {
+        fprintf(stderr, "  %s %u ch (mask %#x%s) -> %u ch: exact %d, matrix %d, bounded %d, round trip %d\n",
+                TypeName(type), source.channels, source.mask, padded ? ", padded" : "", dest.channels,
+                exact, matches, bounded, roundTrip);
+    }
+}
+
+} // namespace
+
+int main() {
+    TestRoundTrip();
+    TestMatrixRules();
+
+    std::mt19937 rng(5);
+    for (SampleType type : kTypes) {
+        for (const Layout& source : kSourceLayouts) {
+            for (const Layout& dest : kDestLayouts) {
+                TestCell(type, source, dest, false, rng);
+                TestCell(type, source, dest, true, rng);
+            }
+        }
+    }
+    return test::TestResult();
+}
@@ -0,0 +1,125 @@
+// SessionActivityTable: a session counts for its process and up to
+// kAncestorDepth ancestors, peaks take the maximum and active any session,
+// and on random process trees every pid reads the same as the per-pid
+// session walks the table replaced.
+
+#include "SessionScan.h"
+#include "TestCheck.h"
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+using ParentMap = std::unordered_map<uint32_t, uint32_t>;
+
+SessionActivityTable::ParentLookup Parents(const ParentMap& parents) {
+    return [&parents](uint32_t pid) {
+        auto it = parents.find(pid);
+        return it != parents.end() ? it->second : 0u;
+    };
+}
+
+// What the old per-pid walks answered: sessions of the process itself or of
+// a descendant IsChildOfProcess finds (three parent hops at most)
+SessionActivity Reference(uint32_t pid, const std::vector<SessionSample>& sessions, const ParentMap& parents) {
+    const SessionActivityTable::ParentLookup parentOf = Parents(parents);
+    SessionActivity result;
+    for (const SessionSample& session : sessions) {
+        if (session.pid == 0) continue;
+        bool match = session.pid == pid;
+        uint32_t current = session.pid;
+        for (int depth = 0; !match && depth < 3; depth++) {
+            const uint32_t parent = parentOf(current);
+            if (parent == 0 || parent == current) break;
+            match = parent == pid;
+            current = parent;
+        }
+        if (!match) continue;
+        result.peak = (std::max)(result.peak, session.peak);
+        result.active = result.active || session.active;
+    }
+    return result;
+}
+
+bool Same(const SessionActivity& a, const SessionActivity& b) { return a.peak == b.peak && a.active == b.active; }
+
+void TestBasics() {
+    SessionActivityTable table;
+    ParentMap parents;
+    table.Build({}, Parents(parents));
+    CHECK(table.Size() == 0 && Same(table.Find(42), SessionActivity{}));
+
+    // 40 <- 30 <- 20 <- 10 <- 5: a session of 40 reaches 30, 20 and 10, not 5
+    parents = { { 40, 30 }, { 30, 20 }, { 20, 10 }, { 10, 5 } };
+    table.Build({ { 40, 0.25f, false } }, Parents(parents));
+    CHECK(table.Find(40).peak == 0.25f && table.Find(30).peak == 0.25f);
+    CHECK(table.Find(20).peak == 0.25f && table.Find(10).peak == 0.25f);
+    CHECK(table.Find(5).peak == 0.0f && table.Size() == 4);
+
+    // Largest peak, and active if any session is; a parent sees its children's
+    table.Build({ { 30, 0.5f, false }, { 30, 0.1f, true }, { 40, 0.7f, false } }, Parents(parents));
+    CHECK(Same(table.Find(30), { 0.7f, true }) && Same(table.Find(40), { 0.7f, false }));
+    CHECK(Same(table.Find(10), { 0.7f, true }));
+
+    // System sounds count for nobody
+    table.Build({ { 0, 0.9f, true } }, Parents(parents));
+    CHECK(table.Size() == 0);
+
+    // A process listed as its own parent, and a two-process loop, end the walk
+    parents = { { 7, 7 }, { 8, 9 }, { 9, 8 } };
+    table.Build({ { 7, 0.3f, true }, { 8, 0.2f, false } }, Parents(parents));
+    CHECK(Same(table.Find(7), { 0.3f, true }) && Same(table.Find(8), { 0.2f, false }));
+    CHECK(Same(table.Find(9), { 0.2f, false }) && table.Size() == 3);
+
+    // Build replaces the previous scan; Clear empties it
+    table.Build({ { 9, 0.4f, false } }, Parents(parents));
+    CHECK(table.Find(7).peak == 0.0f && table.Find(9).peak == 0.4f);
+    table.Clear();
+    CHECK(table.Size() == 0 && table.Find(9).peak == 0.0f);
+}
+
+// Random forests, many of them deeper than kAncestorDepth, with sessions
+// scattered over them
+void TestAgainstPerPidWalks() {
+    std::mt19937 random(5);
+    int mismatches = 0;
+    for (int round = 0; round < 200; round++) {
+        ParentMap parents;
+        const uint32_t processes = 20 + random() % 200;
+        for (uint32_t pid = 1; pid <= processes; pid++) {
+            // Parents have lower pids, so there are roots, chains and fans
+            const uint32_t roll = random() % 10;
+            if (roll < 2 || pid == 1) continue;
+            parents[pid] = roll == 2 ? pid : 1 + random() % (pid - 1);
+        }
+        std::vector<SessionSample> sessions;
+        const size_t count = random() % 60;
+        for (size_t i = 0; i < count; i++) {
+            const uint32_t pid = random() % 10 == 0 ? 0 : 1 + random() % (processes + 5);
+            sessions.push_back({ pid, (float)(random() % 1000) / 1000.0f, random() % 3 == 0 });
+        }
+
+        SessionActivityTable table;
+        table.Build(sessions, Parents(parents));
+        for (uint32_t pid = 1; pid <= processes + 5; pid++) {
+            const SessionActivity want = Reference(pid, sessions, parents);
+            const SessionActivity got = table.Find(pid);
+            if (!Same(got, want) && mismatches++ < 5) {
+                fprintf(stderr, "  round %d, pid %u: peak %.3f active %d, walks give %.3f %d\n", round, pid, got.peak,
+                        got.active, want.peak, want.active);
+            }
+        }
+    }
+    CHECK(mismatches == 0);
+}
+
+} // namespace
+
+int main() {
+    TestBasics();
+    TestAgainstPerPidWalks();
+    return test::TestResult();
+}
@@ -0,0 +1,254 @@
+// SessionEventTable kept current from synthetic session events, against a
+// full rescan of the same sessions: after every burst of creations, state
+// changes, disconnects and device removals (with the late and duplicate
+// events the callbacks can deliver), the sessions selected for the targets
+// and the activity built from them match what enumerating everything
+// would have found.
+
+#include "SessionScan.h"
+#include "TestCheck.h"
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <map>
+#include <random>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+using ParentMap = std::unordered_map<uint32_t, uint32_t>;
+
+SessionActivityTable::ParentLookup Parents(const ParentMap& parents) {
+    return [&parents](uint32_t pid) {
+        auto it = parents.find(pid);
+        return it != parents.end() ? it->second : 0u;
+    };
+}
+
+void TestBasics() {
+    SessionEventTable table;
+    table.Add(1, 0, 100, false);
+    table.Add(2, 0, 200, true);
+    table.Add(3, 1, 100, true);
+    table.Add(4, 1, 0, true);      // System sounds
+    CHECK(table.Size() == 4 && table.Contains(3));
+
+    std::vector<uint64_t> keys;
+    std::vector<SessionSample> samples;
+    ParentMap parents = { { 200, 100 } };
+    table.SelectTargets({ 100 }, Parents(parents), keys, samples);
+    CHECK(keys == std::vector<uint64_t>({ 1, 2, 3 }) && samples.size() == 3);
+    CHECK(samples[0].pid == 100 && !samples[0].active && samples[1].pid == 200 && samples[1].active);
+    CHECK(samples[2].peak == 0.0f);
+
+    // Events for sessions the table doesn't have are ignored
+    table.SetActive(1, true);
+    table.SetActive(99, true);
+    table.Remove(99);
+    CHECK(table.Size() == 4 && !table.Contains(99));
+
+    // Added again (enumerated and reported as created): one entry, latest state
+    table.Add(1, 0, 100, false);
+    table.SelectTargets({ 100 }, Parents(parents), keys, samples);
+    CHECK(table.Size() == 4 && !samples[0].active);
+
+    table.RemoveDevice(1);
+    CHECK(table.Size() == 2 && !table.Contains(3) && !table.Contains(4));
+    table.Remove(2);
+    table.SelectTargets({ 100 }, Parents(parents), keys, samples);
+    CHECK(keys == std::vector<uint64_t>({ 1 }));
+    table.SelectTargets({ 555 }, Parents(parents), keys, samples);
+    CHECK(keys.empty() && samples.empty());
+}
+
+// The sessions that really exist, as a full enumeration would find them
+struct World {
+    struct Session {
+        uint32_t device;
+        uint32_t pid;
+        bool active;
+        float peak;   // Meter reading; inactive sessions read 0
+    };
+
+    std::map<uint64_t, Session> sessions;
+    std::set<uint32_t> devices;
+    ParentMap parents;
+};
+
+// Per target, what AudioSessionMonitor::ScanAllSessions would answer
+SessionActivityTable Rescan(const World& world) {
+    std::vector<SessionSample> samples;
+    for (const auto& pair : world.sessions) {
+        if (pair.second.pid == 0) continue;
+        samples.push_back({ pair.second.pid, pair.second.peak, pair.second.active });
+    }
+    SessionActivityTable table;
+    table.Build(samples, Parents(world.parents));
+    return table;
+}
+
+// What AudioSessionTracker::Sample does with the event table: select the
+// targets' sessions, read the meters of the active ones only, build
+SessionActivityTable FromEvents(const SessionEventTable& events, const World& world,
+                                const std::vector<uint32_t>& targets, std::vector<uint64_t>& keys) {
+    std::vector<SessionSample> samples;
+    events.SelectTargets(targets, Parents(world.parents), keys, samples);
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (samples[i].active) samples[i].peak = world.sessions.at(keys[i]).peak;
+    }
+    SessionActivityTable table;
+    table.Build(samples, Parents(world.parents));
+    return table;
+}
+
+void TestAgainstRescan() {
+    std::mt19937 random(19);
+    auto chance = [&random](int percent) { return (int)(random() % 100) < percent; };
+
+    World world;
+    SessionEventTable events;
+    uint64_t nextKey = 1;
+    uint32_t nextDevice = 0;
+    const uint32_t pidCount = 120;
+    std::vector<uint32_t> targets = { 10, 20, 30 };
+
+    // Keys reported gone, for late events that arrive after the disconnect
+    std::vector<uint64_t> gone;
+    int mismatches = 0;
+    size_t checkedSessions = 0;
+
+    for (int cycle = 0; cycle < 3000; cycle++) {
+        // Processes come and go: some are re-parented, as a reused pid would be
+        if (chance(30)) {
+            const uint32_t pid = 1 + random() % pidCount;
+            if (chance(20)) {
+                world.parents.erase(pid);
+            } else {
+                world.parents[pid] = chance(10) ? pid : 1 + random() % pidCount;
+            }
+        }
+        if (chance(2)) targets = { 1 + (uint32_t)(random() % pidCount), 1 + (uint32_t)(random() % pidCount) };
+
+        const int burst = random() % 12;
+        for (int e = 0; e < burst; e++) {
+            const uint32_t roll = random() % 100;
+            if (world.devices.empty() || roll < 3) {
+                // A render device appears with the sessions already on it
+                const uint32_t device = nextDevice++;
+                world.devices.insert(device);
+                for (int s = random() % 4; s > 0; s--) {
+                    const uint64_t key = nextKey++;
+                    const bool active = chance(50);
+                    world.sessions[key] = { device, (uint32_t)(random() % (pidCount + 1)), active,
+                                            active ? (float)(random() % 1000) / 1000.0f : 0.0f };
+                    events.Add(key, device, world.sessions[key].pid, active);
+                }
+            } else if (roll < 5 && world.devices.size() > 1) {
+                // A device goes away, and every session on it without its own event
+                auto it = world.devices.begin();
+                std::advance(it, random() % world.devices.size());
+                const uint32_t device = *it;
+                world.devices.erase(it);
+                for (auto s = world.sessions.begin(); s != world.sessions.end();) {
+                    if (s->second.device == device) {
+                        gone.push_back(s->first);
+                        s = world.sessions.erase(s);
+                    } else {
+                        ++s;
+                    }
+                }
+                events.RemoveDevice(device);
+            } else if (roll < 35) {
+                // Session created, sometimes also reported by the enumeration
+                auto it = world.devices.begin();
+                std::advance(it, random() % world.devices.size());
+                const uint64_t key = nextKey++;
+                const bool active = chance(40);
+                world.sessions[key] = { *it, (uint32_t)(random() % (pidCount + 1)), active,
+                                        active ? (float)(random() % 1000) / 1000.0f : 0.0f };
+                events.Add(key, *it, world.sessions[key].pid, active);
+                if (chance(10)) events.Add(key, *it, world.sessions[key].pid, active);
+            } else if (roll < 75 && !world.sessions.empty()) {
+                // State change
+                auto it = world.sessions.begin();
+                std::advance(it, random() % world.sessions.size());
+                it->second.active = !it->second.active;
+                it->second.peak = it->second.active ? (float)(random() % 1000) / 1000.0f : 0.0f;
+                events.SetActive(it->first, it->second.active);
+            } else if (roll < 90 && !world.sessions.empty()) {
+                // Disconnected or expired
+                auto it = world.sessions.begin();
+                std::advance(it, random() % world.sessions.size());
+                gone.push_back(it->first);
+                events.Remove(it->first);
+                world.sessions.erase(it);
+            } else if (!gone.empty()) {
+                // A late state change or a second disconnect for a session already gone
+                const uint64_t key = gone[random() % gone.size()];
+                if (chance(50)) {
+                    events.SetActive(key, true);
+                } else {
+                    events.Remove(key);
+                }
+            } else if (!world.sessions.empty()) {
+                // Meters move without any event
+                auto it = world.sessions.begin();
+                std::advance(it, random() % world.sessions.size());
+                if (it->second.active) it->second.peak = (float)(random() % 1000) / 1000.0f;
+            }
+        }
+
+        // The table holds exactly the live sessions ...
+        if (events.Size() != world.sessions.size() && mismatches++ < 5) {
+            fprintf(stderr, "  cycle %d: table has %zu sessions, world %zu\n", cycle, events.Size(),
+                    world.sessions.size());
+        }
+
+        // ... selects exactly the targets' ones ...
+        std::vector<uint64_t> keys;
+        const SessionActivityTable incremental = FromEvents(events, world, targets, keys);
+        const SessionActivityTable full = Rescan(world);
+        std::vector<uint64_t> expectedKeys;
+        for (const auto& pair : world.sessions) {
+            const World::Session& s = pair.second;
+            if (s.pid == 0) continue;
+            // Own process or an ancestor within kAncestorDepth
+            bool belongs = std::find(targets.begin(), targets.end(), s.pid) != targets.end();
+            uint32_t current = s.pid;
+            for (int depth = 0; !belongs && depth < SessionActivityTable::kAncestorDepth; depth++) {
+                const uint32_t parent = Parents(world.parents)(current);
+                if (parent == 0 || parent == current) break;
+                belongs = std::find(targets.begin(), targets.end(), parent) != targets.end();
+                current = parent;
+            }
+            if (belongs) expectedKeys.push_back(pair.first);
+        }
+        checkedSessions += expectedKeys.size();
+        if (keys != expectedKeys && mismatches++ < 5) {
+            fprintf(stderr, "  cycle %d: %zu sessions selected, rescan finds %zu\n", cycle, keys.size(),
+                    expectedKeys.size());
+        }
+
+        // ... and answers for every target as the rescan does
+        for (uint32_t target : targets) {
+            const SessionActivity a = incremental.Find(target);
+            const SessionActivity b = full.Find(target);
+            if ((a.peak != b.peak || a.active != b.active) && mismatches++ < 5) {
+                fprintf(stderr, "  cycle %d, pid %u: peak %.3f active %d, rescan %.3f %d\n", cycle, target, a.peak,
+                        a.active, b.peak, b.active);
+            }
+        }
+    }
+    CHECK(mismatches == 0);
+    CHECK(checkedSessions > 1000);
+}
+
+} // namespace
+
+int main() {
+    TestBasics();
+    TestAgainstRescan();
+    return test::TestResult();
+}
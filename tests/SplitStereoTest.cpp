@@ -0,0 +1,187 @@
+// SplitStereo routing with synthetic tones: the caller (16 kHz int16 mono,
+// 440 Hz) is routed left and the callee (48 kHz float stereo, 1 kHz) right,
+// through the default mixer with drift compensation and the limiter on.
+// Each tone must land on its own channel only, a loud callee must not duck
+// the caller, and a source without a channel goes right.
+
+#include "AudioMixer.h"
+#include "TestCheck.h"
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+const uint32_t kRate = 48000;
+const double kPi = 3.14159265358979323846;
+const DWORD kCaller = 1;
+const DWORD kCallee = 2;
+const DWORD kOther = 3;
+
+WAVEFORMATEX Format(WORD tag, WORD channels, DWORD rate, WORD bits) {
+    WAVEFORMATEX format = {};
+    format.wFormatTag = tag;
+    format.nChannels = channels;
+    format.nSamplesPerSec = rate;
+    format.wBitsPerSample = bits;
+    format.nBlockAlign = (WORD)(channels * bits / 8);
+    format.nAvgBytesPerSec = rate * format.nBlockAlign;
+    return format;
+}
+
+// A sine source fed in 10 ms packets, every channel carrying the same tone
+struct Tone {
+    DWORD sourceId;
+    WAVEFORMATEX format;
+    double frequency;
+    double amplitude;
+    size_t frame = 0;
+
+    void Feed(AudioMixer& mixer) {
+        const size_t frames = format.nSamplesPerSec / 100;
+        const size_t channels = format.nChannels;
+        std::vector<BYTE> packet(frames * format.nBlockAlign);
+        for (size_t n = 0; n < frames; n++, frame++) {
+            const double value = amplitude * std::sin(2.0 * kPi * frequency * frame / format.nSamplesPerSec);
+            for (size_t ch = 0; ch < channels; ch++) {
+                if (format.wFormatTag == WAVE_FORMAT_PCM) {
+                    reinterpret_cast<int16_t*>(packet.data())[n * channels + ch] = (int16_t)std::lround(value * 32767.0);
+                } else {
+                    reinterpret_cast<float*>(packet.data())[n * channels + ch] = (float)value;
+                }
+            }
+        }
+        mixer.AddAudioData(sourceId, packet.data(), (UINT32)packet.size(), &format);
+    }
+};
+
+Tone Caller(double amplitude = 0.5) {
+    return { kCaller, Format(WAVE_FORMAT_PCM, 1, 16000, 16), 440.0, amplitude };
+}
+Tone Callee(double amplitude = 0.5) {
+    return { kCallee, Format(WAVE_FORMAT_IEEE_FLOAT, 2, kRate, 32), 1000.0, amplitude };
+}
+
+// Feed every tone for `seconds`, collecting the stereo float output per channel
+void Run(AudioMixer& mixer, std::vector<Tone>& tones, double seconds, std::vector<float> (&out)[2]) {
+    std::vector<BYTE> block;
+    for (size_t p = 0; p < (size_t)(seconds * 100); p++) {
+        for (Tone& tone : tones) tone.Feed(mixer);
+        if (!mixer.GetMixedAudio(block)) continue;
+        const float* samples = reinterpret_cast<const float*>(block.data());
+        for (size_t i = 0; i < block.size() / sizeof(float); i++) out[i % 2].push_back(samples[i]);
+    }
+}
+
+// Amplitude of `frequency` over the last second of `signal`. Whole cycles
+// of every test tone fit in the window, so the tones don't see each other.
+double Level(const std::vector<float>& signal, double frequency) {
+    const size_t window = kRate;
+    if (signal.size() < window) return -1.0;
+    double re = 0.0, im = 0.0;
+    const size_t start = signal.size() - window;
+    for (size_t n = 0; n < window; n++) {
+        const double phase = 2.0 * kPi * frequency * n / kRate;
+        re += signal[start + n] * std::cos(phase);
+        im += signal[start + n] * std::sin(phase);
+    }
+    return 2.0 * std::sqrt(re * re + im * im) / window;
+}
+
+// RMS of what's left of the last second of `signal` once `frequency` is removed
+double Residual(const std::vector<float>& signal, double frequency) {
+    const size_t window = kRate;
+    const size_t start = signal.size() - window;
+    double total = 0.0;
+    for (size_t n = 0; n < window; n++) total += (double)signal[start + n] * signal[start + n];
+    const double tone = Level(signal, frequency);
+    return std::sqrt((std::max)(total / window - tone * tone / 2.0, 0.0));
+}
+
+double Db(double ratio) { return 20.0 * std::log10((std::max)(ratio, 1e-12)); }
+
+// Stereo float output, caller left and callee right
+void InitializeSplit(AudioMixer& mixer) {
+    const WAVEFORMATEX output = Format(WAVE_FORMAT_IEEE_FLOAT, 2, kRate, 32);
+    CHECK(mixer.Initialize(&output, MixRouting::SplitStereo));
+    mixer.SetSourceChannel(kCaller, 0);
+    mixer.SetSourceChannel(kCallee, 1);
+}
+
+// Caller only on the left, callee only on the right, both at their own level
+void TestIsolation() {
+    AudioMixer mixer;
+    InitializeSplit(mixer);
+    std::vector<Tone> tones = { Caller(), Callee() };
+    std::vector<float> out[2];
+    Run(mixer, tones, 4.0, out);
+
+    const double callerLeft = Level(out[0], 440.0), calleeLeft = Level(out[0], 1000.0);
+    const double calleeRight = Level(out[1], 1000.0), callerRight = Level(out[1], 440.0);
+    if (!CHECK(std::fabs(callerLeft - 0.5) < 0.01 && std::fabs(calleeRight - 0.5) < 0.01)) {
+        fprintf(stderr, "  levels: caller left %.4f, callee right %.4f\n", callerLeft, calleeRight);
+    }
+    // Leakage at the numeric-noise floor, and nothing else on either channel
+    if (!CHECK(Db(calleeLeft / 0.5) < -75.0 && Db(callerRight / 0.5) < -75.0)) {
+        fprintf(stderr, "  leakage: callee on left %.1f dB, caller on right %.1f dB\n", Db(calleeLeft / 0.5),
+                Db(callerRight / 0.5));
+    }
+    const double leftRest = Residual(out[0], 440.0), rightRest = Residual(out[1], 1000.0);
+    if (!CHECK(Db(leftRest / 0.5) < -60.0 && Db(rightRest / 0.5) < -60.0)) {
+        fprintf(stderr, "  residual: left %.1f dB, right %.1f dB\n", Db(leftRest / 0.5), Db(rightRest / 0.5));
+    }
+}
+
+// A callee 12 dB over full scale is limited on its own channel; the caller
+// keeps its level
+void TestIndependentLimiters() {
+    AudioMixer mixer;
+    InitializeSplit(mixer);
+    std::vector<Tone> tones = { Caller(), Callee(4.0) };
+    std::vector<float> out[2];
+    Run(mixer, tones, 4.0, out);
+
+    float peak[2] = { 0.0f, 0.0f };
+    for (int ch = 0; ch < 2; ch++) {
+        for (float sample : out[ch]) peak[ch] = (std::max)(peak[ch], std::fabs(sample));
+    }
+    const float ceiling = (float)std::pow(10.0, -1.0 / 20.0);
+    const double callerLeft = Level(out[0], 440.0);
+    if (!CHECK(peak[1] <= ceiling && peak[1] > 0.8f * ceiling && std::fabs(callerLeft - 0.5) < 0.01)) {
+        fprintf(stderr, "  loud callee: right peak %.4f (ceiling %.4f), caller left %.4f\n", peak[1], ceiling,
+                callerLeft);
+    }
+    CHECK(Db(Level(out[0], 1000.0) / 0.5) < -75.0);
+}
+
+// No channel assigned: right, next to the callee; Sum routing for contrast
+// puts every tone on both channels
+void TestDefaultsAndSum() {
+    AudioMixer mixer;
+    InitializeSplit(mixer);
+    const Tone other = { kOther, Format(WAVE_FORMAT_IEEE_FLOAT, 1, kRate, 32), 2500.0, 0.3 };
+    std::vector<Tone> tones = { Caller(0.3), Callee(0.3), other };
+    std::vector<float> split[2];
+    Run(mixer, tones, 3.0, split);
+    CHECK(Db(Level(split[0], 2500.0) / 0.3) < -75.0);
+    CHECK(std::fabs(Level(split[1], 2500.0) - 0.3) < 0.01 && std::fabs(Level(split[1], 1000.0) - 0.3) < 0.01);
+
+    WAVEFORMATEX output = Format(WAVE_FORMAT_IEEE_FLOAT, 2, kRate, 32);
+    AudioMixer sum;
+    CHECK(sum.Initialize(&output) && sum.GetRouting() == MixRouting::Sum);
+    std::vector<Tone> sumTones = { Caller(0.3), Callee(0.3) };
+    std::vector<float> mixed[2];
+    Run(sum, sumTones, 3.0, mixed);
+    for (int ch = 0; ch < 2; ch++) {
+        CHECK(std::fabs(Level(mixed[ch], 440.0) - 0.3) < 0.01 && std::fabs(Level(mixed[ch], 1000.0) - 0.3) < 0.01);
+    }
+}
+
+} // namespace
+
+int main() {
+    TestIsolation();
+    TestIndependentLimiters();
+    TestDefaultsAndSum();
+    return test::TestResult();
+}
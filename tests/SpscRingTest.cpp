@@ -0,0 +1,151 @@
+// SpscRing: capacity rounding, full/empty edges, and a two-thread stress run
+// that checks every published slot arrives once, in order and intact.
+
+#include "SpscRing.h"
+#include "TestCheck.h"
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Stands in for CapturedPacket: a preallocated payload written in place
+struct Packet {
+    std::vector<uint32_t> data;
+    uint32_t size = 0;
+    uint64_t sequence = 0;
+};
+
+constexpr uint32_t kPayload = 16;
+
+void FillPacket(Packet& packet, uint64_t sequence) {
+    packet.sequence = sequence;
+    packet.size = 1 + (uint32_t)(sequence % kPayload);
+    for (uint32_t i = 0; i < packet.size; i++) packet.data[i] = (uint32_t)(sequence * 31 + i);
+}
+
+bool PacketIntact(const Packet& packet) {
+    if (packet.size != 1 + packet.sequence % kPayload || packet.data.size() != kPayload) return false;
+    for (uint32_t i = 0; i < packet.size; i++) {
+        if (packet.data[i] != (uint32_t)(packet.sequence * 31 + i)) return false;
+    }
+    return true;
+}
+
+void TestEdges() {
+    CHECK(SpscRing<int>(0).Capacity() == 2);
+    CHECK(SpscRing<int>(5).Capacity() == 8);
+    CHECK(SpscRing<int>(64).Capacity() == 64);
+
+    SpscRing<int> ring(4);
+    int value = 0;
+    CHECK(!ring.TryPop(value));
+
+    // Many passes over the slots so the indices wrap the mask repeatedly
+    int next = 0, expected = 0;
+    for (int pass = 0; pass < 100; pass++) {
+        for (int i = 0; i < 4; i++) CHECK(ring.TryPush(next++));
+        CHECK(!ring.TryPush(-1));
+        CHECK(ring.SizeApprox() == 4);
+        for (int i = 0; i < 3; i++) {
+            CHECK(ring.TryPop(value));
+            CHECK(value == expected++);
+        }
+        CHECK(ring.TryPush(next++));
+        for (int i = 0; i < 2; i++) {
+            CHECK(ring.TryPop(value));
+            CHECK(value == expected++);
+        }
+    }
+    CHECK(ring.Overruns() == 100);
+}
+
+// Producer retries until each packet fits: nothing may be lost
+void TestStressLossless() {
+    constexpr uint64_t kCount = 2000000;
+    Packet prototype;
+    prototype.data.resize(kPayload);
+    SpscRing<Packet> ring(64, prototype);
+
+    std::thread producer([&] {
+        for (uint64_t sequence = 0; sequence < kCount;) {
+            Packet* slot = ring.BeginPush();
+            if (!slot) {
+                std::this_thread::yield();
+                continue;
+            }
+            FillPacket(*slot, sequence++);
+            ring.CommitPush();
+        }
+    });
+
+    uint64_t expected = 0;
+    bool inOrder = true, intact = true;
+    while (expected < kCount) {
+        Packet* packet = ring.Front();
+        if (!packet) {
+            std::this_thread::yield();
+            continue;
+        }
+        inOrder = inOrder && packet->sequence == expected;
+        intact = intact && PacketIntact(*packet);
+        ring.Pop();
+        expected++;
+    }
+    producer.join();
+
+    CHECK(inOrder);
+    CHECK(intact);
+    CHECK(ring.SizeApprox() == 0);
+}
+
+// Producer never waits, like the capture thread: what isn't delivered must
+// be counted as an overrun
+void TestStressOverruns() {
+    constexpr uint64_t kAttempts = 2000000;
+    Packet prototype;
+    prototype.data.resize(kPayload);
+    SpscRing<Packet> ring(8, prototype);
+    std::atomic<bool> done{false};
+
+    std::thread producer([&] {
+        for (uint64_t sequence = 0; sequence < kAttempts; sequence++) {
+            if (Packet* slot = ring.BeginPush()) {
+                FillPacket(*slot, sequence);
+                ring.CommitPush();
+            }
+        }
+        done.store(true, std::memory_order_release);
+    });
+
+    uint64_t delivered = 0;
+    uint64_t last = 0;
+    bool increasing = true, intact = true;
+    for (;;) {
+        Packet* packet = ring.Front();
+        if (!packet) {
+            if (done.load(std::memory_order_acquire) && !ring.Front()) break;
+            continue;
+        }
+        increasing = increasing && (delivered == 0 || packet->sequence > last);
+        intact = intact && PacketIntact(*packet);
+        last = packet->sequence;
+        ring.Pop();
+        delivered++;
+    }
+    producer.join();
+
+    CHECK(increasing);
+    CHECK(intact);
+    CHECK(delivered + ring.Overruns() == kAttempts);
+}
+
+} // namespace
+
+int main() {
+    TestEdges();
+    TestStressLossless();
+    TestStressOverruns();
+    return test::TestResult();
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdio>
+
+// Minimal checks for the unit tests. CHECK records a failure and carries on;
+// a test's main() returns TestResult() so ctest sees the outcome.
+
+namespace test {
+
+inline int& FailureCount() {
+    static int failures = 0;
+    return failures;
+}
+
+inline bool Check(bool ok, const char* expression, const char* file, int line) {
+    if (!ok) {
+        fprintf(stderr, "%s:%d: CHECK failed: %s\n", file, line, expression);
+        FailureCount()++;
+    }
+    return ok;
+}
+
+inline int TestResult() {
+    if (FailureCount() == 0) {
+        printf("OK\n");
+        return 0;
+    }
+    fprintf(stderr, "%d check(s) failed\n", FailureCount());
+    return 1;
+}
+
+} // namespace test
+
+#define CHECK(expression) test::Check((expression), #expression, __FILE__, __LINE__)
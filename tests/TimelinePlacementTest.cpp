@@ -0,0 +1,191 @@
+// Placement of timestamped packets on the mixer's timeline: jitter within
+// the tolerance is absorbed, gaps become silence, overlaps and time already
+// mixed are dropped, and an idle mixer moves the timeline instead of
+// recording the gap. Drift compensation and the limiter are off, so every
+// output sample is exactly one input sample and positions can be compared
+// frame by frame.
+
+#include "AudioMixer.h"
+#include "TestCheck.h"
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+const uint32_t kRate = 48000;
+const UINT64 kBaseTicks = 1000000000;  // QPC of packet 0, in 100 ns
+const INT64 kTicksPerMs = 10000;
+
+// Each source frame carries its own index, exactly representable in float;
+// 0 is silence
+float Encode(size_t index) { return (float)(index + 1) / (float)(1 << 20); }
+
+WAVEFORMATEX FloatFormat(WORD channels) {
+    WAVEFORMATEX format = {};
+    format.wFormatTag = WAVE_FORMAT_IEEE_FLOAT;
+    format.nChannels = channels;
+    format.nSamplesPerSec = kRate;
+    format.wBitsPerSample = 32;
+    format.nBlockAlign = (WORD)(channels * 4);
+    format.nAvgBytesPerSec = kRate * format.nBlockAlign;
+    return format;
+}
+
+// A mixer with drift compensation and limiter off, its output per channel
+// and where each output frame should come from
+struct Timeline {
+    AudioMixer mixer;
+    WAVEFORMATEX outputFormat;
+    WAVEFORMATEX sourceFormat = FloatFormat(1);
+    std::vector<float> mixed[2];     // Per output channel
+    std::vector<float> expected[2];
+
+    explicit Timeline(MixRouting routing)
+        : outputFormat(FloatFormat(routing == MixRouting::SplitStereo ? 2 : 1)) {
+        CHECK(mixer.Initialize(&outputFormat, routing));
+        mixer.SetDriftCompensation(false);
+        LimiterSettings bypass;
+        bypass.enabled = false;
+        mixer.SetLimiter(bypass);
+    }
+
+    // Packet `packet` of `frames` frames, stamped `offsetMs` past packet 0
+    void Feed(DWORD sourceId, size_t packet, size_t frames, double offsetMs, bool discontinuity = false) {
+        std::vector<float> samples(frames);
+        for (size_t i = 0; i < frames; i++) samples[i] = Encode(packet * frames + i);
+        const UINT64 timestamp = kBaseTicks + (UINT64)(INT64)(offsetMs * kTicksPerMs);
+        mixer.AddAudioData(sourceId, reinterpret_cast<const BYTE*>(samples.data()),
+                           (UINT32)(samples.size() * sizeof(float)), &sourceFormat, timestamp, discontinuity);
+    }
+
+    // Frames [first, first + count) of packet `packet` expected from output frame `at`
+    void Expect(UINT32 channel, size_t at, size_t packet, size_t frames, size_t first, size_t count) {
+        std::vector<float>& target = expected[channel];
+        if (target.size() < at + count) target.resize(at + count, 0.0f);
+        for (size_t i = 0; i < count; i++) target[at + i] = Encode(packet * frames + first + i);
+    }
+
+    // Mix everything ready, or exactly `frames`
+    void Mix(size_t frames = 0) {
+        std::vector<BYTE> block;
+        if (!(frames ? mixer.GetMixedAudio(block, frames) : mixer.GetMixedAudio(block))) return;
+        const float* samples = reinterpret_cast<const float*>(block.data());
+        const size_t channels = outputFormat.nChannels;
+        for (size_t i = 0; i < block.size() / sizeof(float); i++) mixed[i % channels].push_back(samples[i]);
+    }
+
+    // Mixed output matches the expectation frame for frame
+    void Verify(const char* name) {
+        for (UINT32 channel = 0; channel < outputFormat.nChannels; channel++) {
+            std::vector<float>& want = expected[channel];
+            want.resize(mixed[channel].size(), 0.0f);
+            size_t first = want.size();
+            for (size_t i = 0; i < want.size(); i++) {
+                if (mixed[channel][i] != want[i]) {
+                    first = i;
+                    break;
+                }
+            }
+            if (!CHECK(first == want.size())) {
+                fprintf(stderr, "  %s, channel %u: frame %zu is source frame %ld, expected %ld\n", name, channel,
+                        first, (long)(mixed[channel][first] * (1 << 20)) - 1, (long)(want[first] * (1 << 20)) - 1);
+            }
+        }
+    }
+};
+
+// One source with jitter, a gap, an early packet, a discontinuity and an idle restart
+void TestSingleSource() {
+    const size_t P = kRate / 100;  // 10 ms packets, 480 frames
+    const size_t msFrames = kRate / 1000;
+    Timeline t(MixRouting::Sum);
+
+    // Jitter of up to 3 ms (tolerance 6): packets stay back to back
+    const double jitterMs[] = { 0.0, 1.5, -2.0, 3.0, -3.0, 1.0, 2.5, -0.5, 0.0, -2.5 };
+    for (size_t k = 0; k < 10; k++) {
+        t.Feed(1, k, P, 10.0 * k + jitterMs[k]);
+        t.Expect(0, k * P, k, P, 0, P);
+    }
+
+    // Packets 10-19 lost without a discontinuity flag: packet 20 lands at its
+    // own timestamp, jitter included, with silence before it
+    size_t at = 20 * P + 1 * msFrames;
+    t.Feed(1, 20, P, 201.0);
+    t.Expect(0, at, 20, P, 0, P);
+    for (size_t k = 21; k < 25; k++) {
+        at += P;
+        t.Feed(1, k, P, 10.0 * k + (k % 2 ? 2.0 : -2.0));
+        t.Expect(0, at, k, P, 0, P);
+    }
+
+    // 8 ms earlier than its stream puts it: the overlapping 8 ms is dropped
+    at += P;
+    const size_t overlap = at - (25 * P - 7 * msFrames);
+    t.Feed(1, 25, P, 250.0 - 7.0);
+    t.Expect(0, at, 25, P, overlap, P - overlap);
+
+    // Back on its timestamp: the 7 ms it was behind becomes silence
+    at = 26 * P;
+    t.Feed(1, 26, P, 260.0);
+    t.Expect(0, at, 26, P, 0, P);
+
+    // A discontinuity moves the stream even within the tolerance
+    at = 27 * P + 2 * msFrames;
+    t.Feed(1, 27, P, 272.0, true);
+    t.Expect(0, at, 27, P, 0, P);
+    at += P;
+    t.Feed(1, 28, P, 280.0);
+    t.Expect(0, at, 28, P, 0, P);
+    at += P;
+
+    t.Mix();
+    CHECK(t.mixed[0].size() == at);
+
+    // Idle: with nothing buffered a second's gap is not recorded; the
+    // timeline moves and the packet follows straight on
+    t.Feed(1, 100, P, 1280.0);
+    t.Expect(0, at, 100, P, 0, P);
+    t.Feed(1, 101, P, 1290.0);
+    t.Expect(0, at + P, 101, P, 0, P);
+    t.Mix();
+    CHECK(t.mixed[0].size() == at + 2 * P);
+
+    t.Verify("single source");
+    CHECK(t.mixer.GetDroppedFrameCount() == 0);
+}
+
+// Two sources on one QPC clock, each on its own channel: the second starts
+// later and partly in time already mixed
+void TestTwoSources() {
+    const size_t P = kRate / 100;
+    Timeline t(MixRouting::SplitStereo);
+    t.mixer.SetSourceChannel(1, 0);
+    t.mixer.SetSourceChannel(2, 1);
+
+    for (size_t k = 0; k < 20; k++) {
+        t.Feed(1, k, P, 10.0 * k + (k % 3 ? 1.5 : 0.0));
+        t.Expect(0, k * P, k, P, 0, P);
+    }
+    t.Mix(2 * P);
+
+    // 20 ms packets from 10 ms on: the first one's first half is already mixed
+    for (size_t j = 0; j < 5; j++) {
+        t.Feed(2, j, 2 * P, 10.0 + 20.0 * j);
+    }
+    t.Expect(1, 2 * P, 0, 2 * P, P, P);
+    for (size_t j = 1; j < 5; j++) {
+        t.Expect(1, P + j * 2 * P, j, 2 * P, 0, 2 * P);
+    }
+
+    t.Mix();
+    CHECK(t.mixed[0].size() == 20 * P && t.mixed[1].size() == 20 * P);
+    t.Verify("two sources");
+}
+
+} // namespace
+
+int main() {
+    TestSingleSource();
+    TestTwoSources();
+    return test::TestResult();
+}
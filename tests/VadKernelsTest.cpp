@@ -0,0 +1,353 @@
+// VadKernels: every SIMD level this CPU runs must agree with the scalar
+// reference (zero crossings exactly, the sums to float rounding) over lengths
+// that leave vector tails, and VoiceActivityDetector must reach the same
+// features and decisions at every level. Then detection itself: formant
+// speech is found, alone and over noise; notification chimes, ringback, a
+// steady beep, background noise and silence are not.
+
+#include "VoiceActivityDetector.h"
+#include "TestCheck.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr uint32_t kRate = 48000;
+
+const size_t kLengths[] = { 0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 63, 64, 65, 127, 128, 129, 1023 };
+
+std::vector<float> RandomSamples(std::mt19937& rng, size_t count) {
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<float> samples(count);
+    for (size_t i = 0; i < count; i++) samples[i] = i % 11 == 5 ? (i % 2 ? 0.0f : -0.0f) : dist(rng);
+    return samples;
+}
+
+bool Near(float actual, float expected, float tolerance) {
+    return std::fabs(actual - expected) <= tolerance;
+}
+
+// The scalar polynomial against the true log2, over many octaves
+void TestFastLog2() {
+    float worst = 0.0f;
+    for (float x = 1e-12f; x < 1e12f; x *= 1.0137f) {
+        worst = (std::max)(worst, std::fabs(vad_detail::FastLog2(x) - std::log2(x)));
+    }
+    if (!CHECK(worst < 2e-4f)) fprintf(stderr, "  FastLog2 error %g\n", worst);
+}
+
+void TestLevel(const VadKernels& scalar, const VadKernels& simd) {
+    std::mt19937 rng(2501);
+    int mismatches = 0;
+    for (size_t length : kLengths) {
+        const std::vector<float> x = RandomSamples(rng, length);
+        const std::vector<float> y = RandomSamples(rng, length);
+
+        if (simd.zeroCrossings(x.data(), length) != scalar.zeroCrossings(x.data(), length) && mismatches++ < 5) {
+            fprintf(stderr, "  %zu samples: zero crossings differ\n", length);
+        }
+
+        // Each square is at most 1, so the sum is off by at most ~n ulps of n
+        const float squares = scalar.sumSquares(x.data(), length);
+        if (!Near(simd.sumSquares(x.data(), length), squares, 1e-6f * (float)(length + 1)) && mismatches++ < 5) {
+            fprintf(stderr, "  %zu samples: sum of squares differs\n", length);
+        }
+
+        // Accumulates into what the caller passes; the floor keeps log2 finite at zeros
+        float power = 1.5f, logs = -2.0f, simdPower = 1.5f, simdLogs = -2.0f;
+        scalar.spectrumStats(x.data(), y.data(), length, 1e-10f, &power, &logs);
+        simd.spectrumStats(x.data(), y.data(), length, 1e-10f, &simdPower, &simdLogs);
+        if ((!Near(simdPower, power, 2e-6f * (float)(length + 1)) ||
+             !Near(simdLogs, logs, 4e-5f * (float)(length + 1))) && mismatches++ < 5) {
+            fprintf(stderr, "  %zu bins: spectrum stats %g %g, scalar %g %g\n", length, simdPower, simdLogs, power, logs);
+        }
+    }
+
+    // Widths from the stereo and mono input rates: 6 and 12 at 48 kHz, 2 at 16 kHz
+    for (size_t width : { 1, 2, 3, 4, 5, 6, 8, 11, 12, 16, 24 }) {
+        for (size_t outCount : { 0, 1, 3, 17, 128 }) {
+            const std::vector<float> in = RandomSamples(rng, outCount * width);
+            std::vector<float> expected(outCount + 1, 42.0f), actual(outCount + 1, 42.0f);
+            scalar.boxDecimate(in.data(), outCount, width, expected.data());
+            simd.boxDecimate(in.data(), outCount, width, actual.data());
+            bool same = actual[outCount] == 42.0f;
+            for (size_t j = 0; j < outCount; j++) same = same && Near(actual[j], expected[j], 1e-6f);
+            if (!same && mismatches++ < 5) fprintf(stderr, "  width %zu, %zu out: decimation differs\n", width, outCount);
+        }
+    }
+    CHECK(mismatches == 0);
+}
+
+// ---- Synthetic signals at 48 kHz mono ----
+
+float DbToLinear(float db) { return std::pow(10.0f, db / 20.0f); }
+
+struct Interval {
+    double start;
+    double end;
+};
+
+// Two-pole resonator, one formant
+struct Resonator {
+    double b1, b2, a0, y1 = 0.0, y2 = 0.0;
+
+    Resonator(double frequency, double bandwidth) {
+        const double r = std::exp(-kPi * bandwidth / kRate);
+        b1 = 2.0 * r * std::cos(2.0 * kPi * frequency / kRate);
+        b2 = -r * r;
+        a0 = 1.0 - r;
+    }
+
+    double Run(double x) {
+        const double y = a0 * x + b1 * y1 + b2 * y2;
+        y2 = y1;
+        y1 = y;
+        return y;
+    }
+};
+
+// Phrases of voiced vowels (a glottal pulse train through three formants),
+// 1-2 s of silence between them; `labels` gets each phrase
+std::vector<float> Speech(double seconds, float levelDb, std::vector<Interval>& labels) {
+    struct Vowel {
+        double f1, f2, f3;
+    };
+    static const Vowel vowels[] = {
+        { 730, 1090, 2440 }, { 270, 2290, 3010 }, { 300, 870, 2240 },
+        { 530, 1840, 2480 }, { 570, 840, 2410 }, { 440, 1020, 2240 }
+    };
+    std::mt19937 rng(17);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::normal_distribution<double> gaussian;
+
+    std::vector<float> out((size_t)(seconds * kRate), 0.0f);
+    const float amplitude = DbToLinear(levelDb) * 4.0f;
+    size_t pos = kRate / 2;
+    int phrase = 0;
+    while (true) {
+        const size_t syllables = 4 + phrase % 5;
+        const size_t syllableLength = (size_t)(0.2 * kRate);
+        const size_t length = syllables * syllableLength;
+        if (pos + length >= out.size()) break;
+
+        const double baseF0 = phrase % 2 ? 120.0 : 210.0;
+        double phase = 0.0;
+        double glottal = 0.0;
+        for (size_t s = 0; s < syllables; s++) {
+            const Vowel& v = vowels[(phrase + s) % 6];
+            Resonator r1(v.f1, 80.0), r2(v.f2, 100.0), r3(v.f3, 150.0);
+            for (size_t i = 0; i < syllableLength; i++) {
+                const double t = (double)i / syllableLength;
+                phase += baseF0 * (1.0 - 0.1 * t + 0.01 * gaussian(rng)) / kRate;
+                double pulse = 0.0;
+                if (phase >= 1.0) {
+                    phase -= 1.0;
+                    pulse = 1.0;
+                }
+                glottal += 0.1 * (pulse * 10.0 - glottal);
+                const double source = glottal + 0.02 * gaussian(rng);
+                const double y = r1.Run(source) + 0.6 * r2.Run(source) + 0.3 * r3.Run(source);
+                const double env = (std::min)(1.0, (std::min)(t, 1.0 - t) * 8.0);
+                out[pos + s * syllableLength + i] = (float)(amplitude * y * env);
+            }
+        }
+        labels.push_back({ (double)pos / kRate, (double)(pos + length) / kRate });
+        pos += length + (size_t)((1.0 + unit(rng)) * kRate);
+        phrase++;
+    }
+    return out;
+}
+
+// Notification chimes: two decaying inharmonic notes every 3 s
+std::vector<float> Chimes(double seconds, float levelDb) {
+    std::vector<float> out((size_t)(seconds * kRate), 0.0f);
+    const float amplitude = DbToLinear(levelDb) * 1.4f;
+    const double notes[] = { 880.0, 1320.0, 660.0, 1568.0 };
+    int n = 0;
+    for (size_t pos = kRate / 4; pos < out.size(); pos += 3 * kRate) {
+        for (int note = 0; note < 2; note++, n++) {
+            const double f0 = notes[n % 4];
+            const size_t length = (size_t)(0.4 * kRate);
+            const size_t start = pos + note * length;
+            for (size_t i = 0; i < length && start + i < out.size(); i++) {
+                const double t = (double)i / kRate;
+                const double env = std::exp(-6.0 * t) * (std::min)(1.0, t * 500.0);
+                const double s = std::sin(2 * kPi * f0 * t) + 0.4 * std::sin(2 * kPi * f0 * 2.76 * t) +
+                                 0.2 * std::sin(2 * kPi * f0 * 5.4 * t);
+                out[start + i] += (float)(amplitude * env * s / 1.6);
+            }
+        }
+    }
+    return out;
+}
+
+// `frequency` Hz, `on` of every `period` seconds, over faint noise
+std::vector<float> Tone(double seconds, float levelDb, double frequency, double on, double period) {
+    std::mt19937 rng(5);
+    std::normal_distribution<double> gaussian;
+    std::vector<float> out((size_t)(seconds * kRate), 0.0f);
+    const float amplitude = DbToLinear(levelDb) * 1.414f;
+    const float noise = DbToLinear(levelDb - 45.0f);
+    for (size_t i = 0; i < out.size(); i++) {
+        const double t = (double)i / kRate;
+        if (std::fmod(t, period) < on) out[i] = (float)(amplitude * std::sin(2 * kPi * frequency * t));
+        out[i] += (float)(noise * gaussian(rng));
+    }
+    return out;
+}
+
+// White and low-passed noise whose level jumps by up to `rangeDb` every second
+std::vector<float> Noise(double seconds, float levelDb, float rangeDb) {
+    std::mt19937 rng(9);
+    std::normal_distribution<double> gaussian;
+    std::uniform_real_distribution<float> jump(-rangeDb / 2, rangeDb / 2);
+    std::vector<float> out((size_t)(seconds * kRate), 0.0f);
+    const float amplitude = DbToLinear(levelDb);
+    float level = 1.0f;
+    double low = 0.0;
+    for (size_t i = 0; i < out.size(); i++) {
+        if (i % kRate == 0) level = DbToLinear(jump(rng));
+        low += 0.2 * (gaussian(rng) - low);
+        out[i] = (float)(amplitude * level * (low + 0.2 * gaussian(rng)));
+    }
+    return out;
+}
+
+// 48 kHz stereo float in 10 ms packets, like a capture callback
+std::vector<VoiceActivityDetector::Features> Detect(const std::vector<float>& mono, SimdLevel level) {
+    SampleFormat format;
+    format.type = SampleType::Float32;
+    format.sampleRate = kRate;
+    format.channels = 2;
+    format.channelMask = DefaultChannelMask(2);
+    format.blockAlign = 8;
+    std::vector<float> stereo(mono.size() * 2);
+    for (size_t i = 0; i < mono.size(); i++) stereo[2 * i] = stereo[2 * i + 1] = mono[i];
+
+    VoiceActivityDetector vad;
+    vad.Initialize(VadSettings(), format);
+    vad.SetSimdLevel(level);
+    std::vector<VoiceActivityDetector::Features> features;
+    const size_t packet = kRate / 100;
+    for (size_t offset = 0; offset < mono.size(); offset += packet) {
+        vad.Process(stereo.data() + offset * 2, (std::min)(packet, mono.size() - offset), &features);
+    }
+    return features;
+}
+
+double FrameSeconds() {
+    return VoiceActivityDetector::kFrameSize / ((double)kRate / (kRate / VoiceActivityDetector::kTargetRate));
+}
+
+void TestDetectorLevel(SimdLevel level) {
+    std::vector<Interval> labels;
+    std::vector<float> speech = Speech(20.0, -24.0f, labels);
+    const std::vector<float> chimes = Chimes(20.0, -30.0f);
+    for (size_t i = 0; i < speech.size(); i++) speech[i] += chimes[i];
+
+    const std::vector<VoiceActivityDetector::Features> expected = Detect(speech, SimdLevel::Scalar);
+    const std::vector<VoiceActivityDetector::Features> actual = Detect(speech, level);
+    if (!CHECK(actual.size() == expected.size() && !expected.empty())) return;
+
+    float energyError = 0.0f, flatnessError = 0.0f;
+    size_t zcrs = 0, decisions = 0;
+    for (size_t i = 0; i < expected.size(); i++) {
+        energyError = (std::max)(energyError, std::fabs(actual[i].energyDb - expected[i].energyDb));
+        flatnessError = (std::max)(flatnessError, std::fabs(actual[i].flatness - expected[i].flatness) /
+                                                  (std::max)(expected[i].flatness, 1e-6f));
+        if (actual[i].zcr != expected[i].zcr) zcrs++;
+        if (actual[i].speech != expected[i].speech) decisions++;
+    }
+    if (!CHECK(energyError < 1e-3f && flatnessError < 1e-3f && zcrs == 0 && decisions == 0)) {
+        fprintf(stderr, "  %s: energy %g dB, flatness %g relative, %zu zcr and %zu decisions differ\n",
+                SimdLevelName(level), energyError, flatnessError, zcrs, decisions);
+    }
+}
+
+// Speech ratio of each 2 s window, as MonitorThread compares against SpeechRatioThreshold
+std::vector<float> WindowRatios(const std::vector<VoiceActivityDetector::Features>& features) {
+    const size_t perWindow = (size_t)std::lround(2.0 / FrameSeconds());
+    std::vector<float> ratios;
+    for (size_t first = 0; first + perWindow <= features.size(); first += perWindow) {
+        size_t speech = 0;
+        for (size_t i = first; i < first + perWindow; i++) speech += features[i].speech ? 1 : 0;
+        ratios.push_back((float)speech / (float)perWindow);
+    }
+    return ratios;
+}
+
+// Phrases at `levelDb` over steady noise at `noiseDb` (none if 0)
+void TestSpeech(float levelDb, float noiseDb) {
+    std::vector<Interval> labels;
+    std::vector<float> speech = Speech(30.0, levelDb, labels);
+    if (noiseDb < 0.0f) {
+        const std::vector<float> noise = Noise(30.0, noiseDb, 0.0f);
+        for (size_t i = 0; i < speech.size(); i++) speech[i] += noise[i];
+    }
+    const std::vector<VoiceActivityDetector::Features> features = Detect(speech, DetectSimdLevel());
+
+    // Frames inside a phrase, and frames well clear of one (past the hangover)
+    const double frameSeconds = FrameSeconds();
+    size_t inside = 0, found = 0, outside = 0, flagged = 0;
+    for (size_t i = 0; i < features.size(); i++) {
+        const double t = (i + 0.5) * frameSeconds;
+        bool inPhrase = false, nearPhrase = false;
+        for (const Interval& label : labels) {
+            inPhrase = inPhrase || (t >= label.start && t < label.end);
+            nearPhrase = nearPhrase || (t >= label.start - 0.1 && t < label.end + 0.4);
+        }
+        if (inPhrase) {
+            inside++;
+            found += features[i].speech ? 1 : 0;
+        } else if (!nearPhrase) {
+            outside++;
+            flagged += features[i].speech ? 1 : 0;
+        }
+    }
+    if (!CHECK(inside > 0 && outside > 0 && found >= inside * 8 / 10 && flagged == 0)) {
+        fprintf(stderr, "  speech at %.0f dBFS, noise %.0f: %zu of %zu phrase frames found, %zu of %zu pause "
+                "frames flagged\n", levelDb, noiseDb, found, inside, flagged, outside);
+    }
+}
+
+void TestNotSpeech(const char* name, const std::vector<float>& mono) {
+    const std::vector<VoiceActivityDetector::Features> features = Detect(mono, DetectSimdLevel());
+    size_t speech = 0;
+    for (const VoiceActivityDetector::Features& f : features) speech += f.speech ? 1 : 0;
+    float worst = 0.0f;
+    for (float ratio : WindowRatios(features)) worst = (std::max)(worst, ratio);
+    if (!CHECK(!features.empty() && speech * 100 <= features.size() && worst < 0.05f)) {
+        fprintf(stderr, "  %s: %zu of %zu frames speech, worst window %.2f\n", name, speech, features.size(), worst);
+    }
+}
+
+} // namespace
+
+int main() {
+    TestFastLog2();
+
+    const VadKernels scalar = GetVadKernels(SimdLevel::Scalar);
+    const SimdLevel best = DetectSimdLevel();
+    for (SimdLevel level : { SimdLevel::SSE2, SimdLevel::AVX2 }) {
+        if (level > best) break;
+        const VadKernels simd = GetVadKernels(level);
+        if (simd.level != level) continue;   // Not compiled in on this target
+        printf("%s\n", SimdLevelName(level));
+        TestLevel(scalar, simd);
+        TestDetectorLevel(level);
+    }
+
+    TestSpeech(-24.0f, 0.0f);
+    TestSpeech(-45.0f, 0.0f);
+    TestSpeech(-24.0f, -40.0f);
+    TestNotSpeech("chimes", Chimes(30.0, -18.0f));
+    TestNotSpeech("ringback", Tone(30.0, -20.0f, 425.0, 1.0, 5.0));
+    TestNotSpeech("beep", Tone(30.0, -12.0f, 1000.0, 30.0, 30.0));
+    TestNotSpeech("noise", Noise(30.0, -40.0f, 20.0f));
+    TestNotSpeech("silence", std::vector<float>(30 * kRate, 0.0f));
+    return test::TestResult();
+}
@@ -0,0 +1,3 @@
+#pragma once
+
+// See windows.h in this directory
@@ -0,0 +1,10 @@
+#pragma once
+
+// See windows.h in this directory
+
+#include "mmreg.h"
+
+static const GUID KSDATAFORMAT_SUBTYPE_PCM =
+    { 0x00000001, 0x0000, 0x0010, { 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71 } };
+static const GUID KSDATAFORMAT_SUBTYPE_IEEE_FLOAT =
+    { 0x00000003, 0x0000, 0x0010, { 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71 } };
@@ -0,0 +1,26 @@
+#pragma once
+
+// Stand-in for the few Windows SDK types the platform-neutral parts of
+// AudioCapture use, so their tests build elsewhere. Not a general shim:
+// add only what a tested header actually needs.
+
+#include <cstdint>
+#include <cstring>
+
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef uint32_t UINT32;
+typedef uint64_t UINT64;
+typedef int64_t INT64;
+typedef int64_t LONGLONG;
+
+struct GUID {
+    uint32_t Data1;
+    uint16_t Data2;
+    uint16_t Data3;
+    uint8_t Data4[8];
+};
+
+inline bool operator==(const GUID& a, const GUID& b) { return memcmp(&a, &b, sizeof(GUID)) == 0; }
+inline bool operator!=(const GUID& a, const GUID& b) { return !(a == b); }
@@ -0,0 +1,376 @@
+// CallReplay: run call-detection traces through CallDetector offline.
+//
+//   CallReplay [overrides] <trace>...
+//       Replay traces (recorded with DetectorTrace=true, or synthesized)
+//       and report decisions. With ground-truth labels it also reports
+//       false starts, truncations, missed calls and decision latency.
+//
+//   CallReplay --synthesize <calls> <out.trace> [--seed N] [--no-speech]
+//       Write a labelled trace of <calls> synthetic calls on four processes
+//       (two Telegram), with notification sounds, media playback, long
+//       pauses and session flaps in between. Speech ratios are included as
+//       the voice-activity detector would report them, unless --no-speech.
+//
+// Overrides replace what the trace recorded:
+//   --start-threshold N   --silence-threshold N   --inactive-threshold N
+//   --telegram-silence-cycles N   --peak-history N
+//   --min-seconds N   --max-seconds N   --peak-threshold F
+//   --speech-threshold F
+//
+// Platform-neutral; built with -DBUILD_CALL_REPLAY=ON.
+
+#include "CallDetector.h"
+#include "CallTrace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Overrides {
+    std::map<std::string, double> values;
+
+    void Apply(CallDetector::Settings& settings) const {
+        auto get = [this](const char* name, auto& field) {
+            auto it = values.find(name);
+            if (it != values.end()) field = static_cast<std::remove_reference_t<decltype(field)>>(it->second);
+        };
+        get("--start-threshold", settings.startThreshold);
+        get("--silence-threshold", settings.silenceThreshold);
+        get("--inactive-threshold", settings.inactiveThreshold);
+        get("--telegram-silence-cycles", settings.telegramSilenceCycles);
+        get("--peak-history", settings.peakHistorySize);
+        get("--min-seconds", settings.minRecordingSeconds);
+        get("--max-seconds", settings.maxRecordingSeconds);
+        get("--peak-threshold", settings.peakThreshold);
+        get("--speech-threshold", settings.speechRatioThreshold);
+    }
+};
+
+struct Stats {
+    uint64_t cycles = 0;
+    uint64_t observations = 0;
+    uint64_t starts = 0;
+    uint64_t stops = 0;
+    bool labelled = false;
+    uint64_t calls = 0;
+    uint64_t detected = 0;
+    uint64_t missed = 0;
+    uint64_t falseStarts = 0;
+    uint64_t truncations = 0;
+    std::vector<double> startLatency;   // Seconds from call start to Start
+    std::vector<double> stopLatency;    // Seconds from call end to Stop
+    std::vector<double> recordingSeconds;
+};
+
+// What the labels say about one process
+struct Truth {
+    bool known = false;
+    bool inCall = false;
+    double since = 0.0;           // Time of the last label
+    bool startedInCall = false;   // A Start came during the current (or last) call
+    bool awaitingStop = false;    // Call ended while recording
+    double recordingSince = 0.0;
+};
+
+double Percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    const size_t index = (size_t)(p * (values.size() - 1) + 0.5);
+    return values[index];
+}
+
+double Mean(const std::vector<double>& values) {
+    if (values.empty()) return 0.0;
+    double sum = 0.0;
+    for (double v : values) sum += v;
+    return sum / values.size();
+}
+
+bool Replay(const char* path, const Overrides& overrides, Stats& stats) {
+    CallTrace::Reader reader;
+    if (!reader.Open(path)) {
+        if (!reader.IsOpen()) {
+            fprintf(stderr, "%s: cannot open\n", path);
+        } else if (reader.GetVersion() > CallTrace::kVersion) {
+            fprintf(stderr, "%s: trace version %u, this build reads up to %u\n", path, reader.GetVersion(),
+                    CallTrace::kVersion);
+        } else {
+            fprintf(stderr, "%s: not a call trace\n", path);
+        }
+        return false;
+    }
+
+    CallDetector::Settings settings;
+    overrides.Apply(settings);
+    CallDetector detector(settings);
+    std::map<uint32_t, Truth> truth;
+
+    CallTrace::Record record;
+    double now = 0.0;
+    while (reader.Next(record)) {
+        switch (record.type) {
+            case CallTrace::Record::Settings:
+                settings = record.settings;
+                overrides.Apply(settings);
+                detector.SetSettings(settings);
+                break;
+
+            case CallTrace::Record::Control:
+                switch (record.action) {
+                    case CallTrace::Action::Abort: detector.Abort(record.pid); break;
+                    case CallTrace::Action::MarkRecording: detector.MarkRecording(record.pid, now); break;
+                    case CallTrace::Action::Remove: detector.Remove(record.pid); truth.erase(record.pid); break;
+                    case CallTrace::Action::Clear: detector.Clear(); break;
+                }
+                break;
+
+            case CallTrace::Record::Label: {
+                stats.labelled = true;
+                Truth& t = truth[record.pid];
+                if (record.inCall && !(t.known && t.inCall)) {
+                    stats.calls++;
+                    t.startedInCall = false;
+                    t.awaitingStop = false;
+                } else if (!record.inCall && t.known && t.inCall) {
+                    if (!t.startedInCall) stats.missed++;
+                    t.awaitingStop = detector.IsRecording(record.pid);
+                }
+                t.known = true;
+                t.inCall = record.inCall;
+                t.since = now;
+                break;
+            }
+
+            case CallTrace::Record::Cycle:
+                now = record.timeMs / 1000.0;
+                stats.cycles++;
+                for (const CallDetector::Observation& observation : record.observations) {
+                    stats.observations++;
+                    const CallDetector::Step step = detector.Observe(observation, now);
+                    if (step.decision == CallDetector::Decision::None) continue;
+
+                    Truth& t = truth[observation.pid];
+                    if (step.decision == CallDetector::Decision::Start) {
+                        stats.starts++;
+                        t.recordingSince = now;
+                        if (!t.known) continue;
+                        if (!t.inCall) {
+                            stats.falseStarts++;
+                        } else if (!t.startedInCall) {
+                            t.startedInCall = true;
+                            stats.detected++;
+                            stats.startLatency.push_back(now - t.since);
+                        }
+                    } else {
+                        stats.stops++;
+                        stats.recordingSeconds.push_back(now - t.recordingSince);
+                        if (!t.known) continue;
+                        if (t.inCall) {
+                            stats.truncations++;
+                        } else if (t.awaitingStop) {
+                            t.awaitingStop = false;
+                            stats.stopLatency.push_back(now - t.since);
+                        }
+                    }
+                }
+                break;
+        }
+    }
+    return true;
+}
+
+// ============================================================
+// Synthetic traces
+// ============================================================
+
+class Synthesizer {
+public:
+    Synthesizer(uint32_t seed, bool speech) : m_rng(seed), m_speech(speech) {}
+
+    bool Write(const char* path, int calls) {
+        CallTrace::Writer writer;
+        if (!writer.Open(path)) return false;
+        writer.WriteSettings(CallDetector::Settings());
+
+        const uint32_t pids[] = { 4120, 5208, 6632, 9004 };
+        const bool telegram[] = { false, false, true, true };
+        for (int i = 0; i < 4; i++) {
+            Process process;
+            process.pid = pids[i];
+            process.telegram = telegram[i];
+            process.callsLeft = calls / 4 + (i < calls % 4 ? 1 : 0);
+            process.idleCycles = Uniform(5, 60);
+            m_processes.push_back(process);
+        }
+
+        std::vector<CallDetector::Observation> observations;
+        for (uint32_t cycle = 0; ; cycle++) {
+            observations.clear();
+            bool running = false;
+            for (Process& process : m_processes) {
+                if (process.callsLeft == 0 && !process.inCall && process.idleCycles == 0) continue;
+                running = true;
+                observations.push_back(Step(process, writer));
+                if (!m_speech) observations.back().speechRatio = -1.0f;
+            }
+            if (!running) break;
+            writer.WriteCycle(cycle * 2000, observations);
+        }
+        return true;
+    }
+
+private:
+    struct Process {
+        uint32_t pid = 0;
+        bool telegram = false;
+        int callsLeft = 0;
+        bool inCall = false;
+        int idleCycles = 0;       // Until the next call (or the end)
+        int callCycles = 0;       // Until this call ends
+        int burstCycles = 0;      // Notification or media playing while idle
+        float burstPeak = 0.0f;
+        float burstSpeech = 0.0f; // Media with people talking in it
+        int pauseCycles = 0;      // Silence in the conversation
+        int hangupCycles = 0;     // Session still Active / window still open after the call
+    };
+
+    int Uniform(int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(m_rng); }
+    float Real(float lo, float hi) { return std::uniform_real_distribution<float>(lo, hi)(m_rng); }
+    bool Chance(double p) { return std::bernoulli_distribution(p)(m_rng); }
+
+    CallDetector::Observation Step(Process& p, CallTrace::Writer& writer) {
+        CallDetector::Observation o = { p.pid, Real(0.0f, 0.004f), false, p.telegram, false, Real(0.0f, 0.02f) };
+
+        if (!p.inCall) {
+            if (p.hangupCycles > 0) {
+                // Session / call window lingering after the hang-up
+                p.hangupCycles--;
+                o.sessionActive = true;
+                o.callWindow = p.telegram && Chance(0.5);
+            } else if (p.burstCycles > 0) {
+                p.burstCycles--;
+                o.peak = p.burstPeak * Real(0.5f, 1.0f);
+                o.sessionActive = true;
+                o.speechRatio = p.burstSpeech * Real(0.5f, 1.0f);
+            } else if (Chance(0.03)) {
+                // Notification (1-2 cycles) or media playback (3-12 cycles,
+                // a third of it speech)
+                const bool media = Chance(0.3);
+                p.burstCycles = media ? Uniform(3, 12) : Uniform(1, 2);
+                p.burstPeak = Real(0.05f, 0.5f);
+                p.burstSpeech = media && Chance(0.33) ? Real(0.3f, 0.8f) : Real(0.0f, 0.1f);
+            }
+
+            if (p.idleCycles > 0 && --p.idleCycles == 0 && p.callsLeft > 0) {
+                p.callsLeft--;
+                p.inCall = true;
+                p.callCycles = Chance(0.2) ? Uniform(5, 30) : Uniform(30, 600);
+                p.burstCycles = 0;
+                writer.WriteLabel(p.pid, true);
+            }
+            return o;
+        }
+
+        // In a call: session Active, Telegram call window open (it rarely
+        // flickers), speech with pauses; some pauses are long
+        o.sessionActive = !Chance(0.01);
+        o.callWindow = p.telegram && !Chance(0.01);
+        if (p.pauseCycles > 0) {
+            p.pauseCycles--;
+        } else if (Chance(0.1)) {
+            p.pauseCycles = Chance(0.9) ? Uniform(1, 4) : Uniform(8, 25);
+        } else {
+            o.peak = Real(0.02f, 0.6f);
+            o.speechRatio = Real(0.3f, 0.9f);
+        }
+
+        if (--p.callCycles == 0) {
+            p.inCall = false;
+            p.pauseCycles = 0;
+            p.hangupCycles = Chance(0.3) ? Uniform(1, 3) : 0;
+            // After the last call, idle long enough for the Stop to be seen
+            p.idleCycles = p.callsLeft > 0 ? Uniform(10, 150) : 200;
+            writer.WriteLabel(p.pid, false);
+        }
+        return o;
+    }
+
+    std::mt19937 m_rng;
+    bool m_speech;
+    std::vector<Process> m_processes;
+};
+
+int Usage() {
+    fprintf(stderr,
+        "usage: CallReplay [overrides] <trace>...\n"
+        "       CallReplay --synthesize <calls> <out.trace> [--seed N] [--no-speech]\n"
+        "overrides: --start-threshold N --silence-threshold N --inactive-threshold N\n"
+        "           --telegram-silence-cycles N --peak-history N --min-seconds N\n"
+        "           --max-seconds N --peak-threshold F --speech-threshold F\n");
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc >= 4 && strcmp(argv[1], "--synthesize") == 0) {
+        const int calls = atoi(argv[2]);
+        uint32_t seed = 1;
+        bool speech = true;
+        for (int i = 4; i < argc; i++) {
+            if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+            else if (strcmp(argv[i], "--no-speech") == 0) speech = false;
+            else return Usage();
+        }
+        if (calls <= 0) return Usage();
+        if (!Synthesizer(seed, speech).Write(argv[3], calls)) {
+            fprintf(stderr, "%s: cannot write\n", argv[3]);
+            return 1;
+        }
+        return 0;
+    }
+
+    Overrides overrides;
+    std::vector<const char*> traces;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) == 0) {
+            if (i + 1 >= argc) return Usage();
+            overrides.values[argv[i]] = atof(argv[i + 1]);
+            i++;
+        } else {
+            traces.push_back(argv[i]);
+        }
+    }
+    if (traces.empty()) return Usage();
+
+    Stats stats;
+    const auto begin = std::chrono::steady_clock::now();
+    for (const char* path : traces) {
+        if (!Replay(path, overrides, stats)) return 1;
+    }
+    const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    printf("cycles %llu, observations %llu, replayed in %.3f s (%.1f M observations/s)\n",
+        (unsigned long long)stats.cycles, (unsigned long long)stats.observations, wall,
+        wall > 0 ? stats.observations / wall / 1e6 : 0.0);
+    printf("starts %llu, stops %llu, recording length mean %.0f s\n",
+        (unsigned long long)stats.starts, (unsigned long long)stats.stops, Mean(stats.recordingSeconds));
+    if (stats.labelled) {
+        printf("calls %llu: detected %llu, missed %llu\n",
+            (unsigned long long)stats.calls, (unsigned long long)stats.detected, (unsigned long long)stats.missed);
+        printf("false starts %llu, truncations %llu\n",
+            (unsigned long long)stats.falseStarts, (unsigned long long)stats.truncations);
+        printf("start latency mean %.1f s, p50 %.1f s, p95 %.1f s\n",
+            Mean(stats.startLatency), Percentile(stats.startLatency, 0.5), Percentile(stats.startLatency, 0.95));
+        printf("stop latency  mean %.1f s, p50 %.1f s, p95 %.1f s\n",
+            Mean(stats.stopLatency), Percentile(stats.stopLatency, 0.5), Percentile(stats.stopLatency, 0.95));
+    }
+    return 0;
+}
@@ -0,0 +1,146 @@
+// DeviceCacheBench: poll-cycle cost of listing the render devices, with the
+// DeviceCache kept current by notifications against listing every time.
+//
+//   DeviceCacheBench [--devices N] [--calls N] [--list-us N] [--activate-us N]
+//                    [--change-every N] [--cycles N]
+//       N render devices (default 3), asked for N times per poll cycle
+//       (default 2: the session scan and the session tracker). Listing the
+//       devices busy-waits --list-us (default 150) and activating each
+//       one's session manager --activate-us (default 300), standing in for
+//       IMMDeviceEnumerator::EnumAudioEndpoints and IMMDevice::Activate.
+//       "relist" is the cache without notifications, which lists and
+//       activates on every call as the monitor did before the cache;
+//       "cached" gets a device notification every --change-every cycles
+//       (default 100). Prints the device part of each poll cycle over
+//       --cycles cycles (default 2000): mean and percentiles, plus hits and
+//       misses.
+//
+// Platform-neutral; built with -DBUILD_BENCHMARKS=ON.
+
+#include "DeviceCache.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Device {
+    std::wstring id;
+    bool activated;
+};
+
+void BusyWait(unsigned micros) {
+    const Clock::time_point end = Clock::now() + std::chrono::microseconds(micros);
+    while (Clock::now() < end) {
+    }
+}
+
+class MockSource : public DeviceSource<Device> {
+public:
+    MockSource(unsigned devices, unsigned listMicros, unsigned activateMicros, bool notifications,
+               std::function<void(DeviceEvent)>* onEvent)
+        : m_devices(devices), m_listMicros(listMicros), m_activateMicros(activateMicros),
+          m_notifications(notifications), m_onEvent(onEvent) {}
+
+    bool Open() override { return true; }
+    bool Subscribe(std::function<void(DeviceEvent)> onEvent) override {
+        if (!m_notifications) return false;
+        *m_onEvent = std::move(onEvent);
+        return true;
+    }
+    void Close() override { *m_onEvent = nullptr; }
+    bool List(std::vector<Device>& devices) override {
+        BusyWait(m_listMicros);
+        for (unsigned d = 0; d < m_devices; d++) {
+            BusyWait(m_activateMicros);
+            devices.push_back({ L"device " + std::to_wstring(d), true });
+        }
+        return true;
+    }
+    bool IsActivated(const Device& device) const override { return device.activated; }
+
+private:
+    unsigned m_devices;
+    unsigned m_listMicros;
+    unsigned m_activateMicros;
+    bool m_notifications;
+    std::function<void(DeviceEvent)>* m_onEvent;
+};
+
+struct Options {
+    unsigned devices = 3;
+    unsigned calls = 2;
+    unsigned listMicros = 150;
+    unsigned activateMicros = 300;
+    unsigned changeEvery = 100;
+    unsigned cycles = 2000;
+};
+
+double Percentile(std::vector<double> values, double p) {
+    const size_t index = (std::min)(values.size() - 1, (size_t)(p * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+void Run(const char* name, const Options& options, bool notifications) {
+    std::function<void(DeviceEvent)> onEvent;
+    DeviceCache<Device> cache(std::make_unique<MockSource>(options.devices, options.listMicros,
+                                                           options.activateMicros, notifications, &onEvent));
+    std::vector<double> cycleMicros;
+    cycleMicros.reserve(options.cycles);
+    size_t seen = 0;
+    for (unsigned cycle = 0; cycle < options.cycles; cycle++) {
+        if (cycle > 0 && options.changeEvery > 0 && cycle % options.changeEvery == 0 && onEvent) {
+            onEvent(DeviceEvent::StateChanged);
+        }
+        const Clock::time_point begin = Clock::now();
+        for (unsigned call = 0; call < options.calls; call++) seen += cache.GetDevices().size();
+        cycleMicros.push_back(std::chrono::duration<double, std::micro>(Clock::now() - begin).count());
+    }
+
+    double total = 0.0;
+    for (double micros : cycleMicros) total += micros;
+    const DeviceCacheStats stats = cache.GetStats();
+    printf("%-7s  %9.1f  %9.1f  %9.1f  %9.1f  %9llu  %9llu\n", name, total / cycleMicros.size(),
+           Percentile(cycleMicros, 0.5), Percentile(cycleMicros, 0.99), Percentile(cycleMicros, 1.0),
+           (unsigned long long)stats.hits, (unsigned long long)stats.misses);
+    if (seen != (size_t)options.cycles * options.calls * options.devices) printf("  devices went missing\n");
+}
+
+int Usage() {
+    fprintf(stderr, "usage: DeviceCacheBench [--devices N] [--calls N] [--list-us N] [--activate-us N] "
+                    "[--change-every N] [--cycles N]\n");
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        unsigned* target = nullptr;
+        if (strcmp(argv[i], "--devices") == 0) target = &options.devices;
+        else if (strcmp(argv[i], "--calls") == 0) target = &options.calls;
+        else if (strcmp(argv[i], "--list-us") == 0) target = &options.listMicros;
+        else if (strcmp(argv[i], "--activate-us") == 0) target = &options.activateMicros;
+        else if (strcmp(argv[i], "--change-every") == 0) target = &options.changeEvery;
+        else if (strcmp(argv[i], "--cycles") == 0) target = &options.cycles;
+        if (!target || i + 1 >= argc) return Usage();
+        *target = (unsigned)strtoul(argv[++i], nullptr, 10);
+    }
+    if (options.devices == 0 || options.calls == 0 || options.cycles == 0) return Usage();
+
+    printf("%u devices, %u calls per cycle, list %u us, activate %u us, a device change every %u cycles\n",
+           options.devices, options.calls, options.listMicros, options.activateMicros, options.changeEvery);
+    printf("%-7s  %9s  %9s  %9s  %9s  %9s  %9s\n", "mode", "mean us", "p50 us", "p99 us", "max us", "hits",
+           "misses");
+    Run("relist", options, false);
+    Run("cached", options, true);
+    return 0;
+}
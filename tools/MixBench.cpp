@@ -0,0 +1,115 @@
+// MixBench: throughput of the MixKernels variants.
+//
+//   MixBench [--frames N]
+//       GB/s of source audio mixed on one core for 2, 4, 8 and 16 sources
+//       of 48 kHz stereo float, for every SIMD level this CPU runs, the way
+//       AudioMixer::MixSamples runs them: per 4096-sample accumulator block,
+//       load the first source, add the rest, saturate into the output. One
+//       call mixes N frames (default 960, one 20 ms mixer block). The int16
+//       column adds the output conversion (SampleFormat, at its own best
+//       level), the float32 column stores straight into the output.
+//
+// Platform-neutral; built with -DBUILD_BENCHMARKS=ON.
+
+#include "MixKernels.h"
+#include "SampleFormat.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr unsigned kChannels = 2;
+constexpr size_t kBlockSamples = 4096;   // AudioMixer::kMixBlockSamples
+
+// Calls `run` until a second has passed; calls per second
+template <typename Run>
+double Measure(Run run) {
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point begin = Clock::now();
+    double wall = 0.0;
+    uint64_t calls = 0;
+    do {
+        for (int i = 0; i < 100; i++) run();
+        calls += 100;
+        wall = std::chrono::duration<double>(Clock::now() - begin).count();
+    } while (wall < 1.0);
+    return (double)calls / wall;
+}
+
+void Mix(const MixKernels& kernels, const std::vector<std::vector<float>>& sources, size_t sourceCount,
+         size_t sampleCount, float* acc, SampleType outputType, void* dest) {
+    for (size_t offset = 0; offset < sampleCount; offset += kBlockSamples) {
+        const size_t count = (std::min)(sampleCount - offset, kBlockSamples);
+        kernels.loadFloat(acc, sources[0].data() + offset, count);
+        for (size_t s = 1; s < sourceCount; s++) kernels.addFloat(acc, sources[s].data() + offset, count);
+        if (outputType == SampleType::Float32) {
+            kernels.storeFloat(static_cast<float*>(dest) + offset, acc, count);
+        } else {
+            kernels.storeFloat(acc, acc, count);
+            ConvertFromFloat(acc, count, outputType, static_cast<int16_t*>(dest) + offset);
+        }
+    }
+}
+
+int Bench(size_t frames) {
+    const size_t sampleCount = frames * kChannels;
+    std::mt19937 rng(6);
+    std::uniform_real_distribution<float> dist(-0.5f, 0.5f);
+    std::vector<std::vector<float>> sources(16, std::vector<float>(sampleCount));
+    for (auto& source : sources) {
+        for (float& s : source) s = dist(rng);
+    }
+    alignas(32) static float acc[kBlockSamples];
+    std::vector<float> outFloat(sampleCount);
+    std::vector<int16_t> outInt16(sampleCount);
+
+    printf("48 kHz stereo float sources, %zu frames per call; GB/s of source audio on one core\n", frames);
+    printf("%-6s  %7s  %10s  %10s  %12s\n", "level", "sources", "float32", "int16", "x realtime");
+
+    const SimdLevel best = DetectSimdLevel();
+    for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2 }) {
+        if (level > best) break;
+        const MixKernels kernels = GetMixKernels(level);
+        if (kernels.level != level) continue;
+
+        for (size_t sourceCount : { 2, 4, 8, 16 }) {
+            const double bytesPerCall = (double)sourceCount * sampleCount * sizeof(float);
+            const double floatCalls = Measure([&] {
+                Mix(kernels, sources, sourceCount, sampleCount, acc, SampleType::Float32, outFloat.data());
+            });
+            const double int16Calls = Measure([&] {
+                Mix(kernels, sources, sourceCount, sampleCount, acc, SampleType::Int16, outInt16.data());
+            });
+            // Seconds of audio mixed per second, at the float32 rate
+            const double realtime = floatCalls * frames / 48000.0;
+            printf("%-6s  %7zu  %10.2f  %10.2f  %12.0f\n", SimdLevelName(level), sourceCount,
+                   floatCalls * bytesPerCall / 1e9, int16Calls * bytesPerCall / 1e9, realtime);
+        }
+    }
+    return outFloat[frames % sampleCount] == 12345.0f ? 1 : 0;
+}
+
+int Usage() {
+    fprintf(stderr, "usage: MixBench [--frames N]\n");
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t frames = 960;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = (size_t)strtoul(argv[++i], nullptr, 10);
+        } else {
+            return Usage();
+        }
+    }
+    if (frames == 0) return Usage();
+    return Bench(frames);
+}
@@ -0,0 +1,199 @@
+// MixBufferBench: AudioMixer's per-source AudioRingBuffer against the
+// std::vector + erase() buffering it replaced.
+//
+//   MixBufferBench [--sources N] [--seconds N] [--backlog S] [--stall S]
+//       Feeds 2, 4, 8, 16 and 32 sources (or only N) with 10 ms packets of
+//       48 kHz stereo float and mixes a 20 ms block every 20 ms, both under
+//       the overflow policy AudioMixer uses (past 5 s buffered, drop down to
+//       the newest 2 s). One source runs S seconds ahead (default 3, a
+//       source held back on the timeline), and from the second minute on
+//       the mixer stalls once a minute for --stall seconds (default 6), so
+//       every source overflows.
+//       Simulates --seconds of audio (default 300) and prints how many times
+//       faster than real time each buffering runs, and the time each call
+//       holds the mixer lock: percentiles over the mixes, and the worst
+//       AddAudioData.
+//
+// Only the storage differs; both mix with the same plain float loop.
+// Platform-neutral; built with -DBUILD_BENCHMARKS=ON.
+
+#include "AudioRingBuffer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint32_t kRate = 48000;
+constexpr uint32_t kChannels = 2;
+constexpr uint32_t kFrameBytes = kChannels * sizeof(float);
+constexpr uint32_t kPacketFrames = kRate / 100;     // 10 ms
+constexpr uint32_t kBlockFrames = kRate / 50;       // 20 ms
+constexpr size_t kMaxFrames = (size_t)kRate * 5;
+constexpr size_t kKeepFrames = (size_t)kRate * 2;
+
+// The old AudioBuffer: a growing vector and a read position, compacted with
+// erase() on overflow and once more than a second has been read
+class VectorBuffer {
+public:
+    void Write(const uint8_t* data, size_t frames) {
+        const size_t bytes = frames * kFrameBytes;
+        if (m_data.size() - m_readPosition > kMaxFrames * kFrameBytes) {
+            if (m_readPosition > 0) {
+                m_data.erase(m_data.begin(), m_data.begin() + m_readPosition);
+                m_readPosition = 0;
+            }
+            if (m_data.size() > kKeepFrames * kFrameBytes) {
+                m_data.erase(m_data.begin(), m_data.end() - kKeepFrames * kFrameBytes);
+            }
+        }
+        m_data.insert(m_data.end(), data, data + bytes);
+    }
+
+    size_t Read(uint8_t* dest, size_t frames) {
+        const size_t bytes = (std::min)(frames * kFrameBytes, m_data.size() - m_readPosition);
+        memcpy(dest, m_data.data() + m_readPosition, bytes);
+        m_readPosition += bytes;
+        if (m_readPosition >= m_data.size()) {
+            m_data.clear();
+            m_readPosition = 0;
+        } else if (m_readPosition > kRate * kFrameBytes) {
+            m_data.erase(m_data.begin(), m_data.begin() + m_readPosition);
+            m_readPosition = 0;
+        }
+        return bytes / kFrameBytes;
+    }
+
+private:
+    std::vector<uint8_t> m_data;
+    size_t m_readPosition = 0;
+};
+
+// AudioMixer's AudioBuffer
+class RingBuffer {
+public:
+    RingBuffer() { m_ring.Reset(kFrameBytes, kMaxFrames + kRate); }
+
+    void Write(const uint8_t* data, size_t frames) {
+        if (m_ring.Available() > kMaxFrames) m_ring.DropOldest(m_ring.Available() - kKeepFrames);
+        m_ring.Write(data, frames);
+    }
+
+    size_t Read(uint8_t* dest, size_t frames) { return m_ring.Read(dest, frames); }
+
+private:
+    AudioRingBuffer m_ring;
+};
+
+struct Result {
+    double realtime = 0.0;
+    std::vector<uint32_t> mixNs;
+    uint32_t worstAddNs = 0;
+};
+
+uint32_t Elapsed(Clock::time_point begin) {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count();
+}
+
+template <typename Buffer>
+Result Run(unsigned sourceCount, unsigned seconds, unsigned backlogSeconds, unsigned stallSeconds) {
+    std::vector<Buffer> buffers(sourceCount);
+    std::vector<std::vector<uint8_t>> scratch(sourceCount, std::vector<uint8_t>(kBlockFrames * kFrameBytes));
+    std::vector<float> packet(kPacketFrames * kChannels);
+    for (size_t i = 0; i < packet.size(); i++) packet[i] = 0.01f * (float)(i % 50);
+    const uint8_t* packetBytes = reinterpret_cast<const uint8_t*>(packet.data());
+    std::vector<float> mixed(kBlockFrames * kChannels);
+
+    // The source that runs ahead
+    for (unsigned i = 0; i < backlogSeconds * 100; i++) buffers[0].Write(packetBytes, kPacketFrames);
+
+    Result result;
+    result.mixNs.reserve((size_t)seconds * 50);
+    float sink = 0.0f;
+    const unsigned ticks = seconds * 100;
+    const Clock::time_point start = Clock::now();
+    for (unsigned tick = 0; tick < ticks; tick++) {
+        for (Buffer& buffer : buffers) {
+            const Clock::time_point begin = Clock::now();
+            buffer.Write(packetBytes, kPacketFrames);
+            result.worstAddNs = (std::max)(result.worstAddNs, Elapsed(begin));
+        }
+
+        // Every 20 ms, except while stalled (the first seconds of each minute
+        // after the first)
+        const unsigned secondOfMinute = tick / 100 % 60;
+        if (tick % 2 == 1 && (tick < 6000 || secondOfMinute >= stallSeconds)) {
+            const Clock::time_point begin = Clock::now();
+            std::fill(mixed.begin(), mixed.end(), 0.0f);
+            for (unsigned s = 0; s < sourceCount; s++) {
+                uint8_t* block = scratch[s].data();
+                const size_t read = buffers[s].Read(block, kBlockFrames);
+                memset(block + read * kFrameBytes, 0, (kBlockFrames - read) * kFrameBytes);
+                const float* samples = reinterpret_cast<const float*>(block);
+                for (size_t i = 0; i < mixed.size(); i++) mixed[i] += samples[i];
+            }
+            for (float& sample : mixed) sample = (std::max)(-1.0f, (std::min)(sample, 1.0f));
+            result.mixNs.push_back(Elapsed(begin));
+            sink += mixed[tick % mixed.size()];
+        }
+    }
+    const double wall = std::chrono::duration<double>(Clock::now() - start).count();
+    result.realtime = seconds / wall;
+    if (sink == 12345.0f) printf(" ");
+    return result;
+}
+
+double Percentile(std::vector<uint32_t> values, double p) {
+    if (values.empty()) return 0.0;
+    const size_t index = (std::min)(values.size() - 1, (size_t)(p * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index] / 1000.0;
+}
+
+void Print(unsigned sources, const char* name, const Result& r) {
+    printf("%7u  %-6s  %9.0fx  %8.1f  %8.1f  %8.1f  %8.1f  %10.1f\n", sources, name, r.realtime,
+           Percentile(r.mixNs, 0.5), Percentile(r.mixNs, 0.99), Percentile(r.mixNs, 0.999),
+           Percentile(r.mixNs, 1.0), r.worstAddNs / 1000.0);
+}
+
+int Usage() {
+    fprintf(stderr, "usage: MixBufferBench [--sources N] [--seconds N] [--backlog S] [--stall S]\n");
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    unsigned onlySources = 0, seconds = 300, backlog = 3, stall = 6;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "--sources") == 0) {
+            onlySources = (unsigned)strtoul(argv[++i], nullptr, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "--seconds") == 0) {
+            seconds = (unsigned)strtoul(argv[++i], nullptr, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "--backlog") == 0) {
+            backlog = (unsigned)strtoul(argv[++i], nullptr, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "--stall") == 0) {
+            stall = (unsigned)strtoul(argv[++i], nullptr, 10);
+        } else {
+            return Usage();
+        }
+    }
+    if (seconds == 0 || backlog > 5 || stall >= 60) return Usage();
+
+    printf("48 kHz stereo float, 10 ms packets, 20 ms mixes, %u s simulated, %u s backlog, %u s stall/min\n",
+           seconds, backlog, stall);
+    printf("%7s  %-6s  %10s  %8s  %8s  %8s  %8s  %10s\n", "sources", "buffer", "realtime", "mix p50", "p99", "p99.9",
+           "max", "add max us");
+    const std::vector<unsigned> counts = onlySources ? std::vector<unsigned>{ onlySources }
+                                                     : std::vector<unsigned>{ 2, 4, 8, 16, 32 };
+    for (unsigned sources : counts) {
+        Print(sources, "vector", Run<VectorBuffer>(sources, seconds, backlog, stall));
+        Print(sources, "ring", Run<RingBuffer>(sources, seconds, backlog, stall));
+    }
+    return 0;
+}
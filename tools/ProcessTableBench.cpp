@@ -0,0 +1,209 @@
+// ProcessTableBench: ProcessTable against the two std::maps ProcessSnapshot
+// used to fill, on a synthetic process tree.
+//
+//   ProcessTableBench [--processes N] [--refreshes N] [--queries N] [--churn P]
+//       A host with N processes (default 5000) the shape of a busy RDP
+//       server: a few hundred distinct executable names, new processes
+//       started under recent ones so sessions grow subtrees, and parents
+//       that already exited. Each refresh (default 200) rebuilds the
+//       snapshot with P percent of the short-lived processes replaced by new
+//       pids (default 2). Prints the time per
+//       refresh and per "is X a child of Y" query (default 1000000,
+//       three generations as IsChildOfProcess), and checks both answer
+//       every query the same.
+//
+// Platform-neutral; built with -DBUILD_BENCHMARKS=ON.
+
+#include "ProcessTable.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Process {
+    uint32_t pid;
+    uint32_t parent;
+    std::wstring name;
+};
+
+// The old ProcessSnapshot: pid -> parent and pid -> name
+struct MapSnapshot {
+    std::map<uint32_t, uint32_t> parents;
+    std::map<uint32_t, std::wstring> names;
+
+    void Refresh(const std::vector<Process>& processes) {
+        parents.clear();
+        names.clear();
+        for (const Process& p : processes) {
+            parents[p.pid] = p.parent;
+            names[p.pid] = p.name;
+        }
+    }
+
+    uint32_t ParentOf(uint32_t pid) const {
+        auto it = parents.find(pid);
+        return it != parents.end() ? it->second : 0;
+    }
+
+    // The old IsChildOfProcess(child, parent, snap)
+    bool IsChild(uint32_t child, uint32_t parent) const {
+        uint32_t current = child;
+        for (int depth = 0; depth < ProcessTable::kAncestorDepth; depth++) {
+            const uint32_t up = ParentOf(current);
+            if (up == 0 || up == current) return false;
+            if (up == parent) return true;
+            current = up;
+        }
+        return false;
+    }
+};
+
+void FillTable(ProcessTable& table, const std::vector<Process>& processes) {
+    table.Clear();
+    for (const Process& p : processes) table.Add(p.pid, p.parent, p.name.c_str());
+    table.Finish();
+}
+
+class Host {
+public:
+    Host(size_t count, std::mt19937& random) : m_random(random) {
+        for (int i = 0; i < 300; i++) m_exeNames.push_back(L"app" + std::to_wstring(i) + L".exe");
+        m_processes.push_back({ 4, 0, L"System" });
+        while (m_processes.size() < count) Spawn();
+    }
+
+    const std::vector<Process>& Processes() const { return m_processes; }
+
+    // Replace `percent` of the processes, from the short-lived tail (the
+    // services at the front stay); children keep the old parent pid, as on
+    // Windows
+    void Churn(unsigned percent) {
+        const size_t replace = m_processes.size() * percent / 100;
+        const size_t tail = (std::max)(m_processes.size() / 5, replace);
+        for (size_t i = 0; i < replace; i++) {
+            const size_t victim = m_processes.size() - 1 - m_random() % (std::min)(tail, m_processes.size() - 1);
+            m_processes[victim] = m_processes.back();
+            m_processes.pop_back();
+            Spawn();
+        }
+    }
+
+private:
+    void Spawn() {
+        // Mostly under a recent process (sessions grow in subtrees), now and
+        // then under one that is gone
+        const size_t recent = (std::min)(m_processes.size(), (size_t)400);
+        const uint32_t parent = m_random() % 50 == 0 ? m_nextPid + 4
+                                                     : m_processes[m_processes.size() - 1 - m_random() % recent].pid;
+        // Names repeat heavily: a few common ones, then the long tail
+        const uint32_t roll = m_random() % 100;
+        const std::wstring& name = roll < 30 ? m_common[roll % 5] : m_exeNames[m_random() % m_exeNames.size()];
+        m_processes.push_back({ m_nextPid, parent, name });
+        m_nextPid += 4;
+    }
+
+    std::mt19937& m_random;
+    std::vector<Process> m_processes;
+    std::vector<std::wstring> m_exeNames;
+    const std::wstring m_common[5] = { L"svchost.exe", L"conhost.exe", L"RuntimeBroker.exe", L"chrome.exe",
+                                       L"Telegram.exe" };
+    uint32_t m_nextPid = 8;
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t processCount = 5000;
+    size_t refreshes = 200;
+    size_t queries = 1000000;
+    unsigned churn = 2;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "--processes") == 0) {
+            processCount = strtoul(argv[++i], nullptr, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "--refreshes") == 0) {
+            refreshes = strtoul(argv[++i], nullptr, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "--queries") == 0) {
+            queries = strtoul(argv[++i], nullptr, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "--churn") == 0) {
+            churn = (unsigned)strtoul(argv[++i], nullptr, 10);
+        } else {
+            fprintf(stderr, "usage: ProcessTableBench [--processes N] [--refreshes N] [--queries N] [--churn P]\n");
+            return 2;
+        }
+    }
+    if (processCount < 2 || refreshes == 0 || queries == 0 || churn > 100) {
+        fprintf(stderr, "--processes must be at least 2, --refreshes and --queries positive, --churn at most 100\n");
+        return 2;
+    }
+
+    std::mt19937 random(21);
+    Host host(processCount, random);
+
+    // Refresh: the host changes a little between snapshots, as every 2 s
+    MapSnapshot maps;
+    ProcessTable table;
+    double mapSeconds = 0.0, tableSeconds = 0.0;
+    for (size_t r = 0; r < refreshes; r++) {
+        host.Churn(churn);
+        Clock::time_point begin = Clock::now();
+        maps.Refresh(host.Processes());
+        mapSeconds += std::chrono::duration<double>(Clock::now() - begin).count();
+        begin = Clock::now();
+        FillTable(table, host.Processes());
+        tableSeconds += std::chrono::duration<double>(Clock::now() - begin).count();
+    }
+
+    // Queries: (process, candidate ancestor) pairs, up to four generations
+    // apart or picked at random; about 40% are related
+    const std::vector<Process>& processes = host.Processes();
+    std::vector<std::pair<uint32_t, uint32_t>> pairs(4096);
+    for (auto& pair : pairs) {
+        const Process& p = processes[random() % processes.size()];
+        uint32_t ancestor = p.pid;
+        const int hops = (int)(random() % 5);
+        for (int h = 0; h < hops; h++) ancestor = maps.ParentOf(ancestor);
+        pair = { p.pid, random() % 4 == 0 ? processes[random() % processes.size()].pid : ancestor };
+    }
+
+    size_t mismatches = 0, related = 0;
+    for (const auto& pair : pairs) {
+        const bool expected = maps.IsChild(pair.first, pair.second);
+        related += expected;
+        if (table.IsDescendant(pair.first, pair.second) != expected) mismatches++;
+        const std::wstring* name = table.NameOf(pair.first);
+        if (!name || *name != maps.names[pair.first] || table.ParentOf(pair.first) != maps.ParentOf(pair.first)) {
+            mismatches++;
+        }
+    }
+
+    size_t hits = 0;
+    Clock::time_point begin = Clock::now();
+    for (size_t q = 0; q < queries; q++) {
+        const auto& pair = pairs[q % pairs.size()];
+        hits += maps.IsChild(pair.first, pair.second);
+    }
+    const double mapQuery = std::chrono::duration<double>(Clock::now() - begin).count();
+    begin = Clock::now();
+    for (size_t q = 0; q < queries; q++) {
+        const auto& pair = pairs[q % pairs.size()];
+        hits += table.IsDescendant(pair.first, pair.second);
+    }
+    const double tableQuery = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    printf("%zu processes, %u%% churn per refresh, %zu of %zu query pairs related (%zu hits)\n", processes.size(),
+           churn, related, pairs.size(), hits);
+    printf("std::map:     %8.1f us/refresh  %6.1f ns/query\n", mapSeconds * 1e6 / refreshes, mapQuery * 1e9 / queries);
+    printf("ProcessTable: %8.1f us/refresh  %6.1f ns/query\n", tableSeconds * 1e6 / refreshes,
+           tableQuery * 1e9 / queries);
+    printf("agreement:    %zu mismatches\n", mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,251 @@
+// SessionScanBench: the per-pid audio session walks against one scan per
+// poll cycle, over a mocked session enumerator.
+//
+//   SessionScanBench [--devices N] [--sessions N] [--targets N] [--call-ns N] [--cycles N]
+//       N render devices (default 4) with N sessions each (default 25),
+//       owned by the targets (default 6), their helper processes three
+//       levels down, and unrelated processes. Per poll cycle, the old way
+//       asks GetProcessPeakLevel and IsSessionActive for every target, each
+//       enumerating the devices, activating their session managers and
+//       walking every session; the new way collects every session once and
+//       builds a SessionActivityTable. Prints mocked COM calls and time per
+//       cycle for both, and checks they agree for every process. --call-ns
+//       busy-waits that long in each mocked call, standing in for COM cost
+//       (default 0: the bookkeeping alone).
+//
+// Platform-neutral; built with -DBUILD_BENCHMARKS=ON.
+
+#include "SessionScan.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Devices and sessions the way IMMDeviceEnumerator and
+// IAudioSessionEnumerator hand them out, one counted call at a time
+class MockEnumerator {
+public:
+    std::vector<std::vector<SessionSample>> devices;
+    std::unordered_map<uint32_t, uint32_t> parents;
+    Clock::duration callCost{0};
+    uint64_t calls = 0;
+
+    // EnumAudioEndpoints + GetCount
+    size_t EnumDevices() {
+        Call(2);
+        return devices.size();
+    }
+    // Item + Activate + GetSessionEnumerator + GetCount
+    size_t OpenDevice(size_t) {
+        Call(4);
+        return 0;
+    }
+    size_t SessionCount(size_t device) const { return devices[device].size(); }
+    // GetSession + As(IAudioSessionControl2) + GetProcessId
+    uint32_t SessionPid(size_t device, size_t session) {
+        Call(3);
+        return devices[device][session].pid;
+    }
+    // As(IAudioMeterInformation) + GetPeakValue
+    float Peak(size_t device, size_t session) {
+        Call(2);
+        return devices[device][session].peak;
+    }
+    // GetState
+    bool Active(size_t device, size_t session) {
+        Call(1);
+        return devices[device][session].active;
+    }
+
+    uint32_t ParentOf(uint32_t pid) const {
+        auto it = parents.find(pid);
+        return it != parents.end() ? it->second : 0u;
+    }
+
+    // IsChildOfProcess over the snapshot
+    bool IsChild(uint32_t child, uint32_t parent) const {
+        uint32_t current = child;
+        for (int depth = 0; depth < SessionActivityTable::kAncestorDepth; depth++) {
+            const uint32_t up = ParentOf(current);
+            if (up == 0 || up == current) return false;
+            if (up == parent) return true;
+            current = up;
+        }
+        return false;
+    }
+
+private:
+    void Call(int count) {
+        calls += count;
+        if (callCost.count() == 0) return;
+        const Clock::time_point until = Clock::now() + callCost * count;
+        while (Clock::now() < until) {
+        }
+    }
+};
+
+// The old GetProcessPeakLevel(pid, snap)
+float PerPidPeak(MockEnumerator& mock, uint32_t pid) {
+    float maxPeak = 0.0f;
+    const size_t deviceCount = mock.EnumDevices();
+    for (size_t d = 0; d < deviceCount; d++) {
+        mock.OpenDevice(d);
+        for (size_t i = 0; i < mock.SessionCount(d); i++) {
+            const uint32_t sessionPid = mock.SessionPid(d, i);
+            if (sessionPid == pid || (sessionPid != 0 && mock.IsChild(sessionPid, pid))) {
+                maxPeak = (std::max)(maxPeak, mock.Peak(d, i));
+            }
+        }
+    }
+    return maxPeak;
+}
+
+// The old IsSessionActive(pid, snap), stopping at the first active session
+bool PerPidActive(MockEnumerator& mock, uint32_t pid) {
+    const size_t deviceCount = mock.EnumDevices();
+    for (size_t d = 0; d < deviceCount; d++) {
+        mock.OpenDevice(d);
+        for (size_t i = 0; i < mock.SessionCount(d); i++) {
+            const uint32_t sessionPid = mock.SessionPid(d, i);
+            if (sessionPid == 0) continue;
+            if ((sessionPid == pid || mock.IsChild(sessionPid, pid)) && mock.Active(d, i)) return true;
+        }
+    }
+    return false;
+}
+
+// AudioSessionMonitor::ScanAllSessions
+void Scan(MockEnumerator& mock, std::vector<SessionSample>& samples, SessionActivityTable& table) {
+    samples.clear();
+    const size_t deviceCount = mock.EnumDevices();
+    for (size_t d = 0; d < deviceCount; d++) {
+        mock.OpenDevice(d);
+        for (size_t i = 0; i < mock.SessionCount(d); i++) {
+            const uint32_t pid = mock.SessionPid(d, i);
+            if (pid == 0) continue;
+            SessionSample sample = { pid, mock.Peak(d, i), mock.Active(d, i) };
+            samples.push_back(sample);
+        }
+    }
+    table.Build(samples, [&mock](uint32_t pid) { return mock.ParentOf(pid); });
+}
+
+// Targets 1000, 2000, ... each with helpers three levels down; unrelated
+// processes from 50000 up; a few system-sound sessions
+void Populate(MockEnumerator& mock, std::vector<uint32_t>& targets, std::vector<uint32_t>& everyone,
+              size_t deviceCount, size_t sessionCount, size_t targetCount) {
+    std::mt19937 random(3);
+    std::vector<uint32_t> owners;
+    for (uint32_t t = 1; t <= targetCount; t++) {
+        const uint32_t target = t * 1000;
+        targets.push_back(target);
+        everyone.push_back(target);
+        owners.push_back(target);
+        uint32_t parent = target;
+        for (uint32_t level = 1; level <= 3; level++) {
+            for (uint32_t helper = 0; helper < 2; helper++) {
+                const uint32_t pid = target + level * 10 + helper;
+                mock.parents[pid] = parent;
+                everyone.push_back(pid);
+                owners.push_back(pid);
+            }
+            parent = target + level * 10;
+        }
+    }
+    for (uint32_t pid = 50000; pid < 50000 + sessionCount; pid++) {
+        mock.parents[pid] = 4;
+        everyone.push_back(pid);
+        owners.push_back(pid);
+    }
+    owners.push_back(0);
+
+    mock.devices.resize(deviceCount);
+    for (auto& device : mock.devices) {
+        for (size_t i = 0; i < sessionCount; i++) {
+            const uint32_t pid = owners[random() % owners.size()];
+            device.push_back({ pid, (float)(random() % 1000) / 1000.0f, random() % 4 == 0 });
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t deviceCount = 4;
+    size_t sessionCount = 25;
+    size_t targetCount = 6;
+    unsigned callNs = 0;
+    size_t cycles = 2000;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "--devices") == 0) {
+            deviceCount = strtoul(argv[++i], nullptr, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "--sessions") == 0) {
+            sessionCount = strtoul(argv[++i], nullptr, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "--targets") == 0) {
+            targetCount = strtoul(argv[++i], nullptr, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "--call-ns") == 0) {
+            callNs = (unsigned)strtoul(argv[++i], nullptr, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "--cycles") == 0) {
+            cycles = strtoul(argv[++i], nullptr, 10);
+        } else {
+            fprintf(stderr, "usage: SessionScanBench [--devices N] [--sessions N] [--targets N] [--call-ns N] "
+                            "[--cycles N]\n");
+            return 2;
+        }
+    }
+    if (targetCount == 0 || cycles == 0) {
+        fprintf(stderr, "--targets and --cycles must be positive\n");
+        return 2;
+    }
+
+    MockEnumerator mock;
+    mock.callCost = std::chrono::nanoseconds(callNs);
+    std::vector<uint32_t> targets, everyone;
+    Populate(mock, targets, everyone, deviceCount, sessionCount, targetCount);
+
+    // Both ways must agree for every process, targets or not
+    std::vector<SessionSample> samples;
+    SessionActivityTable table;
+    Scan(mock, samples, table);
+    size_t mismatches = 0;
+    for (uint32_t pid : everyone) {
+        const SessionActivity entry = table.Find(pid);
+        if (entry.peak != PerPidPeak(mock, pid) || entry.active != PerPidActive(mock, pid)) mismatches++;
+    }
+
+    mock.calls = 0;
+    Clock::time_point begin = Clock::now();
+    float sink = 0.0f;
+    for (size_t c = 0; c < cycles; c++) {
+        for (uint32_t pid : targets) sink += PerPidPeak(mock, pid) + (PerPidActive(mock, pid) ? 1.0f : 0.0f);
+    }
+    const double perPidUs = std::chrono::duration<double, std::micro>(Clock::now() - begin).count() / cycles;
+    const double perPidCalls = (double)mock.calls / cycles;
+
+    mock.calls = 0;
+    begin = Clock::now();
+    for (size_t c = 0; c < cycles; c++) {
+        Scan(mock, samples, table);
+        for (uint32_t pid : targets) {
+            const SessionActivity entry = table.Find(pid);
+            sink += entry.peak + (entry.active ? 1.0f : 0.0f);
+        }
+    }
+    const double scanUs = std::chrono::duration<double, std::micro>(Clock::now() - begin).count() / cycles;
+    const double scanCalls = (double)mock.calls / cycles;
+
+    printf("%zu devices x %zu sessions, %zu targets, %u ns per call (checksum %.1f)\n", deviceCount, sessionCount,
+           targetCount, callNs, sink);
+    printf("per-pid walks: %8.0f calls/cycle  %10.1f us/cycle\n", perPidCalls, perPidUs);
+    printf("one scan:      %8.0f calls/cycle  %10.1f us/cycle\n", scanCalls, scanUs);
+    printf("agreement:     %zu of %zu processes differ\n", mismatches, everyone.size());
+    return mismatches == 0 ? 0 : 1;
+}
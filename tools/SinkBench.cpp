@@ -0,0 +1,131 @@
+// SinkBench: cost of getting a packet to an encoder sink.
+//
+//   SinkBench [--bytes N] [--streams N] [--workers N] [--packets N] [--write-us N]
+//       Writes N-byte packets (default 7680, one 20 ms block of 48 kHz
+//       stereo float) to NullSinks: first straight through IEncoderSink,
+//       then through an EncoderWorkerPool with the given streams (default 2)
+//       and workers (default 0 = one per hardware thread), one producer
+//       thread per stream. Prints packets per second and the time a
+//       producer spends in Submit(), which is what the capture and mixer
+//       threads pay. --write-us makes every pooled Write() busy-wait that
+//       long, standing in for encoding, to show how the workers share it.
+//
+// Platform-neutral; built with -DBUILD_BENCHMARKS=ON.
+
+#include "EncoderSink.h"
+#include "EncoderWorkerPool.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double Seconds(Clock::duration d) { return std::chrono::duration<double>(d).count(); }
+
+// NullSink that spends `writeMicros` per Write(), like an encoder would
+class BusySink : public NullSink {
+public:
+    explicit BusySink(unsigned writeMicros) : m_cost(std::chrono::microseconds(writeMicros)) {}
+    bool Write(const uint8_t* data, uint32_t size) override {
+        const Clock::time_point until = Clock::now() + m_cost;
+        while (Clock::now() < until) {
+        }
+        return NullSink::Write(data, size);
+    }
+
+private:
+    const Clock::duration m_cost;
+};
+
+void Direct(size_t bytes, size_t packets) {
+    // From the registry, like CaptureManager's sinks; the volatile read keeps
+    // the compiler from seeing through the virtual call
+    EncoderSinkRegistry registry;
+    registry.Register(AudioFormat::WAV, [] { return std::make_unique<NullSink>(); });
+    std::unique_ptr<IEncoderSink> owner = registry.Create(AudioFormat::WAV);
+    IEncoderSink* volatile opaque = owner.get();
+    IEncoderSink* sink = opaque;
+    sink->Open(L"", nullptr, 0);
+    const std::vector<uint8_t> packet(bytes, 0x55);
+    const Clock::time_point begin = Clock::now();
+    for (size_t i = 0; i < packets; i++) sink->Write(packet.data(), (uint32_t)packet.size());
+    const double wall = Seconds(Clock::now() - begin);
+    sink->Close();
+    printf("direct:  %10.0f packets/s  %8.1f ns/packet\n", packets / wall, wall * 1e9 / packets);
+}
+
+void Pooled(size_t bytes, size_t packets, unsigned streamCount, unsigned workers, unsigned writeMicros) {
+    EncoderWorkerPool pool(workers);
+    std::vector<std::shared_ptr<EncoderWorkerPool::Stream>> streams;
+    for (unsigned s = 0; s < streamCount; s++) {
+        std::unique_ptr<IEncoderSink> sink = writeMicros ? std::make_unique<BusySink>(writeMicros)
+                                                         : std::make_unique<NullSink>();
+        streams.push_back(pool.OpenStream(std::move(sink), 64 << 20, 256 << 20));
+    }
+
+    std::vector<double> submitSeconds(streamCount);
+    const Clock::time_point begin = Clock::now();
+    std::vector<std::thread> producers;
+    for (unsigned s = 0; s < streamCount; s++) {
+        producers.emplace_back([&, s] {
+            const std::vector<uint8_t> packet(bytes, (uint8_t)s);
+            const Clock::time_point start = Clock::now();
+            for (size_t i = 0; i < packets; i++) pool.Submit(*streams[s], packet.data(), (uint32_t)packet.size());
+            submitSeconds[s] = Seconds(Clock::now() - start);
+        });
+    }
+    for (std::thread& producer : producers) producer.join();
+    for (auto& stream : streams) pool.CloseStream(*stream);
+    const double wall = Seconds(Clock::now() - begin);
+
+    double submit = 0.0;
+    for (double seconds : submitSeconds) submit += seconds;
+    const EncoderWorkerPool::Stats stats = pool.GetStats();
+    const double total = (double)packets * streamCount;
+    printf("pool:    %10.0f packets/s  %8.1f ns/Submit  (%u streams, %u workers, %llu written, "
+           "%llu backpressure, %llu rejected)\n",
+           total / wall, submit * 1e9 / total, streamCount, pool.GetWorkerCount(),
+           (unsigned long long)stats.packetsWritten, (unsigned long long)stats.backpressureEvents,
+           (unsigned long long)stats.rejectedPackets);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t bytes = 7680;
+    size_t packets = 200000;
+    unsigned streams = 2;
+    unsigned workers = 0;
+    unsigned writeMicros = 0;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "--bytes") == 0) {
+            bytes = strtoul(argv[++i], nullptr, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "--streams") == 0) {
+            streams = (unsigned)strtoul(argv[++i], nullptr, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "--workers") == 0) {
+            workers = (unsigned)strtoul(argv[++i], nullptr, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "--packets") == 0) {
+            packets = strtoul(argv[++i], nullptr, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "--write-us") == 0) {
+            writeMicros = (unsigned)strtoul(argv[++i], nullptr, 10);
+        } else {
+            fprintf(stderr, "usage: SinkBench [--bytes N] [--streams N] [--workers N] [--packets N] [--write-us N]\n");
+            return 2;
+        }
+    }
+    if (bytes == 0 || streams == 0 || packets == 0) {
+        fprintf(stderr, "--bytes, --streams and --packets must be positive\n");
+        return 2;
+    }
+
+    printf("%zu-byte packets, %zu per stream\n", bytes, packets);
+    Direct(bytes, packets);
+    Pooled(bytes, packets, streams, workers, writeMicros);
+    return 0;
+}
@@ -0,0 +1,659 @@
+// VadBench: benchmark and accuracy harness for VoiceActivityDetector.
+//
+//   VadBench [--threshold F] [--window S] <file.wav>...
+//       Run each WAV through the detector and compare with its labels: an
+//       Audacity label track (file.txt next to file.wav, "start<TAB>end
+//       <TAB>text" per line, every label is speech). No label file means
+//       the file has no speech. Reports frame true / false positive rates
+//       and the accuracy of per-window decisions (speech ratio >= F,
+//       default 0.2, over S-second windows, default 2), the signal
+//       MonitorThread acts on.
+//
+//   VadBench --bench [--seconds N]
+//       Frames per second on one core for every SIMD level this CPU runs,
+//       on N seconds (default 20) of 48 kHz stereo float speech in noise,
+//       plus how far each level's features are from the scalar reference.
+//
+//   VadBench --synthesize <dir> [--seed N]
+//       Write labelled fixtures: formant-synthesized speech (clean, quiet,
+//       in noise) and non-speech (notification chimes, ringback, music,
+//       background noise).
+//
+// The synthesized fixtures only show the detector agrees with the model it
+// was tuned on, so no WAV files are committed. For real audio, record calls
+// and notification sounds from the monitored apps, or take the speech, music
+// and noise sets of the MUSAN corpus (OpenSLR resource 17, openslr.org/17).
+// Convert them to WAV and label the speech in Audacity: select it, Edit >
+// Labels > Add Label at Selection, then File > Export > Export Labels to
+// file.txt next to file.wav. MUSAN's speech is continuous reading, so one
+// label over the whole file will do; music and noise need no label file.
+// Keep such sets out of the tree: recordings of calls are private, and
+// MUSAN is several gigabytes. The kernels and detection on synthetic speech,
+// chimes, ringback and noise are covered by tests/VadKernelsTest.cpp.
+//
+// Platform-neutral; built with -DBUILD_VAD_BENCH=ON.
+
+#include "VoiceActivityDetector.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// ============================================================
+// WAV files and labels
+// ============================================================
+
+struct WavFile {
+    SampleFormat format;
+    std::vector<uint8_t> data;
+
+    size_t GetFrames() const { return format.blockAlign ? data.size() / format.blockAlign : 0; }
+};
+
+uint32_t ReadLe(const uint8_t* p, int bytes) {
+    uint32_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) value = (value << 8) | p[i];
+    return value;
+}
+
+bool ReadWav(const char* path, WavFile& wav) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return false;
+    std::vector<uint8_t> bytes;
+    uint8_t buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) bytes.insert(bytes.end(), buffer, buffer + n);
+    fclose(file);
+
+    if (bytes.size() < 12 || memcmp(bytes.data(), "RIFF", 4) != 0 || memcmp(bytes.data() + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+
+    bool haveFormat = false;
+    size_t pos = 12;
+    while (pos + 8 <= bytes.size()) {
+        const uint8_t* chunk = bytes.data() + pos;
+        const size_t size = ReadLe(chunk + 4, 4);
+        const size_t available = (std::min)(size, bytes.size() - pos - 8);
+        if (memcmp(chunk, "fmt ", 4) == 0 && available >= 16) {
+            uint32_t tag = ReadLe(chunk + 8, 2);
+            const uint32_t bits = ReadLe(chunk + 22, 2);
+            if (tag == 0xFFFE && available >= 40) tag = ReadLe(chunk + 32, 2);   // Extensible: subformat GUID
+            wav.format.channels = ReadLe(chunk + 10, 2);
+            wav.format.sampleRate = ReadLe(chunk + 12, 4);
+            wav.format.blockAlign = ReadLe(chunk + 20, 2);
+            if (tag == 3 && bits == 32) wav.format.type = SampleType::Float32;
+            else if (tag == 1 && bits == 16) wav.format.type = SampleType::Int16;
+            else if (tag == 1 && bits == 24) wav.format.type = SampleType::Int24;
+            else if (tag == 1 && bits == 32) wav.format.type = SampleType::Int32;
+            haveFormat = true;
+        } else if (memcmp(chunk, "data", 4) == 0 && haveFormat) {
+            wav.data.assign(chunk + 8, chunk + 8 + available);
+            return wav.format.IsValid();
+        }
+        pos += 8 + size + (size & 1);
+    }
+    return false;
+}
+
+void WriteLe(FILE* file, uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) fputc((value >> (8 * i)) & 0xFF, file);
+}
+
+// Mono 16-bit PCM
+bool WriteWav(const std::string& path, const std::vector<float>& samples, uint32_t rate) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) return false;
+    const uint32_t dataBytes = (uint32_t)samples.size() * 2;
+    fwrite("RIFF", 1, 4, file);
+    WriteLe(file, 36 + dataBytes, 4);
+    fwrite("WAVEfmt ", 1, 8, file);
+    WriteLe(file, 16, 4);
+    WriteLe(file, 1, 2);
+    WriteLe(file, 1, 2);
+    WriteLe(file, rate, 4);
+    WriteLe(file, rate * 2, 4);
+    WriteLe(file, 2, 2);
+    WriteLe(file, 16, 2);
+    fwrite("data", 1, 4, file);
+    WriteLe(file, dataBytes, 4);
+    for (float s : samples) {
+        const float clamped = (std::max)(-1.0f, (std::min)(s, 32767.0f / 32768.0f));
+        WriteLe(file, (uint32_t)(int32_t)std::lround(clamped * 32768.0f), 2);
+    }
+    const bool ok = ferror(file) == 0;
+    fclose(file);
+    return ok;
+}
+
+struct Interval {
+    double start;
+    double end;
+};
+
+// Audacity label track; false when there is none
+bool ReadLabels(const std::string& path, std::vector<Interval>& labels) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file) return false;
+    char line[1024];
+    while (fgets(line, sizeof(line), file)) {
+        double start, end;
+        if (line[0] == '\\') continue;   // Spectral selection line
+        if (sscanf(line, "%lf %lf", &start, &end) == 2 && end > start) labels.push_back({ start, end });
+    }
+    fclose(file);
+    return true;
+}
+
+bool WriteLabels(const std::string& path, const std::vector<Interval>& labels) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) return false;
+    for (const Interval& label : labels) fprintf(file, "%.6f\t%.6f\tspeech\n", label.start, label.end);
+    fclose(file);
+    return true;
+}
+
+// Seconds of [start, end) covered by labels
+double Covered(const std::vector<Interval>& labels, double start, double end) {
+    double covered = 0.0;
+    for (const Interval& label : labels) {
+        covered += (std::max)(0.0, (std::min)(end, label.end) - (std::max)(start, label.start));
+    }
+    return covered;
+}
+
+std::string LabelPath(const char* wavPath) {
+    std::string path = wavPath;
+    const size_t dot = path.find_last_of('.');
+    const size_t slash = path.find_last_of("/\\");
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) path.erase(dot);
+    return path + ".txt";
+}
+
+// ============================================================
+// Accuracy
+// ============================================================
+
+struct Score {
+    uint64_t speechFrames = 0;      // Labelled speech
+    uint64_t otherFrames = 0;
+    uint64_t truePositives = 0;
+    uint64_t falsePositives = 0;
+    uint64_t windows = 0;
+    uint64_t windowsCorrect = 0;
+    uint64_t speechWindows = 0;
+    uint64_t speechWindowsFound = 0;
+    uint64_t otherWindows = 0;
+    uint64_t otherWindowsFlagged = 0;
+
+    void Add(const Score& other) {
+        speechFrames += other.speechFrames;
+        otherFrames += other.otherFrames;
+        truePositives += other.truePositives;
+        falsePositives += other.falsePositives;
+        windows += other.windows;
+        windowsCorrect += other.windowsCorrect;
+        speechWindows += other.speechWindows;
+        speechWindowsFound += other.speechWindowsFound;
+        otherWindows += other.otherWindows;
+        otherWindowsFlagged += other.otherWindowsFlagged;
+    }
+};
+
+double Percent(uint64_t part, uint64_t whole) {
+    return whole ? 100.0 * (double)part / (double)whole : 0.0;
+}
+
+void PrintScore(const char* name, const Score& s) {
+    printf("%-28s TPR %5.1f%%  FPR %5.1f%%  windows %3llu: correct %5.1f%%, speech found %5.1f%%, other flagged %5.1f%%\n",
+        name, Percent(s.truePositives, s.speechFrames), Percent(s.falsePositives, s.otherFrames),
+        (unsigned long long)s.windows, Percent(s.windowsCorrect, s.windows),
+        Percent(s.speechWindowsFound, s.speechWindows), Percent(s.otherWindowsFlagged, s.otherWindows));
+}
+
+bool Evaluate(const char* path, float threshold, double windowSeconds, Score& total) {
+    WavFile wav;
+    if (!ReadWav(path, wav)) {
+        fprintf(stderr, "%s: not a supported WAV file\n", path);
+        return false;
+    }
+    std::vector<Interval> labels;
+    ReadLabels(LabelPath(path), labels);
+
+    VoiceActivityDetector vad;
+    if (!vad.Initialize(VadSettings(), wav.format)) {
+        fprintf(stderr, "%s: unsupported format\n", path);
+        return false;
+    }
+
+    // 10 ms packets, like a capture callback
+    std::vector<VoiceActivityDetector::Features> features;
+    const size_t packet = (size_t)(std::max)(1u, wav.format.sampleRate / 100);
+    const size_t frames = wav.GetFrames();
+    for (size_t offset = 0; offset < frames; offset += packet) {
+        vad.Process(wav.data.data() + offset * wav.format.blockAlign, (std::min)(packet, frames - offset), &features);
+    }
+
+    Score score;
+    const double frameSeconds = VoiceActivityDetector::kFrameSize / vad.GetAnalysisRate();
+    for (size_t i = 0; i < features.size(); i++) {
+        const double start = i * frameSeconds;
+        const bool labelled = Covered(labels, start, start + frameSeconds) >= frameSeconds / 2;
+        if (labelled) {
+            score.speechFrames++;
+            if (features[i].speech) score.truePositives++;
+        } else {
+            score.otherFrames++;
+            if (features[i].speech) score.falsePositives++;
+        }
+    }
+
+    // A window is speech when at least a quarter of it is labelled
+    const size_t perWindow = (std::max)((size_t)1, (size_t)std::lround(windowSeconds / frameSeconds));
+    for (size_t first = 0; first + perWindow <= features.size(); first += perWindow) {
+        size_t speech = 0;
+        for (size_t i = first; i < first + perWindow; i++) speech += features[i].speech ? 1 : 0;
+        const double start = first * frameSeconds;
+        const bool truth = Covered(labels, start, start + perWindow * frameSeconds) >= perWindow * frameSeconds / 4;
+        const bool decided = (float)speech / (float)perWindow >= threshold;
+        score.windows++;
+        if (truth == decided) score.windowsCorrect++;
+        if (truth) {
+            score.speechWindows++;
+            if (decided) score.speechWindowsFound++;
+        } else {
+            score.otherWindows++;
+            if (decided) score.otherWindowsFlagged++;
+        }
+    }
+
+    std::string name = path;
+    const size_t slash = name.find_last_of("/\\");
+    if (slash != std::string::npos) name.erase(0, slash + 1);
+    PrintScore(name.c_str(), score);
+    total.Add(score);
+    return true;
+}
+
+// ============================================================
+// Synthetic fixtures
+// ============================================================
+
+class Synthesizer {
+public:
+    static constexpr uint32_t kRate = 48000;
+
+    explicit Synthesizer(uint32_t seed) : m_rng(seed) {}
+
+    // Phrases of formant-synthesized syllables with pauses between them.
+    // Labels cover each phrase (short gaps between words included).
+    std::vector<float> Speech(double seconds, float levelDb, std::vector<Interval>& labels) {
+        std::vector<float> out((size_t)(seconds * kRate), 0.0f);
+        size_t pos = (size_t)(Real(0.5, 1.5) * kRate);
+        while (true) {
+            std::vector<float> phrase = Phrase();
+            if (pos + phrase.size() >= out.size()) break;
+            Normalize(phrase, levelDb);
+            std::copy(phrase.begin(), phrase.end(), out.begin() + pos);
+            labels.push_back({ (double)pos / kRate, (double)(pos + phrase.size()) / kRate });
+            pos += phrase.size() + (size_t)(Real(0.4, 2.5) * kRate);
+        }
+        return out;
+    }
+
+    // Chimes: a few decaying partials every few seconds
+    std::vector<float> Notifications(double seconds, float levelDb) {
+        std::vector<float> out((size_t)(seconds * kRate), 0.0f);
+        size_t pos = (size_t)(Real(0.2, 1.0) * kRate);
+        while (pos < out.size()) {
+            const int notes = Uniform(1, 3);
+            for (int note = 0; note < notes; note++) {
+                const double f0 = Real(600.0, 1800.0);
+                const double decay = Real(4.0, 12.0);
+                const size_t length = (size_t)(Real(0.15, 0.6) * kRate);
+                const float amplitude = DbToLinear(levelDb) * 1.4f;
+                for (size_t i = 0; i < length && pos + i < out.size(); i++) {
+                    const double t = (double)i / kRate;
+                    const double env = std::exp(-decay * t) * (std::min)(1.0, t * 500.0);
+                    const double s = std::sin(2 * kPi * f0 * t) + 0.4 * std::sin(2 * kPi * f0 * 2.76 * t) +
+                                     0.2 * std::sin(2 * kPi * f0 * 5.4 * t);
+                    out[pos + i] += (float)(amplitude * env * s / 1.6);
+                }
+                pos += length;
+            }
+            pos += (size_t)(Real(2.0, 6.0) * kRate);
+        }
+        return out;
+    }
+
+    // 425 Hz, 1 s on / 4 s off
+    std::vector<float> Ringback(double seconds, float levelDb) {
+        std::vector<float> out((size_t)(seconds * kRate), 0.0f);
+        const float amplitude = DbToLinear(levelDb) * 1.414f;
+        for (size_t i = 0; i < out.size(); i++) {
+            const double t = (double)i / kRate;
+            if (std::fmod(t, 5.0) < 1.0) out[i] = (float)(amplitude * std::sin(2 * kPi * 425.0 * t));
+        }
+        AddNoise(out, levelDb - 45.0f);
+        return out;
+    }
+
+    // Chords of harmonic notes plus a drum hit on every beat
+    std::vector<float> Music(double seconds, float levelDb) {
+        std::vector<float> out((size_t)(seconds * kRate), 0.0f);
+        const size_t beat = (size_t)(0.5 * kRate);
+        const int scale[] = { 0, 2, 4, 5, 7, 9, 11, 12 };
+        for (size_t start = 0; start < out.size(); start += beat) {
+            const int root = 48 + scale[Uniform(0, 7)];
+            const int chord[] = { root, root + 4, root + 7, root + 12 + scale[Uniform(0, 4)] };
+            for (int midi : chord) {
+                const double f = 440.0 * std::pow(2.0, (midi - 69) / 12.0);
+                for (size_t i = 0; i < beat && start + i < out.size(); i++) {
+                    const double t = (double)i / kRate;
+                    const double env = std::exp(-2.0 * t) * (std::min)(1.0, t * 200.0);
+                    double s = 0.0;
+                    for (int h = 1; h <= 6; h++) s += std::sin(2 * kPi * f * h * t) / (h * h);
+                    out[start + i] += (float)(env * s);
+                }
+            }
+            for (size_t i = 0; i < beat / 4 && start + i < out.size(); i++) {
+                out[start + i] += (float)(Gaussian() * std::exp(-30.0 * i / kRate) * 0.8);
+            }
+        }
+        Normalize(out, levelDb);
+        return out;
+    }
+
+    // Low-passed noise whose level wanders over `rangeDb`, plus mains hum
+    std::vector<float> Noise(double seconds, float levelDb, float rangeDb) {
+        std::vector<float> out((size_t)(seconds * kRate), 0.0f);
+        double low = 0.0;
+        double level = 0.0;
+        for (size_t i = 0; i < out.size(); i++) {
+            if (i % kRate == 0) level = Real(-rangeDb / 2, rangeDb / 2);
+            low += 0.2 * (Gaussian() - low);
+            out[i] = (float)((low + 0.2 * Gaussian()) * DbToLinear((float)level) +
+                             0.1 * std::sin(2 * kPi * 50.0 * i / kRate));
+        }
+        Normalize(out, levelDb);
+        return out;
+    }
+
+    void AddNoise(std::vector<float>& samples, float levelDb) {
+        const float amplitude = DbToLinear(levelDb);
+        for (float& s : samples) s += (float)(Gaussian() * amplitude);
+    }
+
+    bool Write(const std::string& dir) {
+        struct Fixture {
+            const char* name;
+            std::vector<float> samples;
+            std::vector<Interval> labels;
+            bool labelled;
+        };
+        std::vector<Fixture> fixtures;
+
+        Fixture clean = { "speech_clean", {}, {}, true };
+        clean.samples = Speech(60.0, -24.0f, clean.labels);
+        AddNoise(clean.samples, -80.0f);
+        fixtures.push_back(clean);
+
+        Fixture quiet = { "speech_quiet", {}, {}, true };
+        quiet.samples = Speech(60.0, -45.0f, quiet.labels);
+        AddNoise(quiet.samples, -85.0f);
+        fixtures.push_back(quiet);
+
+        Fixture noisy = { "speech_noise", {}, {}, true };
+        noisy.samples = Speech(60.0, -24.0f, noisy.labels);
+        std::vector<float> background = Noise(60.0, -36.0f, 6.0f);
+        for (size_t i = 0; i < noisy.samples.size(); i++) noisy.samples[i] += background[i];
+        fixtures.push_back(noisy);
+
+        fixtures.push_back({ "notifications", Notifications(60.0, -18.0f), {}, false });
+        fixtures.push_back({ "ringback", Ringback(60.0, -20.0f), {}, false });
+        fixtures.push_back({ "music", Music(60.0, -20.0f), {}, false });
+        fixtures.push_back({ "noise", Noise(60.0, -40.0f, 20.0f), {}, false });
+
+        for (Fixture& fixture : fixtures) {
+            const std::string base = dir + "/" + fixture.name;
+            if (!WriteWav(base + ".wav", fixture.samples, kRate)) return false;
+            if (fixture.labelled && !WriteLabels(base + ".txt", fixture.labels)) return false;
+            printf("%s.wav  %.0f s, %zu labels\n", base.c_str(), (double)fixture.samples.size() / kRate,
+                fixture.labels.size());
+        }
+        return true;
+    }
+
+private:
+    struct Vowel {
+        double f1, f2, f3;
+    };
+
+    // 3-8 words of 1-3 syllables; a syllable is an optional fricative
+    // onset and a voiced vowel through three formant resonators
+    std::vector<float> Phrase() {
+        static const Vowel vowels[] = {
+            { 730, 1090, 2440 }, { 270, 2290, 3010 }, { 300, 870, 2240 },
+            { 530, 1840, 2480 }, { 570, 840, 2410 }, { 440, 1020, 2240 }
+        };
+        std::vector<float> out;
+        const double baseF0 = Chance(0.5) ? Real(95.0, 140.0) : Real(180.0, 240.0);
+        const int words = Uniform(3, 8);
+        double phase = 0.0;
+        for (int w = 0; w < words; w++) {
+            const int syllables = Uniform(1, 3);
+            for (int s = 0; s < syllables; s++) {
+                if (Chance(0.4)) {
+                    // Fricative: high-passed noise
+                    const size_t length = (size_t)(Real(0.04, 0.09) * kRate);
+                    double previous = 0.0;
+                    for (size_t i = 0; i < length; i++) {
+                        const double x = Gaussian();
+                        const double env = std::sin(kPi * i / length);
+                        out.push_back((float)((x - previous) * env * 0.08));
+                        previous = x;
+                    }
+                }
+
+                const Vowel& v = vowels[Uniform(0, 5)];
+                const size_t length = (size_t)(Real(0.12, 0.26) * kRate);
+                const double gain = Real(0.5, 1.0);
+                const double drift = Real(-0.15, 0.1);
+                Resonator r1(v.f1, 80.0), r2(v.f2, 100.0), r3(v.f3, 150.0);
+                double glottal = 0.0;
+                for (size_t i = 0; i < length; i++) {
+                    const double t = (double)i / length;
+                    const double f0 = baseF0 * (1.0 + drift * t + 0.01 * Gaussian());
+                    phase += f0 / kRate;
+                    double pulse = 0.0;
+                    if (phase >= 1.0) {
+                        phase -= 1.0;
+                        pulse = 1.0;
+                    }
+                    glottal += 0.1 * (pulse * 10.0 - glottal);   // Spectral tilt
+                    const double source = glottal + 0.02 * Gaussian();
+                    const double y = r1.Run(source) + 0.6 * r2.Run(source) + 0.3 * r3.Run(source);
+                    const double env = (std::min)(1.0, (std::min)(t, 1.0 - t) * 8.0);
+                    out.push_back((float)(y * env * gain));
+                }
+            }
+            if (w + 1 < words) out.resize(out.size() + (size_t)(Real(0.02, 0.12) * kRate), 0.0f);
+        }
+        return out;
+    }
+
+    struct Resonator {
+        double b1, b2, a0, y1 = 0.0, y2 = 0.0;
+
+        Resonator(double frequency, double bandwidth) {
+            const double r = std::exp(-kPi * bandwidth / kRate);
+            b1 = 2.0 * r * std::cos(2.0 * kPi * frequency / kRate);
+            b2 = -r * r;
+            a0 = 1.0 - r;
+        }
+
+        double Run(double x) {
+            const double y = a0 * x + b1 * y1 + b2 * y2;
+            y2 = y1;
+            y1 = y;
+            return y;
+        }
+    };
+
+    // Scale so the non-silent part has the given RMS
+    static void Normalize(std::vector<float>& samples, float levelDb) {
+        double sum = 0.0;
+        size_t count = 0;
+        for (float s : samples) {
+            if (s != 0.0f) {
+                sum += (double)s * s;
+                count++;
+            }
+        }
+        if (count == 0 || sum == 0.0) return;
+        const float scale = DbToLinear(levelDb) / (float)std::sqrt(sum / count);
+        for (float& s : samples) s *= scale;
+    }
+
+    static float DbToLinear(float db) { return std::pow(10.0f, db / 20.0f); }
+
+    int Uniform(int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(m_rng); }
+    double Real(double lo, double hi) { return std::uniform_real_distribution<double>(lo, hi)(m_rng); }
+    bool Chance(double p) { return std::bernoulli_distribution(p)(m_rng); }
+    double Gaussian() { return m_gaussian(m_rng); }
+
+    std::mt19937 m_rng;
+    std::normal_distribution<double> m_gaussian;
+};
+
+// ============================================================
+// Benchmark
+// ============================================================
+
+int Bench(double seconds) {
+    Synthesizer synthesizer(7);
+    std::vector<Interval> labels;
+    std::vector<float> mono = synthesizer.Speech(seconds, -24.0f, labels);
+    synthesizer.AddNoise(mono, -45.0f);
+
+    SampleFormat format;
+    format.type = SampleType::Float32;
+    format.sampleRate = Synthesizer::kRate;
+    format.channels = 2;
+    format.channelMask = DefaultChannelMask(2);
+    format.blockAlign = 8;
+    std::vector<float> stereo(mono.size() * 2);
+    for (size_t i = 0; i < mono.size(); i++) stereo[2 * i] = stereo[2 * i + 1] = mono[i];
+
+    const size_t packet = Synthesizer::kRate / 100;
+    auto run = [&](VoiceActivityDetector& vad, std::vector<VoiceActivityDetector::Features>* features) {
+        vad.Reset();
+        for (size_t offset = 0; offset < mono.size(); offset += packet) {
+            vad.Process(stereo.data() + offset * 2, (std::min)(packet, mono.size() - offset), features);
+        }
+        return vad.TakeCounts();
+    };
+
+    printf("%.0f s of 48 kHz stereo float32, 10 ms packets, %zu-sample frames at 8 kHz\n",
+        seconds, VoiceActivityDetector::kFrameSize);
+
+    std::vector<VoiceActivityDetector::Features> reference;
+    const SimdLevel best = DetectSimdLevel();
+    const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2 };
+    for (SimdLevel level : levels) {
+        if (level > best) break;
+
+        VoiceActivityDetector vad;
+        vad.Initialize(VadSettings(), format);
+        vad.SetSimdLevel(level);
+        if (vad.GetSimdLevel() != level) continue;
+
+        std::vector<VoiceActivityDetector::Features> features;
+        run(vad, &features);
+        if (level == SimdLevel::Scalar) reference = features;
+
+        float energyError = 0.0f;
+        float flatnessError = 0.0f;
+        size_t decisions = 0;
+        for (size_t i = 0; i < features.size() && i < reference.size(); i++) {
+            energyError = (std::max)(energyError, std::fabs(features[i].energyDb - reference[i].energyDb));
+            flatnessError = (std::max)(flatnessError, std::fabs(features[i].flatness - reference[i].flatness));
+            if (features[i].speech != reference[i].speech) decisions++;
+        }
+
+        uint64_t frames = 0;
+        int passes = 0;
+        const auto begin = std::chrono::steady_clock::now();
+        double wall = 0.0;
+        do {
+            frames += run(vad, nullptr).frames;
+            passes++;
+            wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        } while (wall < 1.0);
+
+        printf("%-6s  %10.0f frames/s  %7.0fx realtime  max diff: energy %.2g dB, flatness %.2g, decisions %zu\n",
+            SimdLevelName(level), frames / wall, passes * seconds / wall, energyError, flatnessError, decisions);
+    }
+    return 0;
+}
+
+int Usage() {
+    fprintf(stderr,
+        "usage: VadBench [--threshold F] [--window S] <file.wav>...\n"
+        "       VadBench --bench [--seconds N]\n"
+        "       VadBench --synthesize <dir> [--seed N]\n");
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc >= 3 && strcmp(argv[1], "--synthesize") == 0) {
+        uint32_t seed = 1;
+        if (argc >= 5 && strcmp(argv[3], "--seed") == 0) seed = (uint32_t)strtoul(argv[4], nullptr, 10);
+        if (!Synthesizer(seed).Write(argv[2])) {
+            fprintf(stderr, "%s: cannot write fixtures\n", argv[2]);
+            return 1;
+        }
+        return 0;
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "--bench") == 0) {
+        double seconds = 20.0;
+        if (argc >= 4 && strcmp(argv[2], "--seconds") == 0) seconds = atof(argv[3]);
+        if (seconds <= 0.0) return Usage();
+        return Bench(seconds);
+    }
+
+    float threshold = 0.2f;
+    double windowSeconds = 2.0;
+    std::vector<const char*> files;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            threshold = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+            windowSeconds = atof(argv[++i]);
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+            return Usage();
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty() || windowSeconds <= 0.0) return Usage();
+
+    Score total;
+    for (const char* path : files) {
+        if (!Evaluate(path, threshold, windowSeconds, total)) return 1;
+    }
+    PrintScore("total", total);
+    return 0;
+}